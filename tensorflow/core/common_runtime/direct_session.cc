@@ -90,6 +90,33 @@ auto* direct_session_runs = monitoring::Counter<0>::New(
     "/tensorflow/core/direct_session_runs",
     "The number of times DirectSession::Run() has been called.");
 
+auto* executor_cache_hits = monitoring::Counter<0>::New(
+    "/tensorflow/core/direct_session/executor_cache_hits",
+    "The number of DirectSession runs that reused cached executors.");
+
+auto* executor_cache_misses = monitoring::Counter<0>::New(
+    "/tensorflow/core/direct_session/executor_cache_misses",
+    "The number of DirectSession runs that had to create executors.");
+
+auto* executor_cache_evictions = monitoring::Counter<0>::New(
+    "/tensorflow/core/direct_session/executor_cache_evictions",
+    "The number of signatures evicted from DirectSession executor caches.");
+
+auto* executor_build_time_usecs = monitoring::Counter<0>::New(
+    "/tensorflow/core/direct_session/executor_build_time_usecs",
+    "The total time in microseconds DirectSession spent creating executors "
+    "after executor cache misses.");
+
+auto* optimized_graph_cache_hits = monitoring::Counter<0>::New(
+    "/tensorflow/core/direct_session/optimized_graph_cache_hits",
+    "The number of DirectSession signatures whose partition graphs were "
+    "loaded from the on-disk optimized graph cache.");
+
+auto* optimized_graph_cache_misses = monitoring::Counter<0>::New(
+    "/tensorflow/core/direct_session/optimized_graph_cache_misses",
+    "The number of DirectSession signatures whose partition graphs had to be "
+    "built because the on-disk optimized graph cache had no usable entry.");
+
 Status NewThreadPoolFromThreadPoolOptions(
     const SessionOptions& options,
     const ThreadPoolOptionProto& thread_pool_options, int pool_number,
@@ -392,6 +419,13 @@ DirectSession::DirectSession(const SessionOptions& options,
     }
     ++devices_added;
   }
+
+  const string& graph_cache_dir =
+      options_.config.experimental().optimized_graph_cache_dir();
+  if (!graph_cache_dir.empty()) {
+    optimized_graph_cache_ = std::make_unique<OptimizedGraphCache>(
+        options_.env, graph_cache_dir);
+  }
 }
 
 DirectSession::~DirectSession() {
@@ -399,14 +433,12 @@ DirectSession::~DirectSession() {
   for (auto& it : partial_runs_) {
     it.second.reset(nullptr);
   }
-  for (auto& it : executors_) {
-    it.second.reset();
-  }
+  executor_lru_.clear();
+  executors_.clear();
   callables_.clear();
   for (auto d : device_mgr_->ListDevices()) {
     d->op_segment()->RemoveHold(session_handle_);
   }
-  functions_.clear();
   delete cancellation_manager_;
   for (const auto& p_and_owned : thread_pools_) {
     if (p_and_owned.second) delete p_and_owned.first;
@@ -447,6 +479,13 @@ Status DirectSession::ExtendLocked(GraphDef&& graph) {
   if (finalized_) {
     return errors::FailedPrecondition("Session has been finalized.");
   }
+  // Fingerprint `graph` before it is moved from; the session's fingerprint is
+  // only updated once the extension has succeeded.
+  Fprint128 graph_fingerprint = graph_fingerprint_;
+  if (optimized_graph_cache_) {
+    graph_fingerprint = FingerprintCat128(
+        graph_fingerprint, OptimizedGraphCache::FingerprintGraph(graph));
+  }
   if (!(flib_def_ && execution_state_)) {
     // If this is the first call, we can initialize the execution state
     // with `graph` and do not need to call `Extend()`.
@@ -471,6 +510,7 @@ Status DirectSession::ExtendLocked(GraphDef&& graph) {
     execution_state_.swap(state);
     TF_RETURN_IF_ERROR(flib_def_->AddLibrary(graph.library()));
   }
+  graph_fingerprint_ = graph_fingerprint;
   return OkStatus();
 }
 
@@ -677,6 +717,8 @@ Status DirectSession::RunInternal(
   args.sync_on_finish = sync_on_finish_;
   args.user_intra_op_threadpool = threadpool_options.intra_op_threadpool;
   args.run_all_kernels_inline = pool == nullptr;
+  args.adaptive_scheduling =
+      options_.config.experimental().enable_adaptive_executor_scheduling();
   args.start_time_usecs = start_time_usecs;
   args.deadline = deadline;
 
@@ -878,14 +920,15 @@ Status DirectSession::Run(const RunOptions& run_options,
   metrics::RecordGraphInputTensors(input_size);
 
   // Check if we already have an executor for these arguments.
-  ExecutorsAndKeys* executors_and_keys;
+  std::shared_ptr<CachedExecutors> executors;
   RunStateArgs run_state_args(run_options.debug_options());
   run_state_args.collective_graph_key =
       run_options.experimental().collective_graph_key();
 
   TF_RETURN_IF_ERROR(GetOrCreateExecutors(input_tensor_names, output_names,
-                                          target_nodes, &executors_and_keys,
+                                          target_nodes, &executors,
                                           &run_state_args));
+  ExecutorsAndKeys* executors_and_keys = executors->executors_and_keys.get();
   {
     mutex_lock l(collective_graph_key_lock_);
     collective_graph_key_ = executors_and_keys->collective_graph_key;
@@ -978,14 +1021,15 @@ Status DirectSession::PRunSetup(const std::vector<string>& input_names,
   thread::ThreadPool* pool = thread_pools_[0].first;
 
   // Check if we already have an executor for these arguments.
-  ExecutorsAndKeys* executors_and_keys;
+  std::shared_ptr<CachedExecutors> executors;
   // TODO(cais): TFDBG support for partial runs.
   DebugOptions debug_options;
   RunStateArgs run_state_args(debug_options);
   run_state_args.is_partial_run = true;
   TF_RETURN_IF_ERROR(GetOrCreateExecutors(input_names, output_names,
-                                          target_nodes, &executors_and_keys,
+                                          target_nodes, &executors,
                                           &run_state_args));
+  ExecutorsAndKeys* executors_and_keys = executors->executors_and_keys.get();
 
   // Create the run state and save it for future PRun calls.
   Executor::Args args;
@@ -993,6 +1037,9 @@ Status DirectSession::PRunSetup(const std::vector<string>& input_names,
   PartialRunState* run_state =
       new PartialRunState(input_names, output_names, args.step_id, &devices_);
   run_state->rendez.reset(new IntraProcessRendezvous(device_mgr_.get()));
+  // Keep the executors alive even if they are evicted from the cache before
+  // the partial run completes.
+  run_state->executors = std::move(executors);
   {
     mutex_lock l(executor_lock_);
     if (!partial_runs_
@@ -1050,26 +1097,18 @@ Status DirectSession::PRun(const string& handle, const NamedTensorList& inputs,
                            const std::vector<string>& output_names,
                            std::vector<Tensor>* outputs) {
   TF_RETURN_IF_ERROR(CheckNotClosed());
-  std::vector<string> parts = str_util::Split(handle, ';');
-  const string& key = parts[0];
   // Get the executors for this partial run.
   ExecutorsAndKeys* executors_and_keys;
   PartialRunState* run_state;
   {
     mutex_lock l(executor_lock_);  // could use reader lock
-    auto exc_it = executors_.find(key);
-    if (exc_it == executors_.end()) {
-      return errors::InvalidArgument(
-          "Must run 'setup' before performing partial runs!");
-    }
-    executors_and_keys = exc_it->second.get();
-
     auto prun_it = partial_runs_.find(handle);
     if (prun_it == partial_runs_.end()) {
       return errors::InvalidArgument(
           "Must run 'setup' before performing partial runs!");
     }
     run_state = prun_it->second.get();
+    executors_and_keys = run_state->executors->executors_and_keys.get();
 
     // Make sure that this is a new set of feeds that are still pending.
     for (const auto& input : inputs) {
@@ -1403,6 +1442,8 @@ Status DirectSession::CreateExecutors(
     params.device = device;
     params.session_metadata = session_metadata;
     params.function_library = lib;
+    params.enable_static_memory_planning =
+        options_.config.experimental().enable_static_memory_planning();
     auto opseg = device->op_segment();
     params.create_kernel =
         [this, lib, opseg](const std::shared_ptr<const NodeProperties>& props,
@@ -1494,7 +1535,8 @@ Status DirectSession::CreateExecutors(
 
 Status DirectSession::GetOrCreateExecutors(
     gtl::ArraySlice<string> inputs, gtl::ArraySlice<string> outputs,
-    gtl::ArraySlice<string> target_nodes, ExecutorsAndKeys** executors_and_keys,
+    gtl::ArraySlice<string> target_nodes,
+    std::shared_ptr<CachedExecutors>* executors,
     RunStateArgs* run_state_args) {
   int64_t handle_name_counter_value = -1;
   if (LogMemory::IsEnabled() || run_state_args->is_partial_run) {
@@ -1518,12 +1560,13 @@ Status DirectSession::GetOrCreateExecutors(
         strings::StrCat(key, ";", handle_name_counter_value);
   }
 
+  const Fprint128 fingerprint = Fingerprint128(key);
+
   // See if we already have the executors for this run.
   {
-    mutex_lock l(executor_lock_);  // could use reader lock
-    auto it = executors_.find(key);
-    if (it != executors_.end()) {
-      *executors_and_keys = it->second.get();
+    mutex_lock l(executor_lock_);
+    if (LookupExecutorsLocked(fingerprint, executors)) {
+      executor_cache_hits->GetCell()->IncrementBy(1);
       return OkStatus();
     }
   }
@@ -1551,15 +1594,17 @@ Status DirectSession::GetOrCreateExecutors(
         strings::StrCat(sorted_key, ";", handle_name_counter_value);
   }
 
+  const Fprint128 sorted_fingerprint = Fingerprint128(sorted_key);
+
   // See if we already have the executors for this run.
   {
     mutex_lock l(executor_lock_);
-    auto it = executors_.find(sorted_key);
-    if (it != executors_.end()) {
-      *executors_and_keys = it->second.get();
+    if (LookupExecutorsLocked(sorted_fingerprint, executors)) {
+      executor_cache_hits->GetCell()->IncrementBy(1);
       return OkStatus();
     }
   }
+  executor_cache_misses->GetCell()->IncrementBy(1);
 
   // Nothing found, so create the executors and store in the cache.
   // The executor_lock_ is intentionally released while executors are
@@ -1584,28 +1629,77 @@ Status DirectSession::GetOrCreateExecutors(
       ->set_collective_graph_key(run_state_args->collective_graph_key);
   std::unique_ptr<ExecutorsAndKeys> ek;
   std::unique_ptr<FunctionInfo> func_info;
+  const uint64 start_time_usecs = options_.env->NowMicros();
   TF_RETURN_IF_ERROR(
       CreateExecutors(callable_options, &ek, &func_info, run_state_args));
+  executor_build_time_usecs->GetCell()->IncrementBy(options_.env->NowMicros() -
+                                                    start_time_usecs);
+  auto created = std::make_shared<CachedExecutors>();
+  created->executors_and_keys = std::move(ek);
+  created->function_info = std::move(func_info);
+
+  // Entries that are evicted or lose the race below are destroyed after the
+  // lock is released, since deleting their kernels may be slow.
+  std::vector<std::shared_ptr<CachedExecutors>> evicted;
 
   // Reacquire the lock, try to insert into the map.
   mutex_lock l(executor_lock_);
 
   // Another thread may have created the entry before us, in which case we will
   // reuse the already created one.
-  auto insert_result = executors_.emplace(
-      sorted_key, std::shared_ptr<ExecutorsAndKeys>(std::move(ek)));
+  auto insert_result = executors_.emplace(sorted_fingerprint, created);
+  std::shared_ptr<CachedExecutors> entry = insert_result.first->second;
   if (insert_result.second) {
-    functions_.push_back(std::move(func_info));
+    entry->keys.push_back(sorted_fingerprint);
+    executor_lru_.push_front(entry.get());
+    entry->lru_position = executor_lru_.begin();
+  } else {
+    executor_lru_.splice(executor_lru_.begin(), executor_lru_,
+                         entry->lru_position);
+    evicted.push_back(std::move(created));
   }
 
   // Insert the value under the original key, so the fast path lookup will work
   // if the user uses the same order of inputs, outputs, and targets again.
-  executors_.emplace(key, insert_result.first->second);
-  *executors_and_keys = insert_result.first->second.get();
+  if (executors_.emplace(fingerprint, entry).second) {
+    entry->keys.push_back(fingerprint);
+  }
+  *executors = std::move(entry);
 
+  EvictExecutorsLocked(&evicted);
   return OkStatus();
 }
 
+bool DirectSession::LookupExecutorsLocked(
+    const Fprint128& key, std::shared_ptr<CachedExecutors>* executors) {
+  auto it = executors_.find(key);
+  if (it == executors_.end()) {
+    return false;
+  }
+  executor_lru_.splice(executor_lru_.begin(), executor_lru_,
+                       it->second->lru_position);
+  *executors = it->second;
+  return true;
+}
+
+void DirectSession::EvictExecutorsLocked(
+    std::vector<std::shared_ptr<CachedExecutors>>* evicted) {
+  const int64_t capacity =
+      options_.config.experimental().executor_cache_capacity();
+  if (capacity <= 0) {
+    return;
+  }
+  while (static_cast<int64_t>(executor_lru_.size()) > capacity) {
+    CachedExecutors* victim = executor_lru_.back();
+    executor_lru_.pop_back();
+    evicted->push_back(executors_[victim->keys.front()]);
+    for (const Fprint128& key : victim->keys) {
+      executors_.erase(key);
+    }
+    executor_cache_evictions->GetCell()->IncrementBy(1);
+  }
+}
+
 Status DirectSession::CreateGraphs(
     const BuildGraphOptions& subgraph_options,
     std::unordered_map<string, std::unique_ptr<Graph>>* outputs,
@@ -1617,6 +1711,124 @@ Status DirectSession::CreateGraphs(
     return errors::FailedPrecondition("Session has been finalized.");
   }
 
+  std::unordered_map<string, GraphDef> partitions;
+  std::unique_ptr<FunctionLibraryDefinition> client_flib_def;
+  DataTypeVector feed_types;
+  DataTypeVector fetch_types;
+
+  // Partial runs need the full placed graph, which is not cached.
+  const bool use_graph_cache =
+      optimized_graph_cache_ != nullptr && !run_state_args->is_partial_run;
+  Fprint128 cache_key;
+  bool loaded_from_cache = false;
+  if (use_graph_cache) {
+    cache_key = OptimizedGraphCache::ComputeKey(
+        graph_fingerprint_, options_.config, devices_, subgraph_options);
+    loaded_from_cache = LoadCachedPartitionGraphs(
+        cache_key, subgraph_options, &partitions, &client_flib_def,
+        &feed_types, &fetch_types, collective_graph_key);
+    if (loaded_from_cache) {
+      optimized_graph_cache_hits->GetCell()->IncrementBy(1);
+    } else {
+      optimized_graph_cache_misses->GetCell()->IncrementBy(1);
+    }
+  }
+  if (!loaded_from_cache) {
+    TF_RETURN_IF_ERROR(BuildPartitionGraphs(
+        subgraph_options, &partitions, &client_flib_def, run_state_args,
+        &feed_types, &fetch_types, collective_graph_key));
+  }
+
+  std::vector<string> device_names;
+  device_names.reserve(devices_.size());
+  for (auto device : devices_) {
+    // Extract the LocalName from the device.
+    device_names.push_back(DeviceNameUtils::LocalName(device->name()));
+  }
+
+  // Check for valid partitions.
+  for (const auto& partition : partitions) {
+    const string local_partition_name =
+        DeviceNameUtils::LocalName(partition.first);
+    if (std::count(device_names.begin(), device_names.end(),
+                   local_partition_name) == 0) {
+      return errors::InvalidArgument(
+          "Creating a partition for ", local_partition_name,
+          " which doesn't exist in the list of available devices. Available "
+          "devices: ",
+          absl::StrJoin(device_names, ","));
+    }
+  }
+
+  if (use_graph_cache && !loaded_from_cache) {
+    OptimizedGraphCacheEntry entry;
+    for (const auto& partition : partitions) {
+      (*entry.mutable_partitions())[partition.first] = partition.second;
+    }
+    *entry.mutable_library() = client_flib_def->ToProto();
+    for (DataType dtype : feed_types) entry.add_feed_types(dtype);
+    for (DataType dtype : fetch_types) entry.add_fetch_types(dtype);
+    entry.set_collective_graph_key(*collective_graph_key);
+    for (const auto& placement : stateful_placements_) {
+      (*entry.mutable_stateful_placements())[placement.first] =
+          placement.second;
+    }
+    // The cache is an optimization, so failing to populate it is not fatal.
+    Status s = optimized_graph_cache_->Insert(cache_key, &entry);
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to write to the optimized graph cache in "
+                   << optimized_graph_cache_->directory() << ": " << s;
+    }
+  }
+
+  for (auto& partition : partitions) {
+    std::unique_ptr<Graph> device_graph(new Graph(client_flib_def.get()));
+    device_graph->SetConstructionContext(ConstructionContext::kDirectSession);
+    GraphConstructorOptions device_opts;
+    // There are internal operations (e.g., send/recv) that we now allow.
+    device_opts.allow_internal_ops = true;
+    device_opts.expect_device_spec = true;
+    TF_RETURN_IF_ERROR(ConvertGraphDefToGraph(
+        device_opts, std::move(partition.second), device_graph.get()));
+    outputs->emplace(partition.first, std::move(device_graph));
+  }
+
+  GraphOptimizationPassOptions optimization_options;
+  optimization_options.session_options = &options_;
+  optimization_options.flib_def = client_flib_def.get();
+  optimization_options.partition_graphs = outputs;
+  TF_RETURN_IF_ERROR(OptimizationPassRegistry::Global()->RunGrouping(
+      OptimizationPassRegistry::POST_PARTITIONING, optimization_options));
+
+  Status s;
+  for (auto& partition : *outputs) {
+    const string& partition_name = partition.first;
+    std::unique_ptr<Graph>* graph = &partition.second;
+
+    VLOG(2) << "Created " << DebugString(graph->get()) << " for "
+            << partition_name;
+
+    // Give the device an opportunity to rewrite its subgraph.
+    Device* d;
+    s = device_mgr_->LookupDevice(partition_name, &d);
+    if (!s.ok()) break;
+    s = d->MaybeRewriteGraph(graph);
+    if (!s.ok()) {
+      break;
+    }
+  }
+  *flib_def = std::move(client_flib_def);
+  std::swap(*input_types, feed_types);
+  std::swap(*output_types, fetch_types);
+  return s;
+}
+
+Status DirectSession::BuildPartitionGraphs(
+    const BuildGraphOptions& subgraph_options,
+    std::unordered_map<string, GraphDef>* partitions,
+    std::unique_ptr<FunctionLibraryDefinition>* flib_def,
+    RunStateArgs* run_state_args, DataTypeVector* input_types,
+    DataTypeVector* output_types, int64_t* collective_graph_key) {
   std::unique_ptr<ClientGraph> client_graph;
 
   std::unique_ptr<GraphExecutionState> temp_exec_state_holder;
@@ -1700,71 +1912,59 @@ Status DirectSession::CreateGraphs(
   popts.flib_def = flib_def->get();
   popts.control_flow_added = false;
 
-  std::unordered_map<string, GraphDef> partitions;
-  TF_RETURN_IF_ERROR(Partition(popts, &client_graph->graph, &partitions));
+  TF_RETURN_IF_ERROR(Partition(popts, &client_graph->graph, partitions));
 
-  std::vector<string> device_names;
-  device_names.reserve(devices_.size());
-  for (auto device : devices_) {
-    // Extract the LocalName from the device.
-    device_names.push_back(DeviceNameUtils::LocalName(device->name()));
-  }
+  *flib_def = std::move(client_graph->flib_def);
+  std::swap(*input_types, client_graph->feed_types);
+  std::swap(*output_types, client_graph->fetch_types);
+  return OkStatus();
+}
 
-  // Check for valid partitions.
-  for (const auto& partition : partitions) {
-    const string local_partition_name =
-        DeviceNameUtils::LocalName(partition.first);
-    if (std::count(device_names.begin(), device_names.end(),
-                   local_partition_name) == 0) {
-      return errors::InvalidArgument(
-          "Creating a partition for ", local_partition_name,
-          " which doesn't exist in the list of available devices. Available "
-          "devices: ",
-          absl::StrJoin(device_names, ","));
+bool DirectSession::LoadCachedPartitionGraphs(
+    const Fprint128& key, const BuildGraphOptions& subgraph_options,
+    std::unordered_map<string, GraphDef>* partitions,
+    std::unique_ptr<FunctionLibraryDefinition>* flib_def,
+    DataTypeVector* input_types, DataTypeVector* output_types,
+    int64_t* collective_graph_key) {
+  OptimizedGraphCacheEntry entry;
+  if (!optimized_graph_cache_->Lookup(key, &entry)) return false;
+  if (subgraph_options.callable_options.feed_size() !=
+          entry.feed_types_size() ||
+      subgraph_options.callable_options.fetch_size() !=
+          entry.fetch_types_size()) {
+    return false;
+  }
+  // Stateful nodes cannot move once placed, so an entry that placed them
+  // elsewhere than this session did cannot be used.
+  for (const auto& placement : entry.stateful_placements()) {
+    auto iter = stateful_placements_.find(placement.first);
+    if (iter != stateful_placements_.end() &&
+        iter->second != placement.second) {
+      VLOG(1) << "Ignoring optimized graph cache entry that places "
+              << placement.first << " on " << placement.second
+              << " instead of " << iter->second;
+      return false;
     }
   }
 
-  for (auto& partition : partitions) {
-    std::unique_ptr<Graph> device_graph(
-        new Graph(client_graph->flib_def.get()));
-    device_graph->SetConstructionContext(ConstructionContext::kDirectSession);
-    GraphConstructorOptions device_opts;
-    // There are internal operations (e.g., send/recv) that we now allow.
-    device_opts.allow_internal_ops = true;
-    device_opts.expect_device_spec = true;
-    TF_RETURN_IF_ERROR(ConvertGraphDefToGraph(
-        device_opts, std::move(partition.second), device_graph.get()));
-    outputs->emplace(partition.first, std::move(device_graph));
+  for (const auto& placement : entry.stateful_placements()) {
+    stateful_placements_.insert({placement.first, placement.second});
   }
-
-  GraphOptimizationPassOptions optimization_options;
-  optimization_options.session_options = &options_;
-  optimization_options.flib_def = client_graph->flib_def.get();
-  optimization_options.partition_graphs = outputs;
-  TF_RETURN_IF_ERROR(OptimizationPassRegistry::Global()->RunGrouping(
-      OptimizationPassRegistry::POST_PARTITIONING, optimization_options));
-
-  Status s;
-  for (auto& partition : *outputs) {
-    const string& partition_name = partition.first;
-    std::unique_ptr<Graph>* graph = &partition.second;
-
-    VLOG(2) << "Created " << DebugString(graph->get()) << " for "
-            << partition_name;
-
-    // Give the device an opportunity to rewrite its subgraph.
-    Device* d;
-    s = device_mgr_->LookupDevice(partition_name, &d);
-    if (!s.ok()) break;
-    s = d->MaybeRewriteGraph(graph);
-    if (!s.ok()) {
-      break;
-    }
+  *flib_def = std::make_unique<FunctionLibraryDefinition>(OpRegistry::Global(),
+                                                          entry.library());
+  input_types->clear();
+  for (int dtype : entry.feed_types()) {
+    input_types->push_back(static_cast<DataType>(dtype));
   }
-  *flib_def = std::move(client_graph->flib_def);
-  std::swap(*input_types, client_graph->feed_types);
-  std::swap(*output_types, client_graph->fetch_types);
-  return s;
+  output_types->clear();
+  for (int dtype : entry.fetch_types()) {
+    output_types->push_back(static_cast<DataType>(dtype));
+  }
+  *collective_graph_key = entry.collective_graph_key();
+  for (auto& partition : *entry.mutable_partitions()) {
+    partitions->emplace(partition.first, std::move(partition.second));
+  }
+  return true;
 }
 
 ::tensorflow::Status DirectSession::ListDevices(
@@ -2058,6 +2258,13 @@ Status DirectSession::Finalize() {
   return OkStatus();
 }
 
+DirectSession::CachedExecutors::~CachedExecutors() {
+  // As for `Callable`, the executors must be deleted before the function
+  // library they use.
+  executors_and_keys.reset();
+  function_info.reset();
+}
+
 DirectSession::Callable::~Callable() {
   // We must delete the fields in this order, because the destructor
   // of `executors_and_keys` will call into an object owned by
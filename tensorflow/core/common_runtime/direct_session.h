@@ -17,6 +17,7 @@ limitations under the License.
 #define TENSORFLOW_CORE_COMMON_RUNTIME_DIRECT_SESSION_H_
 
 #include <atomic>
+#include <list>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -29,6 +30,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/device_set.h"
 #include "tensorflow/core/common_runtime/executor.h"
 #include "tensorflow/core/common_runtime/graph_execution_state.h"
+#include "tensorflow/core/common_runtime/optimized_graph_cache.h"
 #include "tensorflow/core/common_runtime/process_function_library_runtime.h"
 #include "tensorflow/core/common_runtime/rendezvous_mgr.h"
 #include "tensorflow/core/common_runtime/session_factory.h"
@@ -39,6 +41,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/fingerprint.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/thread_annotations.h"
@@ -194,6 +197,23 @@ class DirectSession : public Session {
     std::unique_ptr<ProcessFunctionLibraryRuntime> proc_flr;
   };
 
+  // The executors created by `Run()` or `PRunSetup()` for one signature,
+  // together with the function library they depend on. An entry is shared
+  // by the executor cache and by the steps using it, so an entry evicted
+  // from the cache stays alive until its last step finishes.
+  struct CachedExecutors {
+    std::shared_ptr<ExecutorsAndKeys> executors_and_keys;
+    std::shared_ptr<FunctionInfo> function_info;
+
+    // The fields below are guarded by `executor_lock_`.
+    // Keys of `executors_` that map to this entry.
+    std::vector<Fprint128> keys;
+    // Position of this entry in `executor_lru_`.
+    std::list<CachedExecutors*>::iterator lru_position;
+
+    ~CachedExecutors();
+  };
+
   // For each live Run() call, the session maintains a RunState.
   // 'status' is the current status of the execution.
   struct RunState {
@@ -216,6 +236,7 @@ class DirectSession : public Session {
     std::unordered_map<string, bool> pending_inputs;   // true if fed
     std::unordered_map<string, bool> pending_outputs;  // true if fetched
     core::RefCountPtr<IntraProcessRendezvous> rendez = nullptr;
+    std::shared_ptr<CachedExecutors> executors;
 
     PartialRunState(const std::vector<string>& pending_input_names,
                     const std::vector<string>& pending_output_names,
@@ -243,7 +264,21 @@ class DirectSession : public Session {
   ::tensorflow::Status GetOrCreateExecutors(
       gtl::ArraySlice<string> inputs, gtl::ArraySlice<string> outputs,
       gtl::ArraySlice<string> target_nodes,
-      ExecutorsAndKeys** executors_and_keys, RunStateArgs* run_state_args);
+      std::shared_ptr<CachedExecutors>* executors,
+      RunStateArgs* run_state_args);
+
+  // If `executors_` contains `key`, marks its entry as most recently used,
+  // stores it in `*executors` and returns true.
+  bool LookupExecutorsLocked(const Fprint128& key,
+                             std::shared_ptr<CachedExecutors>* executors)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(executor_lock_);
+
+  // Removes least recently used entries from `executors_` until at most
+  // `executor_cache_capacity` remain, moving them to `*evicted` so that they
+  // can be destroyed after `executor_lock_` is released.
+  void EvictExecutorsLocked(
+      std::vector<std::shared_ptr<CachedExecutors>>* evicted)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(executor_lock_);
 
   // Creates a set of executors to run the subgraph defined by
   // `callable_options`.
@@ -263,6 +298,29 @@ class DirectSession : public Session {
       RunStateArgs* run_state_args, DataTypeVector* input_types,
       DataTypeVector* output_types, int64_t* collective_graph_key);
 
+  // Places, optimizes and partitions the subgraph described by `options`,
+  // returning the partition graphs keyed by device name along with the
+  // function library of the optimized client graph. Called by CreateGraphs()
+  // when the graphs cannot be loaded from `optimized_graph_cache_`.
+  ::tensorflow::Status BuildPartitionGraphs(
+      const BuildGraphOptions& options,
+      std::unordered_map<string, GraphDef>* partitions,
+      std::unique_ptr<FunctionLibraryDefinition>* flib_def,
+      RunStateArgs* run_state_args, DataTypeVector* input_types,
+      DataTypeVector* output_types, int64_t* collective_graph_key)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(graph_state_lock_);
+
+  // Populates the outputs of BuildPartitionGraphs() from the entry cached for
+  // `key`. Returns false, leaving the session unchanged, if there is no usable
+  // entry.
+  bool LoadCachedPartitionGraphs(
+      const Fprint128& key, const BuildGraphOptions& options,
+      std::unordered_map<string, GraphDef>* partitions,
+      std::unique_ptr<FunctionLibraryDefinition>* flib_def,
+      DataTypeVector* input_types, DataTypeVector* output_types,
+      int64_t* collective_graph_key)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(graph_state_lock_);
+
   ::tensorflow::Status RunInternal(
       int64_t step_id, const RunOptions& run_options,
       CallFrameInterface* call_frame, ExecutorsAndKeys* executors_and_keys,
@@ -355,17 +413,17 @@ class DirectSession : public Session {
   // If true, blocks until device has finished all queued operations in a step.
   bool sync_on_finish_ = true;
 
-  std::vector<std::unique_ptr<FunctionInfo>> functions_
-      TF_GUARDED_BY(executor_lock_);
-
   mutex executor_lock_;  // protects executors_
-  // Holds mappings from signature to the executors that process
-  // it. The reason for a level of indirection around mapped_type is
+  // Holds mappings from the fingerprint of a signature to the executors that
+  // process it. The reason for a level of indirection around mapped_type is
   // to guarantee address stability.
   // The map value is a shared_ptr since multiple map keys can point to the
-  // same ExecutorsAndKey object.
-  std::unordered_map<string, std::shared_ptr<ExecutorsAndKeys>> executors_
-      TF_GUARDED_BY(executor_lock_);
+  // same CachedExecutors object.
+  std::unordered_map<Fprint128, std::shared_ptr<CachedExecutors>,
+                     Fprint128Hasher>
+      executors_ TF_GUARDED_BY(executor_lock_);
+  // The distinct entries of `executors_`, most recently used first.
+  std::list<CachedExecutors*> executor_lru_ TF_GUARDED_BY(executor_lock_);
 
   class RunCallableCallFrame;
   struct Callable {
@@ -400,6 +458,14 @@ class DirectSession : public Session {
   std::unique_ptr<GraphExecutionState> execution_state_
       TF_GUARDED_BY(graph_state_lock_);
 
+  // Persists the partition graphs built by CreateGraphs() across processes.
+  // Null unless `optimized_graph_cache_dir` is set in the session config.
+  std::unique_ptr<OptimizedGraphCache> optimized_graph_cache_;
+
+  // Fingerprint of the GraphDefs passed to Create() and Extend(), in order.
+  // Only maintained when `optimized_graph_cache_` is set.
+  Fprint128 graph_fingerprint_ TF_GUARDED_BY(graph_state_lock_) = {0, 0};
+
   // The function library, before any rewrites or optimizations have been
   // performed. In particular, CreateGraphs() may need to modify the function
   // library; it copies and modifies the function library.
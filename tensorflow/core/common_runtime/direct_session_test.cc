@@ -43,7 +43,10 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/monitoring/cell_reader.h"
 #include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/path.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/platform/stacktrace.h"
 #include "tensorflow/core/platform/test.h"
@@ -53,6 +56,7 @@ limitations under the License.
 #include "tensorflow/core/public/session.h"
 #include "tensorflow/core/public/session_options.h"
 #include "tensorflow/core/util/device_name_utils.h"
+#include "tensorflow/core/util/equal_graph_def.h"
 
 #if GOOGLE_CUDA
 #include "third_party/gpus/cuda/include/cuda.h"
@@ -834,6 +838,180 @@ TEST(DirectSessionTest, KeepsStateAcrossRunsOfSession) {
   EXPECT_EQ(20.0, outputs[0].flat<float>()(0));
 }
 
+TEST(DirectSessionTest, ExecutorCacheEvictionKeepsState) {
+  GraphDef def;
+  Graph g(OpRegistry::Global());
+  Node* var = test::graph::Var(&g, DT_FLOAT, TensorShape({10}));
+  var->set_assigned_device_name("/job:localhost/replica:0/task:0/cpu:0");
+
+  Tensor twenty(DT_FLOAT, TensorShape({10}));
+  for (int i = 0; i < 10; ++i) {
+    twenty.flat<float>()(i) = 20.0;
+  }
+
+  Node* twenty_node = test::graph::Constant(&g, twenty);
+  twenty_node->set_assigned_device_name(
+      "/job:localhost/replica:0/task:0/cpu:0");
+
+  Node* init = test::graph::Assign(&g, var, twenty_node);
+  init->set_assigned_device_name("/job:localhost/replica:0/task:0/cpu:0");
+
+  Node* neg = test::graph::Unary(&g, "Neg", var);
+  neg->set_assigned_device_name("/job:localhost/replica:0/task:0/cpu:0");
+
+  g.ToGraphDef(&def);
+
+  // Keep the executors for a single signature, so every run below evicts
+  // the executors of the previous one.
+  SessionOptions options = DefaultSessionOptions();
+  options.config.mutable_experimental()->set_executor_cache_capacity(1);
+  std::unique_ptr<Session> session(NewSession(options));
+  ASSERT_TRUE(session != nullptr);
+  TF_ASSERT_OK(session->Create(def));
+
+  std::vector<std::pair<string, Tensor>> inputs;
+  std::vector<Tensor> outputs;
+
+  // Initialize the variable
+  TF_ASSERT_OK(session->Run(inputs, {init->name()}, {}, &outputs));
+
+  for (int i = 0; i < 3; ++i) {
+    // The variable kernel is owned by the OpSegment, so its state survives
+    // the eviction of the executors that created it.
+    TF_ASSERT_OK(session->Run(inputs, {var->name() + ":0"}, {}, &outputs));
+    ASSERT_EQ(1, outputs.size());
+    EXPECT_EQ(20.0, outputs[0].flat<float>()(0));
+
+    TF_ASSERT_OK(session->Run(inputs, {neg->name() + ":0"}, {}, &outputs));
+    ASSERT_EQ(1, outputs.size());
+    EXPECT_EQ(-20.0, outputs[0].flat<float>()(0));
+  }
+}
+
+TEST(DirectSessionTest, OptimizedGraphCacheAcrossSessions) {
+  GraphDef def;
+  Graph g(OpRegistry::Global());
+  Node* var = test::graph::Var(&g, DT_FLOAT, TensorShape({10}));
+  var->set_assigned_device_name("/job:localhost/replica:0/task:0/cpu:0");
+
+  Tensor twenty(DT_FLOAT, TensorShape({10}));
+  for (int i = 0; i < 10; ++i) {
+    twenty.flat<float>()(i) = 20.0;
+  }
+  Node* twenty_node = test::graph::Constant(&g, twenty);
+  Node* init = test::graph::Assign(&g, var, twenty_node);
+  Node* neg = test::graph::Unary(&g, "Neg", var);
+  g.ToGraphDef(&def);
+
+  const string cache_dir =
+      io::JoinPath(testing::TmpDir(), "direct_session_optimized_graph_cache");
+  int64_t undeleted_files, undeleted_dirs;
+  Env::Default()
+      ->DeleteRecursively(cache_dir, &undeleted_files, &undeleted_dirs)
+      .IgnoreError();
+  SessionOptions options = DefaultSessionOptions();
+  options.config.mutable_experimental()->set_optimized_graph_cache_dir(
+      cache_dir);
+
+  // Runs both signatures, and sets `*run_metadata` to the partition graphs of
+  // the second one.
+  auto run_session = [&](const GraphDef& graph_def,
+                         RunMetadata* run_metadata) {
+    std::unique_ptr<Session> session(NewSession(options));
+    ASSERT_TRUE(session != nullptr);
+    TF_ASSERT_OK(session->Create(graph_def));
+    std::vector<Tensor> outputs;
+    TF_ASSERT_OK(session->Run({}, {}, {init->name()}, &outputs));
+    RunOptions run_options;
+    run_options.set_output_partition_graphs(true);
+    TF_ASSERT_OK(session->Run(run_options, {}, {neg->name() + ":0"}, {},
+                              &outputs, run_metadata));
+    ASSERT_EQ(1, outputs.size());
+    EXPECT_EQ(-20.0, outputs[0].flat<float>()(0));
+    TF_ASSERT_OK(session->Close());
+  };
+  auto num_entries = [&]() {
+    std::vector<string> children;
+    TF_CHECK_OK(Env::Default()->GetChildren(cache_dir, &children));
+    return children.size();
+  };
+  monitoring::testing::CellReader<int64_t> hits(
+      "/tensorflow/core/direct_session/optimized_graph_cache_hits");
+  monitoring::testing::CellReader<int64_t> misses(
+      "/tensorflow/core/direct_session/optimized_graph_cache_misses");
+
+  // The first session populates the cache with one entry per signature.
+  RunMetadata built;
+  run_session(def, &built);
+  EXPECT_EQ(2, num_entries());
+  EXPECT_EQ(0, hits.Delta());
+  EXPECT_EQ(2, misses.Delta());
+
+  // A later session with the same graph loads the entries instead, and runs
+  // the same partition graphs.
+  RunMetadata loaded;
+  run_session(def, &loaded);
+  EXPECT_EQ(2, num_entries());
+  EXPECT_EQ(2, hits.Delta());
+  EXPECT_EQ(0, misses.Delta());
+  ASSERT_GT(built.partition_graphs_size(), 0);
+  ASSERT_EQ(built.partition_graphs_size(), loaded.partition_graphs_size());
+  for (int i = 0; i < built.partition_graphs_size(); ++i) {
+    TF_EXPECT_GRAPH_EQ(built.partition_graphs(i), loaded.partition_graphs(i));
+  }
+
+  // Changing the graph invalidates the entries.
+  test::graph::Constant(&g, twenty);
+  g.ToGraphDef(&def);
+  RunMetadata changed;
+  run_session(def, &changed);
+  EXPECT_EQ(4, num_entries());
+  EXPECT_EQ(0, hits.Delta());
+  EXPECT_EQ(2, misses.Delta());
+}
+
+TEST(DirectSessionTest, ExecutorCacheEvictionDuringPartialRun) {
+  GraphDef def;
+  Graph g(OpRegistry::Global());
+
+  Tensor first_value(DT_FLOAT, TensorShape({}));
+  first_value.scalar<float>()() = 1.0;
+  Node* first_const = test::graph::Constant(&g, first_value);
+  Node* first_identity = test::graph::Identity(&g, first_const);
+
+  Tensor second_value(DT_FLOAT, TensorShape({}));
+  second_value.scalar<float>()() = 2.0;
+  Node* second_const = test::graph::Constant(&g, second_value);
+  Node* second_identity = test::graph::Identity(&g, second_const);
+
+  g.ToGraphDef(&def);
+
+  SessionOptions options = DefaultSessionOptions();
+  options.config.mutable_experimental()->set_executor_cache_capacity(1);
+  std::unique_ptr<Session> session(NewSession(options));
+  ASSERT_TRUE(session != nullptr);
+  TF_ASSERT_OK(session->Create(def));
+
+  string handle;
+  TF_ASSERT_OK(session->PRunSetup({first_const->name()},
+                                  {first_identity->name() + ":0"}, {},
+                                  &handle));
+
+  // Evict the executors of the partial run from the cache.
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(
+      session->Run({}, {second_identity->name() + ":0"}, {}, &outputs));
+  ASSERT_EQ(1, outputs.size());
+  EXPECT_EQ(2.0, outputs[0].flat<float>()(0));
+
+  Tensor value_11(DT_FLOAT, TensorShape({}));
+  value_11.scalar<float>()() = 11.0;
+  TF_ASSERT_OK(session->PRun(handle, {{first_const->name(), value_11}},
+                             {first_identity->name() + ":0"}, &outputs));
+  ASSERT_EQ(1, outputs.size());
+  EXPECT_EQ(11.0, outputs[0].flat<float>()(0));
+}
+
 TEST(DirectSessionTest, MultipleFeedTest) {
   GraphDef def;
   Graph g(OpRegistry::Global());
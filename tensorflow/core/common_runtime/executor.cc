@@ -35,6 +35,8 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/propagator_state.h"
 #include "tensorflow/core/common_runtime/renamed_device.h"
 #include "tensorflow/core/common_runtime/simple_propagator_state.h"
+#include "tensorflow/core/common_runtime/static_memory_planner.h"
+#include "tensorflow/core/common_runtime/step_arena_allocator.h"
 #include "tensorflow/core/common_runtime/step_stats_collector.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/cancellation.h"
@@ -152,6 +154,17 @@ class ExecutorImpl : public Executor {
   Status Initialize(const Graph& graph) {
     TF_RETURN_IF_ERROR(immutable_state_.Initialize(graph));
     kernel_stats_.Initialize(immutable_state_.graph_view());
+    const LocalExecutorParams& params = immutable_state_.params();
+    if (params.enable_static_memory_planning &&
+        params.device->device_type() == DEVICE_CPU &&
+        !immutable_state_.requires_control_flow_support()) {
+      memory_planner_ = StaticMemoryPlanner::Create(
+          immutable_state_.graph_view(),
+          params.device->GetAllocator(AllocatorAttributes()));
+    }
+    if (params.device->GetStepArenaAllocatorMgr() != nullptr) {
+      step_arena_nodes_ = FindStepArenaNodes(immutable_state_.graph_view());
+    }
     return OkStatus();
   }
 
@@ -210,6 +223,29 @@ class ExecutorImpl : public Executor {
       cost_estimate.store(new_estimate, std::memory_order_relaxed);
     }
 
+    // Returns the estimated cost of running the given node, in CPU cycles.
+    // Kernels without the expensive marker are not timed, so they are assumed
+    // to cost `kInexpensiveCostEstimateCycles`.
+    uint64 CostEstimate(const NodeItem& node) const {
+      if (!is_expensive_[node.node_id]) return kInexpensiveCostEstimateCycles;
+      return cost_estimates_[node.node_id].load(std::memory_order_relaxed);
+    }
+
+    // Returns the moving average of the time (in CPU cycles) a closure spends
+    // in the runner's queue before it starts executing.
+    uint64 QueueDelayCycles() const {
+      return queue_delay_cycles_.load(std::memory_order_relaxed);
+    }
+
+    // Folds a sampled queueing delay into the moving average. Like
+    // UpdateCostEstimate(), concurrent updates may be lost.
+    void UpdateQueueDelay(uint64 delay_cycles) {
+      auto prev_delay = queue_delay_cycles_.load(std::memory_order_relaxed);
+      queue_delay_cycles_.store(
+          ((kCostDecay - 1) * prev_delay + delay_cycles) / kCostDecay,
+          std::memory_order_relaxed);
+    }
+
    private:
     // Initial time (in CPU cycles) we expect an operation to take.  Used to
     // determine whether an operation should be place in a threadpool.
@@ -217,14 +253,24 @@ class ExecutorImpl : public Executor {
     static constexpr uint64 kInitialCostEstimateCycles = 100 * 1000 * 1000;
     static constexpr uint64 kOpIsExpensiveThresholdCycles = 8000;
     static constexpr uint64 kCostDecay = 10;
+    // Assumed cost of kernels whose IsExpensive() returns false.
+    static constexpr uint64 kInexpensiveCostEstimateCycles = 1000;
 
     std::vector<bool> is_expensive_;
     // std::unique_ptr<std::atomic<bool>[]> is_expensive_;
     std::unique_ptr<std::atomic_uint_fast64_t[]> cost_estimates_;
+    // Aligned to avoid false sharing with `cost_estimates_` updates.
+    alignas(64) std::atomic_uint_fast64_t queue_delay_cycles_{0};
   };
 
   ImmutableExecutorState immutable_state_;
   KernelStats kernel_stats_;
+  // Plans the outputs of each step into an arena. Null unless static memory
+  // planning is enabled and supported for the graph.
+  std::unique_ptr<StaticMemoryPlanner> memory_planner_;
+  // Whether each node allocates from the step arena, indexed by node id.
+  // Empty unless the device supports step arena allocators.
+  std::vector<bool> step_arena_nodes_;
 
   ExecutorImpl(const ExecutorImpl&) = delete;
   void operator=(const ExecutorImpl&) = delete;
@@ -284,7 +330,9 @@ class ExecutorState {
  public:
   ExecutorState(const Executor::Args& args,
                 const ImmutableExecutorState& immutable_state_,
-                ExecutorImpl::KernelStats* kernel_stats_);
+                ExecutorImpl::KernelStats* kernel_stats_,
+                StaticMemoryPlanner* memory_planner,
+                const std::vector<bool>* step_arena_nodes);
   ~ExecutorState();
 
   void RunAsync(Executor::DoneCallback done);
@@ -340,6 +388,20 @@ class ExecutorState {
   // REQUIRES: `!ready->empty()`.
   void ScheduleReady(TaggedNodeSeq* ready, TaggedNodeReadyQueue* inline_ready);
 
+  // Implements ScheduleReady() when `adaptive_scheduling_` is true. Ready
+  // nodes are run inline while their estimated total cost stays within a
+  // budget derived from the runner's queueing delay, cheap nodes beyond that
+  // budget are dispatched in batches, and expensive nodes are dispatched
+  // individually.
+  void ScheduleReadyAdaptive(TaggedNodeSeq* ready,
+                             TaggedNodeReadyQueue* inline_ready,
+                             int64_t scheduled_nsec);
+
+  // Dispatches each node in `expensive_nodes` to its own closure. Large sets
+  // are first split into chunks that are dispatched from child threads.
+  void ScheduleExpensiveNodes(const TaggedNodeSeq& expensive_nodes,
+                              int64_t scheduled_nsec);
+
   // A wrapper for runner_ to keep track of the pending queue length. Op
   // execution should dispatch work using this function instead of using runner_
   // directly.
@@ -370,6 +432,15 @@ class ExecutorState {
   // TODO(fishx): Make it configurable if necessary.
   static constexpr uint64 kInlineScheduleReadyThreshold = 500;
 
+  // Minimum total estimated cost (in CPU cycles) of the ready nodes that
+  // adaptive scheduling runs inline, and of each batch of cheap nodes it
+  // dispatches. The effective budget grows with the observed queueing delay.
+  static constexpr uint64 kAdaptiveInlineBudgetCycles = 20 * 1000;
+
+  // Maximum number of cheap nodes that adaptive scheduling dispatches in a
+  // single closure.
+  static constexpr size_t kAdaptiveMaxBatchSize = 64;
+
   // Not owned.
   RendezvousInterface* rendezvous_;
   CollectiveExecutor* collective_executor_ = nullptr;
@@ -389,6 +460,14 @@ class ExecutorState {
   CallFrameInterface* call_frame_;
   const ImmutableExecutorState& immutable_state_;
   ExecutorImpl::KernelStats* const kernel_stats_;
+  // Not owned, and null unless the executor plans the memory of its steps.
+  StaticMemoryPlanner* const memory_planner_;
+  // The arena this step allocates its planned outputs from, if any.
+  StaticMemoryPlanner::Arena* memory_arena_ = nullptr;
+  // Whether each node allocates from `step_allocator_`, indexed by node id.
+  const std::vector<bool>& step_arena_nodes_;
+  // Allocator for the tensors of this step that cannot outlive it, or null.
+  StepArenaAllocator* step_allocator_ = nullptr;
   CancellationManager* cancellation_manager_;
   tsl::CoordinationServiceAgent* coordination_service_agent_;
   absl::optional<ManagedStackTrace> stack_trace_ = absl::nullopt;
@@ -397,6 +476,7 @@ class ExecutorState {
   Executor::Args::Runner runner_;
   bool sync_on_finish_;
   const bool run_all_kernels_inline_;
+  const bool adaptive_scheduling_;
 
   PropagatorStateType propagator_;
 
@@ -418,7 +498,9 @@ class ExecutorState {
 template <class PropagatorStateType>
 ExecutorState<PropagatorStateType>::ExecutorState(
     const Executor::Args& args, const ImmutableExecutorState& immutable_state,
-    ExecutorImpl::KernelStats* kernel_stats)
+    ExecutorImpl::KernelStats* kernel_stats,
+    StaticMemoryPlanner* memory_planner,
+    const std::vector<bool>* step_arena_nodes)
     : vlog_(VLOG_IS_ON(1)),
       log_memory_(LogMemory::IsEnabled()),
       step_id_(args.step_id),
@@ -440,12 +522,15 @@ ExecutorState<PropagatorStateType>::ExecutorState(
       call_frame_(args.call_frame),
       immutable_state_(immutable_state),
       kernel_stats_(kernel_stats),
+      memory_planner_(memory_planner),
+      step_arena_nodes_(*step_arena_nodes),
       cancellation_manager_(args.cancellation_manager),
       coordination_service_agent_(args.coordination_service_agent),
       stack_trace_(args.stack_trace),
       runner_(args.runner),
       sync_on_finish_(args.sync_on_finish),
       run_all_kernels_inline_(args.run_all_kernels_inline),
+      adaptive_scheduling_(args.adaptive_scheduling),
       propagator_(immutable_state, step_id_, vlog_),
       num_outstanding_ops_(0) {
   if (args.user_intra_op_threadpool != nullptr) {
@@ -453,10 +538,24 @@ ExecutorState<PropagatorStateType>::ExecutorState(
     user_device_ = RenamedDevice::NewRenamedDevice(
         device->name(), device, false, false, args.user_intra_op_threadpool);
   }
+  if (memory_planner_ != nullptr) {
+    memory_arena_ = memory_planner_->BeginStep();
+  }
+  if (!step_arena_nodes_.empty()) {
+    step_allocator_ = immutable_state_.params()
+                          .device->GetStepArenaAllocatorMgr()
+                          ->NewStepAllocator();
+  }
 }
 
 template <class PropagatorStateType>
 ExecutorState<PropagatorStateType>::~ExecutorState() {
+  if (memory_planner_ != nullptr) {
+    memory_planner_->EndStep(memory_arena_);
+  }
+  if (step_allocator_ != nullptr) {
+    step_allocator_->EndStep();
+  }
   if (device_context_) {
     device_context_->Unref();
   }
@@ -477,6 +576,24 @@ void ExecutorState<PropagatorStateType>::RunTask(Closure&& c, int sample_rate) {
   if (n_enqueues % std::max(16, sample_rate) == 0) {
     auto n_dequeues = num_dequeue_ops.load(std::memory_order_relaxed);
     metrics::UpdateGraphPendingQueueLength(n_enqueues - n_dequeues);
+
+    if (adaptive_scheduling_) {
+      // Also sample how long the closure waits before a thread picks it up.
+      // `kernel_stats_` is owned by the executor, which outlives this state.
+      runner_([c = std::forward<Closure>(c), kernel_stats = kernel_stats_,
+               enqueue_cycles =
+                   profile_utils::CpuUtils::GetCurrentClockCycle()]() mutable {
+        num_dequeue_ops.fetch_add(1, std::memory_order_relaxed);
+        const uint64 dequeue_cycles =
+            profile_utils::CpuUtils::GetCurrentClockCycle();
+        // Cycle counters of different cores may be slightly out of sync.
+        if (dequeue_cycles > enqueue_cycles) {
+          kernel_stats->UpdateQueueDelay(dequeue_cycles - enqueue_cycles);
+        }
+        std::forward<Closure>(c)();
+      });
+      return;
+    }
   }
 
   // mutable is needed because std::forward<Closure> in the lambda body may move
@@ -913,6 +1030,14 @@ void ExecutorState<PropagatorStateType>::ProcessInline(
       params->is_input_dead = is_input_dead;
       params->output_attr_array = item.output_attrs();
       params->forward_from_array = item.forward_from();
+      params->output_allocator_array =
+          memory_planner_ != nullptr
+              ? memory_planner_->OutputAllocators(memory_arena_, item)
+              : nullptr;
+      params->step_allocator =
+          step_allocator_ != nullptr && step_arena_nodes_[item.node_id]
+              ? step_allocator_
+              : nullptr;
       params->outputs_required_array = item.outputs_required.get();
       params->inputs = *inputs;
       params->input_alloc_attrs = input_alloc_attrs;
@@ -1278,7 +1403,9 @@ void ExecutorState<PropagatorStateType>::ScheduleReady(
     scheduled_nsec = nodestats::NowInNsec();
   }
 
-  if (run_all_kernels_inline_) {
+  if (adaptive_scheduling_ && !run_all_kernels_inline_) {
+    ScheduleReadyAdaptive(ready, inline_ready, scheduled_nsec);
+  } else if (run_all_kernels_inline_) {
     if (inline_ready == nullptr) {
       // Schedule all ready kernels from a single closure. This ensure that,
       // regardless of the `runner_` implementation, all kernels will run
@@ -1326,49 +1453,135 @@ void ExecutorState<PropagatorStateType>::ScheduleReady(
         expensive_nodes.push_back(*curr_expensive_node);
       }
     }
-    if (!expensive_nodes.empty()) {
-      if (expensive_nodes.size() < kInlineScheduleReadyThreshold) {
-        for (auto& tagged_node : expensive_nodes) {
-          RunTask(std::bind(&ExecutorState::Process, this, tagged_node,
-                            scheduled_nsec),
-                  /*sample_rate=*/expensive_nodes.size());
-        }
-      } else {
-        // There are too many ready expensive nodes. Schedule them in child
-        // threads.
-        // TODO(fishx): Apply the same optimization to cheap ops as well since
-        // executing lots of cheap ops in one thread can potentially be the
-        // bottleneck as well.
-        auto it = expensive_nodes.begin();
-        while (it < expensive_nodes.end()) {
-          auto end = it;
-          std::advance(end, kInlineScheduleReadyThreshold);
-          if (end > expensive_nodes.end()) {
-            end = expensive_nodes.end();
-          }
-          TaggedNodeSeq ready_chunk{it, end};
-          RunTask(
-              [this, ready_chunk = std::move(ready_chunk), scheduled_nsec]() {
-                profiler::TraceMe activity(
-                    [&]() {
-                      return strings::StrCat(
-                          "ExecutorState::ScheduleReady::"
-                          "ChildThreadExpensiveNodes#",
-                          "ready_chunk_size=", ready_chunk.size(), "#");
-                    },
-                    profiler::GetTFTraceMeLevel(/*is_expensive=*/false));
-                for (auto& tagged_node : ready_chunk) {
-                  RunTask(std::bind(&ExecutorState::Process, this, tagged_node,
-                                    scheduled_nsec),
-                          /*sample_rate=*/ready_chunk.size());
-                }
-              });
-          it = end;
+    ScheduleExpensiveNodes(expensive_nodes, scheduled_nsec);
+  }
+  ready->clear();
+}
+
+template <class PropagatorStateType>
+void ExecutorState<PropagatorStateType>::ScheduleReadyAdaptive(
+    TaggedNodeSeq* ready, TaggedNodeReadyQueue* inline_ready,
+    int64_t scheduled_nsec) {
+  // A dispatched closure waits for about `queue_delay` cycles before it
+  // starts, so a node that is estimated to finish sooner than that is cheaper
+  // to run on this thread, which also has its inputs in cache.
+  const uint64 queue_delay = kernel_stats_->QueueDelayCycles();
+  const uint64 budget = std::max(kAdaptiveInlineBudgetCycles, queue_delay);
+  // Dead nodes only propagate deadness, so they are always cheap.
+  auto node_cost = [this](const TaggedNode& tagged_node) -> uint64 {
+    return tagged_node.get_is_dead()
+               ? 0
+               : kernel_stats_->CostEstimate(*tagged_node.node_item);
+  };
+
+  uint64 inline_cost = 0;
+  const TaggedNode* curr_expensive_node = nullptr;
+  TaggedNodeSeq cheap_nodes;
+  TaggedNodeSeq expensive_nodes;
+  for (auto& tagged_node : *ready) {
+    const uint64 cost = node_cost(tagged_node);
+    if (!tagged_node.get_is_dead() &&
+        kernel_stats_->IsExpensive(*tagged_node.node_item) &&
+        cost > queue_delay) {
+      if (curr_expensive_node) {
+        expensive_nodes.push_back(*curr_expensive_node);
+      }
+      curr_expensive_node = &tagged_node;
+    } else if (inline_ready != nullptr && inline_cost + cost <= budget) {
+      inline_ready->push_back(tagged_node);
+      inline_cost += cost;
+    } else {
+      cheap_nodes.push_back(tagged_node);
+    }
+  }
+
+  if (curr_expensive_node) {
+    if (inline_ready != nullptr && inline_ready->empty()) {
+      // Keep one expensive node on this thread, which has just produced its
+      // inputs, rather than leaving the thread idle.
+      inline_ready->push_back(*curr_expensive_node);
+    } else {
+      expensive_nodes.push_back(*curr_expensive_node);
+    }
+  }
+
+  // Dispatch the remaining cheap nodes in batches whose estimated cost is
+  // comparable to the inline budget, which amortizes the queueing delay and
+  // thread wakeups over many nodes while still spreading wide fan-outs across
+  // the threadpool.
+  auto it = cheap_nodes.begin();
+  while (it < cheap_nodes.end()) {
+    auto end = it;
+    uint64 batch_cost = 0;
+    do {
+      batch_cost += node_cost(*end);
+      ++end;
+    } while (end < cheap_nodes.end() &&
+             static_cast<size_t>(end - it) < kAdaptiveMaxBatchSize &&
+             batch_cost < budget);
+    if (end - it == 1) {
+      RunTask(std::bind(&ExecutorState::Process, this, *it, scheduled_nsec),
+              /*sample_rate=*/cheap_nodes.size());
+    } else {
+      TaggedNodeSeq batch{it, end};
+      RunTask(
+          [this, batch = std::move(batch), scheduled_nsec]() {
+            for (auto& tagged_node : batch) {
+              Process(tagged_node, scheduled_nsec);
+            }
+          },
+          /*sample_rate=*/cheap_nodes.size());
+    }
+    it = end;
+  }
+
+  ScheduleExpensiveNodes(expensive_nodes, scheduled_nsec);
+}
+
+template <class PropagatorStateType>
+void ExecutorState<PropagatorStateType>::ScheduleExpensiveNodes(
+    const TaggedNodeSeq& expensive_nodes, int64_t scheduled_nsec) {
+  if (!expensive_nodes.empty()) {
+    if (expensive_nodes.size() < kInlineScheduleReadyThreshold) {
+      for (auto& tagged_node : expensive_nodes) {
+        RunTask(std::bind(&ExecutorState::Process, this, tagged_node,
+                          scheduled_nsec),
+                /*sample_rate=*/expensive_nodes.size());
+      }
+    } else {
+      // There are too many ready expensive nodes. Schedule them in child
+      // threads.
+      // TODO(fishx): Apply the same optimization to cheap ops as well since
+      // executing lots of cheap ops in one thread can potentially be the
+      // bottleneck as well.
+      auto it = expensive_nodes.begin();
+      while (it < expensive_nodes.end()) {
+        auto end = it;
+        std::advance(end, kInlineScheduleReadyThreshold);
+        if (end > expensive_nodes.end()) {
+          end = expensive_nodes.end();
         }
+        TaggedNodeSeq ready_chunk{it, end};
+        RunTask(
+            [this, ready_chunk = std::move(ready_chunk), scheduled_nsec]() {
+              profiler::TraceMe activity(
+                  [&]() {
+                    return strings::StrCat(
+                        "ExecutorState::ScheduleReady::"
+                        "ChildThreadExpensiveNodes#",
+                        "ready_chunk_size=", ready_chunk.size(), "#");
+                  },
+                  profiler::GetTFTraceMeLevel(/*is_expensive=*/false));
+              for (auto& tagged_node : ready_chunk) {
+                RunTask(std::bind(&ExecutorState::Process, this, tagged_node,
+                                  scheduled_nsec),
+                        /*sample_rate=*/ready_chunk.size());
+              }
+            });
+        it = end;
       }
     }
   }
-  ready->clear();
 }
 
 template <class PropagatorStateType>
@@ -1509,15 +1722,19 @@ void ExecutorState<PropagatorStateType>::Finish() {
 
 void ExecutorImpl::RunAsyncInternal(const Args& args, DoneCallback done) {
   if (OpOrderDeterminismRequired()) {
-    (new ExecutorState<OrderedPropagatorState>(args, immutable_state_,
-                                               &kernel_stats_))
+    (new ExecutorState<OrderedPropagatorState>(
+         args, immutable_state_, &kernel_stats_, memory_planner_.get(),
+         &step_arena_nodes_))
         ->RunAsync(std::move(done));
   } else if (immutable_state_.requires_control_flow_support()) {
-    (new ExecutorState<PropagatorState>(args, immutable_state_, &kernel_stats_))
+    (new ExecutorState<PropagatorState>(args, immutable_state_, &kernel_stats_,
+                                        memory_planner_.get(),
+                                        &step_arena_nodes_))
         ->RunAsync(std::move(done));
   } else {
-    (new ExecutorState<SimplePropagatorState>(args, immutable_state_,
-                                              &kernel_stats_))
+    (new ExecutorState<SimplePropagatorState>(
+         args, immutable_state_, &kernel_stats_, memory_planner_.get(),
+         &step_arena_nodes_))
         ->RunAsync(std::move(done));
   }
 }
@@ -124,6 +124,12 @@ class Executor {
     // If true, all kernels will be treated as "inexpensive", and hence executed
     // on the scheduling thread.
     bool run_all_kernels_inline = false;
+
+    // If true, the executor weighs each ready kernel's measured cost against
+    // the observed queueing delay of `runner` when deciding whether to run it
+    // on the scheduling thread, and dispatches cheap ready kernels in batches.
+    // Ignored when `run_all_kernels_inline` is true.
+    bool adaptive_scheduling = false;
   };
   typedef std::function<void(const Status&)> DoneCallback;
 
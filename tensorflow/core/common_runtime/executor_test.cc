@@ -82,6 +82,7 @@ class ExecutorTest : public ::testing::Test {
     const int version = graph->versions().producer();
     LocalExecutorParams params;
     params.device = device_.get();
+    params.enable_static_memory_planning = static_memory_planning_;
     params.create_kernel =
         [this, version](const std::shared_ptr<const NodeProperties>& props,
                         OpKernel** kernel) {
@@ -100,8 +101,10 @@ class ExecutorTest : public ::testing::Test {
   Status Run(Rendezvous* rendez) {
     Executor::Args args;
     args.rendezvous = rendez;
-    args.stats_collector = &step_stats_collector_;
+    // Allocation tracking bypasses the planned allocators.
+    if (!static_memory_planning_) args.stats_collector = &step_stats_collector_;
     args.runner = runner_;
+    args.adaptive_scheduling = adaptive_scheduling_;
     return exec_->Run(args);
   }
 
@@ -112,6 +115,8 @@ class ExecutorTest : public ::testing::Test {
   StepStats step_stats_;
   Executor::Args::Runner runner_;
   Rendezvous* rendez_ = nullptr;
+  bool adaptive_scheduling_ = false;
+  bool static_memory_planning_ = false;
 };
 
 // A float val -> Tensor<float>
@@ -266,6 +271,49 @@ TEST_F(ExecutorTest, RandomTree) {
   EXPECT_EQ(4096.0, V(out));
 }
 
+TEST_F(ExecutorTest, RandomTreeAdaptiveScheduling) {
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  BuildTree(4096, g.get());
+  Create(std::move(g));
+  adaptive_scheduling_ = true;
+  // Run several steps so that later steps schedule with the cost and queueing
+  // delay estimates gathered by the earlier ones.
+  for (int step = 0; step < 4; ++step) {
+    Rendezvous* rendez = NewLocalRendezvous();
+    Rendezvous::Args args;
+    TF_ASSERT_OK(
+        rendez->Send(Key(ALICE, kIncarnation, BOB, "a"), args, V(1.0), false));
+    TF_ASSERT_OK(Run(rendez));
+    Tensor out = V(-1);
+    bool is_dead = false;
+    TF_ASSERT_OK(
+        rendez->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out, &is_dead));
+    EXPECT_EQ(4096.0, V(out));
+    rendez->Unref();
+  }
+}
+
+TEST_F(ExecutorTest, RandomTreeStaticMemoryPlanning) {
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  BuildTree(4096, g.get());
+  static_memory_planning_ = true;
+  Create(std::move(g));
+  // The first step calibrates the plan, and later steps allocate from arenas.
+  for (int step = 0; step < 4; ++step) {
+    Rendezvous* rendez = NewLocalRendezvous();
+    Rendezvous::Args args;
+    TF_ASSERT_OK(
+        rendez->Send(Key(ALICE, kIncarnation, BOB, "a"), args, V(1.0), false));
+    TF_ASSERT_OK(Run(rendez));
+    Tensor out = V(-1);
+    bool is_dead = false;
+    TF_ASSERT_OK(
+        rendez->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out, &is_dead));
+    EXPECT_EQ(4096.0, V(out));
+    rendez->Unref();
+  }
+}
+
 void BuildConcurrentAddAssign(Graph* g) {
   auto one = test::graph::Constant(g, V(1.0));
   // A variable holds one float.
@@ -521,6 +569,43 @@ BENCHMARK(BM_const_identity)
     ->ArgPair(100, 1)
     ->ArgPair(100, 100);
 
+// Wide fan-out of cheap Identity nodes from a single constant, joined by a
+// NoOp. Compares the default scheduling policy (range(1) == 0) with adaptive
+// scheduling (range(1) == 1), which dispatches the ready siblings in batches.
+static void BM_executor_fan_out(::testing::benchmark::State& state) {
+  const int width = state.range(0);
+  const bool adaptive = state.range(1);
+
+  Graph* g = new Graph(OpRegistry::Global());
+  Node* const_node = test::graph::Constant(g, Tensor(1.0f));
+  std::vector<Node*> identities;
+  identities.reserve(width);
+  for (int i = 0; i < width; ++i) {
+    identities.push_back(test::graph::Identity(g, const_node));
+  }
+  test::graph::NoOp(g, identities);
+  FixupSourceAndSinkEdges(g);
+
+  SessionOptions options;
+  auto* experimental = options.config.mutable_experimental();
+  experimental->set_enable_adaptive_executor_scheduling(adaptive);
+  test::Benchmark("cpu", g, &options, /*init=*/nullptr, /*rendez=*/nullptr,
+                  /*executor_type=*/"", /*old_benchmark_api=*/false)
+      .Run(state);
+  state.SetLabel(adaptive ? "adaptive" : "default");
+  state.SetItemsProcessed((width + 2) *
+                          static_cast<int64_t>(state.iterations()));
+}
+
+BENCHMARK(BM_executor_fan_out)
+    ->UseRealTime()
+    ->ArgPair(64, 0)
+    ->ArgPair(64, 1)
+    ->ArgPair(1024, 0)
+    ->ArgPair(1024, 1)
+    ->ArgPair(8192, 0)
+    ->ArgPair(8192, 1);
+
 static void BM_FeedInputFetchOutput(::testing::benchmark::State& state) {
   Graph* g = new Graph(OpRegistry::Global());
   // z = x + y: x and y are provided as benchmark inputs.  z is the
@@ -61,6 +61,9 @@ Benchmark::Benchmark(const string& device, Graph* g,
 
   CHECK(!old_benchmark_api) << "Expected new API only";
 
+  adaptive_scheduling_ =
+      options->config.experimental().enable_adaptive_executor_scheduling();
+
   string t = absl::AsciiStrToUpper(device);
   // Allow NewDevice to allocate a new threadpool with different number of
   // threads for each new benchmark.
@@ -171,6 +174,7 @@ void Benchmark::RunWithRendezvousArgs(
   args.runner = [this](std::function<void()> closure) {
     pool_->Schedule(closure);
   };
+  args.adaptive_scheduling = adaptive_scheduling_;
   static const int kWarmupRuns = 3;
   for (int i = 0; i < kWarmupRuns; ++i) {
     for (const auto& p : inputs) {
@@ -72,6 +72,7 @@ class Benchmark {
   std::unique_ptr<ProcessFunctionLibraryRuntime> pflr_;
   FunctionLibraryRuntime* flr_;  // Not owned.
   std::unique_ptr<Executor> exec_;
+  bool adaptive_scheduling_ = false;
 
   Benchmark(const Benchmark&) = delete;
   void operator=(const Benchmark&) = delete;
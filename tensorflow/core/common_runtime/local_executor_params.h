@@ -50,6 +50,10 @@ struct LocalExecutorParams {
 
   // Whether control flow nodes are allowed to be executed synchronously.
   bool allow_control_flow_sync_execution = false;
+
+  // Whether CPU executors plan the outputs of their kernels into a per-step
+  // arena. See `StaticMemoryPlanner`.
+  bool enable_static_memory_planning = false;
 };
 
 }  // end namespace tensorflow
@@ -0,0 +1,198 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/optimized_graph_cache.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/framework/kernel_def.pb.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_def.pb.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/platform/strcat.h"
+#include "tensorflow/core/public/version.h"
+#include "tensorflow/core/util/util.h"
+
+namespace tensorflow {
+
+namespace {
+
+Fprint128 FingerprintProto(const protobuf::MessageLite& proto) {
+  string serialized;
+  // Deterministic serialization orders map fields, so equal protos always
+  // produce equal fingerprints.
+  SerializeToStringDeterministic(proto, &serialized);
+  return Fingerprint128(serialized);
+}
+
+// Environment variables that change how graphs are placed and rewritten.
+constexpr const char* kGraphRewriteEnvVars[] = {
+    "TF_ENABLE_ONEDNN_OPTS",
+    "TF_XLA_FLAGS",
+    "TF_USE_CUBLASLT",
+    "TF_USE_CUDNN_BATCHNORM_SPATIAL_PERSISTENT",
+    "TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_LEVEL",
+    "TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_IGNORE_PERFORMANCE",
+    "TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_SIMULATE_GPU",
+    "TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_EMULATE_FP16",
+};
+
+// Op lists that auto mixed precision reads from
+// "TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_<list>_ADD" and "..._REMOVE".
+constexpr const char* kAutoMixedPrecisionLists[] = {
+    "ALLOWLIST", "WHITELIST", "INFERLIST", "GRAYLIST",
+    "DENYLIST",  "BLACKLIST", "CLEARLIST"};
+
+Fprint128 FingerprintEnvVar(const std::string& name) {
+  const char* value = std::getenv(name.c_str());
+  // Distinguishes unset variables from empty ones.
+  return Fingerprint128(value == nullptr ? strings::StrCat(name, "?")
+                                         : strings::StrCat(name, "=", value));
+}
+
+// Returns the fingerprint of the process state, other than the session's
+// inputs, that graph construction depends on: the registered ops and
+// kernels, which custom op libraries extend, and the environment variables
+// that configure the graph rewrites, including whether oneDNN is enabled.
+Fprint128 FingerprintProcessState() {
+  OpList ops;
+  OpRegistry::Global()->Export(/*include_internal=*/true, &ops);
+  Fprint128 fingerprint = FingerprintProto(ops);
+
+  // The kernels are listed in registration map order, which can differ
+  // between processes, so they are sorted first.
+  const KernelList kernels = GetAllRegisteredKernels();
+  std::vector<string> serialized_kernels(kernels.kernel_size());
+  for (int i = 0; i < kernels.kernel_size(); ++i) {
+    SerializeToStringDeterministic(kernels.kernel(i), &serialized_kernels[i]);
+  }
+  std::sort(serialized_kernels.begin(), serialized_kernels.end());
+  for (const string& kernel : serialized_kernels) {
+    fingerprint = FingerprintCat128(fingerprint, Fingerprint128(kernel));
+  }
+
+  for (const char* name : kGraphRewriteEnvVars) {
+    fingerprint = FingerprintCat128(fingerprint, FingerprintEnvVar(name));
+  }
+  for (const char* list : kAutoMixedPrecisionLists) {
+    for (const char* suffix : {"_ADD", "_REMOVE"}) {
+      fingerprint = FingerprintCat128(
+          fingerprint,
+          FingerprintEnvVar(strings::StrCat(
+              "TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_", list, suffix)));
+    }
+  }
+  // The default of TF_ENABLE_ONEDNN_OPTS depends on the build and the CPU.
+  return FingerprintCat128(fingerprint, static_cast<uint64>(IsMKLEnabled()));
+}
+
+}  // namespace
+
+OptimizedGraphCache::OptimizedGraphCache(Env* env, std::string directory)
+    : env_(env), directory_(std::move(directory)) {}
+
+/* static */ Fprint128 OptimizedGraphCache::FingerprintGraph(
+    const GraphDef& graph_def) {
+  return FingerprintProto(graph_def);
+}
+
+/* static */ Fprint128 OptimizedGraphCache::ComputeKey(
+    const Fprint128& graph_fingerprint, const ConfigProto& config,
+    const std::vector<Device*>& devices, const BuildGraphOptions& options) {
+  Fprint128 key = Fingerprint128(
+      strings::StrCat(TF_VERSION_STRING, "/", TF_GRAPH_DEF_VERSION, "/",
+                      kFormatVersion));
+  key = FingerprintCat128(key, graph_fingerprint);
+  key = FingerprintCat128(key, FingerprintProcessState());
+
+  // The cache location does not affect the graphs built, so sessions that
+  // point at a copy of the cache still hit.
+  ConfigProto keyed_config = config;
+  keyed_config.mutable_experimental()->clear_optimized_graph_cache_dir();
+  key = FingerprintCat128(key, FingerprintProto(keyed_config));
+
+  // The incarnation is chosen at random on each start, so it is left out.
+  for (const Device* device : devices) {
+    const DeviceAttributes& attrs = device->attributes();
+    key = FingerprintCat128(
+        key, Fingerprint128(strings::StrCat(
+                 attrs.name(), "|", attrs.device_type(), "|",
+                 attrs.memory_limit(), "|", attrs.physical_device_desc())));
+  }
+
+  key = FingerprintCat128(key, FingerprintProto(options.callable_options));
+  key = FingerprintCat128(key, options.use_function_convention);
+  key = FingerprintCat128(key, options.collective_graph_key);
+  key = FingerprintCat128(key, static_cast<uint64>(options.collective_order));
+  return key;
+}
+
+bool OptimizedGraphCache::Lookup(const Fprint128& key,
+                                 OptimizedGraphCacheEntry* entry) const {
+  const std::string filename = FilenameForKey(key);
+  if (!env_->FileExists(filename).ok()) return false;
+  Status s = ReadBinaryProto(env_, filename, entry);
+  if (!s.ok()) {
+    LOG(WARNING) << "Ignoring unreadable optimized graph cache entry "
+                 << filename << ": " << s;
+    return false;
+  }
+  if (entry->format_version() != kFormatVersion ||
+      entry->key_low64() != key.low64 || entry->key_high64() != key.high64) {
+    VLOG(1) << "Ignoring mismatching optimized graph cache entry " << filename;
+    return false;
+  }
+  return true;
+}
+
+Status OptimizedGraphCache::Insert(const Fprint128& key,
+                                   OptimizedGraphCacheEntry* entry) {
+  entry->set_format_version(kFormatVersion);
+  entry->set_key_low64(key.low64);
+  entry->set_key_high64(key.high64);
+
+  TF_RETURN_IF_ERROR(env_->RecursivelyCreateDir(directory_));
+  const std::string filename = FilenameForKey(key);
+  // Write to a unique temporary file first so that concurrent writers and
+  // readers never observe a partially written entry.
+  std::string temp_filename = strings::StrCat(filename, "__");
+  if (!env_->CreateUniqueFileName(&temp_filename, ".tmp")) {
+    return errors::Internal("Failed to create a temporary file for ",
+                            filename);
+  }
+  Status s = WriteBinaryProto(env_, temp_filename, *entry);
+  if (s.ok()) s = env_->RenameFile(temp_filename, filename);
+  if (!s.ok()) {
+    env_->DeleteFile(temp_filename).IgnoreError();
+  }
+  return s;
+}
+
+std::string OptimizedGraphCache::FilenameForKey(const Fprint128& key) const {
+  return io::JoinPath(
+      directory_, absl::StrCat(absl::Hex(key.high64, absl::kZeroPad16),
+                               absl::Hex(key.low64, absl::kZeroPad16), ".pb"));
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,89 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_OPTIMIZED_GRAPH_CACHE_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_OPTIMIZED_GRAPH_CACHE_H_
+
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/build_graph_options.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+#include "tensorflow/core/protobuf/graph_cache.pb.h"
+
+namespace tensorflow {
+
+// An on-disk cache of the placed, optimized and partitioned graphs that a
+// session builds for a signature, used to skip pruning, Grappler and
+// partitioning when a process restarts with the same model. The session still
+// places its full graph when it is created or extended, so a hit only skips
+// placement if `GraphOptions.place_pruned_graph` is set.
+//
+// Entries are keyed by a fingerprint of every input of graph construction
+// (see `ComputeKey()`), so a change to any of them yields a different file
+// rather than a stale hit. Each entry also records its key and a format
+// version, which are checked on load to reject collisions and entries written
+// by incompatible binaries.
+//
+// The cache is best effort: unreadable or mismatching entries are treated as
+// misses, and any number of processes may share a directory since entries
+// are written atomically.
+//
+// OptimizedGraphCache is thread-safe.
+class OptimizedGraphCache {
+ public:
+  // Bump when the meaning of `OptimizedGraphCacheEntry` changes.
+  static constexpr int kFormatVersion = 1;
+
+  OptimizedGraphCache(Env* env, std::string directory);
+
+  // Returns the fingerprint of `graph_def`, suitable for chaining the
+  // successive extensions of a session's graph with `FingerprintCat128()`.
+  static Fprint128 FingerprintGraph(const GraphDef& graph_def);
+
+  // Returns the key of the graphs built for `options` by a session whose
+  // graph has fingerprint `graph_fingerprint`, that was created with `config`
+  // and runs on `devices`. Includes the TensorFlow version, the registered
+  // ops and kernels, and the environment variables that configure the graph
+  // rewrites.
+  static Fprint128 ComputeKey(const Fprint128& graph_fingerprint,
+                              const ConfigProto& config,
+                              const std::vector<Device*>& devices,
+                              const BuildGraphOptions& options);
+
+  // Returns true and populates `*entry` if a valid entry for `key` exists.
+  bool Lookup(const Fprint128& key, OptimizedGraphCacheEntry* entry) const;
+
+  // Atomically writes `entry` as the entry for `key`, replacing any existing
+  // one. Sets the key and version fields of `entry`.
+  Status Insert(const Fprint128& key, OptimizedGraphCacheEntry* entry);
+
+  const std::string& directory() const { return directory_; }
+
+ private:
+  std::string FilenameForKey(const Fprint128& key) const;
+
+  Env* const env_;
+  const std::string directory_;
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_OPTIMIZED_GRAPH_CACHE_H_
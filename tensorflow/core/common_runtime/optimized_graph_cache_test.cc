@@ -0,0 +1,148 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/optimized_graph_cache.h"
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+string CacheDir() {
+  return io::JoinPath(testing::TmpDir(), "optimized_graph_cache_test");
+}
+
+GraphDef TestGraph(const string& node_name) {
+  GraphDef graph_def;
+  NodeDef* node = graph_def.add_node();
+  node->set_name(node_name);
+  node->set_op("NoOp");
+  return graph_def;
+}
+
+Fprint128 KeyFor(const GraphDef& graph_def, const ConfigProto& config,
+                 const string& fetch) {
+  BuildGraphOptions options;
+  options.callable_options.add_fetch(fetch);
+  return OptimizedGraphCache::ComputeKey(
+      OptimizedGraphCache::FingerprintGraph(graph_def), config, {}, options);
+}
+
+TEST(OptimizedGraphCacheTest, KeyDependsOnInputs) {
+  const GraphDef graph_def = TestGraph("a");
+  ConfigProto config;
+  const Fprint128 key = KeyFor(graph_def, config, "a:0");
+
+  EXPECT_EQ(key, KeyFor(graph_def, config, "a:0"));
+  EXPECT_FALSE(key == KeyFor(TestGraph("b"), config, "a:0"));
+  EXPECT_FALSE(key == KeyFor(graph_def, config, "b:0"));
+
+  ConfigProto other_config;
+  other_config.mutable_graph_options()->set_place_pruned_graph(true);
+  EXPECT_FALSE(key == KeyFor(graph_def, other_config, "a:0"));
+
+  // The location of the cache is not an input of graph construction.
+  ConfigProto cache_config;
+  cache_config.mutable_experimental()->set_optimized_graph_cache_dir("/tmp/x");
+  EXPECT_EQ(key, KeyFor(graph_def, cache_config, "a:0"));
+}
+
+TEST(OptimizedGraphCacheTest, KeyDependsOnProcessState) {
+  const GraphDef graph_def = TestGraph("a");
+  const Fprint128 key = KeyFor(graph_def, ConfigProto(), "a:0");
+
+  // Loading a custom op library registers new ops.
+  OpRegistry::Global()->Register([](OpRegistrationData* op_reg_data) {
+    op_reg_data->op_def.set_name("OptimizedGraphCacheTestOp");
+    return OkStatus();
+  });
+  const Fprint128 custom_op_key = KeyFor(graph_def, ConfigProto(), "a:0");
+  EXPECT_FALSE(key == custom_op_key);
+
+  setenv("TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_LEVEL", "TENSOR_CORES",
+         /*overwrite=*/1);
+  EXPECT_FALSE(custom_op_key == KeyFor(graph_def, ConfigProto(), "a:0"));
+  unsetenv("TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_LEVEL");
+  EXPECT_EQ(custom_op_key, KeyFor(graph_def, ConfigProto(), "a:0"));
+}
+
+TEST(OptimizedGraphCacheTest, InsertAndLookup) {
+  OptimizedGraphCache cache(Env::Default(), io::JoinPath(CacheDir(), "rt"));
+  const Fprint128 key = KeyFor(TestGraph("a"), ConfigProto(), "a:0");
+
+  OptimizedGraphCacheEntry entry;
+  EXPECT_FALSE(cache.Lookup(key, &entry));
+
+  (*entry.mutable_partitions())["/device:CPU:0"] = TestGraph("a");
+  entry.add_fetch_types(DT_FLOAT);
+  TF_ASSERT_OK(cache.Insert(key, &entry));
+
+  OptimizedGraphCacheEntry loaded;
+  ASSERT_TRUE(cache.Lookup(key, &loaded));
+  EXPECT_EQ(OptimizedGraphCache::kFormatVersion, loaded.format_version());
+  ASSERT_EQ(1, loaded.partitions_size());
+  EXPECT_EQ("a", loaded.partitions().at("/device:CPU:0").node(0).name());
+  ASSERT_EQ(1, loaded.fetch_types_size());
+  EXPECT_EQ(DT_FLOAT, loaded.fetch_types(0));
+
+  // The cache is shared between instances pointing at the same directory.
+  OptimizedGraphCache other_cache(Env::Default(), cache.directory());
+  EXPECT_TRUE(other_cache.Lookup(key, &loaded));
+}
+
+TEST(OptimizedGraphCacheTest, IgnoresInvalidEntries) {
+  const string directory = io::JoinPath(CacheDir(), "invalid");
+  OptimizedGraphCache cache(Env::Default(), directory);
+  const Fprint128 key = KeyFor(TestGraph("a"), ConfigProto(), "a:0");
+  const Fprint128 other_key = KeyFor(TestGraph("b"), ConfigProto(), "b:0");
+
+  OptimizedGraphCacheEntry entry;
+  TF_ASSERT_OK(cache.Insert(key, &entry));
+  std::vector<string> children;
+  TF_ASSERT_OK(Env::Default()->GetChildren(directory, &children));
+  ASSERT_EQ(1, children.size());
+  const string filename = io::JoinPath(directory, children[0]);
+
+  // Overwrite the entry with one recorded for a different key.
+  OptimizedGraphCacheEntry mismatched;
+  mismatched.set_format_version(OptimizedGraphCache::kFormatVersion);
+  mismatched.set_key_low64(other_key.low64);
+  mismatched.set_key_high64(other_key.high64);
+  TF_ASSERT_OK(WriteBinaryProto(Env::Default(), filename, mismatched));
+  EXPECT_FALSE(cache.Lookup(key, &entry));
+
+  // Entries from a different format version are ignored.
+  mismatched.set_format_version(OptimizedGraphCache::kFormatVersion + 1);
+  mismatched.set_key_low64(key.low64);
+  mismatched.set_key_high64(key.high64);
+  TF_ASSERT_OK(WriteBinaryProto(Env::Default(), filename, mismatched));
+  EXPECT_FALSE(cache.Lookup(key, &entry));
+
+  // So are entries that cannot be parsed.
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), filename, "not a proto"));
+  EXPECT_FALSE(cache.Lookup(key, &entry));
+}
+
+}  // namespace
+}  // namespace tensorflow
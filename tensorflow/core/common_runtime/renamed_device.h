@@ -68,6 +68,10 @@ class RenamedDevice : public Device {
     return underlying_device_->GetScopedAllocatorMgr();
   }
 
+  StepArenaAllocatorMgr* GetStepArenaAllocatorMgr() const override {
+    return underlying_device_->GetStepArenaAllocatorMgr();
+  }
+
   const Eigen::ThreadPoolDevice* eigen_cpu_device() override {
     // Use the underlying threadpool only if the underlying device supports
     // eigen_cpu_device.
@@ -0,0 +1,460 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/static_memory_planner.h"
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/op_def.pb.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/refcount.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Graphs with more plannable outputs than this are not planned, to bound the
+// quadratic cost of assigning offsets.
+constexpr int kMaxSlots = 16 * 1024;
+
+constexpr size_t kAlignment = Allocator::kAllocatorAlignment;
+
+size_t AlignUp(size_t bytes) {
+  return (bytes + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+// Returns true if `item` may hold on to its inputs beyond its own execution,
+// in which case its inputs are not planned.
+bool MayRetainInputs(const NodeItem& item) {
+  if (item.is_transfer_node) return true;
+  const string& op = item.kernel->type_string();
+  if (op == "_Retval" || op == "_DeviceRetval") return true;
+  const OpDef* op_def = nullptr;
+  if (!OpRegistry::Global()->LookUpOpDef(op, &op_def).ok()) {
+    // Functions and other ops that are not in the global registry.
+    return true;
+  }
+  return op_def->is_stateful();
+}
+
+}  // namespace
+
+// Records the largest size requested for an output during calibration, and
+// forwards the allocation to the underlying allocator. Like the arenas, it is
+// kept alive by the tensors allocated from it.
+class StaticMemoryPlanner::RecordingAllocator : public Allocator,
+                                                public core::RefCounted {
+ public:
+  RecordingAllocator(Allocator* allocator, std::atomic<size_t>* max_bytes)
+      : allocator_(allocator), max_bytes_(max_bytes) {}
+
+  std::string Name() override { return "static_memory_plan_calibration"; }
+
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override {
+    size_t prev = max_bytes_->load(std::memory_order_relaxed);
+    while (num_bytes > prev &&
+           !max_bytes_->compare_exchange_weak(prev, num_bytes,
+                                              std::memory_order_relaxed)) {
+    }
+    void* ptr = allocator_->AllocateRaw(alignment, num_bytes);
+    if (ptr != nullptr) Ref();
+    return ptr;
+  }
+
+  void DeallocateRaw(void* ptr) override {
+    allocator_->DeallocateRaw(ptr);
+    Unref();
+  }
+
+ private:
+  Allocator* const allocator_;
+  // Owned by the planner, which outlives every calibration step.
+  std::atomic<size_t>* const max_bytes_;
+};
+
+// One block of memory laid out according to the plan, together with the
+// allocators that hand out its slots.
+//
+// A slot is claimed by setting its `live_` flag and then checking that no
+// overlapping slot is live; a slot whose check fails is released again and
+// the allocation falls back to the underlying allocator. Because both claims
+// are sequentially consistent, two overlapping slots can never be claimed at
+// the same time. Every tensor allocated through the arena, including those
+// that fell back to the underlying allocator, holds a reference on it.
+class StaticMemoryPlanner::Arena : public core::RefCounted {
+ public:
+  explicit Arena(const StaticMemoryPlanner& planner)
+      : allocator_(planner.allocator_),
+        slots_(planner.slots_.get()),
+        bytes_(planner.arena_bytes_),
+        base_(static_cast<char*>(
+            allocator_->AllocateRaw(kAlignment, planner.arena_bytes_))),
+        live_(new std::atomic<bool>[planner.num_slots_]),
+        output_allocators_(planner.output_slot_.size(), nullptr) {
+    slot_allocators_.reserve(planner.num_slots_);
+    for (int i = 0; i < planner.num_slots_; ++i) {
+      live_[i].store(false, std::memory_order_relaxed);
+      slot_allocators_.push_back(std::make_unique<SlotAllocator>(this, i));
+    }
+    for (size_t i = 0; i < planner.output_slot_.size(); ++i) {
+      const int slot = planner.output_slot_[i];
+      if (slot >= 0 && slots_[slot].bytes > 0) {
+        output_allocators_[i] = slot_allocators_[slot].get();
+      }
+    }
+  }
+
+  ~Arena() override {
+    if (base_ != nullptr) allocator_->DeallocateRaw(base_);
+  }
+
+  bool ok() const { return base_ != nullptr; }
+
+  Allocator* const* output_allocators(int base) const {
+    return output_allocators_.data() + base;
+  }
+
+  // Guarded by the planner's `mu_`.
+  bool in_use = false;
+
+ private:
+  class SlotAllocator : public Allocator {
+   public:
+    SlotAllocator(Arena* arena, int slot) : arena_(arena), slot_(slot) {}
+
+    std::string Name() override { return "static_memory_plan"; }
+
+    void* AllocateRaw(size_t alignment, size_t num_bytes) override {
+      return arena_->Allocate(slot_, alignment, num_bytes);
+    }
+
+    void DeallocateRaw(void* ptr) override { arena_->Deallocate(slot_, ptr); }
+
+   private:
+    Arena* const arena_;
+    const int slot_;
+  };
+
+  // Only called while a step that uses this arena is running, so `slots_`,
+  // which is owned by the planner, is still valid.
+  void* Allocate(int slot, size_t alignment, size_t num_bytes) {
+    const Slot& s = slots_[slot];
+    if (num_bytes > s.bytes || alignment > kAlignment) {
+      return Fallback(alignment, num_bytes);
+    }
+    if (live_[slot].exchange(true)) {
+      // The node runs more than once, or an earlier output of it is still
+      // alive.
+      return Fallback(alignment, num_bytes);
+    }
+    for (int other : s.overlapping) {
+      if (live_[other].load()) {
+        live_[slot].store(false);
+        return Fallback(alignment, num_bytes);
+      }
+    }
+    Ref();
+    return base_ + s.offset;
+  }
+
+  void* Fallback(size_t alignment, size_t num_bytes) {
+    void* ptr = allocator_->AllocateRaw(alignment, num_bytes);
+    if (ptr != nullptr) Ref();
+    return ptr;
+  }
+
+  // May be called after the planner has been destroyed, so must not access
+  // `slots_`.
+  void Deallocate(int slot, void* ptr) {
+    char* p = static_cast<char*>(ptr);
+    if (p >= base_ && p < base_ + bytes_) {
+      live_[slot].store(false, std::memory_order_release);
+    } else {
+      allocator_->DeallocateRaw(ptr);
+    }
+    Unref();
+  }
+
+  Allocator* const allocator_;
+  const Slot* const slots_;
+  const size_t bytes_;
+  char* const base_;
+  std::unique_ptr<std::atomic<bool>[]> live_;
+  std::vector<std::unique_ptr<SlotAllocator>> slot_allocators_;
+  std::vector<Allocator*> output_allocators_;
+};
+
+/* static */ std::unique_ptr<StaticMemoryPlanner> StaticMemoryPlanner::Create(
+    const GraphView& gview, Allocator* allocator) {
+  int num_outputs = 0;
+  for (int32_t id = 0; id < gview.num_nodes(); ++id) {
+    const NodeItem* item = gview.node(id);
+    if (item == nullptr) continue;
+    if (item->is_merge || item->is_enter_exit_or_next_iter) return nullptr;
+    num_outputs += item->num_outputs;
+  }
+
+  std::unique_ptr<StaticMemoryPlanner> planner(
+      new StaticMemoryPlanner(gview, allocator, num_outputs));
+
+  // Topological order of the nodes, by Kahn's algorithm.
+  std::vector<int> pending(gview.num_nodes(), 0);
+  for (int32_t id = 0; id < gview.num_nodes(); ++id) {
+    const NodeItem* item = gview.node(id);
+    if (item == nullptr) continue;
+    for (const EdgeInfo& e : item->output_edges()) ++pending[e.dst_id];
+    for (const ControlEdgeInfo& e : item->output_control_edges()) {
+      ++pending[e.dst_id];
+    }
+  }
+  std::deque<int> ready;
+  for (int32_t id = 0; id < gview.num_nodes(); ++id) {
+    if (gview.node(id) != nullptr && pending[id] == 0) ready.push_back(id);
+  }
+  while (!ready.empty()) {
+    const int id = ready.front();
+    ready.pop_front();
+    planner->position_[id] = planner->order_.size();
+    planner->order_.push_back(id);
+    const NodeItem& item = gview.node_ref(id);
+    for (const EdgeInfo& e : item.output_edges()) {
+      if (--pending[e.dst_id] == 0) ready.push_back(e.dst_id);
+    }
+    for (const ControlEdgeInfo& e : item.output_control_edges()) {
+      if (--pending[e.dst_id] == 0) ready.push_back(e.dst_id);
+    }
+  }
+
+  // Assign slots to the outputs that kernels may allocate themselves.
+  int next_output = 0;
+  int num_slots = 0;
+  for (int32_t id = 0; id < gview.num_nodes(); ++id) {
+    const NodeItem* item = gview.node(id);
+    if (item == nullptr) continue;
+    planner->output_base_[id] = next_output;
+    next_output += item->num_outputs;
+    if (item->kernel == nullptr) continue;
+    planner->retains_inputs_[id] = MayRetainInputs(*item);
+    if (item->const_tensor != nullptr || item->is_noop ||
+        item->is_transfer_node) {
+      continue;
+    }
+    for (int i = 0; i < item->num_outputs; ++i) {
+      const DataType dtype = item->output_type(i);
+      if (IsRefType(dtype) || !DataTypeCanUseMemcpy(dtype) ||
+          item->forward_from()[i] >= 0 ||
+          item->output_attrs()[i].scope_id > 0) {
+        continue;
+      }
+      planner->output_slot_[planner->output_base_[id] + i] = num_slots++;
+      planner->has_planned_outputs_[id] = true;
+    }
+  }
+  if (num_slots == 0 || num_slots > kMaxSlots) return nullptr;
+
+  planner->num_slots_ = num_slots;
+  planner->slots_.reset(new Slot[num_slots]);
+  for (int i = 0; i < num_outputs; ++i) {
+    const int slot = planner->output_slot_[i];
+    if (slot < 0) continue;
+    planner->recording_output_allocators_[i] = new RecordingAllocator(
+        allocator, &planner->slots_[slot].observed_bytes);
+  }
+  return planner;
+}
+
+StaticMemoryPlanner::StaticMemoryPlanner(const GraphView& gview,
+                                         Allocator* allocator, int num_outputs)
+    : gview_(gview),
+      allocator_(allocator),
+      position_(gview.num_nodes(), 0),
+      output_base_(gview.num_nodes(), -1),
+      retains_inputs_(gview.num_nodes(), false),
+      has_planned_outputs_(gview.num_nodes(), false),
+      output_slot_(num_outputs, -1),
+      recording_output_allocators_(num_outputs, nullptr) {}
+
+StaticMemoryPlanner::~StaticMemoryPlanner() {
+  mutex_lock l(mu_);
+  // Allocators with live tensors are deleted when the last of them is
+  // released.
+  for (Arena* arena : arenas_) arena->Unref();
+  for (Allocator* allocator : recording_output_allocators_) {
+    if (allocator != nullptr) {
+      static_cast<RecordingAllocator*>(allocator)->Unref();
+    }
+  }
+}
+
+StaticMemoryPlanner::Arena* StaticMemoryPlanner::BeginStep() {
+  if (!planned() || arena_bytes_ == 0) return nullptr;
+  mutex_lock l(mu_);
+  for (Arena* arena : arenas_) {
+    if (!arena->in_use && arena->RefCountIsOne()) {
+      arena->in_use = true;
+      return arena;
+    }
+  }
+  if (arenas_.size() >= kMaxArenas) return nullptr;
+  auto* arena = new Arena(*this);
+  if (!arena->ok()) {
+    arena->Unref();
+    return nullptr;
+  }
+  arena->in_use = true;
+  arenas_.push_back(arena);
+  return arena;
+}
+
+void StaticMemoryPlanner::EndStep(Arena* arena) {
+  if (arena != nullptr) {
+    mutex_lock l(mu_);
+    arena->in_use = false;
+    return;
+  }
+  if (planned()) return;
+  mutex_lock l(mu_);
+  if (planned()) return;
+  // The first completed step that allocated any output ends calibration.
+  bool observed_any = false;
+  for (int i = 0; i < num_slots_ && !observed_any; ++i) {
+    observed_any = slots_[i].observed_bytes.load(std::memory_order_relaxed) > 0;
+  }
+  if (!observed_any) return;
+  Plan();
+  planned_.store(true, std::memory_order_release);
+}
+
+Allocator* const* StaticMemoryPlanner::OutputAllocators(
+    const Arena* arena, const NodeItem& item) const {
+  if (!has_planned_outputs_[item.node_id]) return nullptr;
+  const int base = output_base_[item.node_id];
+  if (arena != nullptr) return arena->output_allocators(base);
+  if (planned()) return nullptr;
+  return recording_output_allocators_.data() + base;
+}
+
+bool StaticMemoryPlanner::IsAllocated(int output) const {
+  const int slot = output_slot_[output];
+  return slot >= 0 &&
+         slots_[slot].observed_bytes.load(std::memory_order_relaxed) > 0;
+}
+
+void StaticMemoryPlanner::Plan() {
+  // Compute the lifetime of each output in a reverse topological pass. An
+  // output is live until its last consumer has run, or, if a consumer did not
+  // allocate an output of the same type during calibration and so may have
+  // forwarded its input, until that output is dead. Outputs that may escape
+  // the step are not planned.
+  const int num_outputs = output_slot_.size();
+  std::vector<int> last_use(num_outputs, 0);
+  std::vector<bool> escapes(num_outputs, false);
+  for (auto it = order_.rbegin(); it != order_.rend(); ++it) {
+    const NodeItem& item = gview_.node_ref(*it);
+    const int base = output_base_[item.node_id];
+    for (int i = 0; i < item.num_outputs; ++i) {
+      last_use[base + i] = position_[item.node_id];
+    }
+    for (const EdgeInfo& e : item.output_edges()) {
+      const int output = base + e.output_slot;
+      last_use[output] = std::max(last_use[output], position_[e.dst_id]);
+      if (retains_inputs_[e.dst_id]) {
+        escapes[output] = true;
+        continue;
+      }
+      const NodeItem& consumer = gview_.node_ref(e.dst_id);
+      const int consumer_base = output_base_[e.dst_id];
+      for (int j = 0; j < consumer.num_outputs; ++j) {
+        if (consumer.output_type(j) == item.output_type(e.output_slot) &&
+            !IsAllocated(consumer_base + j)) {
+          last_use[output] =
+              std::max(last_use[output], last_use[consumer_base + j]);
+          escapes[output] = escapes[output] || escapes[consumer_base + j];
+        }
+      }
+    }
+  }
+
+  std::vector<int> planned_slots;
+  for (int32_t id = 0; id < gview_.num_nodes(); ++id) {
+    if (!has_planned_outputs_[id]) continue;
+    const NodeItem& item = gview_.node_ref(id);
+    const int base = output_base_[id];
+    for (int i = 0; i < item.num_outputs; ++i) {
+      const int slot = output_slot_[base + i];
+      if (slot < 0 || escapes[base + i]) continue;
+      Slot& s = slots_[slot];
+      const size_t observed = s.observed_bytes.load(std::memory_order_relaxed);
+      if (observed == 0) continue;
+      s.bytes = AlignUp(observed);
+      s.first_use = position_[id];
+      s.last_use = last_use[base + i];
+      planned_slots.push_back(slot);
+    }
+  }
+
+  // Greedy by size: place the largest outputs first, each at the lowest
+  // offset that does not overlap an already placed output whose lifetime
+  // intersects its own.
+  std::sort(planned_slots.begin(), planned_slots.end(), [this](int a, int b) {
+    if (slots_[a].bytes != slots_[b].bytes) {
+      return slots_[a].bytes > slots_[b].bytes;
+    }
+    return slots_[a].first_use < slots_[b].first_use;
+  });
+  std::vector<int> by_offset;
+  by_offset.reserve(planned_slots.size());
+  size_t arena_bytes = 0;
+  for (int slot : planned_slots) {
+    Slot& s = slots_[slot];
+    size_t offset = 0;
+    for (int other : by_offset) {
+      const Slot& o = slots_[other];
+      if (o.last_use < s.first_use || s.last_use < o.first_use) continue;
+      if (o.offset >= offset + s.bytes) break;
+      offset = std::max(offset, o.offset + o.bytes);
+    }
+    s.offset = offset;
+    arena_bytes = std::max(arena_bytes, offset + s.bytes);
+    by_offset.insert(
+        std::upper_bound(by_offset.begin(), by_offset.end(), slot,
+                         [this](int a, int b) {
+                           return slots_[a].offset < slots_[b].offset;
+                         }),
+        slot);
+  }
+
+  // Record which slots share memory, for the liveness checks of the arenas.
+  for (size_t i = 0; i < by_offset.size(); ++i) {
+    Slot& s = slots_[by_offset[i]];
+    for (size_t j = i + 1; j < by_offset.size(); ++j) {
+      Slot& o = slots_[by_offset[j]];
+      if (o.offset >= s.offset + s.bytes) break;
+      s.overlapping.push_back(by_offset[j]);
+      o.overlapping.push_back(by_offset[i]);
+    }
+  }
+  arena_bytes_ = arena_bytes;
+  VLOG(1) << "Planned " << by_offset.size() << " outputs into arenas of "
+          << arena_bytes_ << " bytes";
+}
+
+}  // namespace tensorflow
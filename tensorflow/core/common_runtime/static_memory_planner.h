@@ -0,0 +1,155 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_STATIC_MEMORY_PLANNER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_STATIC_MEMORY_PLANNER_H_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/graph_view.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// Plans the outputs that the kernels of an executor's graph allocate into a
+// single arena per step, in the spirit of TFLite's ArenaPlanner, so that
+// `OpKernelContext::allocate_output()` becomes pointer arithmetic instead of a
+// call into the device allocator.
+//
+// The output sizes are not known statically in a GraphView, so the planner
+// calibrates them on the first step: every eligible output is allocated from
+// the underlying allocator and its size recorded. Outputs that their kernels
+// did not allocate, for example because they forwarded an input buffer, are
+// not planned. The planner then computes a lifetime interval for every output
+// from a topological order of the graph, and assigns arena offsets with the
+// greedy-by-size heuristic, letting outputs with disjoint lifetimes share
+// memory.
+//
+// The executor runs nodes in parallel, so the topological order is only a
+// heuristic for the actual lifetimes. Each arena therefore tracks which of its
+// outputs are live, and an allocation falls back to the underlying allocator
+// when its planned region is still held by another tensor, for example one
+// whose lifetime was extended by a kernel that kept a reference to it. The
+// same fallback handles outputs that grow beyond their calibrated size.
+//
+// Arenas are reused across steps once every tensor allocated from them has
+// been released. Tensors that outlive the executor keep their arena alive.
+//
+// StaticMemoryPlanner is thread-safe.
+class StaticMemoryPlanner {
+ public:
+  class Arena;
+
+  // Returns a planner for the graph in `gview`, whose outputs are otherwise
+  // allocated from `allocator`, or nullptr if the graph cannot be planned
+  // because it uses control flow or has no plannable outputs.
+  static std::unique_ptr<StaticMemoryPlanner> Create(const GraphView& gview,
+                                                     Allocator* allocator);
+
+  ~StaticMemoryPlanner();
+
+  // Returns the arena that a new step should allocate its planned outputs
+  // from, or nullptr if the plan is still being calibrated or the maximum
+  // number of arenas are in use. Must be paired with a call to EndStep().
+  Arena* BeginStep();
+
+  // Releases `arena`, which was returned by BeginStep(). Tensors from the
+  // arena that are still alive keep it from being reused.
+  void EndStep(Arena* arena);
+
+  // Returns the array of allocators, indexed by output, to use for the
+  // outputs of `item` in a step that began with `arena`. Returns nullptr if
+  // none of the outputs are planned.
+  Allocator* const* OutputAllocators(const Arena* arena,
+                                     const NodeItem& item) const;
+
+  // Returns true once calibration has finished and steps allocate from
+  // arenas.
+  bool planned() const { return planned_.load(std::memory_order_acquire); }
+
+  // Returns the size in bytes of each arena, or 0 before planning.
+  size_t arena_bytes() const { return arena_bytes_; }
+
+  // Maximum number of arenas, and hence of concurrent planned steps.
+  static constexpr int kMaxArenas = 8;
+
+ private:
+  class RecordingAllocator;
+
+  // Placement of one plannable output within the arenas.
+  struct Slot {
+    // Largest size requested for the output during calibration.
+    std::atomic<size_t> observed_bytes{0};
+    // The planned size, which is 0 if the output is not planned, and offset.
+    size_t bytes = 0;
+    size_t offset = 0;
+    // Topological positions of the producer and the last use.
+    int first_use = 0;
+    int last_use = 0;
+    // Planned slots whose memory overlaps this one's.
+    std::vector<int> overlapping;
+  };
+
+  StaticMemoryPlanner(const GraphView& gview, Allocator* allocator,
+                      int num_outputs);
+
+  // Returns true if `output` was allocated by its kernel during calibration,
+  // rather than forwarded from an input or not produced.
+  bool IsAllocated(int output) const;
+
+  // Assigns offsets to the slots that were allocated during calibration.
+  void Plan() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const GraphView& gview_;
+  Allocator* const allocator_;
+
+  // The nodes in topological order, and the position of each node in it.
+  std::vector<int> order_;
+  std::vector<int> position_;
+
+  // Index of the first output of each node in the per-output arrays below.
+  std::vector<int> output_base_;
+  // Whether each node may hold on to its inputs after it has run.
+  std::vector<bool> retains_inputs_;
+  // Whether any output of each node has a slot.
+  std::vector<bool> has_planned_outputs_;
+
+  // Slot of each output, or -1 if the output is never planned.
+  std::vector<int> output_slot_;
+  std::unique_ptr<Slot[]> slots_;
+  int num_slots_ = 0;
+
+  // Allocators that record the sizes of the outputs during calibration,
+  // indexed like `output_slot_`. Owned, and unreferenced on destruction.
+  std::vector<Allocator*> recording_output_allocators_;
+
+  std::atomic<bool> planned_{false};
+  size_t arena_bytes_ = 0;
+
+  mutex mu_;
+  std::vector<Arena*> arenas_ TF_GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StaticMemoryPlanner);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_STATIC_MEMORY_PLANNER_H_
@@ -0,0 +1,290 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/step_arena_allocator.h"
+
+#include <algorithm>
+#include <deque>
+
+#include "tensorflow/core/framework/op_def.pb.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+
+namespace {
+
+constexpr size_t kAlignment = Allocator::kAllocatorAlignment;
+
+size_t AlignUp(size_t bytes) {
+  return (bytes + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+// Returns the shard that the calling thread allocates from.
+int ShardIndex(int num_shards) {
+  static std::atomic<int> next_index{0};
+  thread_local const int index =
+      next_index.fetch_add(1, std::memory_order_relaxed);
+  return index % num_shards;
+}
+
+// Returns true if `item` may hold on to its inputs, or to the tensors it
+// allocates, beyond its own execution.
+bool MayRetainTensors(const NodeItem& item) {
+  if (item.is_transfer_node) return true;
+  const string& op = item.kernel->type_string();
+  if (op == "_Retval" || op == "_DeviceRetval") return true;
+  const OpDef* op_def = nullptr;
+  if (!OpRegistry::Global()->LookUpOpDef(op, &op_def).ok()) {
+    // Functions and other ops that are not in the global registry.
+    return true;
+  }
+  return op_def->is_stateful();
+}
+
+}  // namespace
+
+struct StepArenaAllocator::Chunk {
+  char* base = nullptr;
+  // Bytes handed out so far. Guarded by the mutex of the allocating shard.
+  size_t used = 0;
+  // One reference for the shard that allocates from the chunk, plus one per
+  // live allocation.
+  std::atomic<int64_t> refs{0};
+};
+
+// Precedes every allocation, so that deallocation can find its chunk.
+struct StepArenaAllocator::AllocationHeader {
+  // The chunk the allocation was made from, or nullptr if it was passed
+  // through to the underlying allocator.
+  Chunk* chunk;
+  // For passed through allocations, the pointer returned by the underlying
+  // allocator.
+  void* base_ptr;
+};
+
+/* static */ StepArenaAllocator::AllocationHeader* StepArenaAllocator::HeaderOf(
+    void* ptr) {
+  static_assert(sizeof(AllocationHeader) <= kAlignment,
+                "AllocationHeader must fit in the alignment padding");
+  return reinterpret_cast<AllocationHeader*>(static_cast<char*>(ptr) -
+                                             kAlignment);
+}
+
+StepArenaAllocator::StepArenaAllocator(StepArenaAllocatorMgr* mgr)
+    : mgr_(mgr) {
+  mgr_->Ref();
+}
+
+StepArenaAllocator::~StepArenaAllocator() { mgr_->Unref(); }
+
+void* StepArenaAllocator::AllocateRaw(size_t alignment, size_t num_bytes) {
+  const size_t bytes = AlignUp(num_bytes) + kAlignment;
+  if (alignment > kAlignment || bytes > mgr_->chunk_bytes() / 4) {
+    return AllocateDirect(alignment, num_bytes);
+  }
+  Shard& shard = shards_[ShardIndex(kNumShards)];
+  Chunk* full_chunk = nullptr;
+  char* ptr;
+  {
+    mutex_lock l(shard.mu);
+    Chunk* chunk = shard.chunk;
+    if (chunk == nullptr || chunk->used + bytes > mgr_->chunk_bytes()) {
+      Chunk* new_chunk = mgr_->GetChunk();
+      if (new_chunk == nullptr) return nullptr;
+      // Chunks keep this allocator alive until they are recycled.
+      Ref();
+      new_chunk->refs.store(1, std::memory_order_relaxed);
+      full_chunk = chunk;
+      shard.chunk = chunk = new_chunk;
+    }
+    ptr = chunk->base + chunk->used;
+    chunk->used += bytes;
+    chunk->refs.fetch_add(1, std::memory_order_relaxed);
+    HeaderOf(ptr + kAlignment)->chunk = chunk;
+  }
+  if (full_chunk != nullptr) ReleaseChunk(full_chunk);
+  return ptr + kAlignment;
+}
+
+void* StepArenaAllocator::AllocateDirect(size_t alignment, size_t num_bytes) {
+  // Reserve a whole alignment unit in front of the allocation for the header.
+  const size_t offset = std::max(alignment, kAlignment);
+  void* base_ptr = mgr_->base()->AllocateRaw(offset, num_bytes + offset);
+  if (base_ptr == nullptr) return nullptr;
+  void* ptr = static_cast<char*>(base_ptr) + offset;
+  AllocationHeader* header = HeaderOf(ptr);
+  header->chunk = nullptr;
+  header->base_ptr = base_ptr;
+  // Live allocations keep this allocator alive.
+  Ref();
+  return ptr;
+}
+
+void StepArenaAllocator::DeallocateRaw(void* ptr) {
+  if (ptr == nullptr) return;
+  AllocationHeader* header = HeaderOf(ptr);
+  if (header->chunk == nullptr) {
+    mgr_->base()->DeallocateRaw(header->base_ptr);
+    Unref();
+    return;
+  }
+  ReleaseChunk(header->chunk);
+}
+
+AllocatorMemoryType StepArenaAllocator::GetMemoryType() const {
+  return mgr_->base()->GetMemoryType();
+}
+
+void StepArenaAllocator::ReleaseChunk(Chunk* chunk) {
+  if (chunk->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    mgr_->RecycleChunk(chunk);
+    Unref();
+  }
+}
+
+void StepArenaAllocator::EndStep() {
+  for (Shard& shard : shards_) {
+    Chunk* chunk;
+    {
+      mutex_lock l(shard.mu);
+      chunk = shard.chunk;
+      shard.chunk = nullptr;
+    }
+    if (chunk != nullptr) ReleaseChunk(chunk);
+  }
+  Unref();
+}
+
+StepArenaAllocatorMgr::StepArenaAllocatorMgr(Allocator* base,
+                                             size_t chunk_bytes,
+                                             int max_cached_chunks)
+    : base_(base),
+      chunk_bytes_(AlignUp(chunk_bytes)),
+      max_cached_chunks_(max_cached_chunks) {}
+
+StepArenaAllocatorMgr::~StepArenaAllocatorMgr() {
+  mutex_lock l(mu_);
+  for (StepArenaAllocator::Chunk* chunk : free_chunks_) {
+    base_->DeallocateRaw(chunk->base);
+    delete chunk;
+  }
+}
+
+StepArenaAllocator* StepArenaAllocatorMgr::NewStepAllocator() {
+  return new StepArenaAllocator(this);
+}
+
+int StepArenaAllocatorMgr::num_cached_chunks() const {
+  mutex_lock l(mu_);
+  return free_chunks_.size();
+}
+
+StepArenaAllocator::Chunk* StepArenaAllocatorMgr::GetChunk() {
+  {
+    mutex_lock l(mu_);
+    if (!free_chunks_.empty()) {
+      StepArenaAllocator::Chunk* chunk = free_chunks_.back();
+      free_chunks_.pop_back();
+      return chunk;
+    }
+  }
+  void* base = base_->AllocateRaw(kAlignment, chunk_bytes_);
+  if (base == nullptr) return nullptr;
+  auto* chunk = new StepArenaAllocator::Chunk;
+  chunk->base = static_cast<char*>(base);
+  return chunk;
+}
+
+void StepArenaAllocatorMgr::RecycleChunk(StepArenaAllocator::Chunk* chunk) {
+  chunk->used = 0;
+  {
+    mutex_lock l(mu_);
+    if (free_chunks_.size() < static_cast<size_t>(max_cached_chunks_)) {
+      free_chunks_.push_back(chunk);
+      return;
+    }
+  }
+  base_->DeallocateRaw(chunk->base);
+  delete chunk;
+}
+
+std::vector<bool> FindStepArenaNodes(const GraphView& gview) {
+  const int num_nodes = gview.num_nodes();
+  std::vector<bool> result(num_nodes, false);
+
+  // Order the nodes topologically. Nodes on cycles are left out, and so are
+  // never eligible.
+  std::vector<int> pending(num_nodes, 0);
+  for (int32_t id = 0; id < num_nodes; ++id) {
+    const NodeItem* item = gview.node(id);
+    if (item == nullptr) continue;
+    for (const EdgeInfo& e : item->output_edges()) ++pending[e.dst_id];
+    for (const ControlEdgeInfo& e : item->output_control_edges()) {
+      ++pending[e.dst_id];
+    }
+  }
+  std::vector<int> order;
+  std::deque<int> ready;
+  for (int32_t id = 0; id < num_nodes; ++id) {
+    if (gview.node(id) != nullptr && pending[id] == 0) ready.push_back(id);
+  }
+  while (!ready.empty()) {
+    const int id = ready.front();
+    ready.pop_front();
+    order.push_back(id);
+    const NodeItem& item = gview.node_ref(id);
+    for (const EdgeInfo& e : item.output_edges()) {
+      if (--pending[e.dst_id] == 0) ready.push_back(e.dst_id);
+    }
+    for (const ControlEdgeInfo& e : item.output_control_edges()) {
+      if (--pending[e.dst_id] == 0) ready.push_back(e.dst_id);
+    }
+  }
+
+  // Visit consumers before producers. A node's tensors may escape if a
+  // consumer retains them, or if a consumer that may forward them into one of
+  // its outputs has escaping outputs.
+  std::vector<bool> escapes(num_nodes, false);
+  for (auto it = order.rbegin(); it != order.rend(); ++it) {
+    const NodeItem& item = gview.node_ref(*it);
+    if (item.kernel == nullptr || MayRetainTensors(item)) {
+      escapes[item.node_id] = true;
+      continue;
+    }
+    bool node_escapes = false;
+    for (const EdgeInfo& e : item.output_edges()) {
+      if (e.output_slot < 0) continue;
+      const NodeItem& consumer = gview.node_ref(e.dst_id);
+      if (consumer.kernel == nullptr || MayRetainTensors(consumer)) {
+        node_escapes = true;
+        break;
+      }
+      if (!escapes[e.dst_id]) continue;
+      for (int i = 0; i < consumer.num_outputs; ++i) {
+        if (consumer.output_type(i) == item.output_type(e.output_slot)) {
+          node_escapes = true;
+          break;
+        }
+      }
+      if (node_escapes) break;
+    }
+    escapes[item.node_id] = node_escapes;
+    result[item.node_id] = !node_escapes;
+  }
+  return result;
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,146 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_STEP_ARENA_ALLOCATOR_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_STEP_ARENA_ALLOCATOR_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/graph_view.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/lib/core/refcount.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+
+namespace tensorflow {
+
+class StepArenaAllocatorMgr;
+
+// An allocator for the tensors that the kernels of a single step allocate.
+// Like core::Arena, it bump-allocates from large chunks and frees them in
+// bulk, but chunks are returned to the owning StepArenaAllocatorMgr to be
+// reused by later steps rather than freed.
+//
+// Each thread allocates from its own shard, so an allocation is an
+// uncontended lock and a pointer bump, and a deallocation is an atomic
+// decrement. A chunk is recycled once the step has stopped allocating from it
+// and every tensor allocated from it has been deallocated. Tensors that escape
+// the step therefore remain valid: they promote their chunk to outlive the
+// step, at the cost of keeping it out of the pool until they are released.
+// Allocations that are large or over-aligned are passed through to the
+// underlying allocator.
+//
+// StepArenaAllocator is thread-safe. It deletes itself once the step has
+// ended and every tensor allocated from it has been deallocated.
+class StepArenaAllocator : public Allocator, public core::RefCounted {
+ public:
+  std::string Name() override { return "step_arena"; }
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override;
+  void DeallocateRaw(void* ptr) override;
+  AllocatorMemoryType GetMemoryType() const override;
+
+  // Marks the end of the step. No allocations may be made afterwards.
+  // Releases the caller's reference.
+  void EndStep();
+
+ private:
+  friend class StepArenaAllocatorMgr;
+  struct AllocationHeader;
+  struct Chunk;
+
+  // Number of shards, which bounds the number of chunks a step allocates
+  // from concurrently.
+  static constexpr int kNumShards = 8;
+
+  struct Shard {
+    mutex mu;
+    Chunk* chunk TF_GUARDED_BY(mu) = nullptr;
+  };
+
+  explicit StepArenaAllocator(StepArenaAllocatorMgr* mgr);
+  ~StepArenaAllocator() override;
+
+  // Returns the header that precedes the allocation at `ptr`.
+  static AllocationHeader* HeaderOf(void* ptr);
+
+  void* AllocateDirect(size_t alignment, size_t num_bytes);
+
+  // Releases a reference on `chunk`, recycling it if it was the last.
+  void ReleaseChunk(Chunk* chunk);
+
+  StepArenaAllocatorMgr* const mgr_;
+  Shard shards_[kNumShards];
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StepArenaAllocator);
+};
+
+// Owns the chunks that the StepArenaAllocators of a device allocate from.
+// At most one of these exists per device, see
+// `DeviceBase::GetStepArenaAllocatorMgr()`.
+class StepArenaAllocatorMgr : public core::RefCounted {
+ public:
+  static constexpr size_t kDefaultChunkBytes = 256 << 10;
+  static constexpr int kDefaultMaxCachedChunks = 256;
+
+  // Chunks are allocated from `base`, which must outlive this. Allocations
+  // larger than a quarter of `chunk_bytes` bypass the chunks. At most
+  // `max_cached_chunks` unused chunks are kept for reuse.
+  explicit StepArenaAllocatorMgr(
+      Allocator* base, size_t chunk_bytes = kDefaultChunkBytes,
+      int max_cached_chunks = kDefaultMaxCachedChunks);
+
+  // Returns a new allocator for one step. The caller must call `EndStep()` on
+  // it when the step is done.
+  StepArenaAllocator* NewStepAllocator();
+
+  Allocator* base() const { return base_; }
+  size_t chunk_bytes() const { return chunk_bytes_; }
+
+  // Returns the number of unused chunks that are kept for reuse.
+  int num_cached_chunks() const;
+
+ private:
+  friend class StepArenaAllocator;
+
+  ~StepArenaAllocatorMgr() override;
+
+  // Returns an empty chunk, or nullptr if the underlying allocator is out of
+  // memory.
+  StepArenaAllocator::Chunk* GetChunk();
+  void RecycleChunk(StepArenaAllocator::Chunk* chunk);
+
+  Allocator* const base_;
+  const size_t chunk_bytes_;
+  const int max_cached_chunks_;
+
+  mutable mutex mu_;
+  std::vector<StepArenaAllocator::Chunk*> free_chunks_ TF_GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StepArenaAllocatorMgr);
+};
+
+// Returns, indexed by node id, whether the kernel of each node in `gview`
+// should allocate from the step arena. Nodes that may hold on to the tensors
+// they allocate, such as stateful ops, and nodes whose outputs may reach such
+// a node, possibly through a consumer that forwards its input, are excluded so
+// that long-lived tensors do not pin chunks.
+std::vector<bool> FindStepArenaNodes(const GraphView& gview);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_STEP_ARENA_ALLOCATOR_H_
@@ -0,0 +1,111 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/step_arena_allocator.h"
+
+#include <cstring>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr size_t kChunkBytes = 4096;
+
+core::RefCountPtr<StepArenaAllocatorMgr> NewMgr() {
+  return core::RefCountPtr<StepArenaAllocatorMgr>(new StepArenaAllocatorMgr(
+      cpu_allocator(), kChunkBytes, /*max_cached_chunks=*/4));
+}
+
+TEST(StepArenaAllocatorTest, RecyclesChunksAfterStep) {
+  auto mgr = NewMgr();
+  for (int step = 0; step < 3; ++step) {
+    StepArenaAllocator* allocator = mgr->NewStepAllocator();
+    std::vector<void*> ptrs;
+    for (int i = 0; i < 30; ++i) {
+      void* ptr = allocator->AllocateRaw(Allocator::kAllocatorAlignment, 100);
+      ASSERT_NE(nullptr, ptr);
+      EXPECT_EQ(0, reinterpret_cast<uintptr_t>(ptr) %
+                       Allocator::kAllocatorAlignment);
+      memset(ptr, i, 100);
+      ptrs.push_back(ptr);
+    }
+    for (void* ptr : ptrs) allocator->DeallocateRaw(ptr);
+    allocator->EndStep();
+    // 30 allocations of 192 bytes, including their headers, fill two chunks,
+    // which are reused by the later steps.
+    EXPECT_EQ(2, mgr->num_cached_chunks());
+  }
+}
+
+TEST(StepArenaAllocatorTest, EscapingTensorsPinTheirChunk) {
+  auto mgr = NewMgr();
+  StepArenaAllocator* allocator = mgr->NewStepAllocator();
+  Tensor escaped(allocator, DT_FLOAT, TensorShape({16}));
+  escaped.flat<float>().setConstant(42.0f);
+  {
+    Tensor temp(allocator, DT_FLOAT, TensorShape({16}));
+    temp.flat<float>().setZero();
+  }
+  allocator->EndStep();
+
+  // The tensor that outlives the step keeps its chunk alive.
+  EXPECT_EQ(0, mgr->num_cached_chunks());
+  EXPECT_EQ(42.0f, escaped.flat<float>()(15));
+  escaped = Tensor();
+  EXPECT_EQ(1, mgr->num_cached_chunks());
+}
+
+TEST(StepArenaAllocatorTest, LargeAllocationsPassThrough) {
+  auto mgr = NewMgr();
+  StepArenaAllocator* allocator = mgr->NewStepAllocator();
+  void* large = allocator->AllocateRaw(Allocator::kAllocatorAlignment,
+                                       kChunkBytes * 2);
+  ASSERT_NE(nullptr, large);
+  memset(large, 1, kChunkBytes * 2);
+  void* aligned = allocator->AllocateRaw(256, 16);
+  ASSERT_NE(nullptr, aligned);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(aligned) % 256);
+  allocator->EndStep();
+  allocator->DeallocateRaw(large);
+  allocator->DeallocateRaw(aligned);
+  EXPECT_EQ(0, mgr->num_cached_chunks());
+}
+
+TEST(StepArenaAllocatorTest, ConcurrentAllocations) {
+  auto mgr = NewMgr();
+  StepArenaAllocator* allocator = mgr->NewStepAllocator();
+  {
+    thread::ThreadPool pool(Env::Default(), "test", 8);
+    for (int t = 0; t < 32; ++t) {
+      pool.Schedule([allocator, t]() {
+        for (int i = 0; i < 100; ++i) {
+          Tensor tensor(allocator, DT_INT32, TensorShape({i % 16 + 1}));
+          tensor.flat<int32>().setConstant(t);
+          ASSERT_EQ(t, tensor.flat<int32>()(0));
+        }
+      });
+    }
+  }
+  allocator->EndStep();
+  EXPECT_LE(1, mgr->num_cached_chunks());
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -31,6 +31,7 @@ info. It does not have any negative impact on performance. */
 #include "tensorflow/core/common_runtime/local_device.h"
 #include "tensorflow/core/common_runtime/scoped_allocator.h"
 #include "tensorflow/core/common_runtime/scoped_allocator_mgr.h"
+#include "tensorflow/core/common_runtime/step_arena_allocator.h"
 #include "tensorflow/core/common_runtime/threadpool_device.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/allocator_registry.h"
@@ -62,6 +63,9 @@ ThreadPoolDevice::ThreadPoolDevice(const SessionOptions& options,
                                name, DEVICE_CPU, memory_limit, locality)),
       allocator_(allocator),
       scoped_allocator_mgr_(new ScopedAllocatorMgr(name)) {
+  if (options.config.experimental().enable_step_arena_allocator()) {
+    step_arena_allocator_mgr_.reset(new StepArenaAllocatorMgr(allocator_));
+  }
   auto s = NodeFileWriter::GetNodeFileWriterIfEnabled(name, env());
   if (!s.ok()) {
     LOG(ERROR) << s.status();
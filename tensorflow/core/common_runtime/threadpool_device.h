@@ -19,9 +19,12 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/device_factory.h"
 #include "tensorflow/core/common_runtime/local_device.h"
 #include "tensorflow/core/common_runtime/node_file_writer.h"
+#include "tensorflow/core/lib/core/refcount.h"
 
 namespace tensorflow {
 
+class StepArenaAllocatorMgr;
+
 // CPU device implementation.
 class ThreadPoolDevice : public LocalDevice {
  public:
@@ -36,6 +39,9 @@ class ThreadPoolDevice : public LocalDevice {
   ScopedAllocatorMgr* GetScopedAllocatorMgr() const override {
     return scoped_allocator_mgr_.get();
   }
+  StepArenaAllocatorMgr* GetStepArenaAllocatorMgr() const override {
+    return step_arena_allocator_mgr_.get();
+  }
   Status MakeTensorFromProto(const TensorProto& tensor_proto,
                              const AllocatorAttributes alloc_attrs,
                              Tensor* tensor) override;
@@ -55,6 +61,8 @@ class ThreadPoolDevice : public LocalDevice {
 
   Allocator* allocator_;  // Not owned
   std::unique_ptr<ScopedAllocatorMgr> scoped_allocator_mgr_;
+  // Null unless step arena allocation is enabled in the session options.
+  core::RefCountPtr<StepArenaAllocatorMgr> step_arena_allocator_mgr_;
   NodeFileWriter* node_file_writer_ = nullptr;  // not owned
 };
 
@@ -0,0 +1,481 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/columnar_file_utils.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/framework/allocation_description.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/platform/byte_order.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/mem.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+constexpr char kMagic[] = "TFCOLF01";
+constexpr uint64_t kMagicSize = sizeof(kMagic) - 1;
+constexpr uint64_t kTrailerSize = sizeof(uint64_t) + kMagicSize;
+constexpr uint64_t kOffsetSize = sizeof(uint64_t);
+constexpr char kAllocatorName[] = "columnar_file";
+
+bool IsSupportedDataType(DataType dtype) {
+  return dtype == DT_STRING || DataTypeCanUseMemcpy(dtype);
+}
+
+// The size of the value of `column` in a row of a numeric column.
+uint64_t RowBytes(const ColumnarFileColumn& column) {
+  return column.shape.num_elements() * DataTypeSize(column.dtype);
+}
+
+// A tensor buffer that refers to rows of a column chunk and keeps the memory
+// of the file alive.
+class ColumnChunkBuffer : public TensorBuffer {
+ public:
+  ColumnChunkBuffer(std::shared_ptr<ReadOnlyMemoryRegion> region,
+                    const char* data, size_t size)
+      : TensorBuffer(const_cast<char*>(data)),
+        region_(std::move(region)),
+        size_(size) {}
+
+  size_t size() const override { return size_; }
+  TensorBuffer* root_buffer() override { return this; }
+  void FillAllocationDescription(AllocationDescription* proto) const override {
+    proto->set_requested_bytes(size_);
+    proto->set_allocator_name(kAllocatorName);
+  }
+  // The memory may be mapped read-only, so ops must not reuse it for their
+  // outputs.
+  bool OwnsMemory() const override { return false; }
+
+ private:
+  const std::shared_ptr<ReadOnlyMemoryRegion> region_;
+  const size_t size_;
+};
+
+// A copy of a file in memory, for file systems that do not support mapping
+// files.
+class InMemoryRegion : public ReadOnlyMemoryRegion {
+ public:
+  explicit InMemoryRegion(uint64_t length)
+      : data_(static_cast<char*>(port::AlignedMalloc(
+            std::max<uint64_t>(length, 1), kColumnarFileAlignment))),
+        length_(length) {}
+  ~InMemoryRegion() override { port::AlignedFree(data_); }
+
+  const void* data() override { return data_; }
+  uint64 length() override { return length_; }
+  char* mutable_data() { return data_; }
+
+ private:
+  char* const data_;
+  const uint64_t length_;
+};
+
+StatusOr<std::unique_ptr<ReadOnlyMemoryRegion>> ReadFileIntoMemory(
+    Env* env, const std::string& filename) {
+  uint64_t length;
+  TF_RETURN_IF_ERROR(env->GetFileSize(filename, &length));
+  std::unique_ptr<RandomAccessFile> file;
+  TF_RETURN_IF_ERROR(env->NewRandomAccessFile(filename, &file));
+  auto region = std::make_unique<InMemoryRegion>(length);
+  StringPiece result;
+  Status s = file->Read(/*offset=*/0, length, &result, region->mutable_data());
+  if (!s.ok() && !errors::IsOutOfRange(s)) {
+    return s;
+  }
+  if (result.size() != length) {
+    return errors::DataLoss("Failed to read ", filename, ": expected ", length,
+                            " bytes, got ", result.size());
+  }
+  if (result.data() != region->mutable_data()) {
+    std::memcpy(region->mutable_data(), result.data(), length);
+  }
+  return region;
+}
+
+}  // namespace
+
+ColumnarFileWriter::ColumnarFileWriter(Env* env, const std::string& filename,
+                                       std::vector<ColumnarFileColumn> columns)
+    : env_(env), filename_(filename), columns_(std::move(columns)) {}
+
+Status ColumnarFileWriter::Initialize() {
+  if (!port::kLittleEndian) {
+    return errors::Unimplemented(
+        "Columnar files are only supported on little-endian platforms.");
+  }
+  for (const ColumnarFileColumn& column : columns_) {
+    if (!IsSupportedDataType(column.dtype)) {
+      return errors::InvalidArgument("Column ", column.name, " has dtype ",
+                                     DataTypeString(column.dtype),
+                                     ", which columnar files do not support.");
+    }
+  }
+  TF_RETURN_IF_ERROR(env_->NewWritableFile(filename_, &file_));
+  return Append(StringPiece(kMagic, kMagicSize));
+}
+
+Status ColumnarFileWriter::WriteRowGroup(
+    const std::vector<Tensor>& batched_columns) {
+  if (!file_) {
+    return errors::FailedPrecondition("Columnar file ", filename_,
+                                      " is not open for writing.");
+  }
+  if (batched_columns.size() != columns_.size()) {
+    return errors::InvalidArgument("Expected ", columns_.size(),
+                                   " columns, got ", batched_columns.size());
+  }
+  RowGroup row_group;
+  for (int i = 0; i < columns_.size(); ++i) {
+    const Tensor& values = batched_columns[i];
+    if (values.dims() == 0) {
+      return errors::InvalidArgument("Values of column ", columns_[i].name,
+                                     " must have a batch dimension.");
+    }
+    if (i == 0) row_group.num_rows = values.dim_size(0);
+    TensorShape expected_shape({row_group.num_rows});
+    expected_shape.AppendShape(columns_[i].shape);
+    if (values.dtype() != columns_[i].dtype ||
+        values.shape() != expected_shape) {
+      return errors::InvalidArgument(
+          "Expected values of column ", columns_[i].name, " to have dtype ",
+          DataTypeString(columns_[i].dtype), " and shape ",
+          expected_shape.DebugString(), ", got ",
+          DataTypeString(values.dtype()), " and ",
+          values.shape().DebugString());
+    }
+  }
+
+  for (int i = 0; i < columns_.size(); ++i) {
+    const Tensor& values = batched_columns[i];
+    TF_RETURN_IF_ERROR(Pad());
+    const uint64_t offset = position_;
+    if (values.dtype() == DT_STRING) {
+      auto flat = values.flat<tstring>();
+      std::string offsets;
+      offsets.reserve((flat.size() + 1) * kOffsetSize);
+      uint64_t end = 0;
+      core::PutFixed64(&offsets, end);
+      for (int64_t j = 0; j < flat.size(); ++j) {
+        end += flat(j).size();
+        core::PutFixed64(&offsets, end);
+      }
+      TF_RETURN_IF_ERROR(Append(offsets));
+      for (int64_t j = 0; j < flat.size(); ++j) {
+        TF_RETURN_IF_ERROR(Append(flat(j)));
+      }
+    } else {
+      TF_RETURN_IF_ERROR(Append(values.tensor_data()));
+    }
+    row_group.offsets.push_back(offset);
+    row_group.sizes.push_back(position_ - offset);
+  }
+  row_groups_.push_back(std::move(row_group));
+  return OkStatus();
+}
+
+Status ColumnarFileWriter::Close() {
+  if (!file_) {
+    return errors::FailedPrecondition("Columnar file ", filename_,
+                                      " is not open for writing.");
+  }
+  std::string footer;
+  core::PutVarint32(&footer, columns_.size());
+  for (const ColumnarFileColumn& column : columns_) {
+    core::PutVarint32(&footer, column.name.size());
+    footer.append(column.name);
+    core::PutVarint32(&footer, column.dtype);
+    core::PutVarint32(&footer, column.shape.dims());
+    for (int64_t dim : column.shape.dim_sizes()) {
+      core::PutVarint64(&footer, dim);
+    }
+  }
+  core::PutVarint64(&footer, row_groups_.size());
+  for (const RowGroup& row_group : row_groups_) {
+    core::PutVarint64(&footer, row_group.num_rows);
+    for (int i = 0; i < columns_.size(); ++i) {
+      core::PutFixed64(&footer, row_group.offsets[i]);
+      core::PutFixed64(&footer, row_group.sizes[i]);
+    }
+  }
+  core::PutFixed64(&footer, footer.size());
+  footer.append(kMagic, kMagicSize);
+  TF_RETURN_IF_ERROR(Append(footer));
+  Status s = file_->Close();
+  file_.reset();
+  return s;
+}
+
+Status ColumnarFileWriter::Append(StringPiece data) {
+  TF_RETURN_IF_ERROR(file_->Append(data));
+  position_ += data.size();
+  return OkStatus();
+}
+
+Status ColumnarFileWriter::Pad() {
+  const uint64_t padding =
+      (kColumnarFileAlignment - position_ % kColumnarFileAlignment) %
+      kColumnarFileAlignment;
+  if (padding == 0) return OkStatus();
+  return Append(std::string(padding, '\0'));
+}
+
+StatusOr<std::unique_ptr<ColumnarFileReader>> ColumnarFileReader::Open(
+    Env* env, const std::string& filename) {
+  if (!port::kLittleEndian) {
+    return errors::Unimplemented(
+        "Columnar files are only supported on little-endian platforms.");
+  }
+  std::unique_ptr<ReadOnlyMemoryRegion> region;
+  Status s = env->NewReadOnlyMemoryRegionFromFile(filename, &region);
+  if (errors::IsUnimplemented(s) || (s.ok() && !region)) {
+    TF_ASSIGN_OR_RETURN(region, ReadFileIntoMemory(env, filename));
+  } else {
+    TF_RETURN_IF_ERROR(s);
+  }
+  std::unique_ptr<ColumnarFileReader> reader(
+      new ColumnarFileReader(std::move(region), filename));
+  TF_RETURN_IF_ERROR(reader->ReadFooter());
+  return reader;
+}
+
+ColumnarFileReader::ColumnarFileReader(
+    std::shared_ptr<ReadOnlyMemoryRegion> region, const std::string& filename)
+    : region_(std::move(region)),
+      data_(static_cast<const char*>(region_->data())),
+      length_(region_->length()),
+      filename_(filename) {}
+
+Status ColumnarFileReader::ReadFooter() {
+  auto corrupted = [this](StringPiece reason) {
+    return errors::DataLoss("Corrupted columnar file ", filename_, ": ",
+                            reason);
+  };
+  if (length_ < kMagicSize + kTrailerSize ||
+      std::memcmp(data_, kMagic, kMagicSize) != 0 ||
+      std::memcmp(data_ + length_ - kMagicSize, kMagic, kMagicSize) != 0) {
+    return errors::DataLoss(filename_, " is not a columnar file.");
+  }
+  const uint64_t footer_size =
+      core::DecodeFixed64(data_ + length_ - kTrailerSize);
+  if (footer_size > length_ - kMagicSize - kTrailerSize) {
+    return corrupted("invalid footer size");
+  }
+  const uint64_t data_end = length_ - kTrailerSize - footer_size;
+  StringPiece footer(data_ + data_end, footer_size);
+
+  uint32_t num_columns;
+  if (!core::GetVarint32(&footer, &num_columns)) {
+    return corrupted("invalid number of columns");
+  }
+  for (uint32_t i = 0; i < num_columns; ++i) {
+    ColumnarFileColumn column;
+    uint32_t name_size, dtype, rank;
+    if (!core::GetVarint32(&footer, &name_size) ||
+        footer.size() < name_size) {
+      return corrupted("invalid column name");
+    }
+    column.name = std::string(footer.substr(0, name_size));
+    footer.remove_prefix(name_size);
+    if (!core::GetVarint32(&footer, &dtype) || !DataType_IsValid(dtype) ||
+        !IsSupportedDataType(static_cast<DataType>(dtype))) {
+      return corrupted(absl::StrCat("invalid dtype of column ", column.name));
+    }
+    column.dtype = static_cast<DataType>(dtype);
+    if (!core::GetVarint32(&footer, &rank) ||
+        rank > TensorShape::MaxDimensions()) {
+      return corrupted(absl::StrCat("invalid shape of column ", column.name));
+    }
+    std::vector<int64_t> dims(rank);
+    for (int64_t& dim : dims) {
+      uint64_t value;
+      if (!core::GetVarint64(&footer, &value)) {
+        return corrupted(
+            absl::StrCat("invalid shape of column ", column.name));
+      }
+      dim = static_cast<int64_t>(value);
+    }
+    if (!TensorShape::BuildTensorShape(dims, &column.shape).ok()) {
+      return corrupted(absl::StrCat("invalid shape of column ", column.name));
+    }
+    columns_.push_back(std::move(column));
+  }
+
+  uint64_t num_row_groups;
+  if (!core::GetVarint64(&footer, &num_row_groups)) {
+    return corrupted("invalid number of row groups");
+  }
+  for (uint64_t i = 0; i < num_row_groups; ++i) {
+    RowGroup row_group;
+    uint64_t num_rows;
+    if (!core::GetVarint64(&footer, &num_rows) ||
+        num_rows > std::numeric_limits<int64_t>::max()) {
+      return corrupted("invalid number of rows");
+    }
+    row_group.num_rows = num_rows;
+    for (const ColumnarFileColumn& column : columns_) {
+      if (footer.size() < 2 * sizeof(uint64_t)) {
+        return corrupted("truncated footer");
+      }
+      const uint64_t offset = core::DecodeFixed64(footer.data());
+      const uint64_t size = core::DecodeFixed64(footer.data() + 8);
+      footer.remove_prefix(2 * sizeof(uint64_t));
+      if (offset < kMagicSize || offset > data_end ||
+          size > data_end - offset || offset % kColumnarFileAlignment != 0) {
+        return corrupted(
+            absl::StrCat("invalid chunk of column ", column.name));
+      }
+      // Validate that the chunk holds `num_rows` rows, without overflowing.
+      const uint64_t values_per_row = column.shape.num_elements();
+      bool valid;
+      if (column.dtype == DT_STRING) {
+        const uint64_t max_values = size / kOffsetSize;
+        valid = max_values > 0 &&
+                (values_per_row == 0 ||
+                 num_rows <= (max_values - 1) / values_per_row);
+      } else {
+        const uint64_t row_bytes = RowBytes(column);
+        valid = row_bytes == 0 ? size == 0
+                               : size % row_bytes == 0 &&
+                                     size / row_bytes == num_rows;
+      }
+      if (!valid) {
+        return corrupted(
+            absl::StrCat("invalid size of chunk of column ", column.name));
+      }
+      row_group.chunks.push_back(data_ + offset);
+      row_group.sizes.push_back(size);
+    }
+    row_groups_.push_back(std::move(row_group));
+  }
+  if (!footer.empty()) {
+    return corrupted("unexpected data at the end of the footer");
+  }
+  return OkStatus();
+}
+
+StatusOr<int> ColumnarFileReader::ColumnIndex(const std::string& name) const {
+  for (int i = 0; i < columns_.size(); ++i) {
+    if (columns_[i].name == name) return i;
+  }
+  return errors::NotFound("Column ", name, " not found in columnar file ",
+                          filename_);
+}
+
+const char* ColumnarFileReader::RowAddress(int64_t row_group, int column_index,
+                                           int64_t row) const {
+  return row_groups_[row_group].chunks[column_index] +
+         row * RowBytes(columns_[column_index]);
+}
+
+bool ColumnarFileReader::CanAlias(int64_t row_group, int column_index,
+                                  int64_t start) const {
+  if (columns_[column_index].dtype == DT_STRING) return false;
+  return reinterpret_cast<uintptr_t>(
+             RowAddress(row_group, column_index, start)) %
+             EIGEN_MAX_ALIGN_BYTES ==
+         0;
+}
+
+StatusOr<Tensor> ColumnarFileReader::Read(int64_t row_group, int column_index,
+                                          int64_t start,
+                                          int64_t num_rows) const {
+  if (row_group < 0 || row_group >= row_groups_.size() || column_index < 0 ||
+      column_index >= columns_.size() || start < 0 || num_rows < 0 ||
+      start > row_groups_[row_group].num_rows - num_rows) {
+    return errors::InvalidArgument("Invalid range of rows of columnar file ",
+                                   filename_);
+  }
+  const ColumnarFileColumn& column = columns_[column_index];
+  TensorShape shape({num_rows});
+  shape.AppendShape(column.shape);
+  if (CanAlias(row_group, column_index, start)) {
+    auto* buffer = new ColumnChunkBuffer(
+        region_, RowAddress(row_group, column_index, start),
+        num_rows * RowBytes(column));
+    Tensor tensor(column.dtype, shape, buffer);
+    buffer->Unref();
+    return tensor;
+  }
+  Tensor tensor(column.dtype, shape);
+  TF_RETURN_IF_ERROR(CopyTo(row_group, column_index, start, num_rows, &tensor,
+                            /*output_offset=*/0));
+  return tensor;
+}
+
+Status ColumnarFileReader::CopyTo(int64_t row_group, int column_index,
+                                  int64_t start, int64_t num_rows,
+                                  Tensor* output, int64_t output_offset) const {
+  if (row_group < 0 || row_group >= row_groups_.size() || column_index < 0 ||
+      column_index >= columns_.size() || start < 0 || num_rows < 0 ||
+      start > row_groups_[row_group].num_rows - num_rows) {
+    return errors::InvalidArgument("Invalid range of rows of columnar file ",
+                                   filename_);
+  }
+  const ColumnarFileColumn& column = columns_[column_index];
+  TensorShape row_shape = output->shape();
+  if (output->dtype() != column.dtype || row_shape.dims() == 0 ||
+      output_offset < 0 || output_offset > row_shape.dim_size(0) - num_rows) {
+    return errors::InvalidArgument("Invalid output for column ", column.name);
+  }
+  row_shape.RemoveDim(0);
+  if (row_shape != column.shape) {
+    return errors::InvalidArgument("Invalid output shape for column ",
+                                   column.name);
+  }
+
+  if (column.dtype != DT_STRING) {
+    const uint64_t row_bytes = RowBytes(column);
+    std::memcpy(static_cast<char*>(output->data()) + output_offset * row_bytes,
+                RowAddress(row_group, column_index, start),
+                num_rows * row_bytes);
+    return OkStatus();
+  }
+
+  const char* chunk = row_groups_[row_group].chunks[column_index];
+  const uint64_t chunk_size = row_groups_[row_group].sizes[column_index];
+  const int64_t values_per_row = column.shape.num_elements();
+  const int64_t num_values = row_groups_[row_group].num_rows * values_per_row;
+  const char* bytes = chunk + (num_values + 1) * kOffsetSize;
+  const uint64_t bytes_size = chunk_size - (num_values + 1) * kOffsetSize;
+  auto flat = output->flat<tstring>();
+  for (int64_t i = 0; i < num_rows * values_per_row; ++i) {
+    const int64_t value = start * values_per_row + i;
+    const uint64_t begin = core::DecodeFixed64(chunk + value * kOffsetSize);
+    const uint64_t end = core::DecodeFixed64(chunk + (value + 1) * kOffsetSize);
+    if (begin > end || end > bytes_size) {
+      return errors::DataLoss("Corrupted columnar file ", filename_,
+                              ": invalid string offsets of column ",
+                              column.name);
+    }
+    flat(output_offset * values_per_row + i).assign(bytes + begin, end - begin);
+  }
+  return OkStatus();
+}
+
+}  // namespace data
+}  // namespace tensorflow
@@ -0,0 +1,171 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_DATA_COLUMNAR_FILE_UTILS_H_
+#define TENSORFLOW_CORE_DATA_COLUMNAR_FILE_UTILS_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/file_system.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/statusor.h"
+
+namespace tensorflow {
+namespace data {
+
+// A columnar file stores a sequence of rows. Every row consists of the same
+// named columns, and every column has a fixed dtype and per-row shape. Rows
+// are grouped into row groups, and a row group stores the values of each
+// column contiguously in a "column chunk". This lets a reader access a subset
+// of the columns without touching the others (projection pushdown), and lets
+// a range of rows of a numeric column be used in place as a tensor.
+//
+// File layout:
+//
+//   magic (8 bytes)
+//   column chunks, each starting at a multiple of `kColumnarFileAlignment`
+//   footer
+//   footer size (fixed64)
+//   magic (8 bytes)
+//
+// The footer lists the columns (name, dtype, and per-row shape) followed by
+// the row groups (number of rows, and the offset and size of every column
+// chunk). Numeric column chunks hold the values in little-endian order.
+// String column chunks hold `n + 1` fixed64 offsets of the `n` strings,
+// relative to the end of the offsets, followed by the string bytes.
+
+// Alignment of column chunks. This is at least the alignment required for
+// tensor buffers, so that chunks of mapped files can back tensors directly.
+inline constexpr int64_t kColumnarFileAlignment = 64;
+
+// Describes a column of a columnar file.
+struct ColumnarFileColumn {
+  std::string name;
+  DataType dtype;
+  // The shape of the value of the column in each row.
+  TensorShape shape;
+};
+
+// Writes a columnar file. Rows are appended one row group at a time.
+//
+// Usage example:
+//
+// ColumnarFileWriter writer(env, filename, columns);
+// TF_RETURN_IF_ERROR(writer.Initialize());
+// TF_RETURN_IF_ERROR(writer.WriteRowGroup(batched_columns));
+// TF_RETURN_IF_ERROR(writer.Close());
+class ColumnarFileWriter {
+ public:
+  ColumnarFileWriter(Env* env, const std::string& filename,
+                     std::vector<ColumnarFileColumn> columns);
+
+  // Creates the file and writes its header.
+  Status Initialize();
+
+  // Appends a row group. `batched_columns[i]` holds the values of the i-th
+  // column for every row of the group, i.e. it has the column dtype and shape
+  // `[num_rows] + columns[i].shape`.
+  Status WriteRowGroup(const std::vector<Tensor>& batched_columns);
+
+  // Writes the footer and closes the file.
+  Status Close();
+
+ private:
+  struct RowGroup {
+    int64_t num_rows = 0;
+    std::vector<uint64_t> offsets;
+    std::vector<uint64_t> sizes;
+  };
+
+  Status Append(StringPiece data);
+  Status Pad();
+
+  Env* const env_;
+  const std::string filename_;
+  const std::vector<ColumnarFileColumn> columns_;
+  std::unique_ptr<WritableFile> file_;
+  uint64_t position_ = 0;
+  std::vector<RowGroup> row_groups_;
+};
+
+// Reads a columnar file. The file is memory-mapped when the file system
+// supports it, and read into memory otherwise.
+class ColumnarFileReader {
+ public:
+  static StatusOr<std::unique_ptr<ColumnarFileReader>> Open(
+      Env* env, const std::string& filename);
+
+  const std::vector<ColumnarFileColumn>& columns() const { return columns_; }
+
+  // Returns the index of the column named `name`, or NotFound.
+  StatusOr<int> ColumnIndex(const std::string& name) const;
+
+  int64_t num_row_groups() const { return row_groups_.size(); }
+  int64_t num_rows(int64_t row_group) const {
+    return row_groups_[row_group].num_rows;
+  }
+
+  // Returns whether `Read` can return the rows without copying them.
+  bool CanAlias(int64_t row_group, int column_index, int64_t start) const;
+
+  // Returns the values of the column `column_index` for the rows
+  // `[start, start + num_rows)` of `row_group`. The result aliases the file
+  // contents if `CanAlias` returns true, and is a copy otherwise.
+  StatusOr<Tensor> Read(int64_t row_group, int column_index, int64_t start,
+                        int64_t num_rows) const;
+
+  // Copies the values of the column `column_index` for the rows
+  // `[start, start + num_rows)` of `row_group` into `output`, starting at
+  // index `output_offset` of its first dimension.
+  Status CopyTo(int64_t row_group, int column_index, int64_t start,
+                int64_t num_rows, Tensor* output,
+                int64_t output_offset) const;
+
+ private:
+  struct RowGroup {
+    int64_t num_rows = 0;
+    std::vector<const char*> chunks;
+    std::vector<uint64_t> sizes;
+  };
+
+  ColumnarFileReader(std::shared_ptr<ReadOnlyMemoryRegion> region,
+                     const std::string& filename);
+
+  // Parses the footer, validating that all chunks lie within the file.
+  Status ReadFooter();
+
+  // Returns the address of the value of `column_index` for row `row` of a
+  // numeric column.
+  const char* RowAddress(int64_t row_group, int column_index,
+                         int64_t row) const;
+
+  const std::shared_ptr<ReadOnlyMemoryRegion> region_;
+  const char* const data_;
+  const uint64_t length_;
+  const std::string filename_;
+  std::vector<ColumnarFileColumn> columns_;
+  std::vector<RowGroup> row_groups_;
+};
+
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DATA_COLUMNAR_FILE_UTILS_H_
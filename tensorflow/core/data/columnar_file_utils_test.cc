@@ -0,0 +1,164 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/columnar_file_utils.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/data/dataset_test_base.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/protobuf/error_codes.pb.h"
+#include "tsl/platform/status_matchers.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+using ::testing::HasSubstr;
+using ::tsl::testing::StatusIs;
+
+std::vector<ColumnarFileColumn> TestColumns() {
+  return {{"ids", DT_INT64, TensorShape({})},
+          {"features", DT_FLOAT, TensorShape({3})},
+          {"tokens", DT_STRING, TensorShape({2})}};
+}
+
+std::string WriteTestFile(const std::string& name) {
+  const std::string filename = io::JoinPath(testing::TmpDir(), name);
+  ColumnarFileWriter writer(Env::Default(), filename, TestColumns());
+  TF_CHECK_OK(writer.Initialize());
+  // Row groups of 2 and 1 rows.
+  TF_CHECK_OK(writer.WriteRowGroup(
+      {CreateTensor<int64_t>(TensorShape({2}), {0, 1}),
+       CreateTensor<float>(TensorShape({2, 3}), {0, 1, 2, 3, 4, 5}),
+       CreateTensor<tstring>(TensorShape({2, 2}), {"a", "bc", "", "def"})}));
+  TF_CHECK_OK(writer.WriteRowGroup(
+      {CreateTensor<int64_t>(TensorShape({1}), {2}),
+       CreateTensor<float>(TensorShape({1, 3}), {6, 7, 8}),
+       CreateTensor<tstring>(TensorShape({1, 2}), {"g", "hi"})}));
+  TF_CHECK_OK(writer.Close());
+  return filename;
+}
+
+TEST(ColumnarFileUtilsTest, ReadColumns) {
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ColumnarFileReader> reader,
+      ColumnarFileReader::Open(Env::Default(), WriteTestFile("read_columns")));
+  ASSERT_EQ(reader->columns().size(), 3);
+  EXPECT_EQ(reader->columns()[1].name, "features");
+  EXPECT_EQ(reader->columns()[1].dtype, DT_FLOAT);
+  EXPECT_EQ(reader->columns()[1].shape, TensorShape({3}));
+  ASSERT_EQ(reader->num_row_groups(), 2);
+  EXPECT_EQ(reader->num_rows(0), 2);
+  EXPECT_EQ(reader->num_rows(1), 1);
+
+  TF_ASSERT_OK_AND_ASSIGN(int features, reader->ColumnIndex("features"));
+  TF_ASSERT_OK_AND_ASSIGN(Tensor values, reader->Read(0, features, 0, 2));
+  test::ExpectEqual(values, CreateTensor<float>(TensorShape({2, 3}),
+                                                {0, 1, 2, 3, 4, 5}));
+  TF_ASSERT_OK_AND_ASSIGN(values, reader->Read(0, features, 1, 1));
+  test::ExpectEqual(values,
+                    CreateTensor<float>(TensorShape({1, 3}), {3, 4, 5}));
+
+  TF_ASSERT_OK_AND_ASSIGN(int tokens, reader->ColumnIndex("tokens"));
+  TF_ASSERT_OK_AND_ASSIGN(values, reader->Read(0, tokens, 1, 1));
+  test::ExpectEqual(values,
+                    CreateTensor<tstring>(TensorShape({1, 2}), {"", "def"}));
+  TF_ASSERT_OK_AND_ASSIGN(values, reader->Read(1, tokens, 0, 1));
+  test::ExpectEqual(values,
+                    CreateTensor<tstring>(TensorShape({1, 2}), {"g", "hi"}));
+
+  EXPECT_THAT(reader->ColumnIndex("labels"),
+              StatusIs(error::NOT_FOUND, HasSubstr("labels")));
+  EXPECT_THAT(reader->Read(1, features, 0, 2),
+              StatusIs(error::INVALID_ARGUMENT));
+}
+
+TEST(ColumnarFileUtilsTest, AliasAlignedRows) {
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ColumnarFileReader> reader,
+      ColumnarFileReader::Open(Env::Default(), WriteTestFile("alias_rows")));
+  TF_ASSERT_OK_AND_ASSIGN(int ids, reader->ColumnIndex("ids"));
+  TF_ASSERT_OK_AND_ASSIGN(int tokens, reader->ColumnIndex("tokens"));
+  // Column chunks are aligned, while the second row of a chunk of 8-byte
+  // values is not.
+  EXPECT_TRUE(reader->CanAlias(0, ids, 0));
+  EXPECT_FALSE(reader->CanAlias(0, ids, 1));
+  EXPECT_FALSE(reader->CanAlias(0, tokens, 0));
+
+  Tensor values;
+  {
+    TF_ASSERT_OK_AND_ASSIGN(values, reader->Read(0, ids, 0, 2));
+  }
+  // The tensor keeps the file contents alive after the reader is destroyed.
+  reader.reset();
+  test::ExpectEqual(values, CreateTensor<int64_t>(TensorShape({2}), {0, 1}));
+}
+
+TEST(ColumnarFileUtilsTest, CopyAcrossRowGroups) {
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ColumnarFileReader> reader,
+      ColumnarFileReader::Open(Env::Default(), WriteTestFile("copy_rows")));
+  TF_ASSERT_OK_AND_ASSIGN(int tokens, reader->ColumnIndex("tokens"));
+  Tensor values(DT_STRING, TensorShape({2, 2}));
+  TF_ASSERT_OK(reader->CopyTo(0, tokens, 1, 1, &values, /*output_offset=*/0));
+  TF_ASSERT_OK(reader->CopyTo(1, tokens, 0, 1, &values, /*output_offset=*/1));
+  test::ExpectEqual(values, CreateTensor<tstring>(TensorShape({2, 2}),
+                                                  {"", "def", "g", "hi"}));
+  EXPECT_THAT(
+      reader->CopyTo(0, tokens, 0, 2, &values, /*output_offset=*/1),
+      StatusIs(error::INVALID_ARGUMENT));
+}
+
+TEST(ColumnarFileUtilsTest, InvalidRowGroup) {
+  ColumnarFileWriter writer(
+      Env::Default(), io::JoinPath(testing::TmpDir(), "invalid_row_group"),
+      TestColumns());
+  TF_ASSERT_OK(writer.Initialize());
+  EXPECT_THAT(
+      writer.WriteRowGroup(
+          {CreateTensor<int64_t>(TensorShape({1}), {0}),
+           CreateTensor<float>(TensorShape({1, 2}), {0, 1}),
+           CreateTensor<tstring>(TensorShape({1, 2}), {"a", "b"})}),
+      StatusIs(error::INVALID_ARGUMENT, HasSubstr("features")));
+}
+
+TEST(ColumnarFileUtilsTest, NotAColumnarFile) {
+  const std::string filename =
+      io::JoinPath(testing::TmpDir(), "not_a_columnar_file");
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), filename,
+                                 "This is not a columnar file."));
+  EXPECT_THAT(ColumnarFileReader::Open(Env::Default(), filename),
+              StatusIs(error::DATA_LOSS));
+}
+
+TEST(ColumnarFileUtilsTest, CorruptedFooter) {
+  const std::string filename = WriteTestFile("corrupted_footer");
+  std::string contents;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), filename, &contents));
+  // Truncate the footer while keeping the trailer intact.
+  contents.erase(contents.size() - 24, 8);
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), filename, contents));
+  EXPECT_THAT(ColumnarFileReader::Open(Env::Default(), filename),
+              StatusIs(error::DATA_LOSS));
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
@@ -15,9 +15,12 @@ limitations under the License.
 #include "tensorflow/core/data/compression_utils.h"
 
 #include <limits>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "absl/memory/memory.h"
+#include "dictBuilder/zdict.h"  // from @net_zstd
 #include "tensorflow/core/common_runtime/dma_helper.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/types.pb.h"
@@ -26,6 +29,7 @@ limitations under the License.
 #include "tensorflow/core/platform/snappy.h"
 #include "tensorflow/core/platform/status.h"
 #include "tensorflow/core/platform/types.h"
+#include "zstd.h"  // from @net_zstd
 
 namespace tensorflow {
 namespace data {
@@ -34,7 +38,42 @@ namespace {
 // Increment this when making changes to the `CompressedElement` proto. The
 // `UncompressElement` function will determine what to read according to the
 // version.
-constexpr int kCompressedElementVersion = 0;
+constexpr int kCompressedElementVersion = 1;
+
+// Elements compressed with Snappy are unchanged since version 0, and keep that
+// version so that older readers can read them.
+constexpr int kSnappyCompressedElementVersion = 0;
+
+struct ZstdCCtxDeleter {
+  void operator()(ZSTD_CCtx* cctx) const { ZSTD_freeCCtx(cctx); }
+};
+
+struct ZstdDCtxDeleter {
+  void operator()(ZSTD_DCtx* dctx) const { ZSTD_freeDCtx(dctx); }
+};
+
+// Zstd contexts hold several hundred KB of state, so each thread reuses its
+// own across elements.
+ZSTD_CCtx* ThreadLocalZstdCCtx() {
+  thread_local std::unique_ptr<ZSTD_CCtx, ZstdCCtxDeleter> cctx(
+      ZSTD_createCCtx());
+  return cctx.get();
+}
+
+ZSTD_DCtx* ThreadLocalZstdDCtx() {
+  thread_local std::unique_ptr<ZSTD_DCtx, ZstdDCtxDeleter> dctx(
+      ZSTD_createDCtx());
+  return dctx.get();
+}
+
+Status ValidateZstdLevel(int level) {
+  if (level < ZSTD_minCLevel() || level > ZSTD_maxCLevel()) {
+    return errors::InvalidArgument("Zstd compression level must be between ",
+                                   ZSTD_minCLevel(), " and ", ZSTD_maxCLevel(),
+                                   ", but got ", level);
+  }
+  return OkStatus();
+}
 
 }  // namespace
 
@@ -61,8 +100,13 @@ class Iov {
   size_t num_bytes_;
 };
 
-Status CompressElement(const std::vector<Tensor>& element,
-                       CompressedElement* out) {
+namespace {
+
+// Returns an iov array of the bytes to compress for `element`, and fills out
+// the component metadata of `out`. Components that cannot be pointed to
+// directly are serialized into `nonmemcpyable`, which must outlive the result.
+Iov PrepareElement(const std::vector<Tensor>& element, tstring* nonmemcpyable,
+                   CompressedElement* out) {
   // First pass: preprocess the non`memcpy`able tensors.
   size_t num_string_tensors = 0;
   size_t num_string_tensor_strings = 0;
@@ -87,9 +131,8 @@ Status CompressElement(const std::vector<Tensor>& element,
   // - All other tensors are serialized and copied into a string (a `tstring`
   // for access to `resize_unitialized`).
   Iov iov{element.size() + num_string_tensor_strings - num_string_tensors};
-  tstring nonmemcpyable;
-  nonmemcpyable.resize_uninitialized(total_nonmemcpyable_size);
-  char* nonmemcpyable_pos = nonmemcpyable.mdata();
+  nonmemcpyable->resize_uninitialized(total_nonmemcpyable_size);
+  char* nonmemcpyable_pos = nonmemcpyable->mdata();
   int nonmemcpyable_component_index = 0;
   for (int i = 0; i < element.size(); ++i) {
     const auto& component = element[i];
@@ -119,25 +162,281 @@ Status CompressElement(const std::vector<Tensor>& element,
       metadata->add_uncompressed_bytes(proto.ByteSizeLong());
     }
   }
+  return iov;
+}
 
+Status SnappyCompress(Iov& iov, std::string* out) {
   if (iov.NumBytes() > kuint32max) {
     return errors::OutOfRange("Encountered dataset element of size ",
                               iov.NumBytes(),
                               ", exceeding the 4GB Snappy limit.");
   }
-  if (!port::Snappy_CompressFromIOVec(iov.Data(), iov.NumBytes(),
-                                      out->mutable_data())) {
+  if (!port::Snappy_CompressFromIOVec(iov.Data(), iov.NumBytes(), out)) {
     return errors::Internal("Failed to compress using snappy.");
   }
-  out->set_version(kCompressedElementVersion);
+  return OkStatus();
+}
+
+Status ZstdCompress(Iov& iov, const CompressionOptions& options,
+                    std::string* out) {
+  ZSTD_CCtx* cctx = ThreadLocalZstdCCtx();
+  if (cctx == nullptr) {
+    return errors::ResourceExhausted(
+        "Failed to create a zstd compression context.");
+  }
+  ZSTD_CCtx_reset(cctx, ZSTD_reset_session_and_parameters);
+  size_t result =
+      options.dictionary != nullptr
+          ? ZSTD_CCtx_refCDict(cctx, options.dictionary->cdict())
+          : ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel,
+                                   options.level);
+  if (!ZSTD_isError(result)) {
+    result = ZSTD_CCtx_setPledgedSrcSize(cctx, iov.NumBytes());
+  }
+  if (ZSTD_isError(result)) {
+    return errors::Internal("Failed to configure zstd compression: ",
+                            ZSTD_getErrorName(result));
+  }
+
+  // The pieces are compressed into a single frame, so that compression spans
+  // the boundaries between them as it does with Snappy.
+  out->resize(ZSTD_compressBound(iov.NumBytes()));
+  ZSTD_outBuffer output = {out->data(), out->size(), 0};
+  for (size_t i = 0; i < iov.NumPieces(); ++i) {
+    ZSTD_inBuffer input = {iov.Data()[i].iov_base, iov.Data()[i].iov_len, 0};
+    while (input.pos < input.size) {
+      result = ZSTD_compressStream2(cctx, &output, &input, ZSTD_e_continue);
+      if (ZSTD_isError(result)) {
+        return errors::Internal("Failed to compress using zstd: ",
+                                ZSTD_getErrorName(result));
+      }
+    }
+  }
+  ZSTD_inBuffer end = {nullptr, 0, 0};
+  do {
+    result = ZSTD_compressStream2(cctx, &output, &end, ZSTD_e_end);
+    if (ZSTD_isError(result)) {
+      return errors::Internal("Failed to compress using zstd: ",
+                              ZSTD_getErrorName(result));
+    }
+  } while (result != 0);
+  out->resize(output.pos);
+  return OkStatus();
+}
+
+Status SnappyUncompress(const std::string& compressed_data, Iov& iov) {
+  size_t uncompressed_size;
+  if (!port::Snappy_GetUncompressedLength(
+          compressed_data.data(), compressed_data.size(), &uncompressed_size)) {
+    return errors::Internal(
+        "Could not get snappy uncompressed length. Compressed data size: ",
+        compressed_data.size());
+  }
+  if (uncompressed_size != static_cast<size_t>(iov.NumBytes())) {
+    return errors::Internal(
+        "Uncompressed size mismatch. Snappy expects ", uncompressed_size,
+        " whereas the tensor metadata suggests ", iov.NumBytes());
+  }
+  if (!port::Snappy_UncompressToIOVec(compressed_data.data(),
+                                      compressed_data.size(), iov.Data(),
+                                      iov.NumPieces())) {
+    return errors::Internal("Failed to perform snappy decompression.");
+  }
+  return OkStatus();
+}
+
+Status ZstdUncompress(const std::string& compressed_data,
+                      const CompressionDictionary* dictionary, Iov& iov) {
+  const unsigned long long uncompressed_size =  // NOLINT
+      ZSTD_getFrameContentSize(compressed_data.data(), compressed_data.size());
+  if (uncompressed_size == ZSTD_CONTENTSIZE_ERROR ||
+      uncompressed_size == ZSTD_CONTENTSIZE_UNKNOWN) {
+    return errors::Internal(
+        "Could not get zstd uncompressed length. Compressed data size: ",
+        compressed_data.size());
+  }
+  if (uncompressed_size != iov.NumBytes()) {
+    return errors::Internal(
+        "Uncompressed size mismatch. Zstd expects ", uncompressed_size,
+        " whereas the tensor metadata suggests ", iov.NumBytes());
+  }
+  ZSTD_DCtx* dctx = ThreadLocalZstdDCtx();
+  if (dctx == nullptr) {
+    return errors::ResourceExhausted(
+        "Failed to create a zstd decompression context.");
+  }
+  ZSTD_DCtx_reset(dctx, ZSTD_reset_session_and_parameters);
+  const unsigned dictionary_id =
+      ZSTD_getDictID_fromFrame(compressed_data.data(), compressed_data.size());
+  if (dictionary_id != 0) {
+    if (dictionary == nullptr) {
+      return errors::FailedPrecondition(
+          "The element was compressed with zstd dictionary ", dictionary_id,
+          ", but no dictionary was provided to uncompress it.");
+    }
+    if (dictionary->id() != dictionary_id) {
+      return errors::InvalidArgument(
+          "The element was compressed with zstd dictionary ", dictionary_id,
+          ", but dictionary ", dictionary->id(),
+          " was provided to uncompress it.");
+    }
+    const size_t result = ZSTD_DCtx_refDDict(dctx, dictionary->ddict());
+    if (ZSTD_isError(result)) {
+      return errors::Internal("Failed to configure zstd decompression: ",
+                              ZSTD_getErrorName(result));
+    }
+  }
+
+  // Uncompress directly into the pieces. `result` is 0 once the frame,
+  // including its epilogue, has been fully decoded.
+  ZSTD_inBuffer input = {compressed_data.data(), compressed_data.size(), 0};
+  size_t result = 1;
+  for (size_t i = 0; i < iov.NumPieces(); ++i) {
+    ZSTD_outBuffer output = {iov.Data()[i].iov_base, iov.Data()[i].iov_len, 0};
+    while (output.pos < output.size) {
+      const size_t output_pos = output.pos;
+      result = ZSTD_decompressStream(dctx, &output, &input);
+      if (ZSTD_isError(result)) {
+        return errors::Internal("Failed to perform zstd decompression: ",
+                                ZSTD_getErrorName(result));
+      }
+      if (output.pos == output_pos && input.pos == input.size) {
+        return errors::Internal(
+            "Failed to perform zstd decompression: truncated data.");
+      }
+    }
+  }
+  // The pieces are full, but the last block header or the checksum may not
+  // have been read yet.
+  while (result != 0 && input.pos < input.size) {
+    const size_t input_pos = input.pos;
+    ZSTD_outBuffer output = {nullptr, 0, 0};
+    result = ZSTD_decompressStream(dctx, &output, &input);
+    if (ZSTD_isError(result)) {
+      return errors::Internal("Failed to perform zstd decompression: ",
+                              ZSTD_getErrorName(result));
+    }
+    if (output.pos != 0) {
+      return errors::Internal(
+          "Failed to perform zstd decompression: the frame holds more than ",
+          iov.NumBytes(), " bytes.");
+    }
+    if (input.pos == input_pos) break;
+  }
+  if (result != 0) {
+    return errors::Internal(
+        "Failed to perform zstd decompression: truncated data.");
+  }
+  if (input.pos != input.size) {
+    return errors::Internal(
+        "Failed to perform zstd decompression: ", input.size - input.pos,
+        " bytes of trailing data after the zstd frame.");
+  }
+  return OkStatus();
+}
+
+}  // namespace
+
+Status CompressionDictionary::Train(
+    const std::vector<std::vector<Tensor>>& samples, size_t max_bytes,
+    int level, std::unique_ptr<CompressionDictionary>* out) {
+  std::string samples_buffer;
+  std::vector<size_t> sample_sizes;
+  sample_sizes.reserve(samples.size());
+  for (const std::vector<Tensor>& sample : samples) {
+    CompressedElement metadata;
+    tstring nonmemcpyable;
+    Iov iov = PrepareElement(sample, &nonmemcpyable, &metadata);
+    for (size_t i = 0; i < iov.NumPieces(); ++i) {
+      samples_buffer.append(static_cast<const char*>(iov.Data()[i].iov_base),
+                            iov.Data()[i].iov_len);
+    }
+    sample_sizes.push_back(iov.NumBytes());
+  }
+  std::string bytes(max_bytes, '\0');
+  const size_t size = ZDICT_trainFromBuffer(
+      bytes.data(), bytes.size(), samples_buffer.data(), sample_sizes.data(),
+      static_cast<unsigned>(sample_sizes.size()));
+  if (ZDICT_isError(size)) {
+    return errors::InvalidArgument("Failed to train a zstd dictionary on ",
+                                   samples.size(),
+                                   " samples: ", ZDICT_getErrorName(size));
+  }
+  bytes.resize(size);
+  return Create(bytes, level, out);
+}
+
+Status CompressionDictionary::Create(
+    absl::string_view bytes, int level,
+    std::unique_ptr<CompressionDictionary>* out) {
+  TF_RETURN_IF_ERROR(ValidateZstdLevel(level));
+  auto dictionary = absl::WrapUnique(new CompressionDictionary());
+  dictionary->bytes_ = std::string(bytes);
+  const std::string& dict = dictionary->bytes_;
+  dictionary->id_ = ZSTD_getDictID_fromDict(dict.data(), dict.size());
+  if (dictionary->id_ == 0) {
+    return errors::InvalidArgument(
+        "Not a trained zstd dictionary: the dictionary has no id.");
+  }
+  dictionary->cdict_ = ZSTD_createCDict(dict.data(), dict.size(), level);
+  dictionary->ddict_ = ZSTD_createDDict(dict.data(), dict.size());
+  if (dictionary->cdict_ == nullptr || dictionary->ddict_ == nullptr) {
+    return errors::InvalidArgument("Failed to load zstd dictionary ",
+                                   dictionary->id_);
+  }
+  *out = std::move(dictionary);
+  return OkStatus();
+}
+
+CompressionDictionary::~CompressionDictionary() {
+  ZSTD_freeCDict(cdict_);
+  ZSTD_freeDDict(ddict_);
+}
+
+Status CompressElement(const std::vector<Tensor>& element,
+                       CompressedElement* out) {
+  return CompressElement(element, CompressionOptions(), out);
+}
+
+Status CompressElement(const std::vector<Tensor>& element,
+                       const CompressionOptions& options,
+                       CompressedElement* out) {
+  if (options.codec == CompressedElement::ZSTD) {
+    TF_RETURN_IF_ERROR(ValidateZstdLevel(options.level));
+  } else if (options.codec != CompressedElement::SNAPPY) {
+    return errors::InvalidArgument("Unsupported compression codec: ",
+                                   options.codec);
+  } else if (options.dictionary != nullptr) {
+    return errors::InvalidArgument(
+        "Compression dictionaries are only supported with zstd.");
+  }
+
+  tstring nonmemcpyable;
+  Iov iov = PrepareElement(element, &nonmemcpyable, out);
+  if (options.codec == CompressedElement::ZSTD) {
+    TF_RETURN_IF_ERROR(ZstdCompress(iov, options, out->mutable_data()));
+    out->set_codec(CompressedElement::ZSTD);
+    out->set_version(kCompressedElementVersion);
+  } else {
+    TF_RETURN_IF_ERROR(SnappyCompress(iov, out->mutable_data()));
+    out->set_version(kSnappyCompressedElementVersion);
+  }
   VLOG(3) << "Compressed element from " << iov.NumBytes() << " bytes to "
-          << out->data().size() << " bytes";
+          << out->data().size() << " bytes using "
+          << CompressedElement::Codec_Name(options.codec);
   return OkStatus();
 }
 
 Status UncompressElement(const CompressedElement& compressed,
                          std::vector<Tensor>* out) {
-  if (compressed.version() != kCompressedElementVersion) {
+  return UncompressElement(compressed, /*dictionary=*/nullptr, out);
+}
+
+Status UncompressElement(const CompressedElement& compressed,
+                         const CompressionDictionary* dictionary,
+                         std::vector<Tensor>* out) {
+  if (compressed.version() < 0 ||
+      compressed.version() > kCompressedElementVersion) {
     return errors::Internal("Unsupported compressed element version: ",
                             compressed.version());
   }
@@ -190,23 +489,16 @@ Status UncompressElement(const CompressedElement& compressed,
   }
 
   // Step 2: Uncompress into the iovec.
-  const std::string& compressed_data = compressed.data();
-  size_t uncompressed_size;
-  if (!port::Snappy_GetUncompressedLength(
-          compressed_data.data(), compressed_data.size(), &uncompressed_size)) {
-    return errors::Internal(
-        "Could not get snappy uncompressed length. Compressed data size: ",
-        compressed_data.size());
-  }
-  if (uncompressed_size != static_cast<size_t>(iov.NumBytes())) {
-    return errors::Internal(
-        "Uncompressed size mismatch. Snappy expects ", uncompressed_size,
-        " whereas the tensor metadata suggests ", iov.NumBytes());
-  }
-  if (!port::Snappy_UncompressToIOVec(compressed_data.data(),
-                                      compressed_data.size(), iov.Data(),
-                                      iov.NumPieces())) {
-    return errors::Internal("Failed to perform snappy decompression.");
+  switch (compressed.codec()) {
+    case CompressedElement::SNAPPY:
+      TF_RETURN_IF_ERROR(SnappyUncompress(compressed.data(), iov));
+      break;
+    case CompressedElement::ZSTD:
+      TF_RETURN_IF_ERROR(ZstdUncompress(compressed.data(), dictionary, iov));
+      break;
+    default:
+      return errors::Internal("Unsupported compression codec: ",
+                              compressed.codec());
   }
 
   // Third pass: deserialize nonstring, non`memcpy`able tensors.
@@ -15,15 +15,79 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_DATA_COMPRESSION_UTILS_H_
 #define TENSORFLOW_CORE_DATA_COMPRESSION_UTILS_H_
 
+#include <memory>
+#include <string>
 #include <vector>
 
+#include "absl/strings/string_view.h"
 #include "tensorflow/core/framework/dataset.pb.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/platform/status.h"
 
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
+
 namespace tensorflow {
 namespace data {
 
+class CompressionDictionary;
+
+struct CompressionOptions {
+  CompressedElement::Codec codec = CompressedElement::SNAPPY;
+
+  // The zstd compression level. 0 selects zstd's default level, 3. Levels up
+  // to 19 trade compression speed for ratio. Negative levels trade ratio for
+  // compression and decompression speed, approaching that of lz4 at -5 and
+  // below.
+  int level = 0;
+
+  // If set, zstd compresses with this dictionary, and ignores `level` in
+  // favor of the one the dictionary was created for. Not owned.
+  const CompressionDictionary* dictionary = nullptr;
+};
+
+// A zstd dictionary, trained on sample elements of a dataset. Compressing
+// small elements with a dictionary trained on similar elements recovers most
+// of the ratio that is otherwise lost to the lack of shared context between
+// elements.
+//
+// Elements compressed with a dictionary can only be uncompressed with the same
+// dictionary. CompressionDictionary is thread-safe.
+class CompressionDictionary {
+ public:
+  // Trains a dictionary of at most `max_bytes` on `samples`, for compressing
+  // at zstd `level`.
+  static Status Train(const std::vector<std::vector<Tensor>>& samples,
+                      size_t max_bytes, int level,
+                      std::unique_ptr<CompressionDictionary>* out);
+
+  // Creates a dictionary from the `bytes()` of a trained one, for compressing
+  // at zstd `level`.
+  static Status Create(absl::string_view bytes, int level,
+                       std::unique_ptr<CompressionDictionary>* out);
+
+  ~CompressionDictionary();
+
+  // The serialized dictionary, which readers need in order to uncompress.
+  const std::string& bytes() const { return bytes_; }
+
+  // The id that zstd records in the elements compressed with the dictionary.
+  uint32_t id() const { return id_; }
+
+  // The digested forms of the dictionary that zstd compresses and
+  // uncompresses with.
+  const ZSTD_CDict_s* cdict() const { return cdict_; }
+  const ZSTD_DDict_s* ddict() const { return ddict_; }
+
+ private:
+  CompressionDictionary() = default;
+
+  std::string bytes_;
+  uint32_t id_ = 0;
+  ZSTD_CDict_s* cdict_ = nullptr;
+  ZSTD_DDict_s* ddict_ = nullptr;
+};
+
 // Compresses the components of `element` into the `CompressedElement` proto.
 //
 // In addition to writing the actual compressed bytes, `Compress` fills
@@ -33,10 +97,22 @@ namespace data {
 Status CompressElement(const std::vector<Tensor>& element,
                        CompressedElement* out);
 
+// Like above, but compresses with the codec in `options`. Only Snappy limits
+// the uncompressed size of the element to 4GB.
+Status CompressElement(const std::vector<Tensor>& element,
+                       const CompressionOptions& options,
+                       CompressedElement* out);
+
 // Uncompresses a `CompressedElement` into a vector of tensor components.
 Status UncompressElement(const CompressedElement& compressed,
                          std::vector<Tensor>* out);
 
+// Like above, but for elements that were compressed with `dictionary`, which
+// may be null otherwise.
+Status UncompressElement(const CompressedElement& compressed,
+                         const CompressionDictionary* dictionary,
+                         std::vector<Tensor>* out);
+
 }  // namespace data
 }  // namespace tensorflow
 
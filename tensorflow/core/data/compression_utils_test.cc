@@ -14,12 +14,17 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/data/compression_utils.h"
 
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "absl/strings/str_join.h"
 #include "tensorflow/core/data/dataset_test_base.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/protobuf/error_codes.pb.h"
 #include "tsl/platform/status_matchers.h"
 
@@ -98,15 +103,227 @@ TEST_P(ParameterizedCompressionUtilsTest, VersionMismatch) {
   CompressedElement compressed;
   TF_ASSERT_OK(CompressElement(element, &compressed));
 
-  compressed.set_version(1);
+  compressed.set_version(2);
   std::vector<Tensor> round_trip_element;
   EXPECT_THAT(UncompressElement(compressed, &round_trip_element),
               StatusIs(error::INTERNAL));
 }
 
+TEST_P(ParameterizedCompressionUtilsTest, ZstdRoundTrip) {
+  std::vector<Tensor> element = GetParam();
+  for (int level : {-5, 0, 3, 19}) {
+    CompressionOptions options;
+    options.codec = CompressedElement::ZSTD;
+    options.level = level;
+    CompressedElement compressed;
+    TF_ASSERT_OK(CompressElement(element, options, &compressed));
+    EXPECT_EQ(CompressedElement::ZSTD, compressed.codec());
+    EXPECT_EQ(1, compressed.version());
+    std::vector<Tensor> round_trip_element;
+    TF_ASSERT_OK(UncompressElement(compressed, &round_trip_element));
+    TF_EXPECT_OK(
+        ExpectEqual(element, round_trip_element, /*compare_order=*/true));
+  }
+}
+
 INSTANTIATE_TEST_SUITE_P(Instantiation, ParameterizedCompressionUtilsTest,
                          ::testing::ValuesIn(TestCases()));
 
+// Returns a sentence of `num_words` random words, like the elements of a
+// text dataset.
+tstring RandomSentence(random::SimplePhilox& rng, int num_words) {
+  static const char* const kWords[] = {
+      "the",  "a",     "of",     "model",  "data",   "training", "input",
+      "with", "layer", "tensor", "shape",  "batch",  "gradient", "loss",
+      "and",  "to",    "in",     "output", "weight", "device",   "step"};
+  std::vector<std::string> words;
+  for (int i = 0; i < num_words; ++i) {
+    words.push_back(kWords[rng.Uniform(sizeof(kWords) / sizeof(kWords[0]))]);
+  }
+  return absl::StrJoin(words, " ");
+}
+
+std::vector<Tensor> TextElement(random::SimplePhilox& rng) {
+  return {CreateTensor<tstring>(TensorShape{}, {RandomSentence(rng, 40)}),
+          CreateTensor<int64_t>(TensorShape{}, {rng.Uniform(1000)})};
+}
+
+// Returns an element like a decoded image: smooth gradients with noise.
+std::vector<Tensor> ImageElement(random::SimplePhilox& rng, int size) {
+  Tensor image(DT_UINT8, TensorShape{size, size, 3});
+  auto pixels = image.tensor<uint8, 3>();
+  for (int y = 0; y < size; ++y) {
+    for (int x = 0; x < size; ++x) {
+      for (int c = 0; c < 3; ++c) {
+        pixels(y, x, c) = (x + y * c + rng.Uniform(8)) % 256;
+      }
+    }
+  }
+  return {image, CreateTensor<int64_t>(TensorShape{}, {rng.Uniform(1000)})};
+}
+
+TEST(CompressionUtilsTest, ZstdDictionary) {
+  random::PhiloxRandom philox(42);
+  random::SimplePhilox rng(&philox);
+  std::vector<std::vector<Tensor>> samples;
+  for (int i = 0; i < 1000; ++i) {
+    samples.push_back(TextElement(rng));
+  }
+  std::unique_ptr<CompressionDictionary> dictionary;
+  TF_ASSERT_OK(CompressionDictionary::Train(samples, /*max_bytes=*/16 << 10,
+                                            /*level=*/3, &dictionary));
+  EXPECT_LE(dictionary->bytes().size(), 16 << 10);
+
+  std::vector<Tensor> element = TextElement(rng);
+  CompressionOptions options;
+  options.codec = CompressedElement::ZSTD;
+  CompressedElement without_dictionary;
+  TF_ASSERT_OK(CompressElement(element, options, &without_dictionary));
+  options.dictionary = dictionary.get();
+  CompressedElement compressed;
+  TF_ASSERT_OK(CompressElement(element, options, &compressed));
+  EXPECT_LT(compressed.data().size(), without_dictionary.data().size());
+
+  std::vector<Tensor> round_trip_element;
+  TF_ASSERT_OK(
+      UncompressElement(compressed, dictionary.get(), &round_trip_element));
+  TF_EXPECT_OK(DatasetOpsTestBase::ExpectEqual(element, round_trip_element,
+                                               /*compare_order=*/true));
+
+  // Readers recreate the dictionary from its bytes.
+  std::unique_ptr<CompressionDictionary> restored;
+  TF_ASSERT_OK(CompressionDictionary::Create(dictionary->bytes(),
+                                             /*level=*/3, &restored));
+  EXPECT_EQ(dictionary->id(), restored->id());
+  TF_ASSERT_OK(
+      UncompressElement(compressed, restored.get(), &round_trip_element));
+  TF_EXPECT_OK(DatasetOpsTestBase::ExpectEqual(element, round_trip_element,
+                                               /*compare_order=*/true));
+
+  EXPECT_THAT(UncompressElement(compressed, &round_trip_element),
+              StatusIs(error::FAILED_PRECONDITION,
+                       HasSubstr("no dictionary was provided")));
+}
+
+TEST(CompressionUtilsTest, InvalidOptions) {
+  std::vector<Tensor> element = CreateTensors<int64_t>(TensorShape{1}, {{1}});
+  CompressionOptions options;
+  options.codec = CompressedElement::ZSTD;
+  options.level = 100;
+  CompressedElement compressed;
+  EXPECT_THAT(CompressElement(element, options, &compressed),
+              StatusIs(error::INVALID_ARGUMENT,
+                       HasSubstr("Zstd compression level must be between")));
+
+  std::unique_ptr<CompressionDictionary> dictionary;
+  EXPECT_THAT(CompressionDictionary::Create("not a dictionary", /*level=*/3,
+                                            &dictionary),
+              StatusIs(error::INVALID_ARGUMENT));
+}
+
+TEST(CompressionUtilsTest, ZstdIncompleteOrTrailingData) {
+  std::vector<Tensor> element =
+      CreateTensors<int64_t>(TensorShape{100}, {std::vector<int64_t>(100, 7)});
+  CompressionOptions options;
+  options.codec = CompressedElement::ZSTD;
+  CompressedElement compressed;
+  TF_ASSERT_OK(CompressElement(element, options, &compressed));
+  std::vector<Tensor> round_trip_element;
+  TF_ASSERT_OK(UncompressElement(compressed, &round_trip_element));
+
+  CompressedElement truncated = compressed;
+  truncated.mutable_data()->pop_back();
+  EXPECT_THAT(UncompressElement(truncated, &round_trip_element),
+              StatusIs(error::INTERNAL));
+
+  CompressedElement trailing = compressed;
+  trailing.mutable_data()->append("garbage");
+  EXPECT_THAT(UncompressElement(trailing, &round_trip_element),
+              StatusIs(error::INTERNAL, HasSubstr("trailing data")));
+}
+
+// Compresses and uncompresses `num_elements` elements with `options`, and
+// reports the compression ratio.
+void CompressionBenchmarkLoop(::testing::benchmark::State& state,
+                              const std::vector<std::vector<Tensor>>& elements,
+                              const CompressionOptions& options,
+                              const CompressionDictionary* dictionary) {
+  int64_t uncompressed_bytes = 0;
+  int64_t compressed_bytes = 0;
+  std::vector<Tensor> round_trip_element;
+  for (auto s : state) {
+    for (const std::vector<Tensor>& element : elements) {
+      CompressedElement compressed;
+      TF_CHECK_OK(CompressElement(element, options, &compressed));
+      TF_CHECK_OK(
+          UncompressElement(compressed, dictionary, &round_trip_element));
+      for (const Tensor& component : element) {
+        uncompressed_bytes += component.dtype() == DT_STRING
+                                  ? component.scalar<tstring>()().size()
+                                  : component.TotalBytes();
+      }
+      compressed_bytes += compressed.data().size();
+    }
+  }
+  state.SetBytesProcessed(uncompressed_bytes);
+  state.counters["ratio"] =
+      static_cast<double>(uncompressed_bytes) / compressed_bytes;
+}
+
+void CompressionBenchmark(::testing::benchmark::State& state, bool image,
+                          CompressedElement::Codec codec, bool use_dictionary) {
+  random::PhiloxRandom philox(42);
+  random::SimplePhilox rng(&philox);
+  std::vector<std::vector<Tensor>> elements;
+  // Enough text elements to train a dictionary on.
+  const int num_elements = image ? 100 : 1000;
+  for (int i = 0; i < num_elements; ++i) {
+    elements.push_back(image ? ImageElement(rng, /*size=*/64)
+                             : TextElement(rng));
+  }
+  CompressionOptions options;
+  options.codec = codec;
+  options.level = state.range(0);
+  std::unique_ptr<CompressionDictionary> dictionary;
+  if (use_dictionary) {
+    TF_CHECK_OK(CompressionDictionary::Train(elements, /*max_bytes=*/16 << 10,
+                                             options.level, &dictionary));
+    options.dictionary = dictionary.get();
+  }
+  CompressionBenchmarkLoop(state, elements, options, dictionary.get());
+}
+
+void BM_CompressImageSnappy(::testing::benchmark::State& state) {
+  CompressionBenchmark(state, /*image=*/true, CompressedElement::SNAPPY,
+                       /*use_dictionary=*/false);
+}
+
+void BM_CompressImageZstd(::testing::benchmark::State& state) {
+  CompressionBenchmark(state, /*image=*/true, CompressedElement::ZSTD,
+                       /*use_dictionary=*/false);
+}
+
+void BM_CompressTextSnappy(::testing::benchmark::State& state) {
+  CompressionBenchmark(state, /*image=*/false, CompressedElement::SNAPPY,
+                       /*use_dictionary=*/false);
+}
+
+void BM_CompressTextZstd(::testing::benchmark::State& state) {
+  CompressionBenchmark(state, /*image=*/false, CompressedElement::ZSTD,
+                       /*use_dictionary=*/false);
+}
+
+void BM_CompressTextZstdDictionary(::testing::benchmark::State& state) {
+  CompressionBenchmark(state, /*image=*/false, CompressedElement::ZSTD,
+                       /*use_dictionary=*/true);
+}
+
+BENCHMARK(BM_CompressImageSnappy)->Arg(0);
+BENCHMARK(BM_CompressImageZstd)->Arg(-5)->Arg(1)->Arg(3)->Arg(9);
+BENCHMARK(BM_CompressTextSnappy)->Arg(0);
+BENCHMARK(BM_CompressTextZstd)->Arg(-5)->Arg(1)->Arg(3)->Arg(9);
+BENCHMARK(BM_CompressTextZstdDictionary)->Arg(-5)->Arg(1)->Arg(3)->Arg(9);
+
 }  // namespace
 }  // namespace data
 }  // namespace tensorflow
@@ -37,6 +37,7 @@ limitations under the License.
 #include "tensorflow/core/data/service/common.pb.h"
 #include "tensorflow/core/data/service/dispatcher_client.h"
 #include "tensorflow/core/data/service/grpc_util.h"
+#include "tensorflow/core/data/service/shm_data_transfer.h"
 #include "tensorflow/core/data/service/worker_client.h"
 #include "tensorflow/core/data/service/worker_impl.h"
 #include "tensorflow/core/data/utils.h"
@@ -380,6 +381,14 @@ DataServiceClient::CreateWorkerClient(const TaskInfo& task_info) {
     return CreateAlternativeWorkerClientWithGrpcFallback(transfer_server,
                                                          task_info);
   }
+  // Prefer shared memory when the worker is on this host. Other workers use
+  // the default protocol.
+  if (StatusOr<DataTransferServerInfo> transfer_server =
+          GetTransferServer(kShmTransferProtocol, task_info);
+      transfer_server.ok() && IsShmTransferServerOnThisHost(*transfer_server)) {
+    return CreateAlternativeWorkerClientWithGrpcFallback(*transfer_server,
+                                                         task_info);
+  }
   if (std::string default_protocol = DefaultDataTransferProtocol();
       default_protocol != kGrpcTransferProtocol) {
     StatusOr<DataTransferServerInfo> transfer_server =
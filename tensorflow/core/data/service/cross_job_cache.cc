@@ -0,0 +1,522 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/service/cross_job_cache.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "tensorflow/core/data/service/task_runner.h"
+#include "tensorflow/core/data/snapshot_utils.h"
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/dataset.pb.h"
+#include "tensorflow/core/framework/function.pb.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/metrics.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_def.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/framework/variant.h"
+#include "tensorflow/core/lib/io/compression.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/platform/protobuf.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/statusor.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+using Elements = std::vector<std::vector<Tensor>>;
+
+// Estimates the memory used by `element`, in the same way as
+// `GetElementResult::EstimatedMemoryUsageBytes`.
+size_t EstimatedSizeBytes(const std::vector<Tensor>& element) {
+  size_t size_bytes = element.size() * sizeof(Tensor);
+  for (const Tensor& tensor : element) {
+    size_bytes += tensor.TotalBytes();
+    if (tensor.dtype() != DT_VARIANT) {
+      continue;
+    }
+    // Estimates the memory usage of compressed elements.
+    auto variants = tensor.flat<Variant>();
+    for (int64_t i = 0; i < variants.size(); ++i) {
+      const CompressedElement* compressed =
+          variants(i).get<CompressedElement>();
+      if (compressed) {
+        size_bytes += compressed->SpaceUsedLong();
+      }
+    }
+  }
+  return size_bytes;
+}
+
+// Replays elements held in memory.
+class CachedTaskIterator : public TaskIterator {
+ public:
+  explicit CachedTaskIterator(std::shared_ptr<const Elements> elements)
+      : elements_(std::move(elements)) {}
+
+  Status GetNext(std::vector<Tensor>& element, bool& end_of_sequence) override {
+    end_of_sequence = next_ == elements_->size();
+    if (!end_of_sequence) {
+      element = (*elements_)[next_++];
+    }
+    return OkStatus();
+  }
+
+  int64_t Cardinality() const override { return elements_->size(); }
+
+ private:
+  const std::shared_ptr<const Elements> elements_;
+  size_t next_ = 0;
+};
+
+// Produces the elements of an iterator and caches them once the iterator is
+// exhausted. Stops caching if the elements held by all caching iterators
+// exceed the cache's memory budget.
+class CachingTaskIterator : public TaskIterator {
+ public:
+  CachingTaskIterator(CrossJobCache& cache, std::string key,
+                      std::unique_ptr<TaskIterator> iterator)
+      : cache_(cache), key_(std::move(key)), iterator_(std::move(iterator)) {}
+
+  ~CachingTaskIterator() override { StopCaching(); }
+
+  Status GetNext(std::vector<Tensor>& element, bool& end_of_sequence) override {
+    TF_RETURN_IF_ERROR(iterator_->GetNext(element, end_of_sequence));
+    if (!caching_) {
+      return OkStatus();
+    }
+    if (end_of_sequence) {
+      cache_.Insert(key_, std::move(elements_), size_bytes_);
+      size_bytes_ = 0;
+      StopCaching();
+      return OkStatus();
+    }
+    const size_t size_bytes = EstimatedSizeBytes(element);
+    if (!cache_.ReserveInFlightBytes(size_bytes)) {
+      VLOG(2) << "The outputs being cached exceed the cross-job cache size of "
+              << cache_.max_size_bytes() << " bytes. The output of dataset "
+              << key_ << " will not be cached.";
+      StopCaching();
+      return OkStatus();
+    }
+    size_bytes_ += size_bytes;
+    elements_.push_back(element);
+    return OkStatus();
+  }
+
+  int64_t Cardinality() const override { return iterator_->Cardinality(); }
+
+  std::shared_ptr<model::Model> model() const override {
+    return iterator_->model();
+  }
+
+ private:
+  void StopCaching() {
+    caching_ = false;
+    elements_ = Elements();
+    cache_.ReleaseInFlightBytes(size_bytes_);
+    size_bytes_ = 0;
+  }
+
+  CrossJobCache& cache_;
+  const std::string key_;
+  const std::unique_ptr<TaskIterator> iterator_;
+  bool caching_ = true;
+  size_t size_bytes_ = 0;
+  Elements elements_;
+};
+
+// Returns the value of `input` if it is a scalar int64 constant in `nodes`.
+std::optional<int64_t> GetInt64Constant(
+    absl::string_view input,
+    const absl::flat_hash_map<absl::string_view, const NodeDef*>& nodes) {
+  // Graph inputs are "node:index", and function inputs "node:output:index".
+  auto it = nodes.find(input.substr(0, input.find(':')));
+  if (it == nodes.end() || it->second->op() != "Const") {
+    return std::nullopt;
+  }
+  auto value = it->second->attr().find("value");
+  Tensor tensor;
+  if (value == it->second->attr().end() ||
+      !tensor.FromProto(value->second.tensor()) || tensor.dtype() != DT_INT64 ||
+      tensor.NumElements() != 1) {
+    return std::nullopt;
+  }
+  return tensor.flat<int64_t>()(0);
+}
+
+// Returns the index of the node input of `op_def`'s input arg `name`, or -1 if
+// there is no such arg or its index depends on the node's attrs.
+int InputIndex(const OpDef& op_def, absl::string_view name) {
+  for (int i = 0; i < op_def.input_arg_size(); ++i) {
+    const OpDef::ArgDef& arg = op_def.input_arg(i);
+    if (arg.name() == name) {
+      return i;
+    }
+    if (!arg.number_attr().empty() || !arg.type_list_attr().empty()) {
+      return -1;
+    }
+  }
+  return -1;
+}
+
+Status CheckNodesCacheable(const protobuf::RepeatedPtrField<NodeDef>& nodes) {
+  absl::flat_hash_map<absl::string_view, const NodeDef*> nodes_by_name;
+  for (const NodeDef& node : nodes) {
+    nodes_by_name[node.name()] = &node;
+  }
+  for (const NodeDef& node : nodes) {
+    const OpDef* op_def = nullptr;
+    if (!OpRegistry::Global()->LookUpOpDef(node.op(), &op_def).ok()) {
+      // Calls to library functions, which are checked on their own.
+      continue;
+    }
+    if (op_def->is_stateful()) {
+      return errors::FailedPrecondition("Node ", node.name(), " runs op ",
+                                        node.op(), ", which is stateful.");
+    }
+    const int seed_index = InputIndex(*op_def, "seed");
+    const int seed2_index = InputIndex(*op_def, "seed2");
+    if (seed_index < 0 || seed2_index < 0) {
+      continue;
+    }
+    std::optional<int64_t> seed, seed2;
+    if (seed_index < node.input_size() && seed2_index < node.input_size()) {
+      seed = GetInt64Constant(node.input(seed_index), nodes_by_name);
+      seed2 = GetInt64Constant(node.input(seed2_index), nodes_by_name);
+    }
+    // Ops with `seed` and `seed2` inputs pick random seeds when both are 0.
+    if (!seed.has_value() || !seed2.has_value() ||
+        (*seed == 0 && *seed2 == 0)) {
+      return errors::FailedPrecondition("Node ", node.name(), " runs op ",
+                                        node.op(), " without fixed seeds.");
+    }
+  }
+  return OkStatus();
+}
+
+}  // namespace
+
+// A file holding spilled elements. The file is deleted when the last
+// reference to it is dropped, so that iterators reading an evicted file can
+// finish reading it.
+class CrossJobCache::SpillFile {
+ public:
+  static StatusOr<std::shared_ptr<const SpillFile>> Write(
+      Env* env, const std::string& path, const Elements& elements) {
+    Status status = WriteElements(env, path, elements);
+    uint64 size_bytes = 0;
+    if (status.ok()) {
+      status = env->GetFileSize(path, &size_bytes);
+    }
+    if (!status.ok()) {
+      env->DeleteFile(path).IgnoreError();
+      return status;
+    }
+    DataTypeVector dtypes;
+    if (!elements.empty()) {
+      for (const Tensor& tensor : elements.front()) {
+        dtypes.push_back(tensor.dtype());
+      }
+    }
+    return std::shared_ptr<const SpillFile>(new SpillFile(
+        env, path, std::move(dtypes), elements.size(), size_bytes));
+  }
+
+  ~SpillFile() {
+    Status status = env_->DeleteFile(path_);
+    if (!status.ok()) {
+      LOG(WARNING) << "Failed to delete cross-job cache spill file " << path_
+                   << ": " << status;
+    }
+  }
+
+  // Returns an iterator over the elements of `file`.
+  static StatusOr<std::unique_ptr<TaskIterator>> MakeIterator(
+      std::shared_ptr<const SpillFile> file) {
+    auto iterator = std::make_unique<Iterator>(std::move(file));
+    TF_RETURN_IF_ERROR(iterator->Initialize());
+    return iterator;
+  }
+
+  size_t size_bytes() const { return size_bytes_; }
+
+ private:
+  class Iterator : public TaskIterator {
+   public:
+    explicit Iterator(std::shared_ptr<const SpillFile> file)
+        : file_(std::move(file)),
+          reader_(file_->path_, io::compression::kNone, file_->dtypes_) {}
+
+    Status Initialize() { return reader_.Initialize(file_->env_); }
+
+    Status GetNext(std::vector<Tensor>& element,
+                   bool& end_of_sequence) override {
+      end_of_sequence = next_ == file_->num_elements_;
+      if (!end_of_sequence) {
+        TF_RETURN_IF_ERROR(reader_.ReadTensors(&element));
+        ++next_;
+      }
+      return OkStatus();
+    }
+
+    int64_t Cardinality() const override { return file_->num_elements_; }
+
+   private:
+    const std::shared_ptr<const SpillFile> file_;
+    snapshot_util::TFRecordReader reader_;
+    int64_t next_ = 0;
+  };
+
+  SpillFile(Env* env, std::string path, DataTypeVector dtypes,
+            int64_t num_elements, size_t size_bytes)
+      : env_(env),
+        path_(std::move(path)),
+        dtypes_(std::move(dtypes)),
+        num_elements_(num_elements),
+        size_bytes_(size_bytes) {}
+
+  static Status WriteElements(Env* env, const std::string& path,
+                              const Elements& elements) {
+    snapshot_util::TFRecordWriter writer(path, io::compression::kNone);
+    TF_RETURN_IF_ERROR(writer.Initialize(env));
+    for (const std::vector<Tensor>& element : elements) {
+      TF_RETURN_IF_ERROR(writer.WriteTensors(element));
+    }
+    return writer.Close();
+  }
+
+  Env* const env_;
+  const std::string path_;
+  const DataTypeVector dtypes_;
+  const int64_t num_elements_;
+  const size_t size_bytes_;
+};
+
+CrossJobCache::CrossJobCache(Env* env, Options options)
+    : env_(env), options_(std::move(options)) {}
+
+StatusOr<std::unique_ptr<TaskIterator>> CrossJobCache::Lookup(
+    const std::string& key) {
+  std::shared_ptr<const Elements> elements;
+  std::shared_ptr<const SpillFile> spill_file;
+  {
+    mutex_lock l(mu_);
+    auto it = entries_.find(key);
+    metrics::RecordTFDataServiceCrossJobCacheQuery(it != entries_.end());
+    if (it == entries_.end()) {
+      return std::unique_ptr<TaskIterator>();
+    }
+    ++it->second.num_accesses;
+    it->second.last_access = ++clock_;
+    elements = it->second.elements;
+    spill_file = it->second.spill_file;
+  }
+  if (elements) {
+    return std::make_unique<CachedTaskIterator>(std::move(elements));
+  }
+  return SpillFile::MakeIterator(std::move(spill_file));
+}
+
+std::unique_ptr<TaskIterator> CrossJobCache::MakeCachingIterator(
+    const std::string& key, std::unique_ptr<TaskIterator> iterator) {
+  return std::make_unique<CachingTaskIterator>(*this, key,
+                                               std::move(iterator));
+}
+
+void CrossJobCache::Insert(const std::string& key, Elements elements,
+                           size_t in_flight_bytes) {
+  size_t size_bytes = 0;
+  for (const std::vector<Tensor>& element : elements) {
+    size_bytes += EstimatedSizeBytes(element);
+  }
+  mutex_lock l(mu_);
+  in_flight_bytes_ -= in_flight_bytes;
+  if (entries_.contains(key) ||
+      in_flight_bytes_ + size_bytes > options_.max_size_bytes) {
+    return;
+  }
+  while (size_bytes_ + in_flight_bytes_ + size_bytes >
+         options_.max_size_bytes) {
+    const std::string* victim = FindVictimLocked(/*spilled=*/false);
+    if (victim == nullptr) {
+      break;
+    }
+    EvictLocked(std::string(*victim));
+  }
+  VLOG(2) << "Caching " << elements.size() << " elements (" << size_bytes
+          << " bytes) of dataset " << key << " in the cross-job cache.";
+  Entry& entry = entries_[key];
+  entry.elements = std::make_shared<const Elements>(std::move(elements));
+  entry.size_bytes = size_bytes;
+  entry.num_accesses = 1;
+  entry.last_access = ++clock_;
+  size_bytes_ += size_bytes;
+  RecordSizeLocked();
+}
+
+bool CrossJobCache::ReserveInFlightBytes(size_t bytes) {
+  mutex_lock l(mu_);
+  if (in_flight_bytes_ + bytes > options_.max_size_bytes) {
+    return false;
+  }
+  bool evicted = false;
+  while (size_bytes_ + in_flight_bytes_ + bytes > options_.max_size_bytes) {
+    const std::string* victim = FindVictimLocked(/*spilled=*/false);
+    if (victim == nullptr) {
+      break;
+    }
+    EvictLocked(std::string(*victim));
+    evicted = true;
+  }
+  if (evicted) {
+    RecordSizeLocked();
+  }
+  in_flight_bytes_ += bytes;
+  return true;
+}
+
+void CrossJobCache::ReleaseInFlightBytes(size_t bytes) {
+  if (bytes == 0) {
+    return;
+  }
+  mutex_lock l(mu_);
+  in_flight_bytes_ -= bytes;
+}
+
+bool CrossJobCache::Contains(const std::string& key) const {
+  tf_shared_lock l(mu_);
+  return entries_.contains(key);
+}
+
+size_t CrossJobCache::size_bytes() const {
+  tf_shared_lock l(mu_);
+  return size_bytes_;
+}
+
+size_t CrossJobCache::spilled_size_bytes() const {
+  tf_shared_lock l(mu_);
+  return spilled_size_bytes_;
+}
+
+const std::string* CrossJobCache::FindVictimLocked(bool spilled) const {
+  // A worker caches the outputs of few datasets, so a linear scan is cheaper
+  // than maintaining an eviction order.
+  const bool lfu =
+      options_.eviction_policy ==
+      experimental::WorkerConfig::CROSS_JOB_CACHE_EVICTION_POLICY_LFU;
+  const std::string* victim = nullptr;
+  const Entry* victim_entry = nullptr;
+  for (const auto& [key, entry] : entries_) {
+    if ((entry.spill_file != nullptr) != spilled) {
+      continue;
+    }
+    if (victim_entry != nullptr) {
+      if (lfu && entry.num_accesses != victim_entry->num_accesses) {
+        if (entry.num_accesses > victim_entry->num_accesses) continue;
+      } else if (entry.last_access > victim_entry->last_access) {
+        continue;
+      }
+    }
+    victim = &key;
+    victim_entry = &entry;
+  }
+  return victim;
+}
+
+void CrossJobCache::EvictLocked(const std::string& key) {
+  auto it = entries_.find(key);
+  size_bytes_ -= it->second.size_bytes;
+  if (!options_.spill_directory.empty()) {
+    Status status = SpillLocked(key, it->second);
+    if (status.ok()) {
+      return;
+    }
+    LOG(WARNING) << "Failed to spill dataset " << key
+                 << " from the cross-job cache: " << status;
+  }
+  VLOG(2) << "Evicting dataset " << key << " from the cross-job cache.";
+  entries_.erase(it);
+}
+
+Status CrossJobCache::SpillLocked(const std::string& key, Entry& entry) {
+  if (options_.max_spill_size_bytes > 0) {
+    if (entry.size_bytes > options_.max_spill_size_bytes) {
+      return errors::ResourceExhausted(
+          "The dataset is larger than the spill size of ",
+          options_.max_spill_size_bytes, " bytes.");
+    }
+    // Makes room based on the in-memory size, which approximates the size of
+    // the spill file. Erasing other entries keeps `entry` valid.
+    while (spilled_size_bytes_ + entry.size_bytes >
+           options_.max_spill_size_bytes) {
+      const std::string* victim = FindVictimLocked(/*spilled=*/true);
+      if (victim == nullptr) {
+        break;
+      }
+      VLOG(2) << "Evicting spilled dataset " << *victim
+              << " from the cross-job cache.";
+      auto victim_it = entries_.find(*victim);
+      spilled_size_bytes_ -= victim_it->second.size_bytes;
+      entries_.erase(victim_it);
+    }
+  }
+  TF_RETURN_IF_ERROR(env_->RecursivelyCreateDir(options_.spill_directory));
+  std::string path = io::JoinPath(options_.spill_directory, "cross_job_cache");
+  if (!env_->CreateUniqueFileName(&path, ".spill")) {
+    return errors::Internal("Failed to create a unique file name in ",
+                            options_.spill_directory);
+  }
+  TF_ASSIGN_OR_RETURN(entry.spill_file,
+                      SpillFile::Write(env_, path, *entry.elements));
+  VLOG(2) << "Spilled dataset " << key << " from the cross-job cache to "
+          << path;
+  entry.elements.reset();
+  entry.size_bytes = entry.spill_file->size_bytes();
+  spilled_size_bytes_ += entry.size_bytes;
+  RecordSizeLocked();
+  return OkStatus();
+}
+
+void CrossJobCache::RecordSizeLocked() const {
+  metrics::RecordTFDataServiceCrossJobCacheSizeBytes(size_bytes_,
+                                                     spilled_size_bytes_);
+}
+
+Status CheckCrossJobCacheable(const GraphDef& graph) {
+  TF_RETURN_IF_ERROR(CheckNodesCacheable(graph.node()));
+  for (const FunctionDef& function : graph.library().function()) {
+    TF_RETURN_IF_ERROR(CheckNodesCacheable(function.node_def()));
+  }
+  return OkStatus();
+}
+
+}  // namespace data
+}  // namespace tensorflow
@@ -0,0 +1,176 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_DATA_SERVICE_CROSS_JOB_CACHE_H_
+#define TENSORFLOW_CORE_DATA_SERVICE_CROSS_JOB_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/data/service/task_runner.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/statusor.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/protobuf/service_config.pb.h"
+
+namespace tensorflow {
+namespace data {
+
+// Worker-side cache of the complete outputs of tasks, shared across jobs.
+//
+// Whereas `CrossTrainerCache` lets the trainers of one job share a sliding
+// window of a task's elements, the cross-job cache keeps every element that a
+// task produced, keyed by a fingerprint of the task's dataset. When a later job
+// reads a dataset with the same fingerprint from this worker, for example the
+// next trial of a hyperparameter sweep over the same preprocessed data, its
+// tasks replay the cached elements instead of running the input pipeline.
+//
+// A task's output is only cached once the task reaches the end of its input,
+// and only if it fits in the memory budget. The elements that caching
+// iterators hold until then are bounded by the memory budget too, across all
+// iterators. When an insertion exceeds the
+// budget, whole outputs are evicted in LRU or LFU order. If a spill directory
+// is configured, evicted outputs are written there, within a separate disk
+// budget, and later jobs read them back from disk.
+//
+// The `CrossJobCache` class is thread-safe.
+//
+// Example usage:
+//
+//   CrossJobCache cache(Env::Default(), options);
+//   TF_ASSIGN_OR_RETURN(std::unique_ptr<TaskIterator> iterator,
+//                       cache.Lookup(fingerprint));
+//   if (iterator == nullptr) {
+//     iterator = cache.MakeCachingIterator(fingerprint, MakeIterator());
+//   }
+class CrossJobCache {
+ public:
+  struct Options {
+    // Memory budget in bytes.
+    size_t max_size_bytes = 0;
+    experimental::WorkerConfig::CrossJobCacheEvictionPolicy eviction_policy =
+        experimental::WorkerConfig::CROSS_JOB_CACHE_EVICTION_POLICY_LRU;
+    // Local directory to which evicted outputs are spilled. If empty, evicted
+    // outputs are dropped.
+    std::string spill_directory;
+    // Disk budget in bytes for the spilled outputs. 0 means no limit.
+    size_t max_spill_size_bytes = 0;
+  };
+
+  CrossJobCache(Env* env, Options options);
+  CrossJobCache(const CrossJobCache&) = delete;
+  CrossJobCache& operator=(const CrossJobCache&) = delete;
+
+  // Returns an iterator which replays the elements cached under `key`, or
+  // nullptr if there are none.
+  StatusOr<std::unique_ptr<TaskIterator>> Lookup(const std::string& key)
+      TF_LOCKS_EXCLUDED(mu_);
+
+  // Returns an iterator which produces the elements of `iterator`, and caches
+  // them under `key` when `iterator` reaches the end of its input.
+  std::unique_ptr<TaskIterator> MakeCachingIterator(
+      const std::string& key, std::unique_ptr<TaskIterator> iterator);
+
+  // Caches `elements` under `key`, evicting other outputs as needed, and
+  // releases the `in_flight_bytes` that were reserved for `elements` with
+  // `ReserveInFlightBytes`. Does nothing else if `key` is already cached or if
+  // `elements` and the elements held by caching iterators exceed the memory
+  // budget.
+  void Insert(const std::string& key, std::vector<std::vector<Tensor>> elements,
+              size_t in_flight_bytes = 0) TF_LOCKS_EXCLUDED(mu_);
+
+  // Reserves `bytes` of the memory budget for elements that caching iterators
+  // hold until their outputs are complete, evicting cached outputs as needed.
+  // Returns false, and reserves nothing, if the elements held by all caching
+  // iterators would then exceed the budget.
+  bool ReserveInFlightBytes(size_t bytes) TF_LOCKS_EXCLUDED(mu_);
+
+  // Releases `bytes` reserved with `ReserveInFlightBytes`.
+  void ReleaseInFlightBytes(size_t bytes) TF_LOCKS_EXCLUDED(mu_);
+
+  // Returns whether an output is cached under `key`, in memory or on disk.
+  bool Contains(const std::string& key) const TF_LOCKS_EXCLUDED(mu_);
+
+  // Returns the estimated size of the outputs cached in memory.
+  size_t size_bytes() const TF_LOCKS_EXCLUDED(mu_);
+
+  // Returns the size of the outputs spilled to disk.
+  size_t spilled_size_bytes() const TF_LOCKS_EXCLUDED(mu_);
+
+  size_t max_size_bytes() const { return options_.max_size_bytes; }
+
+ private:
+  class SpillFile;
+
+  // A cached output. Exactly one of `elements` and `spill_file` is set.
+  struct Entry {
+    std::shared_ptr<const std::vector<std::vector<Tensor>>> elements;
+    std::shared_ptr<const SpillFile> spill_file;
+    // Estimated size of `elements`, or size of `spill_file`.
+    size_t size_bytes = 0;
+    int64_t num_accesses = 0;
+    // Logical time of the last access.
+    int64_t last_access = 0;
+  };
+
+  // Returns the key of the entry to evict next among the ones in memory, or
+  // among the spilled ones if `spilled` is true. Returns nullptr if there are
+  // no such entries.
+  const std::string* FindVictimLocked(bool spilled) const
+      TF_SHARED_LOCKS_REQUIRED(mu_);
+
+  // Evicts the in-memory entry `key`, spilling it to disk if enabled.
+  void EvictLocked(const std::string& key) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Writes the elements of `entry` to a spill file, and makes `entry` refer to
+  // the file instead.
+  Status SpillLocked(const std::string& key, Entry& entry)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  void RecordSizeLocked() const TF_SHARED_LOCKS_REQUIRED(mu_);
+
+  Env* const env_;
+  const Options options_;
+
+  mutable mutex mu_;
+  // Spilling writes files while holding `mu_`. This only delays looking up
+  // and inserting outputs, which happens once per task, and the caching
+  // iterators that evict outputs; the iterators returned by `Lookup` do not
+  // acquire `mu_`.
+  absl::flat_hash_map<std::string, Entry> entries_ TF_GUARDED_BY(mu_);
+  size_t size_bytes_ TF_GUARDED_BY(mu_) = 0;
+  size_t spilled_size_bytes_ TF_GUARDED_BY(mu_) = 0;
+  size_t in_flight_bytes_ TF_GUARDED_BY(mu_) = 0;
+  int64_t clock_ TF_GUARDED_BY(mu_) = 0;
+};
+
+// Returns an error if the output of `graph` may differ between jobs, so that
+// it must not be cached across jobs. This is the case if `graph`, or a
+// function in its library, has stateful ops, such as random ops, or ops with
+// `seed` and `seed2` inputs that are not both constants or are both 0, such as
+// unseeded shuffles.
+Status CheckCrossJobCacheable(const GraphDef& graph);
+
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DATA_SERVICE_CROSS_JOB_CACHE_H_
@@ -0,0 +1,354 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/service/cross_job_cache.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/data/service/task_runner.h"
+#include "tensorflow/core/framework/function.pb.h"
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/monitoring/cell_reader.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/status_matchers.h"
+#include "tensorflow/core/platform/statusor.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/protobuf/service_config.pb.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+using ::tensorflow::monitoring::testing::CellReader;
+using ::tensorflow::FunctionDefHelper;
+using ::tensorflow::test::function::GDef;
+using ::tensorflow::test::function::NDef;
+using ::tensorflow::testing::IsOkAndHolds;
+using ::tensorflow::testing::StatusIs;
+using ::testing::ElementsAreArray;
+using ::testing::Gt;
+using ::testing::HasSubstr;
+using ::testing::IsEmpty;
+using ::testing::IsNull;
+using ::testing::NotNull;
+
+// Estimated size of an output of `n` scalar int64 elements.
+size_t OutputSize(int64_t n) { return n * (sizeof(Tensor) + sizeof(int64_t)); }
+
+std::vector<int64_t> Range(int64_t n) {
+  std::vector<int64_t> range;
+  for (int64_t i = 0; i < n; ++i) {
+    range.push_back(i);
+  }
+  return range;
+}
+
+std::vector<std::vector<Tensor>> RangeElements(int64_t n) {
+  std::vector<std::vector<Tensor>> elements;
+  for (int64_t i = 0; i < n; ++i) {
+    elements.push_back({Tensor(i)});
+  }
+  return elements;
+}
+
+class RangeIterator : public TaskIterator {
+ public:
+  explicit RangeIterator(const int64_t range) : range_(range) {}
+
+  Status GetNext(std::vector<Tensor>& element, bool& end_of_sequence) override {
+    end_of_sequence = (next_ >= range_);
+    if (!end_of_sequence) {
+      element = {Tensor{next_++}};
+    }
+    return OkStatus();
+  }
+
+  int64_t Cardinality() const override { return range_; }
+
+ private:
+  const int64_t range_;
+  int64_t next_ = 0;
+};
+
+// Reads `num_elements` elements from `iterator`, or all its elements if
+// `num_elements` is negative.
+StatusOr<std::vector<int64_t>> Read(TaskIterator& iterator,
+                                    int64_t num_elements = -1) {
+  std::vector<int64_t> result;
+  while (num_elements < 0 || result.size() < num_elements) {
+    std::vector<Tensor> element;
+    bool end_of_sequence = false;
+    TF_RETURN_IF_ERROR(iterator.GetNext(element, end_of_sequence));
+    if (end_of_sequence) {
+      break;
+    }
+    result.push_back(element[0].scalar<int64_t>()());
+  }
+  return result;
+}
+
+// Replays the output cached under `key`.
+StatusOr<std::vector<int64_t>> ReadCached(CrossJobCache& cache,
+                                          const std::string& key) {
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<TaskIterator> iterator,
+                      cache.Lookup(key));
+  if (iterator == nullptr) {
+    return errors::NotFound("No output is cached under ", key);
+  }
+  return Read(*iterator);
+}
+
+CrossJobCache::Options CacheOptions(size_t max_size_bytes) {
+  CrossJobCache::Options options;
+  options.max_size_bytes = max_size_bytes;
+  return options;
+}
+
+std::string SpillDirectory(const std::string& name) {
+  return io::JoinPath(testing::TmpDir(), name);
+}
+
+NodeDef Int64Const(const std::string& name, int64_t value) {
+  return NDef(name, "Const", {},
+              {{"value", test::AsScalar<int64_t>(value)}, {"dtype", DT_INT64}});
+}
+
+// Returns a graph of `range(10).shuffle(10, seed, seed2)`.
+GraphDef ShuffleGraph(int64_t seed, int64_t seed2) {
+  return GDef({Int64Const("start", 0), Int64Const("stop", 10),
+               Int64Const("step", 1),
+               NDef("range", "RangeDataset", {"start", "stop", "step"}),
+               Int64Const("buffer_size", 10), Int64Const("seed", seed),
+               Int64Const("seed2", seed2),
+               NDef("shuffle", "ShuffleDataset",
+                    {"range", "buffer_size", "seed", "seed2"})});
+}
+
+TEST(CrossJobCacheTest, CachesCompleteOutput) {
+  CellReader<int64_t> cache_queries(
+      "/tensorflow/data/service/cross_job_cache_queries");
+  CrossJobCache cache(Env::Default(), CacheOptions(OutputSize(10)));
+  EXPECT_THAT(cache.Lookup("dataset"), IsOkAndHolds(IsNull()));
+
+  std::unique_ptr<TaskIterator> iterator = cache.MakeCachingIterator(
+      "dataset", std::make_unique<RangeIterator>(10));
+  EXPECT_THAT(Read(*iterator), IsOkAndHolds(ElementsAreArray(Range(10))));
+  EXPECT_TRUE(cache.Contains("dataset"));
+  EXPECT_EQ(cache.size_bytes(), OutputSize(10));
+
+  TF_ASSERT_OK_AND_ASSIGN(iterator, cache.Lookup("dataset"));
+  ASSERT_THAT(iterator, NotNull());
+  EXPECT_EQ(iterator->Cardinality(), 10);
+  EXPECT_THAT(Read(*iterator), IsOkAndHolds(ElementsAreArray(Range(10))));
+  EXPECT_EQ(cache_queries.Delta("true"), 1);
+  EXPECT_EQ(cache_queries.Delta("false"), 1);
+}
+
+TEST(CrossJobCacheTest, DoesNotCacheIncompleteOutput) {
+  CrossJobCache cache(Env::Default(), CacheOptions(OutputSize(10)));
+  std::unique_ptr<TaskIterator> iterator = cache.MakeCachingIterator(
+      "dataset", std::make_unique<RangeIterator>(10));
+  EXPECT_THAT(Read(*iterator, /*num_elements=*/5),
+              IsOkAndHolds(ElementsAreArray(Range(5))));
+  iterator.reset();
+  EXPECT_FALSE(cache.Contains("dataset"));
+  EXPECT_EQ(cache.size_bytes(), 0);
+}
+
+TEST(CrossJobCacheTest, DoesNotCacheOutputLargerThanCache) {
+  CrossJobCache cache(Env::Default(), CacheOptions(OutputSize(5)));
+  std::unique_ptr<TaskIterator> iterator = cache.MakeCachingIterator(
+      "dataset", std::make_unique<RangeIterator>(10));
+  EXPECT_THAT(Read(*iterator), IsOkAndHolds(ElementsAreArray(Range(10))));
+  EXPECT_FALSE(cache.Contains("dataset"));
+  EXPECT_EQ(cache.size_bytes(), 0);
+}
+
+TEST(CrossJobCacheTest, BoundsOutputsBeingCached) {
+  CrossJobCache cache(Env::Default(), CacheOptions(OutputSize(10)));
+  std::unique_ptr<TaskIterator> iterator1 = cache.MakeCachingIterator(
+      "dataset1", std::make_unique<RangeIterator>(6));
+  std::unique_ptr<TaskIterator> iterator2 = cache.MakeCachingIterator(
+      "dataset2", std::make_unique<RangeIterator>(6));
+  EXPECT_THAT(Read(*iterator1, /*num_elements=*/6),
+              IsOkAndHolds(ElementsAreArray(Range(6))));
+  // Together with the elements held by the first iterator, the output of the
+  // second one exceeds the cache size.
+  EXPECT_THAT(Read(*iterator2), IsOkAndHolds(ElementsAreArray(Range(6))));
+  EXPECT_THAT(Read(*iterator1), IsOkAndHolds(IsEmpty()));
+  EXPECT_TRUE(cache.Contains("dataset1"));
+  EXPECT_FALSE(cache.Contains("dataset2"));
+
+  // Destroying an iterator releases the elements it held.
+  std::unique_ptr<TaskIterator> iterator3 = cache.MakeCachingIterator(
+      "dataset3", std::make_unique<RangeIterator>(10));
+  EXPECT_THAT(Read(*iterator3, /*num_elements=*/5),
+              IsOkAndHolds(ElementsAreArray(Range(5))));
+  iterator3.reset();
+  std::unique_ptr<TaskIterator> iterator4 = cache.MakeCachingIterator(
+      "dataset4", std::make_unique<RangeIterator>(10));
+  EXPECT_THAT(Read(*iterator4), IsOkAndHolds(ElementsAreArray(Range(10))));
+  EXPECT_TRUE(cache.Contains("dataset4"));
+}
+
+TEST(CrossJobCacheTest, BoundsCachedAndInFlightOutputs) {
+  CrossJobCache cache(Env::Default(), CacheOptions(OutputSize(10)));
+  cache.Insert("dataset1", RangeElements(6));
+  std::unique_ptr<TaskIterator> iterator = cache.MakeCachingIterator(
+      "dataset2", std::make_unique<RangeIterator>(6));
+  EXPECT_THAT(Read(*iterator, /*num_elements=*/4),
+              IsOkAndHolds(ElementsAreArray(Range(4))));
+  EXPECT_TRUE(cache.Contains("dataset1"));
+
+  // Holding one more element would exceed the cache size together with the
+  // cached output, which is evicted.
+  EXPECT_THAT(Read(*iterator, /*num_elements=*/1),
+              IsOkAndHolds(ElementsAreArray({4})));
+  EXPECT_FALSE(cache.Contains("dataset1"));
+  EXPECT_EQ(cache.size_bytes(), 0);
+
+  // The elements being cached count against inserted outputs too.
+  cache.Insert("dataset3", RangeElements(6));
+  EXPECT_FALSE(cache.Contains("dataset3"));
+
+  EXPECT_THAT(Read(*iterator), IsOkAndHolds(ElementsAreArray({5})));
+  EXPECT_TRUE(cache.Contains("dataset2"));
+  EXPECT_EQ(cache.size_bytes(), OutputSize(6));
+  cache.Insert("dataset3", RangeElements(4));
+  EXPECT_TRUE(cache.Contains("dataset3"));
+  EXPECT_EQ(cache.size_bytes(), OutputSize(10));
+}
+
+TEST(CrossJobCacheTest, EvictsLeastRecentlyUsed) {
+  CrossJobCache cache(Env::Default(), CacheOptions(OutputSize(20)));
+  cache.Insert("dataset1", RangeElements(10));
+  cache.Insert("dataset2", RangeElements(10));
+  EXPECT_THAT(ReadCached(cache, "dataset1"),
+              IsOkAndHolds(ElementsAreArray(Range(10))));
+  cache.Insert("dataset3", RangeElements(10));
+  EXPECT_TRUE(cache.Contains("dataset1"));
+  EXPECT_FALSE(cache.Contains("dataset2"));
+  EXPECT_TRUE(cache.Contains("dataset3"));
+  EXPECT_EQ(cache.size_bytes(), OutputSize(20));
+}
+
+TEST(CrossJobCacheTest, EvictsLeastFrequentlyUsed) {
+  CrossJobCache::Options options = CacheOptions(OutputSize(20));
+  options.eviction_policy =
+      experimental::WorkerConfig::CROSS_JOB_CACHE_EVICTION_POLICY_LFU;
+  CrossJobCache cache(Env::Default(), options);
+  cache.Insert("dataset1", RangeElements(10));
+  cache.Insert("dataset2", RangeElements(10));
+  TF_ASSERT_OK(ReadCached(cache, "dataset2").status());
+  TF_ASSERT_OK(ReadCached(cache, "dataset2").status());
+  TF_ASSERT_OK(ReadCached(cache, "dataset1").status());
+  cache.Insert("dataset3", RangeElements(10));
+  EXPECT_FALSE(cache.Contains("dataset1"));
+  EXPECT_TRUE(cache.Contains("dataset2"));
+  EXPECT_TRUE(cache.Contains("dataset3"));
+}
+
+TEST(CrossJobCacheTest, SpillsEvictedOutputs) {
+  CrossJobCache::Options options = CacheOptions(OutputSize(20));
+  options.spill_directory = SpillDirectory("spills_evicted_outputs");
+  CrossJobCache cache(Env::Default(), options);
+  cache.Insert("dataset1", RangeElements(10));
+  cache.Insert("dataset2", RangeElements(10));
+  cache.Insert("dataset3", RangeElements(10));
+  EXPECT_TRUE(cache.Contains("dataset1"));
+  EXPECT_EQ(cache.size_bytes(), OutputSize(20));
+  EXPECT_THAT(cache.spilled_size_bytes(), Gt(0));
+  EXPECT_THAT(ReadCached(cache, "dataset1"),
+              IsOkAndHolds(ElementsAreArray(Range(10))));
+}
+
+TEST(CrossJobCacheTest, BoundsSpilledOutputs) {
+  CrossJobCache::Options options = CacheOptions(OutputSize(10));
+  options.spill_directory = SpillDirectory("bounds_spilled_outputs");
+  options.max_spill_size_bytes = OutputSize(10);
+  CrossJobCache cache(Env::Default(), options);
+  cache.Insert("dataset1", RangeElements(10));
+  cache.Insert("dataset2", RangeElements(10));
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<TaskIterator> iterator,
+                          cache.Lookup("dataset1"));
+  ASSERT_THAT(iterator, NotNull());
+  EXPECT_THAT(Read(*iterator, /*num_elements=*/5),
+              IsOkAndHolds(ElementsAreArray(Range(5))));
+
+  // Spilling the second dataset evicts the first one from disk.
+  cache.Insert("dataset3", RangeElements(10));
+  EXPECT_FALSE(cache.Contains("dataset1"));
+  EXPECT_TRUE(cache.Contains("dataset2"));
+  EXPECT_TRUE(cache.Contains("dataset3"));
+  EXPECT_THAT(cache.spilled_size_bytes(), Gt(0));
+
+  // Iterators keep evicted spill files until they are destroyed.
+  EXPECT_THAT(Read(*iterator),
+              IsOkAndHolds(ElementsAreArray({5, 6, 7, 8, 9})));
+}
+
+TEST(CheckCrossJobCacheableTest, DeterministicDataset) {
+  TF_EXPECT_OK(CheckCrossJobCacheable(GDef(
+      {Int64Const("start", 0), Int64Const("stop", 10), Int64Const("step", 1),
+       NDef("range", "RangeDataset", {"start", "stop", "step"})})));
+}
+
+TEST(CheckCrossJobCacheableTest, SeededShuffle) {
+  TF_EXPECT_OK(CheckCrossJobCacheable(ShuffleGraph(/*seed=*/1, /*seed2=*/2)));
+  TF_EXPECT_OK(CheckCrossJobCacheable(ShuffleGraph(/*seed=*/0, /*seed2=*/2)));
+}
+
+TEST(CheckCrossJobCacheableTest, UnseededShuffle) {
+  EXPECT_THAT(CheckCrossJobCacheable(ShuffleGraph(/*seed=*/0, /*seed2=*/0)),
+              StatusIs(error::FAILED_PRECONDITION,
+                       HasSubstr("ShuffleDataset without fixed seeds")));
+}
+
+TEST(CheckCrossJobCacheableTest, RandomOpInFunction) {
+  FunctionDef augment;
+  augment.mutable_signature()->set_name("augment");
+  *augment.add_node_def() = NDef("shape", "Const", {},
+                                 {{"value", test::AsTensor<int32>({2})},
+                                  {"dtype", DT_INT32}});
+  *augment.add_node_def() =
+      NDef("noise", "RandomUniform", {"shape:output:0"},
+           {{"dtype", DT_FLOAT}, {"T", DT_INT32}});
+  GraphDef graph =
+      GDef({Int64Const("start", 0), Int64Const("stop", 10),
+            Int64Const("step", 1),
+            NDef("range", "RangeDataset", {"start", "stop", "step"}),
+            NDef("map", "MapDataset", {"range"},
+                 {{"f", FunctionDefHelper::FunctionRef("augment")}})},
+           {augment});
+  EXPECT_THAT(CheckCrossJobCacheable(graph),
+              StatusIs(error::FAILED_PRECONDITION,
+                       HasSubstr("RandomUniform, which is stateful")));
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
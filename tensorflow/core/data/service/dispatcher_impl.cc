@@ -1258,7 +1258,9 @@ Status DataServiceDispatcherImpl::DisableCompressionAtRuntime(
   mutex_lock l(mu_);
   TF_RETURN_IF_ERROR(state_.DatasetFromId(request->dataset_id(), dataset));
   if (dataset->metadata.compression() !=
-      DataServiceMetadata::COMPRESSION_SNAPPY) {
+          DataServiceMetadata::COMPRESSION_SNAPPY &&
+      dataset->metadata.compression() !=
+          DataServiceMetadata::COMPRESSION_ZSTD) {
     response->set_no_compression_to_disable(true);
     return OkStatus();
   }
@@ -29,6 +29,7 @@ limitations under the License.
 #include "tensorflow/core/data/service/grpc_dispatcher_impl.h"
 #include "tensorflow/core/data/service/grpc_util.h"
 #include "tensorflow/core/data/service/grpc_worker_impl.h"
+#include "tensorflow/core/data/service/shm_data_transfer.h"
 #include "tensorflow/core/data/service/worker_client.h"
 #include "tensorflow/core/platform/errors.h"
 
@@ -173,7 +174,11 @@ WorkerGrpcDataServer::WorkerGrpcDataServer(
                          std::move(options)),
       config_(config) {}
 
-WorkerGrpcDataServer::~WorkerGrpcDataServer() { delete service_; }
+WorkerGrpcDataServer::~WorkerGrpcDataServer() {
+  // The connections of the shared memory transfer server use `service_`.
+  shm_transfer_server_.reset();
+  delete service_;
+}
 
 void WorkerGrpcDataServer::AddDataServiceToBuilder(
     ::grpc::ServerBuilder& builder) {
@@ -226,6 +231,39 @@ void WorkerGrpcDataServer::MaybeStartAlternativeDataTransferServer(
   transfer_servers.push_back(alternative_transfer_server);
 }
 
+void WorkerGrpcDataServer::MaybeStartShmDataTransferServer(
+    std::vector<DataTransferServerInfo>& transfer_servers) {
+  if (config_.data_transfer_protocol() == kShmTransferProtocol) {
+    // Already started as the alternative data transfer server.
+    return;
+  }
+  Status s = DataTransferServer::Build(kShmTransferProtocol,
+                                       service_->get_element_getter(),
+                                       &shm_transfer_server_);
+  if (!s.ok()) {
+    VLOG(1) << "Shared memory data transfer is not available for worker "
+            << config_.worker_address() << ": " << s;
+    return;
+  }
+  s = shm_transfer_server_->Start();
+  StatusOr<std::string> compatibility_info =
+      s.ok() ? shm_transfer_server_->GetCompatibilityInfo()
+             : StatusOr<std::string>(s);
+  if (!compatibility_info.ok()) {
+    LOG(WARNING) << "failed to start " << kShmTransferProtocol
+                 << " server for worker " << config_.worker_address() << ": "
+                 << compatibility_info.status();
+    shm_transfer_server_.reset();
+    return;
+  }
+  DataTransferServerInfo shm_transfer_server;
+  shm_transfer_server.set_protocol(kShmTransferProtocol);
+  shm_transfer_server.set_address(
+      absl::StrCat("localhost:", shm_transfer_server_->Port()));
+  shm_transfer_server.set_compatibility_info(*compatibility_info);
+  transfer_servers.push_back(shm_transfer_server);
+}
+
 Status WorkerGrpcDataServer::StartServiceInternal() {
   std::string base_address = config_.worker_address();
   if (base_address.empty()) {
@@ -239,11 +277,15 @@ Status WorkerGrpcDataServer::StartServiceInternal() {
   grpc_transfer_server.set_address(worker_address);
   std::vector<DataTransferServerInfo> transfer_servers = {grpc_transfer_server};
   MaybeStartAlternativeDataTransferServer(transfer_servers);
+  MaybeStartShmDataTransferServer(transfer_servers);
   TF_RETURN_IF_ERROR(service_->Start(worker_address, transfer_servers));
   return OkStatus();
 }
 
-void WorkerGrpcDataServer::StopServiceInternal() { service_->Stop(); }
+void WorkerGrpcDataServer::StopServiceInternal() {
+  service_->Stop();
+  shm_transfer_server_.reset();
+}
 
 Status WorkerGrpcDataServer::NumTasks(int* num_tasks) {
   GetWorkerTasksRequest req;
@@ -167,11 +167,17 @@ class WorkerGrpcDataServer : public GrpcDataServerBase {
   // successful.
   void MaybeStartAlternativeDataTransferServer(
       std::vector<DataTransferServerInfo>& transfer_servers);
+  // Tries to start a shared memory transfer server, which clients on the same
+  // host use instead of gRPC, adding an entry to `transfer_servers` if
+  // successful.
+  void MaybeStartShmDataTransferServer(
+      std::vector<DataTransferServerInfo>& transfer_servers);
 
   const experimental::WorkerConfig config_;
   // Owned. We use a raw pointer because GrpcWorkerImpl is forward-declared.
   GrpcWorkerImpl* service_;
   std::shared_ptr<DataTransferServer> transfer_server_;
+  std::shared_ptr<DataTransferServer> shm_transfer_server_;
 };
 
 // Creates a dispatch tf.data server and stores it in `out_server`.
@@ -0,0 +1,918 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/service/shm_data_transfer.h"
+
+#if defined(__linux__)
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "tensorflow/core/framework/allocation_description.pb.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/metrics.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor.pb.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/core/refcount.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/host_info.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/random.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+constexpr size_t kAlignment = Allocator::kAllocatorAlignment;
+
+// The ring starts with a page that holds its `RingHeader`.
+constexpr size_t kRingHeaderBytes = 4096;
+
+constexpr char kSocketNamePrefix[] = "tf_data_service_shm_";
+constexpr int kMaxBindAttempts = 16;
+
+// Frames larger than this are rejected as corrupt.
+constexpr uint32_t kMaxFrameBytes = 64 << 20;
+
+// Where the tensor data of an element is.
+enum Storage : uint8_t {
+  // The element has no tensor data.
+  kStorageNone = 0,
+  // In the ring of the connection.
+  kStorageRing = 1,
+  // In a shared memory region of its own, whose file descriptor is sent
+  // along with the response.
+  kStorageRegion = 2,
+};
+
+// Shared between the server and the client at the start of the ring.
+struct RingHeader {
+  // Total number of bytes, including padding, that the client has released
+  // since the connection was established. The server reserves the bytes of
+  // the ring in the same order.
+  std::atomic<uint64_t> released;
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "RingHeader must be lock-free to be shared between processes");
+
+size_t AlignUp(size_t bytes) {
+  return (bytes + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+// Returns the address of the abstract Unix domain socket of server `id`.
+sockaddr_un SocketAddress(int id, socklen_t* length) {
+  const std::string name = absl::StrCat(kSocketNamePrefix, id);
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  // A leading NUL byte puts the socket in the abstract namespace, so that it
+  // is not visible in, and is never left behind on, the file system.
+  memcpy(address.sun_path + 1, name.data(), name.size());
+  *length = offsetof(sockaddr_un, sun_path) + 1 + name.size();
+  return address;
+}
+
+// Returns a string that identifies the host, and the network namespace that
+// scopes abstract sockets, of the calling process.
+StatusOr<std::string> HostId() {
+  std::string boot_id;
+  TF_RETURN_IF_ERROR(ReadFileToString(
+      Env::Default(), "/proc/sys/kernel/random/boot_id", &boot_id));
+  char network_namespace[128];
+  const ssize_t length = readlink("/proc/self/ns/net", network_namespace,
+                                  sizeof(network_namespace));
+  if (length < 0) {
+    return errors::IOError("Failed to read the network namespace", errno);
+  }
+  return absl::StrCat(port::Hostname(), "/",
+                      absl::StripAsciiWhitespace(boot_id), "/",
+                      absl::string_view(network_namespace, length));
+}
+
+StatusOr<int> CreateSharedMemory(size_t bytes) {
+  const int fd = memfd_create("tf_data_service_shm", MFD_CLOEXEC);
+  if (fd < 0) {
+    return errors::IOError("Failed to create shared memory", errno);
+  }
+  if (ftruncate(fd, bytes) != 0) {
+    const int error = errno;
+    close(fd);
+    return errors::IOError(
+        absl::StrCat("Failed to allocate ", bytes, " bytes of shared memory"),
+        error);
+  }
+  return fd;
+}
+
+StatusOr<char*> MapSharedMemory(int fd, size_t bytes, int protection) {
+  void* mapping = mmap(nullptr, bytes, protection, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    return errors::IOError(
+        absl::StrCat("Failed to map ", bytes, " bytes of shared memory"),
+        errno);
+  }
+  return static_cast<char*>(mapping);
+}
+
+Status WriteAll(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    const ssize_t written = send(fd, data, size, MSG_NOSIGNAL);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return errors::Unavailable("Failed to write to the shared memory ",
+                                 "transfer socket: ", strerror(errno));
+    }
+    data += written;
+    size -= written;
+  }
+  return OkStatus();
+}
+
+Status ReadAll(int fd, char* data, size_t size) {
+  while (size > 0) {
+    const ssize_t read = recv(fd, data, size, 0);
+    if (read < 0 && errno == EINTR) continue;
+    if (read <= 0) {
+      return errors::Unavailable(
+          "The shared memory transfer connection was closed",
+          read < 0 ? absl::StrCat(": ", strerror(errno)) : "");
+    }
+    data += read;
+    size -= read;
+  }
+  return OkStatus();
+}
+
+// Sends `payload`, prefixed by its length, and `fd_to_send` if it is not -1.
+Status SendFrame(int fd, absl::string_view payload, int fd_to_send = -1) {
+  char length[sizeof(uint32_t)];
+  core::EncodeFixed32(length, payload.size());
+  iovec iov[2] = {{length, sizeof(length)},
+                  {const_cast<char*>(payload.data()), payload.size()}};
+  msghdr message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = iov;
+  message.msg_iovlen = 2;
+  char control[CMSG_SPACE(sizeof(int))];
+  if (fd_to_send >= 0) {
+    memset(control, 0, sizeof(control));
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(header), &fd_to_send, sizeof(int));
+  }
+  ssize_t sent;
+  do {
+    sent = sendmsg(fd, &message, MSG_NOSIGNAL);
+  } while (sent < 0 && errno == EINTR);
+  if (sent < 0) {
+    return errors::Unavailable("Failed to write to the shared memory ",
+                               "transfer socket: ", strerror(errno));
+  }
+  // The file descriptor went out with the first byte. Write the rest.
+  const size_t total = sizeof(length) + payload.size();
+  if (static_cast<size_t>(sent) < sizeof(length)) {
+    TF_RETURN_IF_ERROR(WriteAll(fd, length + sent, sizeof(length) - sent));
+    sent = sizeof(length);
+  }
+  const size_t payload_sent = sent - sizeof(length);
+  return WriteAll(fd, payload.data() + payload_sent,
+                  total - sizeof(length) - payload_sent);
+}
+
+// Receives a frame sent by `SendFrame`. Sets `*received_fd` to the file
+// descriptor sent with it, or to -1.
+Status ReceiveFrame(int fd, std::string* payload, int* received_fd) {
+  *received_fd = -1;
+  char length[sizeof(uint32_t)];
+  iovec iov = {length, sizeof(length)};
+  msghdr message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  char control[CMSG_SPACE(sizeof(int))];
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  ssize_t read;
+  do {
+    read = recvmsg(fd, &message, MSG_CMSG_CLOEXEC);
+  } while (read < 0 && errno == EINTR);
+  if (read <= 0) {
+    return errors::Unavailable(
+        "The shared memory transfer connection was closed",
+        read < 0 ? absl::StrCat(": ", strerror(errno)) : "");
+  }
+  for (cmsghdr* header = CMSG_FIRSTHDR(&message); header != nullptr;
+       header = CMSG_NXTHDR(&message, header)) {
+    if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) {
+      memcpy(received_fd, CMSG_DATA(header), sizeof(int));
+    }
+  }
+  Status s = ReadAll(fd, length + read, sizeof(length) - read);
+  const uint32_t size = core::DecodeFixed32(length);
+  if (s.ok() && size > kMaxFrameBytes) {
+    s = errors::DataLoss("Corrupt shared memory transfer frame of ", size,
+                         " bytes");
+  }
+  if (s.ok()) {
+    payload->resize(size);
+    s = ReadAll(fd, payload->data(), size);
+  }
+  if (!s.ok() && *received_fd >= 0) {
+    close(*received_fd);
+    *received_fd = -1;
+  }
+  return s;
+}
+
+// Returns the number of bytes that `component` takes in shared memory.
+// Components that cannot be shared as they are are serialized into
+// `serialized`.
+size_t ComponentBytes(const Tensor& component, std::string* serialized) {
+  if (DataTypeCanUseMemcpy(component.dtype())) {
+    return component.TotalBytes();
+  }
+  if (component.dtype() == DT_STRING) {
+    // The lengths of the strings, followed by their bytes.
+    const auto strings = component.unaligned_flat<tstring>();
+    size_t bytes = strings.size() * sizeof(uint64_t);
+    for (int64_t i = 0; i < strings.size(); ++i) {
+      bytes += strings(i).size();
+    }
+    return bytes;
+  }
+  TensorProto proto;
+  component.AsProtoTensorContent(&proto);
+  proto.SerializeToString(serialized);
+  return serialized->size();
+}
+
+void WriteComponent(const Tensor& component, const std::string& serialized,
+                    char* dst) {
+  if (DataTypeCanUseMemcpy(component.dtype())) {
+    const auto data = component.tensor_data();
+    memcpy(dst, data.data(), data.size());
+  } else if (component.dtype() == DT_STRING) {
+    const auto strings = component.unaligned_flat<tstring>();
+    char* bytes = dst + strings.size() * sizeof(uint64_t);
+    for (int64_t i = 0; i < strings.size(); ++i) {
+      const uint64_t length = strings(i).size();
+      memcpy(dst + i * sizeof(uint64_t), &length, sizeof(length));
+      memcpy(bytes, strings(i).data(), length);
+      bytes += length;
+    }
+  } else {
+    memcpy(dst, serialized.data(), serialized.size());
+  }
+}
+
+std::string EncodeError(const Status& status) {
+  std::string response;
+  core::PutVarint32(&response, static_cast<uint32_t>(status.code()));
+  absl::StrAppend(&response, status.message());
+  return response;
+}
+
+// A tensor buffer that points into the shared memory of an element, which it
+// keeps alive through a reference on `region`.
+class SharedTensorBuffer : public TensorBuffer {
+ public:
+  SharedTensorBuffer(core::RefCounted* region, const char* data, size_t size)
+      : TensorBuffer(const_cast<char*>(data)), region_(region), size_(size) {
+    region_->Ref();
+  }
+  ~SharedTensorBuffer() override { region_->Unref(); }
+
+  size_t size() const override { return size_; }
+  TensorBuffer* root_buffer() override { return this; }
+  void FillAllocationDescription(AllocationDescription* proto) const override {
+    proto->set_requested_bytes(size_);
+    proto->set_allocator_name("tf_data_service_shm");
+  }
+  // Keeps kernels from forwarding the buffer and writing to shared memory.
+  bool OwnsMemory() const override { return false; }
+
+ private:
+  core::RefCounted* const region_;
+  const size_t size_;
+};
+
+// A tensor buffer of strings that are views of the shared memory of an
+// element.
+class SharedStringTensorBuffer : public TensorBuffer {
+ public:
+  SharedStringTensorBuffer(core::RefCounted* region, tstring* strings,
+                           int64_t num_strings)
+      : TensorBuffer(strings), region_(region), num_strings_(num_strings) {
+    region_->Ref();
+  }
+  ~SharedStringTensorBuffer() override {
+    delete[] base<tstring>();
+    region_->Unref();
+  }
+
+  size_t size() const override { return num_strings_ * sizeof(tstring); }
+  TensorBuffer* root_buffer() override { return this; }
+  void FillAllocationDescription(AllocationDescription* proto) const override {
+    proto->set_requested_bytes(size());
+    proto->set_allocator_name("tf_data_service_shm");
+  }
+
+ private:
+  core::RefCounted* const region_;
+  const int64_t num_strings_;
+};
+
+}  // namespace
+
+struct ShmDataTransferServer::Connection {
+  ~Connection() {
+    thread.reset();
+    if (ring != nullptr) munmap(ring, kRingHeaderBytes + ring_bytes);
+    if (ring_fd >= 0) close(ring_fd);
+    close(fd);
+  }
+
+  RingHeader* header() { return reinterpret_cast<RingHeader*>(ring); }
+  char* data() { return ring + kRingHeaderBytes; }
+
+  // Reserves `bytes` of the ring, which must be a multiple of `kAlignment`,
+  // for an element. Returns the offset of the reserved bytes in the ring, or
+  // -1 if there is not enough free space. Sets `[*start, *end)` to the range
+  // that the client releases once it is done with the element.
+  int64_t Reserve(size_t bytes, uint64_t* start, uint64_t* end) {
+    const uint64_t released =
+        header()->released.load(std::memory_order_acquire);
+    const size_t offset = written % ring_bytes;
+    // Elements are contiguous, so skip the end of the ring if the element
+    // does not fit there.
+    const size_t padding =
+        offset + bytes > ring_bytes ? ring_bytes - offset : 0;
+    if (written + padding + bytes - released > ring_bytes) return -1;
+    *start = written;
+    written += padding + bytes;
+    *end = written;
+    return padding > 0 ? 0 : offset;
+  }
+
+  int fd = -1;
+  int ring_fd = -1;
+  char* ring = nullptr;
+  size_t ring_bytes = 0;
+  // Total number of bytes reserved since the connection was established.
+  uint64_t written = 0;
+  std::unique_ptr<Thread> thread;
+  std::atomic<bool> done{false};
+};
+
+ShmDataTransferServer::ShmDataTransferServer(GetElementT get_element,
+                                             size_t ring_bytes)
+    : get_element_(std::move(get_element)), ring_bytes_(AlignUp(ring_bytes)) {}
+
+ShmDataTransferServer::~ShmDataTransferServer() {
+  std::vector<std::unique_ptr<Connection>> connections;
+  {
+    mutex_lock l(mu_);
+    cancelled_ = true;
+    for (const auto& connection : connections_) {
+      shutdown(connection->fd, SHUT_RDWR);
+    }
+    connections = std::move(connections_);
+  }
+  if (listen_fd_ >= 0) shutdown(listen_fd_, SHUT_RDWR);
+  accept_thread_.reset();
+  // Joins the connection threads.
+  connections.clear();
+  if (listen_fd_ >= 0) close(listen_fd_);
+}
+
+Status ShmDataTransferServer::Start() {
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listen_fd_ < 0) {
+    return errors::IOError("Failed to create the shared memory transfer socket",
+                           errno);
+  }
+  for (int attempt = 0; attempt < kMaxBindAttempts; ++attempt) {
+    // Ids are used as ports, so keep them positive ints.
+    const int id = 1 + random::New64() % (kint32max - 1);
+    socklen_t length;
+    sockaddr_un address = SocketAddress(id, &length);
+    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), length) == 0) {
+      id_ = id;
+      break;
+    }
+    if (errno != EADDRINUSE) {
+      return errors::IOError(
+          "Failed to bind the shared memory transfer socket", errno);
+    }
+  }
+  if (id_ == 0) {
+    return errors::Unavailable(
+        "Failed to find a free name for the shared memory transfer socket");
+  }
+  if (listen(listen_fd_, SOMAXCONN) != 0) {
+    return errors::IOError(
+        "Failed to listen on the shared memory transfer socket", errno);
+  }
+  accept_thread_ = absl::WrapUnique(Env::Default()->StartThread(
+      {}, "tf_data_service_shm_accept", [this]() { AcceptLoop(); }));
+  VLOG(1) << "Started shared memory transfer server " << id_;
+  return OkStatus();
+}
+
+StatusOr<std::string> ShmDataTransferServer::GetCompatibilityInfo() const {
+  return HostId();
+}
+
+void ShmDataTransferServer::AcceptLoop() {
+  while (true) {
+    const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      mutex_lock l(mu_);
+      if (!cancelled_) {
+        LOG(ERROR) << "Shared memory transfer server " << id_
+                   << " stopped accepting connections: " << strerror(errno);
+      }
+      return;
+    }
+    auto connection = std::make_unique<Connection>();
+    connection->fd = fd;
+    connection->ring_bytes = ring_bytes_;
+    const size_t mapping_bytes = kRingHeaderBytes + ring_bytes_;
+    StatusOr<int> ring_fd = CreateSharedMemory(mapping_bytes);
+    Status s = ring_fd.status();
+    if (s.ok()) {
+      connection->ring_fd = *ring_fd;
+      StatusOr<char*> ring = MapSharedMemory(*ring_fd, mapping_bytes,
+                                             PROT_READ | PROT_WRITE);
+      s = ring.status();
+      if (s.ok()) connection->ring = *ring;
+    }
+    if (s.ok()) {
+      // The handshake sends the ring to the client.
+      std::string handshake;
+      core::PutVarint64(&handshake, ring_bytes_);
+      s = SendFrame(fd, handshake, connection->ring_fd);
+    }
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to set up a shared memory transfer connection: "
+                   << s;
+      continue;
+    }
+
+    mutex_lock l(mu_);
+    if (cancelled_) return;
+    // Reap the connections that the clients have closed.
+    for (auto it = connections_.begin(); it != connections_.end();) {
+      it = (*it)->done ? connections_.erase(it) : it + 1;
+    }
+    Connection* raw_connection = connection.get();
+    connection->thread = absl::WrapUnique(Env::Default()->StartThread(
+        {}, "tf_data_service_shm_connection",
+        [this, raw_connection]() { ServeConnection(raw_connection); }));
+    connections_.push_back(std::move(connection));
+  }
+}
+
+void ShmDataTransferServer::ServeConnection(Connection* connection) {
+  while (true) {
+    std::string request_bytes;
+    int received_fd;
+    if (!ReceiveFrame(connection->fd, &request_bytes, &received_fd).ok()) {
+      break;
+    }
+    if (received_fd >= 0) close(received_fd);
+
+    GetElementRequest request;
+    GetElementResult result;
+    Status s = request.ParseFromString(request_bytes)
+                   ? get_element_(&request, &result)
+                   : errors::InvalidArgument("Failed to parse request.");
+    std::string response;
+    int region_fd = -1;
+    if (s.ok()) {
+      // Lay the components out, each aligned, in a single block of shared
+      // memory.
+      std::vector<std::string> serialized(result.components.size());
+      std::vector<size_t> offsets(result.components.size());
+      std::vector<size_t> sizes(result.components.size());
+      size_t total_bytes = 0;
+      for (int i = 0; i < result.components.size(); ++i) {
+        sizes[i] = ComponentBytes(result.components[i], &serialized[i]);
+        offsets[i] = total_bytes;
+        total_bytes += AlignUp(sizes[i]);
+      }
+
+      core::PutVarint32(&response, 0);
+      response.push_back(result.end_of_sequence);
+      response.push_back(result.skip);
+      core::PutVarint64(&response, result.element_index);
+      char* data = nullptr;
+      uint64_t start, end;
+      const int64_t ring_offset =
+          total_bytes == 0 ? -1
+                           : connection->Reserve(total_bytes, &start, &end);
+      if (total_bytes == 0) {
+        response.push_back(kStorageNone);
+      } else if (ring_offset >= 0) {
+        response.push_back(kStorageRing);
+        core::PutVarint64(&response, ring_offset);
+        core::PutVarint64(&response, start);
+        core::PutVarint64(&response, end);
+        data = connection->data() + ring_offset;
+      } else {
+        // Too large for the free space of the ring.
+        StatusOr<int> fd = CreateSharedMemory(total_bytes);
+        StatusOr<char*> mapping =
+            fd.ok() ? MapSharedMemory(*fd, total_bytes, PROT_READ | PROT_WRITE)
+                    : StatusOr<char*>(fd.status());
+        s = mapping.status();
+        if (fd.ok()) region_fd = *fd;
+        if (s.ok()) {
+          response.push_back(kStorageRegion);
+          core::PutVarint64(&response, total_bytes);
+          data = *mapping;
+        }
+      }
+      if (s.ok()) {
+        core::PutVarint32(&response, result.components.size());
+        for (int i = 0; i < result.components.size(); ++i) {
+          const Tensor& component = result.components[i];
+          WriteComponent(component, serialized[i], data + offsets[i]);
+          core::PutVarint32(&response, component.dtype());
+          core::PutVarint32(&response, component.dims());
+          for (int64_t dim : component.shape().dim_sizes()) {
+            core::PutVarint64(&response, dim);
+          }
+          core::PutVarint64(&response, offsets[i]);
+          core::PutVarint64(&response, sizes[i]);
+        }
+        if (region_fd >= 0) munmap(data, total_bytes);
+      }
+    }
+    if (!s.ok()) response = EncodeError(s);
+    s = SendFrame(connection->fd, response, s.ok() ? region_fd : -1);
+    if (region_fd >= 0) close(region_fd);
+    if (!s.ok()) break;
+  }
+  connection->done = true;
+}
+
+// The client's view of the ring of a connection.
+class ShmDataTransferClient::Ring {
+ public:
+  Ring(char* mapping, size_t ring_bytes)
+      : mapping_(mapping), ring_bytes_(ring_bytes) {}
+  ~Ring() { munmap(mapping_, kRingHeaderBytes + ring_bytes_); }
+
+  const char* data() const { return mapping_ + kRingHeaderBytes; }
+  size_t ring_bytes() const { return ring_bytes_; }
+
+  // Releases the range `[start, end)` of an element. The ring reuses the
+  // space once every earlier element has been released too.
+  void Release(uint64_t start, uint64_t end) {
+    mutex_lock l(mu_);
+    pending_[start] = end;
+    while (!pending_.empty() && pending_.begin()->first == released_) {
+      released_ = pending_.begin()->second;
+      pending_.erase(pending_.begin());
+    }
+    reinterpret_cast<RingHeader*>(mapping_)->released.store(
+        released_, std::memory_order_release);
+  }
+
+ private:
+  char* const mapping_;
+  const size_t ring_bytes_;
+
+  mutex mu_;
+  uint64_t released_ TF_GUARDED_BY(mu_) = 0;
+  // Released ranges that follow an unreleased one, keyed by start.
+  std::map<uint64_t, uint64_t> pending_ TF_GUARDED_BY(mu_);
+};
+
+// The shared memory that holds the tensor data of one element. Each tensor of
+// the element holds a reference to it.
+class ShmDataTransferClient::Region : public core::RefCounted {
+ public:
+  // A region of `ring`.
+  Region(std::shared_ptr<Ring> ring, uint64_t ring_offset, uint64_t start,
+         uint64_t end)
+      : ring_(std::move(ring)),
+        data_(ring_->data() + ring_offset),
+        start_(start),
+        end_(end) {}
+
+  // A region of its own, which is unmapped on destruction.
+  Region(char* mapping, size_t size) : data_(mapping), end_(size) {}
+
+  ~Region() override {
+    if (ring_) {
+      ring_->Release(start_, end_);
+    } else {
+      munmap(const_cast<char*>(data_), end_);
+    }
+  }
+
+  const char* data() const { return data_; }
+
+ private:
+  const std::shared_ptr<Ring> ring_;
+  const char* const data_;
+  const uint64_t start_ = 0;
+  const uint64_t end_;
+};
+
+Status ShmDataTransferClient::Create(const std::string& address,
+                                     std::unique_ptr<DataTransferClient>* out) {
+  int id;
+  const size_t colon = address.rfind(':');
+  if (colon == std::string::npos ||
+      !absl::SimpleAtoi(absl::string_view(address).substr(colon + 1), &id)) {
+    return errors::InvalidArgument(
+        "Invalid shared memory transfer server address: ", address);
+  }
+  const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return errors::IOError("Failed to create the shared memory transfer socket",
+                           errno);
+  }
+  socklen_t length;
+  sockaddr_un socket_address = SocketAddress(id, &length);
+  if (connect(fd, reinterpret_cast<sockaddr*>(&socket_address), length) != 0) {
+    const int error = errno;
+    close(fd);
+    return errors::Unavailable("Failed to connect to shared memory transfer ",
+                               "server ", address, ": ", strerror(error));
+  }
+
+  std::string handshake;
+  int ring_fd;
+  Status s = ReceiveFrame(fd, &handshake, &ring_fd);
+  uint64_t ring_bytes = 0;
+  absl::string_view input(handshake);
+  if (s.ok() && (ring_fd < 0 || !core::GetVarint64(&input, &ring_bytes))) {
+    s = errors::DataLoss("Invalid shared memory transfer handshake.");
+  }
+  StatusOr<char*> mapping =
+      s.ok() ? MapSharedMemory(ring_fd, kRingHeaderBytes + ring_bytes,
+                               PROT_READ | PROT_WRITE)
+             : StatusOr<char*>(s);
+  if (ring_fd >= 0) close(ring_fd);
+  if (!mapping.ok()) {
+    close(fd);
+    return mapping.status();
+  }
+  out->reset(new ShmDataTransferClient(
+      fd, std::make_shared<Ring>(*mapping, ring_bytes)));
+  return OkStatus();
+}
+
+ShmDataTransferClient::ShmDataTransferClient(int fd, std::shared_ptr<Ring> ring)
+    : fd_(fd), ring_(std::move(ring)) {
+  VLOG(2) << "Create ShmDataTransferClient with a ring of "
+          << ring_->ring_bytes() << " bytes.";
+}
+
+ShmDataTransferClient::~ShmDataTransferClient() { close(fd_); }
+
+Status ShmDataTransferClient::GetElement(const GetElementRequest& req,
+                                         GetElementResult& result) {
+  VLOG(3) << "GetElement for task " << req.task_id()
+          << " from shared memory worker server.";
+  mutex_lock request_lock(request_mu_);
+  {
+    mutex_lock l(mu_);
+    if (cancelled_) {
+      return errors::Cancelled("Client was cancelled.");
+    }
+  }
+  const int64_t start_time_us = env_->NowMicros();
+  std::string response;
+  int region_fd = -1;
+  Status s = SendFrame(fd_, req.SerializeAsString());
+  if (s.ok()) s = ReceiveFrame(fd_, &response, &region_fd);
+  if (!s.ok()) {
+    mutex_lock l(mu_);
+    return cancelled_ ? errors::Cancelled("Client was cancelled.") : s;
+  }
+  metrics::RecordTFDataServiceGetElementDuration(
+      kShmTransferProtocol, env_->NowMicros() - start_time_us);
+
+  absl::string_view input(response);
+  auto corrupt = [&region_fd]() {
+    if (region_fd >= 0) close(region_fd);
+    return errors::DataLoss("Corrupt shared memory transfer response.");
+  };
+  uint32_t code;
+  if (!core::GetVarint32(&input, &code)) return corrupt();
+  if (code != 0) {
+    if (region_fd >= 0) close(region_fd);
+    return Status(static_cast<absl::StatusCode>(code), input);
+  }
+  uint64_t element_index;
+  if (input.size() < 2) return corrupt();
+  result.end_of_sequence = input[0];
+  result.skip = input[1];
+  input.remove_prefix(2);
+  if (!core::GetVarint64(&input, &element_index) || input.empty()) {
+    return corrupt();
+  }
+  result.element_index = element_index;
+  const uint8_t storage = input[0];
+  input.remove_prefix(1);
+
+  // Adopts the initial reference.
+  core::RefCountPtr<Region> region;
+  uint64_t region_bytes = 0;
+  if (storage == kStorageRing) {
+    uint64_t ring_offset, start, end;
+    if (!core::GetVarint64(&input, &ring_offset) ||
+        !core::GetVarint64(&input, &start) ||
+        !core::GetVarint64(&input, &end) ||
+        ring_offset >= ring_->ring_bytes()) {
+      return corrupt();
+    }
+    region_bytes = ring_->ring_bytes() - ring_offset;
+    region.reset(new Region(ring_, ring_offset, start, end));
+  } else if (storage == kStorageRegion) {
+    if (region_fd < 0 || !core::GetVarint64(&input, &region_bytes)) {
+      return corrupt();
+    }
+    StatusOr<char*> mapping =
+        MapSharedMemory(region_fd, region_bytes, PROT_READ);
+    close(region_fd);
+    region_fd = -1;
+    TF_RETURN_IF_ERROR(mapping.status());
+    region.reset(new Region(*mapping, region_bytes));
+  } else if (storage != kStorageNone) {
+    return corrupt();
+  }
+  if (region_fd >= 0) close(region_fd);
+
+  uint32_t num_components;
+  if (!core::GetVarint32(&input, &num_components)) return corrupt();
+  result.components.clear();
+  result.components.reserve(num_components);
+  for (uint32_t i = 0; i < num_components; ++i) {
+    uint32_t dtype, dims;
+    if (!core::GetVarint32(&input, &dtype) ||
+        !core::GetVarint32(&input, &dims)) {
+      return corrupt();
+    }
+    TensorShape shape;
+    for (uint32_t d = 0; d < dims; ++d) {
+      uint64_t dim;
+      if (!core::GetVarint64(&input, &dim)) return corrupt();
+      TF_RETURN_IF_ERROR(shape.AddDimWithStatus(dim));
+    }
+    uint64_t offset, bytes;
+    if (!core::GetVarint64(&input, &offset) ||
+        !core::GetVarint64(&input, &bytes) ||
+        (bytes > 0 && region == nullptr) || offset > region_bytes ||
+        bytes > region_bytes - offset) {
+      return corrupt();
+    }
+    const char* data = bytes > 0 ? region->data() + offset : nullptr;
+    const DataType type = static_cast<DataType>(dtype);
+    if (DataTypeCanUseMemcpy(type)) {
+      if (bytes != shape.num_elements() * DataTypeSize(type)) return corrupt();
+      if (bytes == 0) {
+        result.components.emplace_back(type, shape);
+        continue;
+      }
+      auto* buffer = new SharedTensorBuffer(region.get(), data, bytes);
+      result.components.emplace_back(type, shape, buffer);
+      buffer->Unref();
+    } else if (type == DT_STRING) {
+      const int64_t num_strings = shape.num_elements();
+      if (num_strings == 0) {
+        result.components.emplace_back(type, shape);
+        continue;
+      }
+      if (bytes < num_strings * sizeof(uint64_t)) return corrupt();
+      auto strings = std::make_unique<tstring[]>(num_strings);
+      const char* string_data = data + num_strings * sizeof(uint64_t);
+      const char* limit = data + bytes;
+      for (int64_t j = 0; j < num_strings; ++j) {
+        uint64_t length;
+        memcpy(&length, data + j * sizeof(uint64_t), sizeof(length));
+        if (length > limit - string_data) return corrupt();
+        strings[j].assign_as_view(string_data, length);
+        string_data += length;
+      }
+      auto* buffer = new SharedStringTensorBuffer(
+          region.get(), strings.release(), num_strings);
+      result.components.emplace_back(type, shape, buffer);
+      buffer->Unref();
+    } else {
+      TensorProto proto;
+      if (!proto.ParseFromArray(data, bytes)) return corrupt();
+      result.components.emplace_back();
+      if (!result.components.back().FromProto(proto)) {
+        return errors::Internal("Failed to parse tensor.");
+      }
+    }
+  }
+  return OkStatus();
+}
+
+void ShmDataTransferClient::TryCancel() {
+  VLOG(2) << "Cancel ShmDataTransferClient.";
+  mutex_lock l(mu_);
+  cancelled_ = true;
+  // Unblocks the request in progress, if any.
+  shutdown(fd_, SHUT_RDWR);
+}
+
+StatusOr<std::string> ShmDataTransferClient::GetCompatibilityInfo() const {
+  return HostId();
+}
+
+Status ShmDataTransferClient::CheckCompatibility(
+    const std::string& server_compatibility_info) const {
+  TF_ASSIGN_OR_RETURN(std::string host_id, HostId());
+  if (host_id != server_compatibility_info) {
+    return errors::FailedPrecondition(
+        "The shared memory transfer protocol requires the tf.data service "
+        "worker to be on the same host as the client. The worker is on ",
+        server_compatibility_info, ", while the client is on ", host_id);
+  }
+  return OkStatus();
+}
+
+bool IsShmTransferServerOnThisHost(const DataTransferServerInfo& server) {
+  StatusOr<std::string> host_id = HostId();
+  return host_id.ok() && *host_id == server.compatibility_info();
+}
+
+class ShmTransferRegistrar {
+ public:
+  ShmTransferRegistrar() {
+    DataTransferServer::Register(
+        kShmTransferProtocol,
+        [](DataTransferServer::GetElementT get_element,
+           std::shared_ptr<DataTransferServer>* out) {
+          *out = std::make_shared<ShmDataTransferServer>(get_element);
+          return OkStatus();
+        });
+    DataTransferClient::Register(
+        kShmTransferProtocol, [](DataTransferClient::Config config,
+                                 std::unique_ptr<DataTransferClient>* out) {
+          return ShmDataTransferClient::Create(config.address, out);
+        });
+  }
+};
+static ShmTransferRegistrar shm_transfer_registrar;
+
+}  // namespace data
+}  // namespace tensorflow
+
+#else  // defined(__linux__)
+
+namespace tensorflow {
+namespace data {
+
+bool IsShmTransferServerOnThisHost(const DataTransferServerInfo& server) {
+  return false;
+}
+
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // defined(__linux__)
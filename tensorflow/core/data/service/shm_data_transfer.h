@@ -0,0 +1,127 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_DATA_SERVICE_SHM_DATA_TRANSFER_H_
+#define TENSORFLOW_CORE_DATA_SERVICE_SHM_DATA_TRANSFER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/data/service/common.pb.h"
+#include "tensorflow/core/data/service/data_transfer.h"
+#include "tensorflow/core/data/service/worker.pb.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/statusor.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+
+namespace tensorflow {
+namespace data {
+
+// Transfers elements between a tf.data service worker and a client on the
+// same host through shared memory.
+//
+// Each client connects to the worker's transfer server over a Unix domain
+// socket, which carries the requests and the metadata of the responses. The
+// server writes the tensor data of the elements into a shared memory ring
+// buffer that it creates for the connection, and the client hands the tensors
+// out as views into the ring, without copying or deserializing them. String
+// tensors are views too. Only tensors of other non-`memcpy`able types, such as
+// variants, are serialized. Ring space is released once the client has
+// destroyed every tensor of an element, in any order. Elements that do not fit
+// in the free space of the ring are sent in a shared memory region of their
+// own instead.
+//
+// The server identifies itself by its host in its compatibility info, so
+// clients on other hosts fail the compatibility check and fall back to gRPC.
+// Only supported on Linux.
+constexpr const char kShmTransferProtocol[] = "shm";
+
+// Returns whether the shm transfer server described by `server` is on the
+// host of the calling process, so that clients should prefer it. Always false
+// on platforms other than Linux.
+bool IsShmTransferServerOnThisHost(const DataTransferServerInfo& server);
+
+#if defined(__linux__)
+
+class ShmDataTransferServer : public DataTransferServer {
+ public:
+  static constexpr size_t kDefaultRingBytes = 64 << 20;
+
+  explicit ShmDataTransferServer(GetElementT get_element,
+                                 size_t ring_bytes = kDefaultRingBytes);
+  ~ShmDataTransferServer() override;
+
+  Status Start() override;
+
+  // Returns the id of the server's socket. Clients connect to the server at
+  // "<host>:<id>".
+  int Port() const override { return id_; }
+
+  StatusOr<std::string> GetCompatibilityInfo() const override;
+
+ private:
+  struct Connection;
+
+  void AcceptLoop();
+  void ServeConnection(Connection* connection);
+
+  const GetElementT get_element_;
+  const size_t ring_bytes_;
+  int id_ = 0;
+  int listen_fd_ = -1;
+  std::unique_ptr<Thread> accept_thread_;
+
+  mutex mu_;
+  bool cancelled_ TF_GUARDED_BY(mu_) = false;
+  std::vector<std::unique_ptr<Connection>> connections_ TF_GUARDED_BY(mu_);
+};
+
+class ShmDataTransferClient : public DataTransferClient {
+ public:
+  // Connects to the server at `address`, as advertised by the worker.
+  static Status Create(const std::string& address,
+                       std::unique_ptr<DataTransferClient>* out);
+  ~ShmDataTransferClient() override;
+
+  Status GetElement(const GetElementRequest& req,
+                    GetElementResult& result) override;
+  void TryCancel() override;
+  StatusOr<std::string> GetCompatibilityInfo() const override;
+  Status CheckCompatibility(
+      const std::string& server_compatibility_info) const override;
+
+ private:
+  class Region;
+  class Ring;
+
+  ShmDataTransferClient(int fd, std::shared_ptr<Ring> ring);
+
+  const int fd_;
+  const std::shared_ptr<Ring> ring_;
+
+  // Serializes the requests on the connection.
+  mutex request_mu_;
+  mutex mu_;
+  bool cancelled_ TF_GUARDED_BY(mu_) = false;
+};
+
+#endif  // defined(__linux__)
+
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DATA_SERVICE_SHM_DATA_TRANSFER_H_
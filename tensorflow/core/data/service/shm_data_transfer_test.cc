@@ -0,0 +1,200 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/service/shm_data_transfer.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/data/service/data_transfer.h"
+#include "tensorflow/core/data/service/worker.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/status_matchers.h"
+#include "tensorflow/core/platform/test.h"
+
+#if defined(__linux__)
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+using ::tensorflow::testing::StatusIs;
+using ::testing::HasSubstr;
+
+// Returns elements whose components are filled with the element index.
+Status GetTestElement(int64_t size, const GetElementRequest* request,
+                      GetElementResult* result) {
+  static std::atomic<int64_t> next_index{0};
+  const int64_t index = next_index++;
+  result->element_index = index;
+  result->components.push_back(
+      test::AsTensor<int64_t>(std::vector<int64_t>(size, index)));
+  result->components.push_back(test::AsTensor<tstring>(
+      {"a", tstring(size, 'b'), ""}, TensorShape({3})));
+  result->components.push_back(Tensor(DT_FLOAT, TensorShape({0, 2})));
+  return OkStatus();
+}
+
+void ExpectTestElement(const GetElementResult& result, int64_t size) {
+  ASSERT_EQ(result.components.size(), 3);
+  test::ExpectEqual(result.components[0],
+                    test::AsTensor<int64_t>(std::vector<int64_t>(
+                        size, result.element_index)));
+  test::ExpectEqual(result.components[1],
+                    test::AsTensor<tstring>({"a", tstring(size, 'b'), ""},
+                                            TensorShape({3})));
+  EXPECT_EQ(result.components[2].shape(), TensorShape({0, 2}));
+}
+
+class ShmDataTransferTest : public ::testing::Test {
+ protected:
+  void StartServer(DataTransferServer::GetElementT get_element,
+                   size_t ring_bytes) {
+    server_ = std::make_shared<ShmDataTransferServer>(get_element, ring_bytes);
+    TF_ASSERT_OK(server_->Start());
+    TF_ASSERT_OK(DataTransferClient::Build(
+        kShmTransferProtocol,
+        {/*protocol=*/"grpc", absl::StrCat("localhost:", server_->Port())},
+        &client_));
+    TF_ASSERT_OK_AND_ASSIGN(std::string compatibility_info,
+                            server_->GetCompatibilityInfo());
+    TF_ASSERT_OK(client_->CheckCompatibility(compatibility_info));
+  }
+
+  std::shared_ptr<DataTransferServer> server_;
+  std::unique_ptr<DataTransferClient> client_;
+};
+
+TEST_F(ShmDataTransferTest, GetElements) {
+  StartServer(
+      [](const GetElementRequest* request, GetElementResult* result) {
+        return GetTestElement(/*size=*/100, request, result);
+      },
+      ShmDataTransferServer::kDefaultRingBytes);
+  for (int i = 0; i < 100; ++i) {
+    GetElementResult result;
+    TF_ASSERT_OK(client_->GetElement(GetElementRequest(), result));
+    ExpectTestElement(result, /*size=*/100);
+  }
+}
+
+TEST_F(ShmDataTransferTest, ElementsOutliveTheRing) {
+  // Each element takes about a quarter of the ring, so holding on to them
+  // sends the later ones in regions of their own.
+  constexpr int64_t kSize = 2048;
+  StartServer(
+      [](const GetElementRequest* request, GetElementResult* result) {
+        return GetTestElement(kSize, request, result);
+      },
+      /*ring_bytes=*/64 << 10);
+  std::vector<GetElementResult> results(10);
+  for (int round = 0; round < 3; ++round) {
+    for (GetElementResult& result : results) {
+      result = GetElementResult();
+      TF_ASSERT_OK(client_->GetElement(GetElementRequest(), result));
+    }
+    for (const GetElementResult& result : results) {
+      ExpectTestElement(result, kSize);
+    }
+  }
+  client_.reset();
+  server_.reset();
+  // The tensors remain valid after the connection is gone.
+  for (const GetElementResult& result : results) {
+    ExpectTestElement(result, kSize);
+  }
+}
+
+TEST_F(ShmDataTransferTest, EndOfSequence) {
+  StartServer(
+      [](const GetElementRequest* request, GetElementResult* result) {
+        result->end_of_sequence = true;
+        return OkStatus();
+      },
+      ShmDataTransferServer::kDefaultRingBytes);
+  GetElementResult result;
+  TF_ASSERT_OK(client_->GetElement(GetElementRequest(), result));
+  EXPECT_TRUE(result.end_of_sequence);
+  EXPECT_TRUE(result.components.empty());
+}
+
+TEST_F(ShmDataTransferTest, Error) {
+  StartServer(
+      [](const GetElementRequest* request, GetElementResult* result) {
+        return errors::NotFound("No task ", request->task_id());
+      },
+      ShmDataTransferServer::kDefaultRingBytes);
+  GetElementRequest request;
+  request.set_task_id(42);
+  GetElementResult result;
+  EXPECT_THAT(client_->GetElement(request, result),
+              StatusIs(error::NOT_FOUND, HasSubstr("No task 42")));
+}
+
+TEST_F(ShmDataTransferTest, Cancel) {
+  StartServer(
+      [](const GetElementRequest* request, GetElementResult* result) {
+        return GetTestElement(/*size=*/1, request, result);
+      },
+      ShmDataTransferServer::kDefaultRingBytes);
+  client_->TryCancel();
+  GetElementResult result;
+  EXPECT_THAT(client_->GetElement(GetElementRequest(), result),
+              StatusIs(error::CANCELLED));
+}
+
+TEST_F(ShmDataTransferTest, OtherHost) {
+  StartServer(
+      [](const GetElementRequest* request, GetElementResult* result) {
+        return GetTestElement(/*size=*/1, request, result);
+      },
+      ShmDataTransferServer::kDefaultRingBytes);
+  EXPECT_THAT(client_->CheckCompatibility("other_host"),
+              StatusIs(error::FAILED_PRECONDITION,
+                       HasSubstr("to be on the same host")));
+}
+
+TEST_F(ShmDataTransferTest, IsShmTransferServerOnThisHost) {
+  StartServer(
+      [](const GetElementRequest* request, GetElementResult* result) {
+        return GetTestElement(/*size=*/1, request, result);
+      },
+      ShmDataTransferServer::kDefaultRingBytes);
+  DataTransferServerInfo server_info;
+  server_info.set_protocol(kShmTransferProtocol);
+  TF_ASSERT_OK_AND_ASSIGN(*server_info.mutable_compatibility_info(),
+                          server_->GetCompatibilityInfo());
+  EXPECT_TRUE(IsShmTransferServerOnThisHost(server_info));
+  server_info.set_compatibility_info("other_host");
+  EXPECT_FALSE(IsShmTransferServerOnThisHost(server_info));
+}
+
+TEST(ShmDataTransferClientTest, NoServer) {
+  std::unique_ptr<DataTransferClient> client;
+  EXPECT_THAT(DataTransferClient::Build(kShmTransferProtocol,
+                                        {/*protocol=*/"grpc", "localhost:0"},
+                                        &client),
+              StatusIs(error::UNAVAILABLE));
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // defined(__linux__)
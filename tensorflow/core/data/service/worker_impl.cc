@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/data/service/worker_impl.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <memory>
 #include <optional>
@@ -25,12 +26,15 @@ limitations under the License.
 #include "absl/algorithm/container.h"
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
 #include "absl/strings/string_view.h"
 #include "absl/strings/substitute.h"
 #include "absl/time/time.h"
+#include "tensorflow/core/data/hash_utils.h"
 #include "tensorflow/core/data/service/common.h"
 #include "tensorflow/core/data/service/common.pb.h"
+#include "tensorflow/core/data/service/cross_job_cache.h"
 #include "tensorflow/core/data/service/data_transfer.h"
 #include "tensorflow/core/data/service/dispatcher.pb.h"
 #include "tensorflow/core/data/service/dispatcher_client.h"
@@ -159,6 +163,16 @@ LocalWorkers::AddressToWorkerMap* LocalWorkers::local_workers_ =
 DataServiceWorkerImpl::DataServiceWorkerImpl(const WorkerConfig& config)
     : config_(ApplyWorkerDefaults(config)), worker_uid_(port::JobUid()) {
   metrics::RecordTFDataServiceWorkerCreated();
+  if (config_.cross_job_cache_size_bytes() > 0) {
+    CrossJobCache::Options options;
+    options.max_size_bytes = config_.cross_job_cache_size_bytes();
+    options.eviction_policy = config_.cross_job_cache_eviction_policy();
+    options.spill_directory = config_.cross_job_cache_spill_directory();
+    options.max_spill_size_bytes =
+        std::max<int64_t>(config_.cross_job_cache_spill_size_bytes(), 0);
+    cross_job_cache_ =
+        std::make_unique<CrossJobCache>(Env::Default(), std::move(options));
+  }
 }
 
 DataServiceWorkerImpl::~DataServiceWorkerImpl() {
@@ -234,6 +248,13 @@ Status DataServiceWorkerImpl::ValidateWorkerConfig() const {
                       config_.worker_tags().end(), ", "),
         "}");
   }
+  if (config_.cross_job_cache_size_bytes() < 0 ||
+      config_.cross_job_cache_spill_size_bytes() < 0) {
+    return errors::FailedPrecondition(
+        "Cross-job cache sizes cannot be negative. Got cache size ",
+        config_.cross_job_cache_size_bytes(), " and spill size ",
+        config_.cross_job_cache_spill_size_bytes(), ".");
+  }
   return OkStatus();
 }
 
@@ -343,12 +364,10 @@ Status DataServiceWorkerImpl::EnsureTaskInitialized(
     return OkStatus();
   }
   TF_ASSIGN_OR_RETURN(DatasetDef dataset_def, GetDatasetDef(task.task_def));
-  TF_ASSIGN_OR_RETURN(std::unique_ptr<standalone::Dataset> dataset,
-                      MakeDataset(dataset_def, task.task_def));
-  TF_ASSIGN_OR_RETURN(std::unique_ptr<standalone::Iterator> iterator,
-                      MakeDatasetIterator(*dataset, task.task_def));
-  auto task_iterator = std::make_unique<StandaloneTaskIterator>(
-      std::move(dataset), std::move(iterator));
+  TF_ASSIGN_OR_RETURN(GraphDef graph,
+                      MakeDatasetGraph(dataset_def, task.task_def));
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<TaskIterator> task_iterator,
+                      MakeTaskIterator(graph, task.task_def));
   TF_RETURN_IF_ERROR(TaskRunner::Create(
       config_, task.task_def, std::move(task_iterator), task.task_runner));
 
@@ -405,9 +424,8 @@ StatusOr<bool> DataServiceWorkerImpl::DisableCompressionAtRuntime(
   return response.compression_disabled_at_runtime();
 }
 
-StatusOr<std::unique_ptr<standalone::Dataset>>
-DataServiceWorkerImpl::MakeDataset(const DatasetDef& dataset_def,
-                                   const TaskDef& task_def) const {
+StatusOr<GraphDef> DataServiceWorkerImpl::MakeDatasetGraph(
+    const DatasetDef& dataset_def, const TaskDef& task_def) const {
   TF_ASSIGN_OR_RETURN(bool compression_disabled_at_runtime,
                       DisableCompressionAtRuntime(task_def.dataset_id()));
   GraphDef graph = dataset_def.graph();
@@ -426,10 +444,53 @@ DataServiceWorkerImpl::MakeDataset(const DatasetDef& dataset_def,
                       AutoShardRewriter::Create(task_def));
   // `ApplyAutoShardRewrite` does nothing if auto-sharding is disabled.
   TF_ASSIGN_OR_RETURN(graph, auto_shard_rewriter.ApplyAutoShardRewrite(graph));
+  return graph;
+}
+
+StatusOr<std::unique_ptr<TaskIterator>> DataServiceWorkerImpl::MakeTaskIterator(
+    const GraphDef& graph, const TaskDef& task_def) const {
+  // With dynamic sharding, the elements of a task depend on the splits it is
+  // assigned, so only the outputs of unsharded or statically sharded tasks are
+  // cached. The rewritten graph determines the shard of the task. Datasets
+  // with random ops would replay the same "random" elements, so they are not
+  // cached either.
+  std::string cache_key;
+  if (cross_job_cache_ != nullptr &&
+      (IsNoShard(task_def.processing_mode_def()) ||
+       IsStaticShard(task_def.processing_mode_def()))) {
+    uint64 fingerprint;
+    Status status = CheckCrossJobCacheable(graph);
+    if (status.ok()) {
+      status = HashGraph(graph, &fingerprint);
+    }
+    if (status.ok()) {
+      cache_key = absl::StrFormat("%016x", fingerprint);
+      TF_ASSIGN_OR_RETURN(std::unique_ptr<TaskIterator> cached_iterator,
+                          cross_job_cache_->Lookup(cache_key));
+      if (cached_iterator != nullptr) {
+        VLOG(1) << "Task " << task_def.task_id() << " replays dataset "
+                << cache_key << " from the cross-job cache.";
+        return cached_iterator;
+      }
+    } else {
+      VLOG(1) << "Not caching the output of task " << task_def.task_id()
+              << " across jobs: " << status;
+    }
+  }
+
   std::unique_ptr<standalone::Dataset> dataset;
   TF_RETURN_IF_ERROR(standalone::Dataset::FromGraph(
       standalone::Dataset::Params(), graph, &dataset));
-  return dataset;
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<standalone::Iterator> iterator,
+                      MakeDatasetIterator(*dataset, task_def));
+  std::unique_ptr<TaskIterator> task_iterator =
+      std::make_unique<StandaloneTaskIterator>(std::move(dataset),
+                                               std::move(iterator));
+  if (!cache_key.empty()) {
+    task_iterator = cross_job_cache_->MakeCachingIterator(
+        cache_key, std::move(task_iterator));
+  }
+  return task_iterator;
 }
 
 StatusOr<std::unique_ptr<standalone::Iterator>>
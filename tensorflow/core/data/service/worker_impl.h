@@ -26,6 +26,7 @@ limitations under the License.
 #include "absl/hash/hash.h"
 #include "absl/strings/string_view.h"
 #include "tensorflow/core/data/service/common.pb.h"
+#include "tensorflow/core/data/service/cross_job_cache.h"
 #include "tensorflow/core/data/service/data_transfer.h"
 #include "tensorflow/core/data/service/dispatcher_client.h"
 #include "tensorflow/core/data/service/export.pb.h"
@@ -34,6 +35,7 @@ limitations under the License.
 #include "tensorflow/core/data/service/worker.pb.h"
 #include "tensorflow/core/data/standalone.h"
 #include "tensorflow/core/framework/cancellation.h"
+#include "tensorflow/core/framework/graph.pb.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/status.h"
@@ -165,9 +167,14 @@ class DataServiceWorkerImpl {
   std::vector<SnapshotTaskProgress> GetSnapshotTaskProgress() const;
   // Gets the DatasetDef for `task_def`.
   StatusOr<DatasetDef> GetDatasetDef(const TaskDef& task_def) const;
-  // Creates a dataset from `dataset_def`.
-  StatusOr<std::unique_ptr<standalone::Dataset>> MakeDataset(
-      const DatasetDef& dataset_def, const TaskDef& task_def) const;
+  // Applies the runtime rewrites for `task_def` to the graph of
+  // `dataset_def`.
+  StatusOr<GraphDef> MakeDatasetGraph(const DatasetDef& dataset_def,
+                                      const TaskDef& task_def) const;
+  // Creates an iterator over the dataset `graph` for `task_def`. The iterator
+  // replays the cross-job cache if it holds the output of `graph`.
+  StatusOr<std::unique_ptr<TaskIterator>> MakeTaskIterator(
+      const GraphDef& graph, const TaskDef& task_def) const;
   // Creates an iterator for `dataset`.
   StatusOr<std::unique_ptr<standalone::Iterator>> MakeDatasetIterator(
       standalone::Dataset& dataset, const TaskDef& task_def) const;
@@ -181,6 +188,9 @@ class DataServiceWorkerImpl {
   // The data transfer servers available to worker clients.
   std::vector<DataTransferServerInfo> transfer_servers_;
   std::unique_ptr<DataServiceDispatcherClient> dispatcher_;
+  // Cache of task outputs shared across jobs, or nullptr if disabled. It is
+  // declared before `tasks_` since the tasks' iterators refer to it.
+  std::unique_ptr<CrossJobCache> cross_job_cache_;
 
   mutable mutex mu_;
   condition_variable cv_;
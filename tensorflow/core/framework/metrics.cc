@@ -214,6 +214,20 @@ auto* tf_data_service_cross_trainer_cache_size_bytes =
         "/tensorflow/data/service/cross_trainer_cache_size_bytes",
         "tf.data service cross-trainer cache memory usage in bytes.");
 
+auto* tf_data_service_cross_job_cache_queries_counter =
+    tsl::monitoring::Counter<1>::New(
+        "/tensorflow/data/service/cross_job_cache_queries",
+        "tf.data service cross-job cache queries counter. The result can be "
+        "hit or miss.",
+        "cache_hit");
+
+auto* tf_data_service_cross_job_cache_size_bytes =
+    tsl::monitoring::Gauge<int64_t, 1>::New(
+        "/tensorflow/data/service/cross_job_cache_size_bytes",
+        "tf.data service cross-job cache usage in bytes. The storage can be "
+        "memory or disk.",
+        "storage");
+
 auto* tf_data_service_snapshot_bytes_committed =
     tsl::monitoring::Counter<0>::New(
         "/tensorflow/data/service/snapshot_bytes_committed",
@@ -627,6 +641,20 @@ void RecordTFDataServiceCrossTrainerCacheSizeBytes(size_t bytes) {
       static_cast<int64_t>(bytes));
 }
 
+void RecordTFDataServiceCrossJobCacheQuery(bool cache_hit) {
+  std::string cache_hit_str = cache_hit ? "true" : "false";
+  tf_data_service_cross_job_cache_queries_counter->GetCell(cache_hit_str)
+      ->IncrementBy(1);
+}
+
+void RecordTFDataServiceCrossJobCacheSizeBytes(size_t memory_bytes,
+                                               size_t spilled_bytes) {
+  tf_data_service_cross_job_cache_size_bytes->GetCell("memory")->Set(
+      static_cast<int64_t>(memory_bytes));
+  tf_data_service_cross_job_cache_size_bytes->GetCell("disk")->Set(
+      static_cast<int64_t>(spilled_bytes));
+}
+
 void RecordTFDataServiceSnapshotBytesCommitted(int64_t bytes) {
   tf_data_service_snapshot_bytes_committed->GetCell()->IncrementBy(bytes);
 }
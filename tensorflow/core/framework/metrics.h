@@ -181,6 +181,13 @@ void RecordTFDataServiceCrossTrainerCacheQuery(bool cache_hit);
 // Records tf.data service cross-trainer cache memory usage in bytes.
 void RecordTFDataServiceCrossTrainerCacheSizeBytes(size_t bytes);
 
+// Records tf.data service cross-job cache queries.
+void RecordTFDataServiceCrossJobCacheQuery(bool cache_hit);
+
+// Records tf.data service cross-job cache memory and disk usage in bytes.
+void RecordTFDataServiceCrossJobCacheSizeBytes(size_t memory_bytes,
+                                               size_t spilled_bytes);
+
 // Records tf.data distributed snapshot bytes committed.
 void RecordTFDataServiceSnapshotBytesCommitted(int64_t bytes);
 
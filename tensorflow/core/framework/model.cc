@@ -64,6 +64,20 @@ constexpr double kBufferDownsizeMultipliter = 0.9;
 // upsizing.
 constexpr int64_t kBufferLowWatermarkThreshold = 2;
 
+// In empirical optimization, the weight of the throughput samples recorded
+// before an optimization round is multiplied by this factor, so that the curves
+// follow changes in contention.
+constexpr double kThroughputSampleDecay = 0.8;
+// In empirical optimization, samples with a smaller weight are dropped.
+constexpr double kMinThroughputSampleWeight = 1.0;
+// In empirical optimization, a thread is only added to a node if it is
+// predicted to reduce the time to produce an element by at least this
+// fraction.
+constexpr double kMinThroughputImprovement = 0.05;
+// In empirical optimization, buffers are grown up to this multiple of the
+// parallelism of their node with the RAM left over.
+constexpr double kMaxBufferToParallelismRatio = 2.0;
+
 constexpr char kDataService[] = "DataService";
 constexpr char kFlatMap[] = "FlatMap";
 constexpr char kInterleave[] = "Interleave";
@@ -2351,6 +2365,10 @@ void Model::Optimize(AutotuneAlgorithm algorithm,
       OptimizeStageBased(snapshot, optimization_params, cancellation_manager,
                          ram_budget_manager);
       break;
+    case AutotuneAlgorithm::EMPIRICAL:
+      OptimizeEmpirical(snapshot, optimization_params, cancellation_manager,
+                        ram_budget_manager);
+      break;
     default:
       VLOG(2) << "Autotuning algorithm was not recognized. Aborting "
                  "optimization.";
@@ -2527,10 +2545,11 @@ Status Model::OptimizeLoop(AutotuneAlgorithm algorithm,
     int64_t start_ms = EnvTime::NowMicros() / EnvTime::kMillisToMicros;
     double model_input_time = 0.0;
     // Model input time is set to 0 for all optimization algorithms except for
-    // stage-based optimization algorithm for historical reason. In stage-based
-    // optimization algorithm, the model input time is used as a target
+    // stage-based and empirical optimization algorithms for historical reason.
+    // In these algorithms, the model input time is used as a target
     // optimization time of all stages in the pipeline.
-    if (algorithm == AutotuneAlgorithm::STAGE_BASED) {
+    if (algorithm == AutotuneAlgorithm::STAGE_BASED ||
+        algorithm == AutotuneAlgorithm::EMPIRICAL) {
       model_input_time = ComputeTargetTimeNsec();
     }
     Optimize(algorithm, cpu_budget_func, ram_budget_share, fixed_ram_budget,
@@ -2974,6 +2993,29 @@ void Model::OptimizeStageBasedNonAsyncInterleaveManyNodes(
   }
 }
 
+void Model::OptimizeEmpirical(std::shared_ptr<Node> snapshot,
+                              const OptimizationParams& optimization_params,
+                              CancellationManager* cancellation_manager,
+                              RamBudgetManager& ram_budget_manager) {
+  VLOG(2) << "Starting optimization of tunable parameters with empirical "
+             "throughput curves with a target time of "
+          << optimization_params.model_input_time() << " nanoseconds.";
+  ModelParameters parameters = CollectTunableParameters(snapshot);
+  {
+    mutex_lock l(throughput_curves_mu_);
+    throughput_curves_.RecordSnapshot(snapshot);
+    throughput_curves_.Optimize(snapshot, optimization_params,
+                                cancellation_manager);
+  }
+  if (cancellation_manager->IsCancelled()) {
+    return;
+  }
+  if (ram_budget_manager.RequestModelAllocation(
+          TotalMaximumBufferedBytes(snapshot))) {
+    UpdateStateValues(&parameters);
+  }
+}
+
 void Model::OptimizeBuffers(std::shared_ptr<Node> snapshot,
                             int64_t ram_budget) {
   VLOG(2) << "Starting optimization of buffer_size parameters.";
@@ -3453,6 +3495,240 @@ std::vector<std::shared_ptr<Node>> ModelTiming::GetStageNodes(
   return CollectNodes(stage_root, TraversalOrder::BFS, IsSyncNode);
 }
 
+void ThroughputCurves::RecordSnapshot(std::shared_ptr<Node> snapshot) {
+  Node::NodeVector nodes =
+      snapshot->CollectNodes(TraversalOrder::BFS, IsAnyNode);
+  nodes.push_back(snapshot);
+  for (auto& [id, curve] : curves_) {
+    for (auto it = curve.samples.begin(); it != curve.samples.end();) {
+      it->second.first *= kThroughputSampleDecay;
+      it->second.second *= kThroughputSampleDecay;
+      if (it->second.first < kMinThroughputSampleWeight) {
+        curve.samples.erase(it++);
+      } else {
+        ++it;
+      }
+    }
+  }
+  NodeParallelismParameters node_parallelism;
+  for (const auto& node : nodes) {
+    Parameter* parallelism = node_parallelism.Get(node.get());
+    if (parallelism == nullptr || !node->autotune()) {
+      continue;
+    }
+    Curve& curve = curves_[node->id()];
+    const int64_t num_elements = node->num_elements();
+    const int64_t processing_time = node->processing_time();
+    const int64_t delta_elements = num_elements - curve.num_elements;
+    const int64_t delta_processing_time =
+        processing_time - curve.processing_time;
+    curve.num_elements = num_elements;
+    curve.processing_time = processing_time;
+    if (delta_elements <= 0 || delta_processing_time <= 0) {
+      continue;
+    }
+    // The samples are attributed to the parallelism that the pipeline ran
+    // with, which is the state value rather than the value being tuned.
+    double value = parallelism->value;
+    if (parallelism->state != nullptr) {
+      tf_shared_lock l(*parallelism->state->mu);
+      if (parallelism->state->value != kAutotune) {
+        value = parallelism->state->value;
+      }
+    }
+    std::pair<double, double>& sample =
+        curve.samples[std::max<int64_t>(1, std::round(value))];
+    sample.first += delta_elements;
+    sample.second += delta_processing_time;
+    Fit(curve);
+  }
+}
+
+void ThroughputCurves::Fit(Curve& curve) {
+  // Weighted least squares of the per-element processing time against
+  // `p - 1`, weighted by the number of elements.
+  double sum_w = 0.0, sum_x = 0.0, sum_y = 0.0, sum_xx = 0.0, sum_xy = 0.0;
+  for (const auto& [parallelism, sample] : curve.samples) {
+    const double w = sample.first;
+    const double x = parallelism - 1;
+    const double y = sample.second / sample.first;
+    sum_w += w;
+    sum_x += w * x;
+    sum_y += w * y;
+    sum_xx += w * x * x;
+    sum_xy += w * x * y;
+  }
+  if (sum_w <= 0.0) {
+    curve.processing_time_at_one = 0.0;
+    curve.slope = 0.0;
+    return;
+  }
+  const double mean_y = sum_y / sum_w;
+  const double variance_x = sum_xx * sum_w - sum_x * sum_x;
+  double slope = 0.0;
+  if (curve.samples.size() > 1 && variance_x > 0.0) {
+    slope = (sum_xy * sum_w - sum_x * sum_y) / variance_x;
+  }
+  double processing_time_at_one = (sum_y - slope * sum_x) / sum_w;
+  // Additional threads are not expected to make each element faster, and the
+  // processing time must remain positive, so fall back to a flat curve
+  // otherwise.
+  if (slope < 0.0 || processing_time_at_one <= 0.0) {
+    slope = 0.0;
+    processing_time_at_one = mean_y;
+  }
+  curve.processing_time_at_one = processing_time_at_one;
+  curve.slope = slope;
+}
+
+std::optional<double> ThroughputCurves::PredictProcessingTimeNsec(
+    int64_t node_id, double parallelism) const {
+  auto it = curves_.find(node_id);
+  if (it == curves_.end() || it->second.samples.empty()) {
+    return std::nullopt;
+  }
+  return it->second.processing_time_at_one +
+         it->second.slope * (std::max(1.0, parallelism) - 1);
+}
+
+void ThroughputCurves::Optimize(
+    std::shared_ptr<Node> snapshot,
+    const ModelProto::OptimizationParams& optimization_params,
+    CancellationManager* cancellation_manager) const {
+  struct Candidate {
+    Node* node;
+    Parameter* parallelism;
+    Parameter* buffer_size;
+    double pipeline_ratio;
+  };
+  Node::NodeVector nodes =
+      snapshot->CollectNodes(TraversalOrder::BFS, IsAnyNode);
+  nodes.push_back(snapshot);
+  ModelTiming model_timing(snapshot);
+  std::vector<Candidate> candidates;
+  double total_parallelism = 0.0;
+  for (const auto& node : nodes) {
+    if (!node->autotune()) {
+      continue;
+    }
+    Parameter* parallelism = nullptr;
+    Parameter* buffer_size = nullptr;
+    for (auto& [node_name, parameter] : node->CollectNodeTunableParameters()) {
+      if (parameter->name == kParallelism) {
+        parallelism = parameter.get();
+      } else if (parameter->name == kBufferSize) {
+        buffer_size = parameter.get();
+      }
+    }
+    if (parallelism == nullptr) {
+      continue;
+    }
+    const ModelTiming::NodeTiming* timing = model_timing.GetTiming(node.get());
+    if (timing == nullptr || timing->pipeline_ratio <= 0.0 ||
+        !PredictProcessingTimeNsec(node->id(), 1).has_value()) {
+      // Without samples, the node keeps the parallelism it runs with.
+      total_parallelism += parallelism->value;
+      continue;
+    }
+    parallelism->value = parallelism->min;
+    if (buffer_size != nullptr) {
+      buffer_size->value =
+          std::max(buffer_size->min,
+                   std::min(buffer_size->max, parallelism->value));
+    }
+    total_parallelism += parallelism->value;
+    candidates.push_back(
+        {node.get(), parallelism, buffer_size, timing->pipeline_ratio});
+  }
+  if (candidates.empty()) {
+    return;
+  }
+
+  // Returns the time in nanoseconds that `candidate` takes to produce the
+  // elements needed for one element of the root with `parallelism` threads.
+  auto stage_time = [this](const Candidate& candidate, double parallelism) {
+    return candidate.pipeline_ratio *
+           *PredictProcessingTimeNsec(candidate.node->id(), parallelism) /
+           parallelism;
+  };
+  const double ram_budget = optimization_params.ram_budget();
+  while (!cancellation_manager->IsCancelled()) {
+    Candidate* slowest = &candidates[0];
+    for (Candidate& candidate : candidates) {
+      if (stage_time(candidate, candidate.parallelism->value) >
+          stage_time(*slowest, slowest->parallelism->value)) {
+        slowest = &candidate;
+      }
+    }
+    const double parallelism = slowest->parallelism->value;
+    const double time = stage_time(*slowest, parallelism);
+    const std::string node_name =
+        RemoveArrayIndices(slowest->node->long_name());
+    if (time <= optimization_params.model_input_time()) {
+      metrics::RecordTFDataAutotuneStoppingCriteria("target_time_reached");
+      break;
+    }
+    if (parallelism + 1 > slowest->parallelism->max) {
+      metrics::RecordTFDataAutotuneStoppingCriteria(
+          strings::StrCat("parameter_max_exceeded:", node_name));
+      break;
+    }
+    if (total_parallelism + 1 > optimization_params.cpu_budget()) {
+      metrics::RecordTFDataAutotuneStoppingCriteria("cpu_budget_exceeded");
+      break;
+    }
+    if (stage_time(*slowest, parallelism + 1) >
+        time * (1.0 - kMinThroughputImprovement)) {
+      metrics::RecordTFDataAutotuneStoppingCriteria(
+          strings::StrCat("throughput_saturated:", node_name));
+      break;
+    }
+    slowest->parallelism->value += 1.0;
+    const double buffer_size =
+        slowest->buffer_size ? slowest->buffer_size->value : 0.0;
+    if (slowest->buffer_size != nullptr) {
+      slowest->buffer_size->value =
+          std::max(buffer_size, std::min(slowest->buffer_size->max,
+                                         slowest->parallelism->value));
+    }
+    if (snapshot->TotalMaximumBufferedBytes() > ram_budget) {
+      slowest->parallelism->value -= 1.0;
+      if (slowest->buffer_size != nullptr) {
+        slowest->buffer_size->value = buffer_size;
+      }
+      metrics::RecordTFDataAutotuneStoppingCriteria(
+          strings::StrCat("ram_budget_exceeded:", node_name));
+      return;
+    }
+    total_parallelism += 1.0;
+  }
+
+  // Spend the RAM left over on the buffers of the slowest nodes first, which
+  // absorb the variance of their processing time.
+  std::sort(candidates.begin(), candidates.end(),
+            [&stage_time](const Candidate& a, const Candidate& b) {
+              return stage_time(a, a.parallelism->value) >
+                     stage_time(b, b.parallelism->value);
+            });
+  for (Candidate& candidate : candidates) {
+    if (candidate.buffer_size == nullptr) {
+      continue;
+    }
+    const double max_buffer_size =
+        std::min(candidate.buffer_size->max,
+                 std::round(kMaxBufferToParallelismRatio *
+                            candidate.parallelism->value));
+    while (!cancellation_manager->IsCancelled() &&
+           candidate.buffer_size->value + 1 <= max_buffer_size) {
+      candidate.buffer_size->value += 1.0;
+      if (snapshot->TotalMaximumBufferedBytes() > ram_budget) {
+        candidate.buffer_size->value -= 1.0;
+        return;
+      }
+    }
+  }
+}
+
 }  // namespace model
 }  // namespace data
 }  // namespace tensorflow
@@ -175,7 +175,7 @@ class RamBudgetManager {
   // Returns whether the request succeeded.
   bool RequestModelAllocation(int64_t total_bytes) {
     mutex_lock l(mu_);
-    if (total_bytes > budget_ - legacy_prefetch_allocated_) {
+    if (total_bytes > budget_ - legacy_prefetch_allocated_ - cache_allocated_) {
       return false;
     }
     model_allocated_ = total_bytes;
@@ -195,7 +195,8 @@ class RamBudgetManager {
     // memory.
     if (delta_elements > 0) {
       int64_t max_delta_elements = static_cast<int64_t>(
-          (budget_ - legacy_prefetch_allocated_ - model_allocated_) /
+          (budget_ - legacy_prefetch_allocated_ - cache_allocated_ -
+           model_allocated_) /
           element_size);
       if (max_delta_elements < 0) {
         return 0;
@@ -218,17 +219,35 @@ class RamBudgetManager {
   // request. If not, no bytes are allocated.
   bool RequestLegacyPrefetchBytes(int64_t delta_bytes) {
     mutex_lock l(mu_);
-    if (delta_bytes > budget_ - legacy_prefetch_allocated_ - model_allocated_) {
+    if (delta_bytes > budget_ - legacy_prefetch_allocated_ - cache_allocated_ -
+                          model_allocated_) {
       return false;
     }
     legacy_prefetch_allocated_ += delta_bytes;
     return true;
   }
 
+  // Requests `delta_bytes` additional bytes for the elements that `cache()`
+  // keeps in memory. `delta_bytes` can be negative to release bytes.
+  //
+  // Returns whether there were enough bytes left in the budget to serve the
+  // request. If not, no bytes are allocated. Releases always succeed, even if
+  // `UpdateBudget()` has shrunk the budget below the allocated bytes.
+  bool RequestCacheBytes(int64_t delta_bytes) {
+    mutex_lock l(mu_);
+    if (delta_bytes > 0 &&
+        delta_bytes > budget_ - legacy_prefetch_allocated_ - cache_allocated_ -
+                          model_allocated_) {
+      return false;
+    }
+    cache_allocated_ += delta_bytes;
+    return true;
+  }
+
   // The total number of bytes that the model could potentially use.
   int64_t AvailableModelRam() const {
     tf_shared_lock l(mu_);
-    return budget_ - legacy_prefetch_allocated_;
+    return budget_ - legacy_prefetch_allocated_ - cache_allocated_;
   }
 
   void UpdateBudget(int64_t budget) {
@@ -241,6 +260,7 @@ class RamBudgetManager {
     mutex_lock l(mu_);
     return absl::StrCat("RamBudgetManager: budget_: ", budget_,
                         " prefetch allocated: ", legacy_prefetch_allocated_,
+                        " cache allocated: ", cache_allocated_,
                         " model allocated: ", model_allocated_);
   }
 
@@ -249,6 +269,8 @@ class RamBudgetManager {
   int64_t budget_ TF_GUARDED_BY(mu_) = 0;
   // Number of bytes allocated by legacy prefetch autotuner.
   int64_t legacy_prefetch_allocated_ TF_GUARDED_BY(mu_) = 0;
+  // Number of bytes allocated by in-memory caches.
+  int64_t cache_allocated_ TF_GUARDED_BY(mu_) = 0;
   // Number of bytes allocated by the model.
   int64_t model_allocated_ TF_GUARDED_BY(mu_) = 0;
 };
@@ -895,6 +917,63 @@ std::shared_ptr<Node> MakeAsyncUnknownRatioNode(
 // as pass-through between inputs and output.
 std::shared_ptr<Node> MakeUnknownNode(Node::Args args);
 
+// Empirical curves of the per-element processing time of the nodes with a
+// tunable `parallelism` parameter, as a function of their parallelism. The
+// curves are fit to the metrics of successive model snapshots. Because the
+// samples are measured while the input pipeline runs next to the training
+// step, they include the slowdown from CPU contention that the analytic
+// `OutputTime` model does not account for.
+//
+// The per-element processing time of a node is modeled as
+// `t(p) = t(1) + slope * (p - 1)`, fit with weighted least squares. A node with
+// parallelism `p` then produces an element every `t(p) / p` nanoseconds, which
+// stops improving once the contention of an additional thread outweighs its
+// work.
+//
+// The class is not thread-safe.
+class ThroughputCurves {
+ public:
+  // Adds the samples recorded by the nodes of `snapshot` since the previous
+  // call, attributing them to the parallelism that the nodes ran with.
+  void RecordSnapshot(std::shared_ptr<Node> snapshot);
+
+  // Returns the predicted per-element processing time in nanoseconds of the
+  // node with the given id at `parallelism`, or `std::nullopt` if there are no
+  // samples for the node.
+  std::optional<double> PredictProcessingTimeNsec(int64_t node_id,
+                                                  double parallelism) const;
+
+  // Sets the `parallelism` and `buffer_size` parameter values of the nodes of
+  // `snapshot` that have samples. Starting from the minimum parallelism, it
+  // repeatedly adds a thread to the slowest node until the node meets the
+  // target time of `optimization_params`, the curve predicts no significant
+  // improvement, or the CPU or RAM budget would be exceeded. The buffers of
+  // the nodes are kept at least as large as their parallelism, and the RAM
+  // left over is spent on the buffers of the slowest nodes. Only parameter
+  // values are updated; the caller is responsible for the state values.
+  void Optimize(std::shared_ptr<Node> snapshot,
+                const ModelProto::OptimizationParams& optimization_params,
+                CancellationManager* cancellation_manager) const;
+
+ private:
+  struct Curve {
+    // The cumulative metrics of the node at the previous snapshot.
+    int64_t num_elements = 0;
+    int64_t processing_time = 0;
+    // The decayed number of elements and their processing time, by the
+    // parallelism they were produced with.
+    absl::flat_hash_map<int64_t, std::pair<double, double>> samples;
+    // The fitted curve.
+    double processing_time_at_one = 0.0;
+    double slope = 0.0;
+  };
+
+  // Fits `curve` to its samples.
+  static void Fit(Curve& curve);
+
+  absl::flat_hash_map<int64_t, Curve> curves_;
+};
+
 // Abstract representation of a TensorFlow input pipeline that can be used
 // for collecting runtime information and optimizing performance. It collects
 // runtime information about execution of the input pipeline that is used to
@@ -1005,9 +1084,9 @@ class Model {
   // Records gap time between consecutive `GetNext()` calls.
   void RecordIteratorGapTime(uint64_t duration_usec);
 
-  // Computes the target time in nsecs to use for `STAGE_BASED` autotune
-  // algorithm. Returns 0 if there if there are not sufficient recorded iterator
-  // gap times to produce a good estimate.
+  // Computes the target time in nsecs to use for `STAGE_BASED` and
+  // `EMPIRICAL` autotune algorithms. Returns 0 if there if there are not
+  // sufficient recorded iterator gap times to produce a good estimate.
   double ComputeTargetTimeNsec();
 
   // Computes the target time in nsecs to use for estimating input bottlenecks.
@@ -1100,6 +1179,15 @@ class Model {
                               CancellationManager* cancellation_manager,
                               RamBudgetManager& ram_budget_manager);
 
+  // This optimization updates the empirical throughput curves with the
+  // metrics of `snapshot`, and then uses them to choose the parallelism and
+  // buffer sizes of the nodes within the CPU and RAM budgets. See
+  // `ThroughputCurves::Optimize`.
+  void OptimizeEmpirical(std::shared_ptr<Node> snapshot,
+                         const OptimizationParams& optimization_params,
+                         CancellationManager* cancellation_manager,
+                         RamBudgetManager& ram_budget_manager);
+
   // This optimization starts by setting all tunable parallelism parameters to
   // their minimum values. It then repeatedly increases the parallelism
   // parameter of the longest stage by 1 until either the longest stage is
@@ -1198,6 +1286,9 @@ class Model {
   OptimizationParams optimization_params_ TF_GUARDED_BY(mu_);
   // Stores the model id in the string format
   std::string model_id_;
+  // The empirical throughput curves used by the `EMPIRICAL` algorithm.
+  mutex throughput_curves_mu_;
+  ThroughputCurves throughput_curves_ TF_GUARDED_BY(throughput_curves_mu_);
 };
 
 // Class to compute timing information for a model.
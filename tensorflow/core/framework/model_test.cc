@@ -23,14 +23,17 @@ limitations under the License.
 #include <string>
 #include <tuple>
 #include <utility>
+#include <vector>
 
 #include "tensorflow/core/framework/cancellation.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/gtl/cleanup.h"
 #include "tensorflow/core/lib/monitoring/cell_reader.h"
+#include "tensorflow/core/platform/path.h"
 #include "tensorflow/core/platform/stringprintf.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 namespace data {
@@ -3132,6 +3135,125 @@ TEST_F(ModelTimingTest, OptimizeStageBased_PipelineRatioLessThanOne) {
   EXPECT_EQ(14, GetNode(/*node_id=*/1)->parameter_value("parallelism"));
 }
 
+// A parallel map whose per-element processing time is measured against its
+// parallelism during empirical optimization.
+constexpr char kEmpiricalModel[] = R"pb(
+  nodes: {
+    key: 1
+    value: {
+      id: 1
+      name: "ParallelMapV2"
+      autotune: true
+      num_elements: 100
+      processing_time: 100000
+      node_class: ASYNC_KNOWN_RATIO
+      ratio: 1
+      inputs: 2
+      parameters: {
+        name: "parallelism"
+        value: 1
+        state_value: 1
+        min: 1
+        max: 16
+        tunable: true
+      }
+    }
+  }
+  nodes: {
+    key: 2
+    value: {
+      id: 2
+      name: "SSTable"
+      autotune: true
+      num_elements: 100
+      processing_time: 1000
+      node_class: KNOWN_RATIO
+    }
+  }
+  output: 1
+)pb";
+
+// Runs `num_rounds` rounds of empirical optimization of the parallel map of
+// `kEmpiricalModel`. Before each round, the map produces 100 elements, each
+// taking `processing_time_at_one + slope * (parallelism - 1)` nanoseconds.
+void RunEmpiricalOptimization(Model& model, Node& node, int num_rounds,
+                              double processing_time_at_one, double slope,
+                              int64_t cpu_budget, double model_input_time) {
+  CancellationManager cancellation_manager;
+  RamBudgetManager ram_budget_manager(0);
+  for (int i = 0; i < num_rounds; ++i) {
+    model.Optimize(AutotuneAlgorithm::EMPIRICAL, CpuBudgetFunc(cpu_budget),
+                   /*ram_budget_share=*/1.0,
+                   /*fixed_ram_budget=*/1000, model_input_time,
+                   ram_budget_manager, &cancellation_manager);
+    const double parallelism = node.parameter_value("parallelism");
+    node.add_processing_time(
+        100 * (processing_time_at_one + slope * (parallelism - 1)));
+    for (int j = 0; j < 100; ++j) {
+      node.record_element();
+    }
+  }
+}
+
+TEST_F(ModelTimingTest, OptimizeEmpirical_ThroughputSaturates) {
+  BuildModelFromProto(kEmpiricalModel);
+  // Each element takes 500 + 500 * p nanoseconds, so the time to produce an
+  // element, 500 + 500 / p, improves by less than 5% past 4 threads. The first
+  // round only has samples at a parallelism of 1, and climbs to the CPU
+  // budget; the later rounds measure the contention and back off.
+  RunEmpiricalOptimization(*model_, *MutableGetNode(/*node_id=*/1),
+                           /*num_rounds=*/3, /*processing_time_at_one=*/1000,
+                           /*slope=*/500, /*cpu_budget=*/16,
+                           /*model_input_time=*/0);
+  EXPECT_EQ(4, GetNode(/*node_id=*/1)->parameter_value("parallelism"));
+}
+
+TEST_F(ModelTimingTest, OptimizeEmpirical_TargetTimeReached) {
+  BuildModelFromProto(kEmpiricalModel);
+  RunEmpiricalOptimization(*model_, *MutableGetNode(/*node_id=*/1),
+                           /*num_rounds=*/2, /*processing_time_at_one=*/1000,
+                           /*slope=*/0, /*cpu_budget=*/16,
+                           /*model_input_time=*/200);
+  EXPECT_EQ(5, GetNode(/*node_id=*/1)->parameter_value("parallelism"));
+}
+
+TEST_F(ModelTimingTest, OptimizeEmpirical_CappedByCpuBudget) {
+  BuildModelFromProto(kEmpiricalModel);
+  RunEmpiricalOptimization(*model_, *MutableGetNode(/*node_id=*/1),
+                           /*num_rounds=*/2, /*processing_time_at_one=*/1000,
+                           /*slope=*/0, /*cpu_budget=*/4,
+                           /*model_input_time=*/0);
+  EXPECT_EQ(4, GetNode(/*node_id=*/1)->parameter_value("parallelism"));
+}
+
+TEST(ThroughputCurvesTest, PredictProcessingTime) {
+  ModelProto model_proto;
+  protobuf::TextFormat::ParseFromString(kEmpiricalModel, &model_proto);
+  std::unique_ptr<Model> model;
+  TF_ASSERT_OK(Model::FromProto(model_proto, &model));
+  ThroughputCurves curves;
+  EXPECT_FALSE(curves.PredictProcessingTimeNsec(/*node_id=*/1, 1).has_value());
+  curves.RecordSnapshot(model->output()->Snapshot());
+  EXPECT_EQ(*curves.PredictProcessingTimeNsec(/*node_id=*/1, 1), 1000);
+  EXPECT_EQ(*curves.PredictProcessingTimeNsec(/*node_id=*/1, 8), 1000);
+  // Nodes without a `parallelism` parameter have no curve.
+  EXPECT_FALSE(curves.PredictProcessingTimeNsec(/*node_id=*/2, 1).has_value());
+
+  // 100 elements at a parallelism of 3, taking 2000 nanoseconds each.
+  Node* node = model->output().get();
+  for (auto& [node_name, parameter] : node->CollectNodeTunableParameters()) {
+    parameter->state->value = 3;
+  }
+  node->add_processing_time(200000);
+  for (int i = 0; i < 100; ++i) {
+    node->record_element();
+  }
+  curves.RecordSnapshot(model->output()->Snapshot());
+  EXPECT_NEAR(*curves.PredictProcessingTimeNsec(/*node_id=*/1, 1), 1000, 1e-6);
+  EXPECT_NEAR(*curves.PredictProcessingTimeNsec(/*node_id=*/1, 3), 2000, 1e-6);
+  EXPECT_NEAR(*curves.PredictProcessingTimeNsec(/*node_id=*/1, 5), 3000, 1e-6);
+}
+
 TEST_F(ModelTimingTest, ComputeTargetTime) {
   model_ = std::make_unique<Model>();
 
@@ -3548,6 +3670,82 @@ TEST(RamBudgetManagerTest, RequestAllocationsWithBudgetAdjustment) {
   EXPECT_TRUE(rbm.RequestLegacyPrefetchBytes(4));
 }
 
+TEST(RamBudgetManagerTest, ReleaseCacheBytesAfterBudgetShrinks) {
+  RamBudgetManager rbm(10);
+  EXPECT_TRUE(rbm.RequestCacheBytes(6));
+  EXPECT_TRUE(rbm.RequestModelAllocation(4));
+  EXPECT_FALSE(rbm.RequestCacheBytes(1));
+  // The allocations now exceed the budget, but releases still succeed.
+  rbm.UpdateBudget(5);
+  EXPECT_EQ(rbm.AvailableModelRam(), -1);
+  EXPECT_TRUE(rbm.RequestCacheBytes(-2));
+  EXPECT_EQ(rbm.AvailableModelRam(), 1);
+  EXPECT_TRUE(rbm.RequestCacheBytes(-4));
+  EXPECT_EQ(rbm.AvailableModelRam(), 5);
+  // Over budget 2 > 5 - 0 - 4
+  EXPECT_FALSE(rbm.RequestCacheBytes(2));
+  EXPECT_TRUE(rbm.RequestCacheBytes(1));
+}
+
+// Loads the model snapshots to replay in `BM_ReplayEmpiricalOptimization`.
+std::vector<std::pair<std::unique_ptr<Model>, Model::OptimizationParams>>
+LoadSnapshotsToReplay() {
+  std::vector<std::string> filenames;
+  const char* recorded = std::getenv("TF_DATA_MODEL_SNAPSHOTS");
+  if (recorded != nullptr) {
+    filenames = str_util::Split(recorded, ',', str_util::SkipEmpty());
+  } else {
+    // Record the snapshots of 20 rounds of optimization of a parallel map
+    // under contention.
+    std::unique_ptr<Model> model;
+    ModelProto model_proto;
+    protobuf::TextFormat::ParseFromString(kEmpiricalModel, &model_proto);
+    TF_CHECK_OK(Model::FromProto(model_proto, &model));
+    Node* node = model->output().get();
+    for (int i = 0; i < 20; ++i) {
+      RunEmpiricalOptimization(*model, *node, /*num_rounds=*/1,
+                               /*processing_time_at_one=*/1000, /*slope=*/300,
+                               /*cpu_budget=*/16, /*model_input_time=*/0);
+      Model::OptimizationParams optimization_params;
+      optimization_params.set_algorithm(AutotuneAlgorithm::EMPIRICAL);
+      optimization_params.set_cpu_budget(16);
+      optimization_params.set_ram_budget(1000);
+      filenames.push_back(io::JoinPath(
+          testing::TmpDir(), strings::StrCat("empirical_snapshot_", i)));
+      TF_CHECK_OK(model->Save(filenames.back(), model->output()->Snapshot(),
+                              optimization_params));
+    }
+  }
+  std::vector<std::pair<std::unique_ptr<Model>, Model::OptimizationParams>>
+      snapshots(filenames.size());
+  for (int i = 0; i < filenames.size(); ++i) {
+    TF_CHECK_OK(Model::Load(filenames[i], &snapshots[i].first,
+                            &snapshots[i].second));
+  }
+  return snapshots;
+}
+
+// Replays the empirical optimization over a sequence of model snapshots, as
+// saved by `Model::Save` during successive optimization rounds. The snapshots
+// are read from the comma-separated files in the `TF_DATA_MODEL_SNAPSHOTS`
+// environment variable if it is set, and recorded from a simulated pipeline
+// otherwise.
+void BM_ReplayEmpiricalOptimization(::testing::benchmark::State& state) {
+  auto snapshots = LoadSnapshotsToReplay();
+  CancellationManager cancellation_manager;
+  for (auto s : state) {
+    ThroughputCurves curves;
+    for (auto& [model, optimization_params] : snapshots) {
+      curves.RecordSnapshot(model->output());
+      curves.Optimize(model->output(), optimization_params,
+                      &cancellation_manager);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * snapshots.size());
+}
+
+BENCHMARK(BM_ReplayEmpiricalOptimization);
+
 }  // namespace
 }  // namespace model
 }  // namespace data
@@ -377,6 +377,8 @@ Allocator* OpKernelContext::get_allocator(AllocatorAttributes attr) {
   if (TF_PREDICT_FALSE(attr.scope_id > 0)) {
     allocator = params_->device->GetScopedAllocator(attr, step_id());
     CHECK(allocator);
+  } else if (params_->step_allocator != nullptr && attr.value == 0) {
+    allocator = params_->step_allocator;
   } else {
     allocator = params_->device->GetAllocator(attr);
   }
@@ -760,7 +762,13 @@ Status OpKernelContext::allocate_output(StringPiece name,
 Status OpKernelContext::allocate_tensor(
     DataType type, const TensorShape& shape, Tensor* out_tensor,
     AllocatorAttributes attr, const AllocationAttributes& allocation_attr) {
-  Allocator* a = get_allocator(attr);
+  return allocate_tensor(get_allocator(attr), type, shape, out_tensor,
+                         allocation_attr);
+}
+
+Status OpKernelContext::allocate_tensor(
+    Allocator* a, DataType type, const TensorShape& shape, Tensor* out_tensor,
+    const AllocationAttributes& allocation_attr) {
   Tensor new_tensor(
       a, type, shape,
       AllocationAttributes(
@@ -819,7 +827,18 @@ Status OpKernelContext::allocate_output(int index, const TensorShape& shape,
       op_kernel().name_view().data(), step_id(), "output", type,
       [&shape]() { return shape.DebugString(); });
   auto output_tensor = std::make_unique<Tensor>();
-  Status s = allocate_tensor(type, shape, output_tensor.get(), attr);
+  Status s;
+  // Planned allocators stand in for the default device allocator only, so
+  // outputs with special attributes, scoped allocators or tracked allocations
+  // use the usual path.
+  if (TF_PREDICT_FALSE(params_->output_allocator_array != nullptr) &&
+      params_->output_allocator_array[index] != nullptr && attr.value == 0 &&
+      attr.scope_id <= 0 && !track_allocations()) {
+    s = allocate_tensor(params_->output_allocator_array[index], type, shape,
+                        output_tensor.get(), AllocationAttributes());
+  } else {
+    s = allocate_tensor(type, shape, output_tensor.get(), attr);
+  }
   if (s.ok()) {
     outputs_[index] = TensorValue(output_tensor.release());
     *output = outputs_[index].tensor;
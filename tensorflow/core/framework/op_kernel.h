@@ -683,6 +683,16 @@ class OpKernelContext {
     // Values in [0,...) represent reservations for the indexed output.
     const int* forward_from_array = nullptr;
 
+    // Support for statically planned output memory. If not null, an array of
+    // allocators indexed by output, used by `allocate_output()` in place of
+    // the device allocator for the outputs with a non-null entry.
+    Allocator* const* output_allocator_array = nullptr;
+
+    // If not null, the allocator that `get_allocator()` returns in place of
+    // the device allocator for default allocator attributes. Only set for
+    // kernels whose allocations do not outlive the step.
+    Allocator* step_allocator = nullptr;
+
     // For tracking actively running deferred ops.
     std::function<void()> inc_num_deferred_ops_function;
     std::function<void()> dec_num_deferred_ops_function;
@@ -1275,6 +1285,10 @@ class OpKernelContext {
                          Tensor* out_tensor, AllocatorAttributes allocator_attr,
                          const AllocationAttributes& allocation_attr);
 
+  Status allocate_tensor(Allocator* a, DataType type, const TensorShape& shape,
+                         Tensor* out_tensor,
+                         const AllocationAttributes& allocation_attr);
+
   // Helpers for `set_output()`.
 
   // Returns `true` if the tensor was copied into an allocated output.
@@ -25,6 +25,8 @@ limitations under the License.
 #include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
 #include "tensorflow/core/framework/run_handler_util.h"
 #include "tensorflow/core/lib/core/threadpool_interface.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/lib/monitoring/gauge.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/context.h"
 #include "tensorflow/core/platform/denormal.h"
@@ -42,6 +44,19 @@ static constexpr int32_t kMaxConcurrentHandlers = 128;
 
 typedef typename internal::RunHandlerEnvironment::Task Task;
 typedef Eigen::RunQueue<Task, 1024> Queue;
+typedef Eigen::RunQueue<Task, 64> LocalQueue;
+
+auto* run_handler_queue_depth = monitoring::Gauge<int64_t, 1>::New(
+    "/tensorflow/core/run_handler/queue_depth",
+    "The number of inter-op and intra-op closures queued on a RunHandler, "
+    "sampled when closures are enqueued.",
+    "handler_id");
+
+auto* run_handler_steal_count = monitoring::Counter<1>::New(
+    "/tensorflow/core/run_handler/steal_count",
+    "The number of inter-op closures of a RunHandler that a worker thread "
+    "stole from another worker's deque.",
+    "handler_id");
 
 }  // namespace
 
@@ -123,6 +138,9 @@ void WaitOnWaiter(Waiter* waiter, Waiter* queue_head, mutex* mutex,
 }
 
 ThreadWorkSource::ThreadWorkSource()
+    : ThreadWorkSource(/*handler_id=*/-1, /*num_local_queues=*/0) {}
+
+ThreadWorkSource::ThreadWorkSource(int handler_id, int num_local_queues)
     : non_blocking_work_sharding_factor_(
           static_cast<int32>(ParamFromEnvWithDefault(
               "TF_RUN_HANDLER_NUM_OF_NON_BLOCKING_QUEUES", 1))),
@@ -131,18 +149,33 @@ ThreadWorkSource::ThreadWorkSource()
       non_blocking_inflight_(0),
       traceme_id_(0),
       version_(0),
-      sub_thread_pool_waiter_(nullptr) {
+      sub_thread_pool_waiter_(nullptr),
+      local_work_queues_(num_local_queues),
+      num_enqueued_(0),
+      queue_depth_cell_(nullptr),
+      steal_count_cell_(nullptr) {
   queue_waiters_.next = &queue_waiters_;
   queue_waiters_.prev = &queue_waiters_;
   for (int i = 0; i < NonBlockingWorkShardingFactor(); ++i) {
     non_blocking_work_queues_.emplace_back(new NonBlockingQueue());
   }
+  for (int i = 0; i < num_local_queues; ++i) {
+    local_work_queues_.emplace_back(new LocalQueue());
+  }
+  if (handler_id >= 0) {
+    const string label = strings::StrCat(handler_id);
+    queue_depth_cell_ = run_handler_queue_depth->GetCell(label);
+    steal_count_cell_ = run_handler_steal_count->GetCell(label);
+  }
 }
 
 ThreadWorkSource::~ThreadWorkSource() {
   for (int i = 0; i < non_blocking_work_queues_.size(); ++i) {
     delete non_blocking_work_queues_[i];
   }
+  for (int i = 0; i < local_work_queues_.size(); ++i) {
+    delete local_work_queues_[i];
+  }
 }
 
 Task ThreadWorkSource::EnqueueTask(Task t, bool is_blocking) {
@@ -165,6 +198,33 @@ Task ThreadWorkSource::EnqueueTask(Task t, bool is_blocking) {
     t = task_queue->PushFront(std::move(t));
   }
 
+  NotifyWaiter();
+  MaybeRecordQueueDepth();
+  VLOG(3) << "Added " << (is_blocking ? "inter" : "intra") << " work from "
+          << traceme_id_.load(std::memory_order_relaxed);
+  return t;
+}
+
+Task ThreadWorkSource::EnqueueLocalTask(int thread_id, Task t) {
+  DCHECK_GE(thread_id, 0);
+  DCHECK_LT(thread_id, NumLocalQueues());
+  // Only the owning worker pushes to or pops from the front of its deque, so
+  // no lock is needed here.
+  t = local_work_queues_[thread_id]->PushFront(std::move(t));
+  if (t.f) {
+    return t;
+  }
+  // Wake up another worker so that it can steal the task if this worker is
+  // busy for a while.
+  NotifyWaiter();
+  MaybeRecordQueueDepth();
+  VLOG(3) << "Added local inter work from "
+          << traceme_id_.load(std::memory_order_relaxed) << " for thread "
+          << thread_id;
+  return t;
+}
+
+void ThreadWorkSource::NotifyWaiter() {
   Waiter* w = nullptr;
   static const bool use_sub_thread_pool =
       ParamFromEnvBoolWithDefault("TF_RUN_HANDLER_USE_SUB_THREAD_POOL", false);
@@ -210,15 +270,49 @@ Task ThreadWorkSource::EnqueueTask(Task t, bool is_blocking) {
     // period of time in case a notification is missed.
     w->cv.notify_one();
   }
-  VLOG(3) << "Added " << (is_blocking ? "inter" : "intra") << " work from "
-          << traceme_id_.load(std::memory_order_relaxed);
-  return t;
+}
+
+void ThreadWorkSource::MaybeRecordQueueDepth() {
+  if (queue_depth_cell_ == nullptr ||
+      num_enqueued_.fetch_add(1, std::memory_order_relaxed) % 16 != 0) {
+    return;
+  }
+  queue_depth_cell_->Set(TaskQueueSize(true) + TaskQueueSize(false));
 }
 
 Task ThreadWorkSource::PopBlockingTask() {
   return blocking_work_queue_.PopBack();
 }
 
+Task ThreadWorkSource::PopLocalTask(int thread_id) {
+  if (thread_id < 0 || thread_id >= NumLocalQueues()) {
+    return Task();
+  }
+  return local_work_queues_[thread_id]->PopFront();
+}
+
+Task ThreadWorkSource::StealLocalTask(int thread_id) {
+  Task t;
+  const int num_local_queues = NumLocalQueues();
+  // Start with the next worker so that victims are spread across thieves.
+  for (int i = 1; i <= num_local_queues; ++i) {
+    const int victim = (thread_id + i) % num_local_queues;
+    if (victim == thread_id) continue;
+    t = local_work_queues_[victim]->PopBack();
+    if (t.f) {
+      if (steal_count_cell_ != nullptr) {
+        steal_count_cell_->IncrementBy(1);
+      }
+      return t;
+    }
+  }
+  return t;
+}
+
+int ThreadWorkSource::NumLocalQueues() const {
+  return local_work_queues_.size();
+}
+
 Task ThreadWorkSource::PopNonBlockingTask(int start_index,
                                           bool search_from_all_queue) {
   Task t;
@@ -243,7 +337,11 @@ void ThreadWorkSource::WaitForWork(int max_sleep_micros) {
 
 int ThreadWorkSource::TaskQueueSize(bool is_blocking) {
   if (is_blocking) {
-    return blocking_work_queue_.Size();
+    unsigned total_size = blocking_work_queue_.Size();
+    for (int i = 0; i < local_work_queues_.size(); ++i) {
+      total_size += local_work_queues_[i]->Size();
+    }
+    return total_size;
   } else {
     unsigned total_size = 0;
     for (int i = 0; i < non_blocking_work_sharding_factor_; ++i) {
@@ -324,6 +422,9 @@ RunHandlerThreadPool::RunHandlerThreadPool(
       queue_waiters_(queue_waiters),
       use_sub_thread_pool_(ParamFromEnvBoolWithDefault(
           "TF_RUN_HANDLER_USE_SUB_THREAD_POOL", false)),
+      use_work_stealing_(!use_sub_thread_pool_ &&
+                         ParamFromEnvBoolWithDefault(
+                             "TF_RUN_HANDLER_USE_WORK_STEALING", false)),
       num_threads_in_sub_thread_pool_(ParamFromEnvWithDefault(
           "TF_RUN_HANDLER_NUM_THREADS_IN_SUB_THREAD_POOL",
           std::vector<int>({num_blocking_threads / 2,
@@ -391,6 +492,17 @@ void RunHandlerThreadPool::AddWorkToQueue(ThreadWorkSource* tws,
                                           bool is_blocking,
                                           std::function<void()> fn) {
   Task t = env_.CreateTask(std::move(fn));
+  if (is_blocking && tws->NumLocalQueues() > 0) {
+    // Inter-op work scheduled from a worker is usually a successor of the
+    // kernel that worker just ran, so keep it on that worker's deque.
+    const int thread_id = CurrentThreadId();
+    if (thread_id >= 0 && thread_id < tws->NumLocalQueues()) {
+      t = tws->EnqueueLocalTask(thread_id, std::move(t));
+      if (!t.f) {
+        return;
+      }
+    }
+  }
   t = tws->EnqueueTask(std::move(t), is_blocking);
   if (t.f) {
     VLOG(3) << "Running " << (is_blocking ? "inter" : "intra") << " work for "
@@ -472,6 +584,10 @@ int RunHandlerThreadPool::NumNonBlockingThreads() const {
   return num_non_blocking_threads_;
 }
 
+bool RunHandlerThreadPool::UseWorkStealing() const {
+  return use_work_stealing_;
+}
+
 RunHandlerThreadPool::ThreadData::ThreadData()
     : new_version(0),
       current_index(0),
@@ -595,10 +711,21 @@ void RunHandlerThreadPool::WorkerLoop(int thread_id,
         // This is best effort policy.
         if (may_steal_blocking_work &&
             tws->GetInflightTaskCount(true) < kMaxBlockingInflight) {
+          // With work stealing, prefer this worker's own (cache-warm) work,
+          // then the shared queue, then other workers' work for the same
+          // request before moving on to a request that arrived later.
+          t = tws->PopLocalTask(thread_id);
+          if (t.f) {
+            break;
+          }
           t = tws->PopBlockingTask();
           if (t.f) {
             break;
           }
+          t = tws->StealLocalTask(thread_id);
+          if (t.f) {
+            break;
+          }
         }
         if (i == 0) {
           // Always look for any work from the "primary" work source.
@@ -724,7 +851,7 @@ void RunHandlerThreadPool::WaitForWork(bool is_blocking, int thread_id,
 // Externally visible RunHandler class simply forwards the work to this one.
 class RunHandler::Impl {
  public:
-  explicit Impl(RunHandlerPool::Impl* pool_impl);
+  Impl(RunHandlerPool::Impl* pool_impl, int handler_id, int num_local_queues);
 
   ~Impl() {}
 
@@ -794,8 +921,12 @@ class RunHandlerPool::Impl {
     VLOG(1) << "Creating a RunHandlerPool with max handlers: " << max_handlers_;
     free_handlers_.reserve(max_handlers_);
     handlers_.reserve(max_handlers_);
+    const int num_local_queues =
+        run_handler_thread_pool_->UseWorkStealing()
+            ? run_handler_thread_pool_->NumBlockingThreads()
+            : 0;
     for (int i = 0; i < max_handlers_; ++i) {
-      handlers_.emplace_back(new RunHandler::Impl(this));
+      handlers_.emplace_back(new RunHandler::Impl(this, i, num_local_queues));
       free_handlers_.push_back(handlers_.back().get());
     }
     queue_waiters_.resize(
@@ -1056,8 +1187,9 @@ void RunHandler::Impl::ThreadPoolInterfaceWrapper::Schedule(
   return run_handler_impl_->ScheduleIntraOpClosure(std::move(fn));
 }
 
-RunHandler::Impl::Impl(RunHandlerPool::Impl* pool_impl)
-    : pool_impl_(pool_impl) {
+RunHandler::Impl::Impl(RunHandlerPool::Impl* pool_impl, int handler_id,
+                       int num_local_queues)
+    : pool_impl_(pool_impl), tws_(handler_id, num_local_queues) {
   thread_pool_interface_.reset(new ThreadPoolInterfaceWrapper(this));
   Reset(0, RunOptions::Experimental::RunHandlerPoolOptions());
 }
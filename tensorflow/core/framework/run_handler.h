@@ -18,6 +18,8 @@ limitations under the License.
 
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/histogram/histogram.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/lib/monitoring/gauge.h"
 #include "tensorflow/core/platform/context.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/thread_annotations.h"
@@ -139,6 +141,9 @@ class RunHandlerEnvironment {
 
 typedef typename RunHandlerEnvironment::Task Task;
 typedef Eigen::RunQueue<Task, 1024> Queue;
+// Per-worker deque used when work stealing is enabled. Overflowing tasks are
+// pushed to the shared blocking queue instead.
+typedef Eigen::RunQueue<Task, 64> LocalQueue;
 
 // To reduce cache misses, we use a doubly-linked list of Waiter structs and
 // queue them in LIFO order rather than the FIFO order used by a single
@@ -158,12 +163,30 @@ class ThreadWorkSource {
  public:
   ThreadWorkSource();
 
+  // `handler_id` labels the per-handler monitoring metrics; a negative id
+  // disables them. If `num_local_queues` > 0, one work-stealing deque is
+  // created for each of the first `num_local_queues` worker threads.
+  ThreadWorkSource(int handler_id, int num_local_queues);
+
   ~ThreadWorkSource();
 
   Task EnqueueTask(Task t, bool is_blocking);
 
+  // Pushes a blocking task onto the deque owned by worker `thread_id`. Must
+  // only be called from that worker. Returns `t` if the deque is full.
+  Task EnqueueLocalTask(int thread_id, Task t);
+
   Task PopBlockingTask();
 
+  // Pops the most recently pushed task from the deque owned by `thread_id`.
+  // Must only be called from that worker.
+  Task PopLocalTask(int thread_id);
+
+  // Steals the oldest task from the deque of a worker other than `thread_id`.
+  Task StealLocalTask(int thread_id);
+
+  int NumLocalQueues() const;
+
   Task PopNonBlockingTask(int start_index, bool search_from_all_queue);
 
   void WaitForWork(int max_sleep_micros);
@@ -193,6 +216,12 @@ class ThreadWorkSource {
     Queue queue;
   };
 
+  // Wakes up one thread waiting for work from this source, if any.
+  void NotifyWaiter();
+
+  // Records the queue depth on every 16th enqueued task.
+  void MaybeRecordQueueDepth();
+
   int32 non_blocking_work_sharding_factor_;
   Eigen::MaxSizeVector<NonBlockingQueue*> non_blocking_work_queues_;
 
@@ -210,6 +239,12 @@ class ThreadWorkSource {
   uint64 version_ TF_GUARDED_BY(run_handler_waiter_mu_);
   mutex* sub_thread_pool_waiter_mu_ TF_GUARDED_BY(run_handler_waiter_mu_);
   Waiter* sub_thread_pool_waiter_ TF_GUARDED_BY(run_handler_waiter_mu_);
+
+  Eigen::MaxSizeVector<LocalQueue*> local_work_queues_;
+  std::atomic<int64_t> num_enqueued_;
+  // Not owned. Null if metrics are disabled.
+  monitoring::GaugeCell<int64_t>* queue_depth_cell_;
+  monitoring::CounterCell* steal_count_cell_;
 };
 
 class RunHandlerThreadPool {
@@ -269,6 +304,10 @@ class RunHandlerThreadPool {
 
   void WaitForWorkInSubThreadPool(bool is_blocking, int sub_thread_pool_id);
 
+  // Returns true if blocking threads keep inter-op work scheduled from a
+  // worker in that worker's own deque, from which other workers steal.
+  bool UseWorkStealing() const;
+
  private:
   struct ThreadData {
     ThreadData();
@@ -299,6 +338,8 @@ class RunHandlerThreadPool {
   Eigen::MaxSizeVector<Waiter>* queue_waiters_;
 
   bool use_sub_thread_pool_;
+  // Ignored if `use_sub_thread_pool_` is true.
+  bool use_work_stealing_;
   std::vector<int> num_threads_in_sub_thread_pool_;
 
   // Threads in each sub thread pool will search tasks from the given
@@ -146,6 +146,38 @@ TEST(RunHandlerThreadPool, EnqueueTask) {
   EXPECT_EQ(result, 2);
 }
 
+TEST(RunHandlerThreadPool, LocalTaskWorkStealing) {
+  internal::RunHandlerEnvironment env(Env::Default(), ThreadOptions(),
+                                      "tf_run_handler_pool");
+  internal::ThreadWorkSource tws(/*handler_id=*/0, /*num_local_queues=*/2);
+  EXPECT_EQ(tws.NumLocalQueues(), 2);
+
+  int result = 0;
+  for (int i = 1; i <= 3; ++i) {
+    EXPECT_EQ(
+        tws.EnqueueLocalTask(/*thread_id=*/0,
+                             env.CreateTask([&result, i] { result = i; }))
+            .f,
+        nullptr);
+  }
+  EXPECT_EQ(tws.TaskQueueSize(/*is_blocking=*/true), 3);
+
+  // Another worker steals the oldest task.
+  EXPECT_EQ(tws.PopLocalTask(/*thread_id=*/1).f, nullptr);
+  env.ExecuteTask(tws.StealLocalTask(/*thread_id=*/1));
+  EXPECT_EQ(result, 1);
+
+  // The owner pops its most recent task first.
+  env.ExecuteTask(tws.PopLocalTask(/*thread_id=*/0));
+  EXPECT_EQ(result, 3);
+  env.ExecuteTask(tws.PopLocalTask(/*thread_id=*/0));
+  EXPECT_EQ(result, 2);
+
+  EXPECT_EQ(tws.PopLocalTask(/*thread_id=*/0).f, nullptr);
+  EXPECT_EQ(tws.StealLocalTask(/*thread_id=*/1).f, nullptr);
+  EXPECT_EQ(tws.TaskQueueSize(/*is_blocking=*/true), 0);
+}
+
 TEST(RunHandlerThreadPool, FindTask) {
   Eigen::MaxSizeVector<mutex> waiters_mu(2);
   waiters_mu.resize(2);
@@ -779,6 +811,47 @@ TEST_F(RunHandlerTest, TestConcurrencyUseRunHandlerPoolWithPriority) {
   delete tp;
 }
 
+TEST(RunHandlerPoolTest, WorkStealing) {
+  // Work stealing is only used without sub thread pools.
+  const char* use_sub_thread_pool =
+      getenv("TF_RUN_HANDLER_USE_SUB_THREAD_POOL");
+  const string prev_use_sub_thread_pool =
+      use_sub_thread_pool ? use_sub_thread_pool : "false";
+  ASSERT_EQ(setenv("TF_RUN_HANDLER_USE_SUB_THREAD_POOL", "false", true), 0);
+  ASSERT_EQ(setenv("TF_RUN_HANDLER_USE_WORK_STEALING", "true", true), 0);
+  auto pool = std::make_unique<RunHandlerPool>(/*num_inter_op_threads=*/4,
+                                               /*num_intra_op_threads=*/0);
+
+  // Each root closure fans out into closures scheduled from a worker thread,
+  // which land on that worker's deque and may be stolen by other workers.
+  constexpr int kNumHandlers = 4;
+  constexpr int kNumRoots = 8;
+  constexpr int kFanOut = 32;
+  std::vector<std::unique_ptr<RunHandler>> handlers;
+  for (int i = 0; i < kNumHandlers; ++i) {
+    handlers.push_back(pool->Get(/*step_id=*/i));
+  }
+  BlockingCounter counter(kNumHandlers * kNumRoots * kFanOut);
+  for (auto& handler : handlers) {
+    RunHandler* h = handler.get();
+    for (int i = 0; i < kNumRoots; ++i) {
+      h->ScheduleInterOpClosure([h, &counter] {
+        for (int j = 0; j < kFanOut; ++j) {
+          h->ScheduleInterOpClosure([&counter] { counter.DecrementCount(); });
+        }
+      });
+    }
+  }
+  counter.Wait();
+  // Releasing a handler checks that none of its queues hold leftover work.
+  handlers.clear();
+  pool.reset();
+  ASSERT_EQ(unsetenv("TF_RUN_HANDLER_USE_WORK_STEALING"), 0);
+  ASSERT_EQ(setenv("TF_RUN_HANDLER_USE_SUB_THREAD_POOL",
+                   prev_use_sub_thread_pool.c_str(), true),
+            0);
+}
+
 TEST_F(RunHandlerTest, TestWaitTimeout) {
   std::unique_ptr<RunHandlerPool> pool(new RunHandlerPool(1, 1));
 
@@ -0,0 +1,319 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/data/map_vectorization.h"
+
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/function.h"
+#include "tensorflow/core/framework/function.pb.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/grappler/clusters/cluster.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/mutable_graph_view.h"
+#include "tensorflow/core/grappler/optimizers/custom_graph_optimizer_registry.h"
+#include "tensorflow/core/grappler/optimizers/data/graph_utils.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/lib/gtl/map_util.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+constexpr char kMapDatasetOp[] = "MapDataset";
+constexpr char kParallelMapDatasetOp[] = "ParallelMapDatasetV2";
+constexpr char kBatchDatasetOp[] = "BatchDataset";
+constexpr char kBatchDatasetV2Op[] = "BatchDatasetV2";
+constexpr char kConstOp[] = "Const";
+constexpr char kOutputShapesAttr[] = "output_shapes";
+constexpr char kOutputTypesAttr[] = "output_types";
+
+// Stateless ops with one input that are applied to each scalar of the input
+// independently.
+bool IsElementwiseUnaryOp(const string& op) {
+  static const auto* const kOps = new absl::flat_hash_set<string>({
+      "Abs", "Cast", "Ceil", "Cos", "Exp", "Expm1", "Floor", "Identity",
+      "IsFinite", "IsInf", "IsNan", "Log", "Log1p", "LogicalNot", "Neg",
+      "Reciprocal", "Relu", "Relu6", "Rint", "Round", "Rsqrt", "Sigmoid",
+      "Sign", "Sin", "Softplus", "Sqrt", "Square", "Tanh"});
+  return kOps->contains(op);
+}
+
+// Stateless ops with two inputs that are applied to each pair of scalars of
+// the (broadcast) inputs independently.
+bool IsElementwiseBinaryOp(const string& op) {
+  static const auto* const kOps = new absl::flat_hash_set<string>({
+      "Add", "AddV2", "Div", "DivNoNan", "Equal", "FloorDiv", "FloorMod",
+      "Greater", "GreaterEqual", "Less", "LessEqual", "LogicalAnd", "LogicalOr",
+      "Maximum", "Minimum", "Mod", "Mul", "NotEqual", "Pow", "RealDiv",
+      "SquaredDifference", "Sub", "TruncateDiv", "TruncateMod"});
+  return kOps->contains(op);
+}
+
+// Describes a value computed by the map function.
+struct ValueInfo {
+  // Whether the value depends on an element of the input dataset. Values that
+  // do not are computed from scalar constants only, and are hence scalars.
+  bool depends_on_input = false;
+  // The per-element shape of the value.
+  PartialTensorShape shape;
+};
+
+// Returns the name of the node or function argument that produces `input`.
+string SourceName(const string& input) {
+  return input.substr(0, input.find(':'));
+}
+
+// Returns true if batching the outputs of `function` is equivalent to applying
+// `function` to the batched inputs, given the per-element `input_shapes`.
+bool IsBatchPolymorphic(const FunctionDef& function,
+                        const std::vector<PartialTensorShape>& input_shapes) {
+  const OpDef& signature = function.signature();
+  if (signature.is_stateful() || !function.control_ret().empty() ||
+      signature.input_arg_size() != input_shapes.size()) {
+    return false;
+  }
+
+  absl::flat_hash_map<string, ValueInfo> values;
+  for (int i = 0; i < signature.input_arg_size(); ++i) {
+    // Elements whose shapes are not fully defined may have different shapes,
+    // in which case batching them before the map would fail where batching
+    // the map outputs might not (e.g. for components the map drops).
+    if (!input_shapes[i].IsFullyDefined()) return false;
+    values[signature.input_arg(i).name()] = {/*depends_on_input=*/true,
+                                             input_shapes[i]};
+  }
+
+  for (const NodeDef& node : function.node_def()) {
+    if (node.op() == kConstOp) {
+      const auto* value = gtl::FindOrNull(node.attr(), "value");
+      if (!value || !value->has_tensor() ||
+          value->tensor().tensor_shape().dim_size() != 0) {
+        return false;
+      }
+    } else if (!IsElementwiseUnaryOp(node.op()) &&
+               !IsElementwiseBinaryOp(node.op())) {
+      VLOG(2) << "Function " << signature.name() << " is not vectorized "
+              << "because of the op " << node.op();
+      return false;
+    }
+    for (const string& input : node.input()) {
+      if (IsControlInput(input)) return false;
+    }
+  }
+
+  // Function bodies are not necessarily topologically sorted, so iterate until
+  // all nodes are resolved.
+  int num_resolved = 0;
+  bool progress = true;
+  while (progress && num_resolved < function.node_def_size()) {
+    progress = false;
+    for (const NodeDef& node : function.node_def()) {
+      if (values.contains(node.name())) continue;
+      std::vector<const ValueInfo*> operands;
+      for (const string& input : node.input()) {
+        const ValueInfo* operand = gtl::FindOrNull(values, SourceName(input));
+        if (!operand) break;
+        operands.push_back(operand);
+      }
+      if (operands.size() != node.input_size()) continue;
+
+      ValueInfo result;
+      if (node.op() == kConstOp) {
+        if (!operands.empty()) return false;
+        result.shape = PartialTensorShape({});
+      } else if (IsElementwiseUnaryOp(node.op())) {
+        if (operands.size() != 1) return false;
+        result = *operands[0];
+      } else {
+        if (operands.size() != 2) return false;
+        const ValueInfo& x = *operands[0];
+        const ValueInfo& y = *operands[1];
+        if (x.depends_on_input && y.depends_on_input) {
+          // Broadcasting between components of different shapes would be
+          // misaligned by the leading batch dimension.
+          if (!x.shape.IsIdenticalTo(y.shape)) return false;
+          result = x;
+        } else {
+          // The other operand is a scalar, which broadcasts the same way with
+          // or without the batch dimension.
+          result = x.depends_on_input ? x : y;
+        }
+      }
+      values[node.name()] = std::move(result);
+      ++num_resolved;
+      progress = true;
+    }
+  }
+  if (num_resolved < function.node_def_size()) return false;
+
+  for (const auto& output : function.ret()) {
+    const ValueInfo* value = gtl::FindOrNull(values, SourceName(output.second));
+    // Outputs that do not depend on the input would not have a batch
+    // dimension.
+    if (!value || !value->depends_on_input) return false;
+  }
+  return true;
+}
+
+// Returns the per-element shapes produced by `node`, or false if they are not
+// known.
+bool GetOutputShapes(const NodeDef& node,
+                     std::vector<PartialTensorShape>* shapes) {
+  const auto* attr = gtl::FindOrNull(node.attr(), kOutputShapesAttr);
+  if (!attr || !gtl::FindOrNull(node.attr(), kOutputTypesAttr)) return false;
+  for (const auto& shape : attr->list().shape()) {
+    shapes->emplace_back(shape);
+  }
+  return true;
+}
+
+// Returns the size of the leading dimension of the `batch_node` outputs, or -1
+// if it is not known statically.
+int64_t GetBatchDimension(const NodeDef& batch_node) {
+  const auto& shapes = batch_node.attr().at(kOutputShapesAttr).list().shape();
+  if (shapes.empty() || shapes[0].unknown_rank() ||
+      shapes[0].dim_size() == 0) {
+    return -1;
+  }
+  return shapes[0].dim(0).size();
+}
+
+FunctionDef MakeVectorizedFunction(const FunctionDef& function,
+                                   const FunctionDefLibrary& library) {
+  FunctionDef vectorized = function;
+  graph_utils::SetUniqueGraphFunctionName(
+      absl::StrCat("map_vectorization_funcs/", function.signature().name()),
+      &library, &vectorized);
+  // Argument and node shapes describe single elements.
+  vectorized.mutable_arg_attr()->clear();
+  for (NodeDef& node : *vectorized.mutable_node_def()) {
+    node.mutable_attr()->erase("_output_shapes");
+  }
+  return vectorized;
+}
+
+NodeDef MakeBatchNode(const NodeDef& batch_node, const NodeDef& input_node,
+                      const std::vector<PartialTensorShape>& input_shapes,
+                      MutableGraphView* graph) {
+  NodeDef new_node = batch_node;
+  graph_utils::SetUniqueGraphNodeName(
+      absl::StrCat("map_vectorization/", batch_node.name()), graph->graph(),
+      &new_node);
+  new_node.set_input(0, input_node.name());
+
+  graph_utils::CopyAttribute(kOutputTypesAttr, input_node, &new_node);
+  const int64_t batch_dimension = GetBatchDimension(batch_node);
+  auto* shapes =
+      (*new_node.mutable_attr())[kOutputShapesAttr].mutable_list();
+  shapes->clear_shape();
+  for (const PartialTensorShape& shape : input_shapes) {
+    PartialTensorShape({batch_dimension})
+        .Concatenate(shape)
+        .AsProto(shapes->add_shape());
+  }
+  return new_node;
+}
+
+NodeDef MakeMapNode(const NodeDef& map_node, const NodeDef& batch_node,
+                    const FunctionDef& vectorized_function,
+                    const NodeDef& new_batch_node, MutableGraphView* graph) {
+  NodeDef new_node = map_node;
+  graph_utils::SetUniqueGraphNodeName(
+      absl::StrCat("map_vectorization/", map_node.name()), graph->graph(),
+      &new_node);
+  new_node.set_input(0, new_batch_node.name());
+  *(*new_node.mutable_attr())["f"].mutable_func()->mutable_name() =
+      vectorized_function.signature().name();
+  graph_utils::CopyAttribute(kOutputShapesAttr, batch_node, &new_node);
+  return new_node;
+}
+
+}  // namespace
+
+Status MapVectorization::OptimizeAndCollectStats(Cluster* cluster,
+                                                 const GrapplerItem& item,
+                                                 GraphDef* output,
+                                                 OptimizationStats* stats) {
+  *output = item.graph;
+  MutableGraphView graph(output);
+  absl::flat_hash_set<string> nodes_to_delete;
+  FunctionLibraryDefinition function_library(OpRegistry::Global(),
+                                             item.graph.library());
+
+  for (const NodeDef& node : item.graph.node()) {
+    if (node.op() != kBatchDatasetOp && node.op() != kBatchDatasetV2Op) {
+      continue;
+    }
+    const NodeDef& batch_node = node;
+    if (!gtl::FindOrNull(batch_node.attr(), kOutputShapesAttr)) continue;
+
+    NodeDef* map_node = graph_utils::GetInputNode(batch_node, graph);
+    // Only maps without captured inputs (empty `other_arguments`) whose
+    // outputs are only consumed by the batch are eligible for rewrite.
+    if (map_node->op() == kMapDatasetOp) {
+      if (map_node->input_size() != 1) continue;
+    } else if (map_node->op() == kParallelMapDatasetOp) {
+      if (map_node->input_size() != 2) continue;
+    } else {
+      continue;
+    }
+    if (graph.GetFanouts(*map_node, /*include_controlled_nodes=*/true).size() !=
+        1) {
+      continue;
+    }
+
+    NodeDef* input_node = graph_utils::GetInputNode(*map_node, graph);
+    std::vector<PartialTensorShape> input_shapes;
+    if (!GetOutputShapes(*input_node, &input_shapes)) continue;
+
+    const FunctionDef* function =
+        function_library.Find(map_node->attr().at("f").func().name());
+    if (!function || !IsBatchPolymorphic(*function, input_shapes)) continue;
+
+    FunctionDef vectorized_function =
+        MakeVectorizedFunction(*function, output->library());
+    const NodeDef* new_batch_node = graph.AddNode(
+        MakeBatchNode(batch_node, *input_node, input_shapes, &graph));
+    const NodeDef* new_map_node =
+        graph.AddNode(MakeMapNode(*map_node, batch_node, vectorized_function,
+                                  *new_batch_node, &graph));
+    TF_RETURN_IF_ERROR(
+        graph.UpdateFanouts(batch_node.name(), new_map_node->name()));
+    TF_RETURN_IF_ERROR(function_library.AddFunctionDef(vectorized_function));
+    *output->mutable_library()->add_function() = std::move(vectorized_function);
+
+    nodes_to_delete.insert(map_node->name());
+    nodes_to_delete.insert(batch_node.name());
+    stats->num_changes++;
+  }
+
+  TF_RETURN_IF_ERROR(graph.DeleteNodes(nodes_to_delete));
+  return OkStatus();
+}
+
+REGISTER_GRAPH_OPTIMIZER_AS(MapVectorization, "map_vectorization");
+
+}  // namespace grappler
+}  // namespace tensorflow
@@ -0,0 +1,192 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/data/map_vectorization.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "tensorflow/core/framework/attr_value_util.h"
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/optimizers/data/graph_test_utils.h"
+#include "tensorflow/core/grappler/optimizers/data/graph_utils.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+using graph_tests_utils::MakeMapNode;
+using graph_tests_utils::MakeParallelMapV2Node;
+using test::function::NDef;
+
+// Creates a dataset node with the given element signature.
+NodeDef MakeInputNode(const std::vector<DataType>& output_types,
+                      const std::vector<PartialTensorShape>& output_shapes) {
+  return NDef("input", "TensorSliceDataset", {},
+              {{"output_shapes", output_shapes},
+               {"output_types", output_types}});
+}
+
+NodeDef MakeBatchNode(StringPiece input_node_name, int64_t batch_dimension,
+                      const std::vector<DataType>& output_types,
+                      const std::vector<PartialTensorShape>& element_shapes) {
+  std::vector<PartialTensorShape> output_shapes;
+  for (const PartialTensorShape& shape : element_shapes) {
+    output_shapes.push_back(
+        PartialTensorShape({batch_dimension}).Concatenate(shape));
+  }
+  return NDef("batch", "BatchDatasetV2",
+              {string(input_node_name), "batch_size", "drop_remainder"},
+              {{"parallel_copy", false},
+               {"output_shapes", output_shapes},
+               {"output_types", output_types}});
+}
+
+GrapplerItem MakeItem(const std::vector<DataType>& types,
+                      const std::vector<PartialTensorShape>& shapes,
+                      const NodeDef& map_node, int64_t batch_dimension,
+                      const FunctionDef& function) {
+  GrapplerItem item;
+  item.graph = test::function::GDef(
+      {MakeInputNode(types, shapes),
+       NDef("batch_size", "Const", {}, {{"value", 5}, {"dtype", DT_INT64}}),
+       NDef("drop_remainder", "Const", {},
+            {{"value", batch_dimension >= 0}, {"dtype", DT_BOOL}}),
+       NDef("num_parallel_calls", "Const", {},
+            {{"value", -1}, {"dtype", DT_INT64}}),
+       map_node,
+       MakeBatchNode(map_node.name(), batch_dimension, types, shapes)},
+      // FunctionLib
+      {function});
+  return item;
+}
+
+TEST(MapVectorizationTest, BatchesBeforeElementwiseMap) {
+  GrapplerItem item =
+      MakeItem({DT_INT64}, {PartialTensorShape({3})},
+               MakeMapNode("map", "input"), /*batch_dimension=*/-1,
+               test::function::XTimesTwo());
+
+  MapVectorization optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_FALSE(graph_utils::ContainsGraphNodeWithName("map", output));
+  EXPECT_FALSE(graph_utils::ContainsGraphNodeWithName("batch", output));
+  const NodeDef& batch_node = output.node(
+      graph_utils::FindGraphNodeWithOp("BatchDatasetV2", output));
+  const NodeDef& map_node =
+      output.node(graph_utils::FindGraphNodeWithOp("MapDataset", output));
+  EXPECT_EQ(batch_node.input(0), "input");
+  EXPECT_EQ(batch_node.input(1), "batch_size");
+  EXPECT_EQ(map_node.input(0), batch_node.name());
+
+  AttrValue expected_shapes;
+  SetAttrValue(std::vector<PartialTensorShape>{PartialTensorShape({-1, 3})},
+               &expected_shapes);
+  EXPECT_TRUE(AreAttrValuesEqual(batch_node.attr().at("output_shapes"),
+                                 expected_shapes));
+  EXPECT_TRUE(AreAttrValuesEqual(map_node.attr().at("output_shapes"),
+                                 expected_shapes));
+
+  const string& function_name = map_node.attr().at("f").func().name();
+  EXPECT_NE(function_name, "XTimesTwo");
+  EXPECT_TRUE(graph_utils::ContainsGraphFunctionWithName(function_name,
+                                                         output.library()));
+}
+
+TEST(MapVectorizationTest, BatchesBeforeElementwiseParallelMap) {
+  GrapplerItem item = MakeItem(
+      {DT_INT64}, {PartialTensorShape({})},
+      MakeParallelMapV2Node("map", "input", "num_parallel_calls", "XTimesTwo",
+                            "default"),
+      /*batch_dimension=*/5, test::function::XTimesTwo());
+
+  MapVectorization optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_FALSE(graph_utils::ContainsGraphNodeWithName("map", output));
+  EXPECT_FALSE(graph_utils::ContainsGraphNodeWithName("batch", output));
+  const NodeDef& batch_node = output.node(
+      graph_utils::FindGraphNodeWithOp("BatchDatasetV2", output));
+  const NodeDef& map_node = output.node(
+      graph_utils::FindGraphNodeWithOp("ParallelMapDatasetV2", output));
+  EXPECT_EQ(map_node.input(0), batch_node.name());
+  EXPECT_EQ(map_node.input(1), "num_parallel_calls");
+  EXPECT_EQ(batch_node.attr().at("output_shapes").list().shape(0).dim(0).size(),
+            5);
+}
+
+TEST(MapVectorizationTest, MatchingComponentShapes) {
+  GrapplerItem item = MakeItem(
+      {DT_INT64, DT_INT64}, {PartialTensorShape({3}), PartialTensorShape({3})},
+      MakeMapNode("map", "input", "XAddY"), /*batch_dimension=*/-1,
+      test::function::XAddY());
+
+  MapVectorization optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+  EXPECT_FALSE(graph_utils::ContainsGraphNodeWithName("map", output));
+}
+
+TEST(MapVectorizationTest, MismatchedComponentShapes) {
+  // Adding a scalar to a vector broadcasts differently once both have a
+  // leading batch dimension.
+  GrapplerItem item = MakeItem(
+      {DT_INT64, DT_INT64}, {PartialTensorShape({}), PartialTensorShape({3})},
+      MakeMapNode("map", "input", "XAddY"), /*batch_dimension=*/-1,
+      test::function::XAddY());
+
+  MapVectorization optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+  EXPECT_TRUE(graph_utils::ContainsGraphNodeWithName("map", output));
+  EXPECT_TRUE(graph_utils::ContainsGraphNodeWithName("batch", output));
+}
+
+TEST(MapVectorizationTest, UnknownShapes) {
+  GrapplerItem item = MakeItem({DT_INT64}, {PartialTensorShape({-1})},
+                               MakeMapNode("map", "input"),
+                               /*batch_dimension=*/-1,
+                               test::function::XTimesTwo());
+
+  MapVectorization optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+  EXPECT_TRUE(graph_utils::ContainsGraphNodeWithName("map", output));
+  EXPECT_TRUE(graph_utils::ContainsGraphNodeWithName("batch", output));
+}
+
+TEST(MapVectorizationTest, NonElementwiseFunction) {
+  GrapplerItem item = MakeItem({DT_INT64}, {PartialTensorShape({})},
+                               MakeMapNode("map", "input", "RandomUniformFn"),
+                               /*batch_dimension=*/-1,
+                               test::function::RandomUniform());
+
+  MapVectorization optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+  EXPECT_TRUE(graph_utils::ContainsGraphNodeWithName("map", output));
+  EXPECT_TRUE(graph_utils::ContainsGraphNodeWithName("batch", output));
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
@@ -271,6 +271,57 @@ TEST(ShuffleAndRepeatFusionTest, NoChange) {
   EXPECT_TRUE(graph_utils::Compare(*graph.graph(), output));
 }
 
+TEST(ShuffleAndRepeatFusionTest, NoChangeWithCompactBuffer) {
+  GrapplerItem item;
+  MutableGraphView graph(&item.graph);
+
+  std::vector<std::pair<string, AttrValue>> common_attrs(2);
+  AttrValue shapes_attr;
+  SetAttrValue(kOutputShapes, &shapes_attr);
+  common_attrs[0] = std::make_pair(kOutputShapes, shapes_attr);
+  AttrValue types_attr;
+  SetAttrValue(kOutputTypes, &types_attr);
+  common_attrs[1] = std::make_pair(kOutputTypes, types_attr);
+
+  NodeDef *start_node = graph_utils::AddScalarConstNode<int64_t>(0, &graph);
+  NodeDef *stop_node = graph_utils::AddScalarConstNode<int64_t>(10, &graph);
+  NodeDef *step_node = graph_utils::AddScalarConstNode<int64_t>(1, &graph);
+
+  std::vector<string> range_inputs(3);
+  range_inputs[0] = start_node->name();
+  range_inputs[1] = stop_node->name();
+  range_inputs[2] = step_node->name();
+  NodeDef *range_node = graph_utils::AddNode("", "RangeDataset", range_inputs,
+                                             common_attrs, &graph);
+
+  NodeDef *buffer_size_node =
+      graph_utils::AddScalarConstNode<int64_t>(128, &graph);
+  NodeDef *seed_node = graph_utils::AddScalarConstNode<int64_t>(-1, &graph);
+  NodeDef *seed2_node = graph_utils::AddScalarConstNode<int64_t>(-1, &graph);
+  std::vector<string> shuffle_inputs(4);
+  shuffle_inputs[0] = range_node->name();
+  shuffle_inputs[1] = buffer_size_node->name();
+  shuffle_inputs[2] = seed_node->name();
+  shuffle_inputs[3] = seed2_node->name();
+  NodeDef *shuffle_node = graph_utils::AddNode(
+      "", "ShuffleDataset", shuffle_inputs, common_attrs, &graph);
+  (*shuffle_node->mutable_attr())[kReshuffleEachIteration].set_b(true);
+  (*shuffle_node->mutable_attr())["compact_buffer"].set_b(true);
+
+  NodeDef *count_node = graph_utils::AddScalarConstNode<int64_t>(-1, &graph);
+  std::vector<string> repeat_inputs(2);
+  repeat_inputs[0] = shuffle_node->name();
+  repeat_inputs[1] = count_node->name();
+  graph_utils::AddNode("", "RepeatDataset", repeat_inputs, common_attrs,
+                       &graph);
+
+  ShuffleAndRepeatFusion optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_TRUE(graph_utils::Compare(*graph.graph(), output));
+}
+
 }  // namespace
 }  // namespace grappler
 }  // namespace tensorflow
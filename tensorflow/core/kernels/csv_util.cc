@@ -0,0 +1,134 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/kernels/csv_util.h"
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <system_error>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "absl/base/optimization.h"
+#include "absl/numeric/bits.h"
+#include "absl/strings/charconv.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Returns whether `field` is made only of the characters of a decimal number,
+// i.e. has no spaces, "inf", "nan" or hexadecimal digits, whose handling by
+// `absl::from_chars` differs from `strings::safe_strtof`.
+bool IsPlainDecimal(StringPiece field) {
+  for (char c : field) {
+    if (!((c >= '0' && c <= '9') || c == '.' || c == '-' || c == '+' ||
+          c == 'e' || c == 'E')) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename T>
+bool IntegerFieldToNumber(StringPiece field, T* value) {
+  const char* const end = field.data() + field.size();
+  T result;
+  const std::from_chars_result parsed =
+      std::from_chars(field.data(), end, result);
+  if (parsed.ec != std::errc() || parsed.ptr != end) return false;
+  *value = result;
+  return true;
+}
+
+template <typename T>
+bool FloatFieldToNumber(StringPiece field, T* value) {
+  // `strings::safe_strtof` rejects fields of `kFastToBufferSize` characters
+  // or more.
+  if (field.size() >= strings::kFastToBufferSize || !IsPlainDecimal(field)) {
+    return false;
+  }
+  const char* const end = field.data() + field.size();
+  T result;
+  const absl::from_chars_result parsed =
+      absl::from_chars(field.data(), end, result);
+  if (parsed.ec != std::errc() || parsed.ptr != end) return false;
+  *value = result;
+  return true;
+}
+
+}  // namespace
+
+CsvScanner::CsvScanner(char delim, bool use_quote_delim)
+    : delim_(delim), use_quote_delim_(use_quote_delim) {
+  std::memset(is_special_, 0, sizeof(is_special_));
+  is_special_[static_cast<uint8_t>(delim)] = true;
+  is_special_[static_cast<uint8_t>('\n')] = true;
+  is_special_[static_cast<uint8_t>('\r')] = true;
+  if (use_quote_delim) is_special_[static_cast<uint8_t>('"')] = true;
+}
+
+size_t CsvScanner::Find(StringPiece text, size_t pos) const {
+  const char* const data = text.data();
+  const size_t size = text.size();
+#if defined(__SSE2__)
+  const __m128i delim = _mm_set1_epi8(delim_);
+  const __m128i newline = _mm_set1_epi8('\n');
+  const __m128i carriage_return = _mm_set1_epi8('\r');
+  // Without quote delimiters, quotes are compared with the delimiter again.
+  const __m128i quote = _mm_set1_epi8(use_quote_delim_ ? '"' : delim_);
+  for (; pos + 16 <= size; pos += 16) {
+    const __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+    const __m128i matches = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(block, delim),
+                     _mm_cmpeq_epi8(block, quote)),
+        _mm_or_si128(_mm_cmpeq_epi8(block, newline),
+                     _mm_cmpeq_epi8(block, carriage_return)));
+    const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(matches));
+    if (mask != 0) return pos + absl::countr_zero(mask);
+  }
+#endif
+  for (; pos < size; ++pos) {
+    if (is_special_[static_cast<uint8_t>(data[pos])]) return pos;
+  }
+  return size;
+}
+
+bool CsvFieldToNumber(StringPiece field, int32_t* value) {
+  if (ABSL_PREDICT_TRUE(IntegerFieldToNumber(field, value))) return true;
+  return strings::safe_strto32(field, value);
+}
+
+bool CsvFieldToNumber(StringPiece field, int64_t* value) {
+  if (ABSL_PREDICT_TRUE(IntegerFieldToNumber(field, value))) return true;
+  return strings::safe_strto64(field, value);
+}
+
+bool CsvFieldToNumber(StringPiece field, float* value) {
+  if (ABSL_PREDICT_TRUE(FloatFieldToNumber(field, value))) return true;
+  return strings::safe_strtof(field, value);
+}
+
+bool CsvFieldToNumber(StringPiece field, double* value) {
+  if (ABSL_PREDICT_TRUE(FloatFieldToNumber(field, value))) return true;
+  return strings::safe_strtod(field, value);
+}
+
+}  // namespace tensorflow
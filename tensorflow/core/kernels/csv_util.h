@@ -0,0 +1,56 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_KERNELS_CSV_UTIL_H_
+#define TENSORFLOW_CORE_KERNELS_CSV_UTIL_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "tensorflow/core/lib/core/stringpiece.h"
+
+namespace tensorflow {
+
+// Finds the characters that delimit the fields of CSV records: the field
+// delimiter, line breaks and, if quotes delimit fields, the quote character.
+// With SSE2, 16 bytes are compared against all of them at once, so the bytes
+// of long fields are not looked at one by one.
+class CsvScanner {
+ public:
+  CsvScanner(char delim, bool use_quote_delim);
+
+  // Returns the position of the first delimiting character of `text` at or
+  // after `pos`, or `text.size()` if there is none.
+  size_t Find(StringPiece text, size_t pos) const;
+
+ private:
+  const char delim_;
+  const bool use_quote_delim_;
+  bool is_special_[256];
+};
+
+// Converts a CSV field to a number. These accept exactly the fields that
+// `strings::safe_strto32`, `safe_strto64`, `safe_strtof` and `safe_strtod`
+// accept, and return the same values. Plain decimal numbers are converted
+// with `std::from_chars` and `absl::from_chars`, and the rest (e.g. with
+// surrounding spaces, "inf" or hexadecimal floats) by the `strings::`
+// functions.
+bool CsvFieldToNumber(StringPiece field, int32_t* value);
+bool CsvFieldToNumber(StringPiece field, int64_t* value);
+bool CsvFieldToNumber(StringPiece field, float* value);
+bool CsvFieldToNumber(StringPiece field, double* value);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_CSV_UTIL_H_
@@ -0,0 +1,93 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/csv_util.h"
+
+#include <cstdint>
+#include <string>
+
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+TEST(CsvScannerTest, Find) {
+  const CsvScanner scanner(',', /*use_quote_delim=*/true);
+  EXPECT_EQ(scanner.Find("", 0), 0);
+  EXPECT_EQ(scanner.Find("abc", 0), 3);
+  EXPECT_EQ(scanner.Find("a,b", 0), 1);
+  EXPECT_EQ(scanner.Find("a,b", 2), 3);
+  EXPECT_EQ(scanner.Find("ab\"c", 0), 2);
+  EXPECT_EQ(scanner.Find("abc\r\n", 0), 3);
+  EXPECT_EQ(scanner.Find("abc\n", 0), 3);
+
+  // Delimiters in and after the blocks that are compared at once.
+  for (int length = 0; length < 70; ++length) {
+    std::string text(length, 'x');
+    EXPECT_EQ(scanner.Find(text, 0), length);
+    for (int pos = 0; pos < length; ++pos) {
+      text[pos] = ',';
+      EXPECT_EQ(scanner.Find(text, 0), pos);
+      EXPECT_EQ(scanner.Find(text, pos + 1), length);
+      text[pos] = 'x';
+    }
+  }
+}
+
+TEST(CsvScannerTest, FindWithoutQuoteDelim) {
+  const CsvScanner scanner('\t', /*use_quote_delim=*/false);
+  EXPECT_EQ(scanner.Find("a\"b,c\td", 0), 5);
+  EXPECT_EQ(scanner.Find(std::string(40, '"') + "\t", 0), 40);
+}
+
+TEST(CsvFieldToNumberTest, Integers) {
+  int32_t i32;
+  EXPECT_TRUE(CsvFieldToNumber("-123", &i32));
+  EXPECT_EQ(i32, -123);
+  EXPECT_TRUE(CsvFieldToNumber(" 42 ", &i32));
+  EXPECT_EQ(i32, 42);
+  EXPECT_FALSE(CsvFieldToNumber("2147483648", &i32));
+  EXPECT_FALSE(CsvFieldToNumber("12a", &i32));
+
+  int64_t i64;
+  EXPECT_TRUE(CsvFieldToNumber("9223372036854775807", &i64));
+  EXPECT_EQ(i64, 9223372036854775807LL);
+  EXPECT_FALSE(CsvFieldToNumber("1.5", &i64));
+}
+
+TEST(CsvFieldToNumberTest, MatchesSafeStrto) {
+  for (const char* field :
+       {"0", "-0", "1.5", "-2.25e10", "1e-50", "3.4028236e38", "1e400", ".5",
+        "5.", "+7", "1e", "--1", "inf", "-Infinity", "nan", " 1.5", "0x1p3",
+        "1.5f", "abc", "0.1000000000000000055511151231257827"}) {
+    float expected_float, actual_float;
+    const bool float_ok = strings::safe_strtof(field, &expected_float);
+    EXPECT_EQ(CsvFieldToNumber(field, &actual_float), float_ok) << field;
+    if (float_ok && expected_float == expected_float) {
+      EXPECT_EQ(actual_float, expected_float) << field;
+    }
+
+    double expected_double, actual_double;
+    const bool double_ok = strings::safe_strtod(field, &expected_double);
+    EXPECT_EQ(CsvFieldToNumber(field, &actual_double), double_ok) << field;
+    if (double_ok && expected_double == expected_double) {
+      EXPECT_EQ(actual_double, expected_double) << field;
+    }
+  }
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -74,6 +74,19 @@ constexpr char kIncompleteCacheErrorMessage[] =
     "contents of the dataset  will be discarded. This can happen if you have "
     "an input pipeline similar to `dataset.cache().take(k).repeat()`. You "
     "should use `dataset.take(k).cache().repeat()` instead.";
+
+// Returns the elements in `cache`, reading back the ones that were spilled.
+Status GetCachedElements(MemoryCache* cache,
+                         std::vector<std::vector<Tensor>>* elements) {
+  elements->clear();
+  for (;;) {
+    std::vector<Tensor> element;
+    bool found;
+    TF_RETURN_IF_ERROR(cache->Get(elements->size(), &element, &found));
+    if (!found) return OkStatus();
+    elements->push_back(std::move(element));
+  }
+}
 }  // namespace
 
 class PartialCache {
@@ -803,6 +816,15 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
 
     Status Initialize(IteratorContext* ctx) override {
       mutex_lock l(mu_);
+      // Only one iterator populates the cache. Iterators created while it is
+      // running produce the whole epoch from their own input.
+      if (cache_->IsCompleted()) {
+        mode_ = Mode::read;
+      } else if (cache_->AcquireWriter()) {
+        mode_ = Mode::write;
+      } else {
+        mode_ = Mode::bypass;
+      }
       return InitializeIterator(ctx);
     }
 
@@ -823,10 +845,13 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
     Status SaveInternal(SerializationContext* ctx,
                         IteratorStateWriter* writer) override {
       mutex_lock l(mu_);
-      if (cache_->IsCompleted()) {
+      TF_RETURN_IF_ERROR(writer->WriteScalar(prefix(), kMode, mode_));
+      if (mode_ != Mode::bypass && cache_->IsCompleted()) {
         TF_RETURN_IF_ERROR(writer->WriteScalar(prefix(), kCacheCompleted, ""));
+        std::vector<std::vector<Tensor>> elements;
+        TF_RETURN_IF_ERROR(GetCachedElements(cache_, &elements));
         TF_RETURN_IF_ERROR(
-            WriteElementsToCheckpoint(writer, prefix(), cache_->data()));
+            WriteElementsToCheckpoint(writer, prefix(), elements));
       }
       return SaveInput(ctx, writer, iterator_);
     }
@@ -835,12 +860,31 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
                            IteratorStateReader* reader) override {
       mutex_lock l(mu_);
       iterator_.reset();
-      cache_->Reset();
-      if (reader->Contains(prefix(), kCacheCompleted)) {
-        std::vector<std::vector<Tensor>> temp_cache;
-        TF_RETURN_IF_ERROR(
-            ReadElementsFromCheckpoint(ctx, reader, prefix(), &temp_cache));
-        cache_->Complete(std::move(temp_cache));
+      if (reader->Contains(prefix(), kMode)) {
+        int64_t temp;
+        TF_RETURN_IF_ERROR(reader->ReadScalar(prefix(), kMode, &temp));
+        mode_ = static_cast<Mode>(temp);
+      } else {
+        // Checkpoints written before the mode was saved.
+        mode_ = reader->Contains(prefix(), kCacheCompleted) ? Mode::read
+                                                             : Mode::write;
+      }
+      if (mode_ == Mode::write && !cache_->AcquireWriter()) {
+        // Another iterator has started populating the cache since the
+        // checkpoint was saved. The writer's input state is restored without
+        // caching its elements.
+        LOG(WARNING) << "The cache is being populated by another iterator. "
+                     << "The restored iterator will not cache its elements.";
+        mode_ = Mode::bypass;
+      }
+      if (mode_ != Mode::bypass) {
+        cache_->Reset();
+        if (reader->Contains(prefix(), kCacheCompleted)) {
+          std::vector<std::vector<Tensor>> temp_cache;
+          TF_RETURN_IF_ERROR(
+              ReadElementsFromCheckpoint(ctx, reader, prefix(), &temp_cache));
+          cache_->Complete(std::move(temp_cache));
+        }
       }
       TF_RETURN_IF_ERROR(InitializeIterator(ctx));
       return RestoreInput(ctx, reader, iterator_);
@@ -854,10 +898,11 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
 
       ~MemoryWriterIterator() override {
         mutex_lock l(mu_);
-        if (!temp_cache_.empty() && !cache_->IsCompleted()) {
+        if (cache_->size() > 0 && !cache_->IsCompleted()) {
           LOG(WARNING) << kIncompleteCacheErrorMessage;
           cache_->Reset();
         }
+        cache_->ReleaseWriter();
       }
 
       Status Initialize(IteratorContext* ctx) override {
@@ -874,16 +919,18 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
         if (*end_of_sequence) {
           if (!cache_->IsCompleted()) {
             VLOG(2) << "Finalizing the cache because EOF has been reached.";
-            cache_->Complete(std::move(temp_cache_));
+            cache_->Complete();
           }
           return OkStatus();
         }
         RecordBufferEnqueue(ctx, *out_tensors);
-        temp_cache_.emplace_back(*out_tensors);
-        if (temp_cache_.size() == dataset()->input_->Cardinality()) {
+        std::vector<Tensor> element = *out_tensors;
+        TF_RETURN_IF_ERROR(
+            cache_->Add(std::move(element), ctx->ram_budget_manager()));
+        if (cache_->size() == dataset()->input_->Cardinality()) {
           VLOG(2) << "Finalizing the cache because its size matches the "
                      "expected input cardinality.";
-          cache_->Complete(std::move(temp_cache_));
+          cache_->Complete();
         }
         return OkStatus();
       }
@@ -899,8 +946,10 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
                           IteratorStateWriter* writer) override {
         mutex_lock l(mu_);
         if (!cache_->IsCompleted()) {
+          std::vector<std::vector<Tensor>> elements;
+          TF_RETURN_IF_ERROR(GetCachedElements(cache_, &elements));
           TF_RETURN_IF_ERROR(
-              WriteElementsToCheckpoint(writer, prefix(), temp_cache_));
+              WriteElementsToCheckpoint(writer, prefix(), elements));
         }
         return SaveInput(ctx, writer, input_impl_);
       }
@@ -909,8 +958,13 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
                              IteratorStateReader* reader) override {
         mutex_lock l(mu_);
         if (!reader->Contains(prefix(), kCacheCompleted)) {
+          std::vector<std::vector<Tensor>> elements;
           TF_RETURN_IF_ERROR(
-              ReadElementsFromCheckpoint(ctx, reader, prefix(), &temp_cache_));
+              ReadElementsFromCheckpoint(ctx, reader, prefix(), &elements));
+          for (std::vector<Tensor>& element : elements) {
+            TF_RETURN_IF_ERROR(
+                cache_->Add(std::move(element), ctx->ram_budget_manager()));
+          }
         }
         return RestoreInput(ctx, reader, input_impl_);
       }
@@ -919,7 +973,6 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
       mutex mu_;
       std::unique_ptr<IteratorBase> input_impl_ TF_GUARDED_BY(mu_);
       MemoryCache* const cache_ TF_GUARDED_BY(mu_);  // not owned.
-      std::vector<std::vector<Tensor>> temp_cache_ TF_GUARDED_BY(mu_);
     };  // MemoryWriterIterator
 
     class MemoryReaderIterator : public DatasetIterator<MemoryDatasetBase> {
@@ -934,10 +987,13 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
         // dataset but performance modeling uses the iterator abstraction and
         // thus we record the memory allocated for the cache here. The caveat
         // is that this is incorrect if there are concurrent instances of this
-        // iterator.
+        // iterator. Spilled elements are not in memory, and are not recorded.
         tf_shared_lock l(mu_);
+        std::vector<Tensor> element;
         for (size_t i = 0; i < cache_->size(); ++i) {
-          RecordBufferEnqueue(ctx, cache_->at(i));
+          if (cache_->GetInMemory(i, &element)) {
+            RecordBufferEnqueue(ctx, element);
+          }
         }
         return OkStatus();
       }
@@ -946,17 +1002,15 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
                              std::vector<Tensor>* out_tensors,
                              bool* end_of_sequence) override {
         mutex_lock l(mu_);
-        if (index_ < cache_->size()) {
-          const std::vector<Tensor>& cache_tensors = cache_->at(index_);
-          out_tensors->insert(out_tensors->begin(), cache_tensors.begin(),
-                              cache_tensors.end());
+        bool found;
+        TF_RETURN_IF_ERROR(cache_->Get(index_, out_tensors, &found));
+        if (found) {
           index_++;
           *end_of_sequence = false;
-          return OkStatus();
         } else {
           *end_of_sequence = true;
-          return OkStatus();
         }
+        return OkStatus();
       }
 
      protected:
@@ -996,16 +1050,25 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
 
     Status InitializeIterator(IteratorContext* ctx)
         TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
-      if (cache_->IsCompleted()) {
-        iterator_ = std::make_unique<MemoryReaderIterator>(
-            MemoryReaderIterator::Params{dataset(),
-                                         strings::StrCat(prefix(), kImpl)},
-            cache_);
-      } else {
-        iterator_ = std::make_unique<MemoryWriterIterator>(
-            MemoryWriterIterator::Params{dataset(),
-                                         strings::StrCat(prefix(), kImpl)},
-            cache_);
+      // The input iterator of `Mode::bypass` uses the prefix of the
+      // `MemoryWriterIterator`'s input, so that a writer's checkpoint can be
+      // restored in `Mode::bypass`.
+      switch (mode_) {
+        case Mode::read:
+          iterator_ = std::make_unique<MemoryReaderIterator>(
+              MemoryReaderIterator::Params{dataset(),
+                                           strings::StrCat(prefix(), kImpl)},
+              cache_);
+          break;
+        case Mode::write:
+          iterator_ = std::make_unique<MemoryWriterIterator>(
+              MemoryWriterIterator::Params{dataset(),
+                                           strings::StrCat(prefix(), kImpl)},
+              cache_);
+          break;
+        case Mode::bypass:
+          return dataset()->input_->MakeIterator(
+              ctx, this, strings::StrCat(prefix(), kImpl), &iterator_);
       }
       TF_RETURN_IF_ERROR(iterator_->InitializeBase(ctx, this));
       return iterator_->Initialize(ctx);
@@ -1013,6 +1076,10 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
 
     mutex mu_;
     MemoryCache* cache_ TF_GUARDED_BY(mu_);  // not owned.
+    // `read` iterates over the completed cache, `write` populates it and
+    // `bypass` produces the elements of the input without caching them.
+    enum Mode { read, write, bypass };
+    Mode mode_ TF_GUARDED_BY(mu_);
     std::unique_ptr<IteratorBase> iterator_ TF_GUARDED_BY(mu_);
   };  // MemoryIterator
 
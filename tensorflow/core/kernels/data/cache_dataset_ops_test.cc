@@ -11,8 +11,10 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/kernels/data/cache_dataset_ops.h"
 
+#include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "tensorflow/core/data/dataset_test_base.h"
 #include "tensorflow/core/data/dataset_utils.h"
@@ -370,6 +372,132 @@ INSTANTIATE_TEST_CASE_P(CacheDatasetOpTest,
                         ParameterizedIteratorSaveAndRestoreTest,
                         ::testing::ValuesIn(IteratorSaveAndRestoreTestCases()));
 
+// Returns the elements that `iterator` produces until the end of sequence.
+std::vector<Tensor> GetRemainingOutputs(IteratorBase* iterator,
+                                        IteratorContext* ctx) {
+  std::vector<Tensor> outputs;
+  bool end_of_sequence = false;
+  while (!end_of_sequence) {
+    std::vector<Tensor> next;
+    TF_EXPECT_OK(iterator->GetNext(ctx, &next, &end_of_sequence));
+    outputs.insert(outputs.end(), next.begin(), next.end());
+  }
+  return outputs;
+}
+
+std::vector<Tensor> MemoryCacheOutputs() {
+  return CreateTensors<int64_t>(TensorShape({3, 1}),
+                                {{0, 1, 2}, {3, 4, 5}, {6, 7, 8}});
+}
+
+TEST_F(CacheDatasetOpTest, MemoryCacheReadWhilePopulated) {
+  auto dataset_params = CacheDatasetParams3();
+  TF_ASSERT_OK(Initialize(dataset_params));
+  // `iterator_` populates the cache.
+  bool end_of_sequence = false;
+  std::vector<Tensor> out_tensors;
+  TF_ASSERT_OK(
+      iterator_->GetNext(iterator_ctx_.get(), &out_tensors, &end_of_sequence));
+
+  // Another iterator produces the whole epoch without waiting for the cache.
+  std::unique_ptr<IteratorBase> reader;
+  TF_ASSERT_OK(dataset_->MakeIterator(iterator_ctx_.get(), /*parent=*/nullptr,
+                                      dataset_params.iterator_prefix(),
+                                      &reader));
+  TF_EXPECT_OK(
+      ExpectEqual(GetRemainingOutputs(reader.get(), iterator_ctx_.get()),
+                  MemoryCacheOutputs(), /*compare_order=*/true));
+
+  std::vector<Tensor> expected = MemoryCacheOutputs();
+  expected.erase(expected.begin());
+  TF_EXPECT_OK(
+      ExpectEqual(GetRemainingOutputs(iterator_.get(), iterator_ctx_.get()),
+                  expected, /*compare_order=*/true));
+
+  // Once the cache is completed, new iterators read it.
+  TF_ASSERT_OK(dataset_->MakeIterator(iterator_ctx_.get(), /*parent=*/nullptr,
+                                      dataset_params.iterator_prefix(),
+                                      &reader));
+  TF_EXPECT_OK(
+      ExpectEqual(GetRemainingOutputs(reader.get(), iterator_ctx_.get()),
+                  MemoryCacheOutputs(), /*compare_order=*/true));
+}
+
+TEST_F(CacheDatasetOpTest, MemoryCacheSaveAndRestoreWhilePopulated) {
+  auto dataset_params = CacheDatasetParams3();
+  TF_ASSERT_OK(Initialize(dataset_params));
+  bool end_of_sequence = false;
+  std::vector<Tensor> out_tensors;
+  TF_ASSERT_OK(
+      iterator_->GetNext(iterator_ctx_.get(), &out_tensors, &end_of_sequence));
+
+  std::unique_ptr<IteratorBase> reader;
+  TF_ASSERT_OK(dataset_->MakeIterator(iterator_ctx_.get(), /*parent=*/nullptr,
+                                      dataset_params.iterator_prefix(),
+                                      &reader));
+  out_tensors.clear();
+  TF_ASSERT_OK(
+      reader->GetNext(iterator_ctx_.get(), &out_tensors, &end_of_sequence));
+  std::unique_ptr<SerializationContext> serialization_ctx;
+  TF_ASSERT_OK(CreateSerializationContext(&serialization_ctx));
+  VariantTensorDataWriter writer;
+  TF_ASSERT_OK(reader->Save(serialization_ctx.get(), &writer));
+  std::vector<const VariantTensorData*> data;
+  writer.GetData(&data);
+
+  // The cache is completed before the restore. The restored iterator keeps
+  // producing the elements of its own input.
+  GetRemainingOutputs(iterator_.get(), iterator_ctx_.get());
+  VariantTensorDataReader checkpoint(data);
+  TF_ASSERT_OK(RestoreIterator(iterator_ctx_.get(), &checkpoint,
+                               dataset_params.iterator_prefix(), *dataset_,
+                               &reader));
+  std::vector<Tensor> expected = MemoryCacheOutputs();
+  expected.erase(expected.begin());
+  TF_EXPECT_OK(
+      ExpectEqual(GetRemainingOutputs(reader.get(), iterator_ctx_.get()),
+                  expected, /*compare_order=*/true));
+}
+
+TEST_F(CacheDatasetOpTest, MemoryCacheRestoreWriterWhilePopulated) {
+  auto dataset_params = CacheDatasetParams3();
+  TF_ASSERT_OK(Initialize(dataset_params));
+  bool end_of_sequence = false;
+  std::vector<Tensor> out_tensors;
+  TF_ASSERT_OK(
+      iterator_->GetNext(iterator_ctx_.get(), &out_tensors, &end_of_sequence));
+  std::unique_ptr<SerializationContext> serialization_ctx;
+  TF_ASSERT_OK(CreateSerializationContext(&serialization_ctx));
+  VariantTensorDataWriter writer;
+  TF_ASSERT_OK(iterator_->Save(serialization_ctx.get(), &writer));
+  std::vector<const VariantTensorData*> data;
+  writer.GetData(&data);
+
+  // `iterator_` still populates the cache, so the restored writer produces
+  // its elements without caching them.
+  VariantTensorDataReader checkpoint(data);
+  std::unique_ptr<IteratorBase> restored;
+  TF_ASSERT_OK(RestoreIterator(iterator_ctx_.get(), &checkpoint,
+                               dataset_params.iterator_prefix(), *dataset_,
+                               &restored));
+  std::vector<Tensor> expected = MemoryCacheOutputs();
+  expected.erase(expected.begin());
+  TF_EXPECT_OK(
+      ExpectEqual(GetRemainingOutputs(restored.get(), iterator_ctx_.get()),
+                  expected, /*compare_order=*/true));
+  TF_EXPECT_OK(
+      ExpectEqual(GetRemainingOutputs(iterator_.get(), iterator_ctx_.get()),
+                  expected, /*compare_order=*/true));
+
+  std::unique_ptr<IteratorBase> reader;
+  TF_ASSERT_OK(dataset_->MakeIterator(iterator_ctx_.get(), /*parent=*/nullptr,
+                                      dataset_params.iterator_prefix(),
+                                      &reader));
+  TF_EXPECT_OK(
+      ExpectEqual(GetRemainingOutputs(reader.get(), iterator_ctx_.get()),
+                  MemoryCacheOutputs(), /*compare_order=*/true));
+}
+
 }  // namespace
 }  // namespace data
 }  // namespace tensorflow
@@ -14,14 +14,20 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/kernels/data/cache_ops.h"
 
+#include <string>
+#include <utility>
+
 #include "tensorflow/core/data/dataset_utils.h"
 #include "tensorflow/core/framework/dataset.h"
 #include "tensorflow/core/framework/partial_tensor_shape.h"
 #include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/lib/random/philox_random.h"
 #include "tensorflow/core/lib/random/random.h"
 #include "tensorflow/core/lib/random/random_distributions.h"
+#include "tensorflow/core/platform/coding.h"
+#include "tensorflow/core/platform/env.h"
 
 namespace tensorflow {
 namespace data {
@@ -29,14 +35,217 @@ namespace {
 
 constexpr char kMemoryCache[] = "MemoryCache";
 
+// Returns whether `element` can be serialized to the spill file. Variants,
+// such as nested datasets, and resources are kept in memory.
+bool IsSpillable(const std::vector<Tensor>& element) {
+  for (const Tensor& tensor : element) {
+    if (tensor.dtype() == DT_VARIANT || tensor.dtype() == DT_RESOURCE) {
+      return false;
+    }
+  }
+  return true;
+}
+
 }  // namespace
 
 string MemoryCacheManager::DebugString() const { return kMemoryCache; }
 
+// A local file that the elements past the RAM budget are appended to.
+class MemoryCache::SpillFile {
+ public:
+  static Status Create(std::shared_ptr<SpillFile>* spill_file) {
+    Env* env = Env::Default();
+    std::string path;
+    if (!env->LocalTempFilename(&path)) {
+      return errors::Unavailable(
+          "Failed to create a local file to spill the cache to.");
+    }
+    std::unique_ptr<WritableFile> file;
+    TF_RETURN_IF_ERROR(env->NewWritableFile(path, &file));
+    std::unique_ptr<RandomAccessFile> reader;
+    TF_RETURN_IF_ERROR(env->NewRandomAccessFile(path, &reader));
+    VLOG(2) << "Spilling the cache to " << path;
+    spill_file->reset(
+        new SpillFile(std::move(path), std::move(file), std::move(reader)));
+    return OkStatus();
+  }
+
+  ~SpillFile() {
+    if (file_ != nullptr) file_->Close().IgnoreError();
+    mapped_.reset();
+    Env::Default()->DeleteFile(path_).IgnoreError();
+  }
+
+  // Appends `data` to the file, and sets `*offset` to where it starts.
+  Status Append(StringPiece data, uint64* offset) {
+    mutex_lock l(mu_);
+    if (file_ == nullptr) {
+      return errors::FailedPrecondition("The cache spill file is closed.");
+    }
+    TF_RETURN_IF_ERROR(file_->Append(data));
+    *offset = size_;
+    size_ += data.size();
+    return OkStatus();
+  }
+
+  // Closes the file for appending, and maps it into memory for reading.
+  Status Finish() {
+    mutex_lock l(mu_);
+    if (file_ == nullptr) return OkStatus();
+    Status s = file_->Close();
+    file_ = nullptr;
+    flushed_size_ = size_;
+    TF_RETURN_IF_ERROR(s);
+    return Env::Default()->NewReadOnlyMemoryRegionFromFile(path_, &mapped_);
+  }
+
+  // Reads the element that was appended as `size` bytes at `offset`.
+  Status ReadElement(uint64 offset, uint64 size,
+                     std::vector<Tensor>* element) {
+    StringPiece data;
+    std::string scratch;
+    bool mapped = false;
+    {
+      mutex_lock l(mu_);
+      if (mapped_ != nullptr) {
+        data = StringPiece(static_cast<const char*>(mapped_->data()) + offset,
+                           size);
+        mapped = true;
+      } else if (offset + size > flushed_size_) {
+        TF_RETURN_IF_ERROR(file_->Flush());
+        flushed_size_ = size_;
+      }
+    }
+    if (!mapped) {
+      scratch.resize(size);
+      TF_RETURN_IF_ERROR(reader_->Read(offset, size, &data, &scratch[0]));
+      if (data.size() != size) {
+        return errors::DataLoss("Truncated cache spill file ", path_);
+      }
+    }
+
+    element->clear();
+    while (!data.empty()) {
+      uint64 length;
+      TensorProto proto;
+      Tensor tensor;
+      if (!core::GetVarint64(&data, &length) || length > data.size() ||
+          !proto.ParseFromArray(data.data(), length) ||
+          !tensor.FromProto(proto)) {
+        return errors::DataLoss("Corrupted cache spill file ", path_);
+      }
+      element->push_back(std::move(tensor));
+      data.remove_prefix(length);
+    }
+    return OkStatus();
+  }
+
+ private:
+  SpillFile(std::string path, std::unique_ptr<WritableFile> file,
+            std::unique_ptr<RandomAccessFile> reader)
+      : path_(std::move(path)),
+        reader_(std::move(reader)),
+        file_(std::move(file)) {}
+
+  const std::string path_;
+  const std::unique_ptr<RandomAccessFile> reader_;
+
+  mutex mu_;
+  std::unique_ptr<WritableFile> file_ TF_GUARDED_BY(mu_);
+  // Number of bytes appended, and the prefix of them that `reader_` sees.
+  uint64 size_ TF_GUARDED_BY(mu_) = 0;
+  uint64 flushed_size_ TF_GUARDED_BY(mu_) = 0;
+  std::unique_ptr<ReadOnlyMemoryRegion> mapped_ TF_GUARDED_BY(mu_);
+};
+
+MemoryCache::~MemoryCache() {
+  mutex_lock l(mu_);
+  Clear();
+}
+
+Status MemoryCache::Add(
+    std::vector<Tensor>&& element,
+    const std::shared_ptr<model::RamBudgetManager>& ram_budget_manager) {
+  std::shared_ptr<SpillFile> spill_file;
+  {
+    mutex_lock l(mu_);
+    if (ram_budget_manager_ == nullptr) {
+      ram_budget_manager_ = ram_budget_manager;
+    }
+    if (ram_budget_manager_ == nullptr || !IsSpillable(element)) {
+      cache_.push_back(Element{std::move(element)});
+      return OkStatus();
+    }
+    const int64_t bytes = GetAllocatedBytes(element);
+    if (ram_budget_manager_->RequestCacheBytes(bytes)) {
+      budgeted_bytes_ += bytes;
+      cache_.push_back(Element{std::move(element)});
+      return OkStatus();
+    }
+    spill_file = spill_file_;
+  }
+
+  // Writes outside of the lock, so that readers of the cache do not wait for
+  // the file. The elements are added by a single writer, so they stay in
+  // order.
+  if (spill_file == nullptr) {
+    TF_RETURN_IF_ERROR(SpillFile::Create(&spill_file));
+  }
+  Element entry;
+  TF_RETURN_IF_ERROR(Spill(element, spill_file.get(), &entry));
+  mutex_lock l(mu_);
+  if (spill_file_ == nullptr) {
+    spill_file_ = std::move(spill_file);
+  } else if (spill_file_ != spill_file) {
+    return errors::Aborted(
+        "The cache was reset while an element was being spilled.");
+  }
+  cache_.push_back(std::move(entry));
+  ++num_spilled_;
+  return OkStatus();
+}
+
+Status MemoryCache::Spill(const std::vector<Tensor>& element,
+                          SpillFile* spill_file, Element* spilled) {
+  std::string data;
+  for (const Tensor& tensor : element) {
+    TensorProto proto;
+    tensor.AsProtoTensorContent(&proto);
+    core::PutVarint64(&data, proto.ByteSizeLong());
+    proto.AppendToString(&data);
+  }
+  spilled->size = data.size();
+  return spill_file->Append(data, &spilled->offset);
+}
+
+void MemoryCache::Complete() {
+  std::shared_ptr<SpillFile> spill_file;
+  {
+    mutex_lock l(mu_);
+    if (completed_) return;
+    completed_ = true;
+    spill_file = spill_file_;
+  }
+  // Until the file is mapped, readers read the spilled elements from it.
+  if (spill_file != nullptr) {
+    Status s = spill_file->Finish();
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to map the cache spill file, reading it instead: "
+                   << s;
+    }
+  }
+}
+
 void MemoryCache::Complete(std::vector<std::vector<Tensor>>&& cache) {
+  // Outlives the lock, so that the file is deleted outside of it.
+  std::shared_ptr<SpillFile> spill_file;
   mutex_lock l(mu_);
   if (!completed_) {
-    cache_ = std::move(cache);
+    spill_file = Clear();
+    cache_.reserve(cache.size());
+    for (std::vector<Tensor>& element : cache) {
+      cache_.push_back(Element{std::move(element)});
+    }
     completed_ = true;
   }
 }
@@ -47,15 +256,64 @@ bool MemoryCache::IsCompleted() {
 }
 
 void MemoryCache::Reset() {
+  // Outlives the lock, so that the file is deleted outside of it.
+  std::shared_ptr<SpillFile> spill_file;
   mutex_lock l(mu_);
   completed_ = false;
+  spill_file = Clear();
+}
+
+std::shared_ptr<MemoryCache::SpillFile> MemoryCache::Clear() {
+  if (budgeted_bytes_ > 0) {
+    // Releases always succeed.
+    ram_budget_manager_->RequestCacheBytes(-budgeted_bytes_);
+    budgeted_bytes_ = 0;
+  }
   cache_.clear();
+  num_spilled_ = 0;
+  return std::move(spill_file_);
+}
+
+bool MemoryCache::AcquireWriter() {
+  mutex_lock l(mu_);
+  if (has_writer_) return false;
+  has_writer_ = true;
+  return true;
+}
+
+void MemoryCache::ReleaseWriter() {
+  mutex_lock l(mu_);
+  has_writer_ = false;
+}
+
+Status MemoryCache::Get(int64_t index, std::vector<Tensor>* element,
+                        bool* found) {
+  std::shared_ptr<SpillFile> spill_file;
+  uint64 offset;
+  uint64 size;
+  {
+    tf_shared_lock l(mu_);
+    *found = index < cache_.size();
+    if (!*found) return OkStatus();
+    const Element& entry = cache_[index];
+    if (entry.size == 0) {
+      *element = entry.tensors;
+      return OkStatus();
+    }
+    spill_file = spill_file_;
+    offset = entry.offset;
+    size = entry.size;
+  }
+  // Reads outside of the lock, so that readers of the in-memory elements and
+  // the writer do not wait for the file.
+  return spill_file->ReadElement(offset, size, element);
 }
 
-const std::vector<Tensor>& MemoryCache::at(int64_t index) {
+bool MemoryCache::GetInMemory(int64_t index, std::vector<Tensor>* element) {
   tf_shared_lock l(mu_);
-  DCHECK(index < cache_.size());
-  return cache_[index];
+  if (index >= cache_.size() || cache_[index].size > 0) return false;
+  *element = cache_[index].tensors;
+  return true;
 }
 
 size_t MemoryCache::size() {
@@ -63,9 +321,9 @@ size_t MemoryCache::size() {
   return cache_.size();
 }
 
-const std::vector<std::vector<Tensor>>& MemoryCache::data() {
+size_t MemoryCache::num_spilled() {
   tf_shared_lock l(mu_);
-  return cache_;
+  return num_spilled_;
 }
 
 AnonymousMemoryCacheHandleOp::AnonymousMemoryCacheHandleOp(
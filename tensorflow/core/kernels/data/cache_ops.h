@@ -16,8 +16,13 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_KERNELS_DATA_CACHE_OPS_H_
 #define TENSORFLOW_CORE_KERNELS_DATA_CACHE_OPS_H_
 
+#include <memory>
+#include <vector>
+
 #include "tensorflow/core/data/dataset_utils.h"
+#include "tensorflow/core/framework/model.h"
 #include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/tensor.h"
 
 namespace tensorflow {
 namespace data {
@@ -25,13 +30,29 @@ namespace data {
 // A thread-safe data structure for caching dataset elements.
 //
 // The expected use is that a single `MemoryWriterIterator` populates the
-// cache with dataset elements. Once all elements are cached, the cache can
-// be used by one or more `MemoryReaderIterator`s.
+// cache with dataset elements. Elements are visible as soon as they are added,
+// so `MemoryReaderIterator`s can stream the cached prefix before the cache is
+// completed.
+//
+// Elements are kept in memory as long as the `RamBudgetManager` of the writer
+// grants their bytes. Elements past the budget are serialized to a local file,
+// which is memory mapped for reading once the cache is completed.
 class MemoryCache {
  public:
   MemoryCache() = default;
+  ~MemoryCache();
+
+  // Appends `element` to the cache. If `ram_budget_manager` is null, the
+  // element is kept in memory.
+  Status Add(
+      std::vector<Tensor>&& element,
+      const std::shared_ptr<model::RamBudgetManager>& ram_budget_manager);
 
   // Marks the cache as completed.
+  void Complete();
+
+  // Replaces the contents of the cache with `cache` and marks the cache as
+  // completed, unless it is already completed.
   void Complete(std::vector<std::vector<Tensor>>&& cache);
 
   // Returns whether the cache is completed.
@@ -40,21 +61,55 @@ class MemoryCache {
   // Resets the cache.
   void Reset();
 
-  // Returns the element at the given index.
-  const std::vector<Tensor>& at(int64_t index);
+  // Claims the right to populate the cache, returning false if another writer
+  // holds it. The claim is released by `ReleaseWriter()`.
+  bool AcquireWriter();
+  void ReleaseWriter();
+
+  // Sets `*element` to the element at the given index and `*found` to true,
+  // or `*found` to false if the cache does not have that many elements.
+  Status Get(int64_t index, std::vector<Tensor>* element, bool* found);
+
+  // Like `Get()`, but only returns elements that are kept in memory.
+  bool GetInMemory(int64_t index, std::vector<Tensor>* element);
 
   // Returns the size of the cache.
   size_t size();
 
-  // Returns a reference to the cache's data. The returned reference will be
-  // invalidated by any call to Reset().
-  const std::vector<std::vector<Tensor>>& data();
+  // Returns the number of elements that were spilled to the local file.
+  size_t num_spilled();
 
  private:
+  class SpillFile;
+
+  struct Element {
+    // The tensors of an element that is kept in memory.
+    std::vector<Tensor> tensors;
+    // The location of an element in the spill file, if `size` is positive.
+    uint64 offset = 0;
+    uint64 size = 0;
+  };
+
+  // Serializes `element` to `spill_file`.
+  static Status Spill(const std::vector<Tensor>& element,
+                      SpillFile* spill_file, Element* spilled);
+
+  // Releases the budget of the in-memory elements and removes all elements.
+  // Returns the spill file, which the caller deletes outside of `mu_`.
+  std::shared_ptr<SpillFile> Clear() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
   mutex mu_;
   // Determines whether all elements of the dataset have been cached.
   bool completed_ TF_GUARDED_BY(mu_) = false;
-  std::vector<std::vector<Tensor>> cache_ TF_GUARDED_BY(mu_);
+  bool has_writer_ TF_GUARDED_BY(mu_) = false;
+  std::vector<Element> cache_ TF_GUARDED_BY(mu_);
+  size_t num_spilled_ TF_GUARDED_BY(mu_) = 0;
+  // Bytes of the in-memory elements that `ram_budget_manager_` has granted.
+  int64_t budgeted_bytes_ TF_GUARDED_BY(mu_) = 0;
+  std::shared_ptr<model::RamBudgetManager> ram_budget_manager_
+      TF_GUARDED_BY(mu_);
+  // Shared with the readers of spilled elements, so that it outlives a reset.
+  std::shared_ptr<SpillFile> spill_file_ TF_GUARDED_BY(mu_);
 };
 
 // A resource wrapping a shared instance of a memory cache.
@@ -0,0 +1,98 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/data/cache_ops.h"
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/model.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+std::vector<Tensor> MakeElement(int64_t value) {
+  return {test::AsTensor<int64_t>({value, value + 1, value + 2}),
+          test::AsTensor<tstring>({strings::StrCat("element_", value)})};
+}
+
+void ExpectElement(MemoryCache* cache, int64_t index) {
+  std::vector<Tensor> element;
+  bool found;
+  TF_ASSERT_OK(cache->Get(index, &element, &found));
+  ASSERT_TRUE(found);
+  std::vector<Tensor> expected = MakeElement(index);
+  ASSERT_EQ(expected.size(), element.size());
+  test::ExpectTensorEqual<int64_t>(expected[0], element[0]);
+  test::ExpectTensorEqual<tstring>(expected[1], element[1]);
+}
+
+TEST(MemoryCacheTest, UnboundedWithoutRamBudget) {
+  MemoryCache cache;
+  for (int64_t i = 0; i < 10; ++i) {
+    TF_ASSERT_OK(cache.Add(MakeElement(i), /*ram_budget_manager=*/nullptr));
+  }
+  cache.Complete();
+  EXPECT_EQ(10, cache.size());
+  EXPECT_EQ(0, cache.num_spilled());
+  for (int64_t i = 0; i < 10; ++i) ExpectElement(&cache, i);
+}
+
+TEST(MemoryCacheTest, SpillsPastRamBudget) {
+  // The budget fits three elements.
+  const int64_t element_bytes = GetAllocatedBytes(MakeElement(0));
+  const int64_t budget = 3 * element_bytes + 1;
+  auto ram_budget_manager = std::make_shared<model::RamBudgetManager>(budget);
+  MemoryCache cache;
+  for (int64_t i = 0; i < 10; ++i) {
+    TF_ASSERT_OK(cache.Add(MakeElement(i), ram_budget_manager));
+    // Elements are readable before the cache is completed, including the
+    // spilled ones.
+    ExpectElement(&cache, i);
+  }
+  EXPECT_EQ(7, cache.num_spilled());
+  EXPECT_EQ(1, ram_budget_manager->AvailableModelRam());
+
+  std::vector<Tensor> element;
+  EXPECT_TRUE(cache.GetInMemory(0, &element));
+  EXPECT_FALSE(cache.GetInMemory(9, &element));
+  bool found;
+  TF_ASSERT_OK(cache.Get(10, &element, &found));
+  EXPECT_FALSE(found);
+
+  // Completing the cache maps the spilled elements.
+  cache.Complete();
+  for (int64_t i = 0; i < 10; ++i) ExpectElement(&cache, i);
+
+  cache.Reset();
+  EXPECT_EQ(0, cache.size());
+  EXPECT_EQ(budget, ram_budget_manager->AvailableModelRam());
+}
+
+TEST(MemoryCacheTest, SingleWriter) {
+  MemoryCache cache;
+  EXPECT_TRUE(cache.AcquireWriter());
+  EXPECT_FALSE(cache.AcquireWriter());
+  cache.ReleaseWriter();
+  EXPECT_TRUE(cache.AcquireWriter());
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
@@ -0,0 +1,359 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/kernels/data/experimental/columnar_file_dataset_op.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/data/columnar_file_utils.h"
+#include "tensorflow/core/data/name_utils.h"
+#include "tensorflow/core/data/utils.h"
+#include "tensorflow/core/framework/dataset.h"
+#include "tensorflow/core/framework/metrics.h"
+#include "tensorflow/core/framework/partial_tensor_shape.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+namespace data {
+namespace experimental {
+
+// Constants declared in columnar_file_dataset_op.h and used both here and in
+// test cases.
+/* static */ constexpr const char* const ColumnarFileDatasetOp::kDatasetType;
+/* static */ constexpr const char* const ColumnarFileDatasetOp::kFileNames;
+/* static */ constexpr const char* const ColumnarFileDatasetOp::kColumns;
+/* static */ constexpr const char* const ColumnarFileDatasetOp::kBatchSize;
+/* static */ constexpr const char* const ColumnarFileDatasetOp::kDropRemainder;
+/* static */ constexpr const char* const ColumnarFileDatasetOp::kOutputTypes;
+/* static */ constexpr const char* const ColumnarFileDatasetOp::kOutputShapes;
+
+namespace {
+
+constexpr char kCurrentFileIndex[] = "current_file_index";
+constexpr char kRowGroup[] = "row_group";
+constexpr char kRowOffset[] = "row_offset";
+
+}  // namespace
+
+class ColumnarFileDatasetOp::Dataset : public DatasetBase {
+ public:
+  Dataset(OpKernelContext* ctx, std::vector<string> filenames,
+          std::vector<string> columns, int64_t batch_size, bool drop_remainder,
+          const DataTypeVector& output_types,
+          const std::vector<PartialTensorShape>& output_shapes)
+      : DatasetBase(DatasetContext(ctx)),
+        filenames_(std::move(filenames)),
+        columns_(std::move(columns)),
+        batch_size_(batch_size),
+        drop_remainder_(drop_remainder),
+        output_types_(output_types),
+        output_shapes_(output_shapes) {}
+
+  std::unique_ptr<IteratorBase> MakeIteratorInternal(
+      const string& prefix) const override {
+    return std::make_unique<Iterator>(Iterator::Params{
+        this, name_utils::IteratorPrefix(kDatasetType, prefix)});
+  }
+
+  const DataTypeVector& output_dtypes() const override {
+    return output_types_;
+  }
+
+  const std::vector<PartialTensorShape>& output_shapes() const override {
+    return output_shapes_;
+  }
+
+  string DebugString() const override {
+    return name_utils::DatasetDebugString(kDatasetType);
+  }
+
+  Status InputDatasets(std::vector<const DatasetBase*>* inputs) const override {
+    return OkStatus();
+  }
+
+  Status CheckExternalState() const override { return OkStatus(); }
+
+ protected:
+  Status AsGraphDefInternal(SerializationContext* ctx,
+                            DatasetGraphDefBuilder* b,
+                            Node** output) const override {
+    Node* filenames = nullptr;
+    Node* columns = nullptr;
+    Node* batch_size = nullptr;
+    Node* drop_remainder = nullptr;
+    TF_RETURN_IF_ERROR(b->AddVector(filenames_, &filenames));
+    TF_RETURN_IF_ERROR(b->AddVector(columns_, &columns));
+    TF_RETURN_IF_ERROR(b->AddScalar(batch_size_, &batch_size));
+    TF_RETURN_IF_ERROR(b->AddScalar(drop_remainder_, &drop_remainder));
+    TF_RETURN_IF_ERROR(b->AddDataset(
+        this, {filenames, columns, batch_size, drop_remainder}, output));
+    return OkStatus();
+  }
+
+ private:
+  // A file being read, along with the indices of the requested columns in it.
+  struct OpenFile {
+    std::unique_ptr<ColumnarFileReader> reader;
+    std::vector<int> column_indices;
+  };
+
+  // A range of rows of a row group, which contributes to a batch.
+  struct Segment {
+    std::shared_ptr<const OpenFile> file;
+    int64_t row_group;
+    int64_t start;
+    int64_t num_rows;
+  };
+
+  class Iterator : public DatasetIterator<Dataset> {
+   public:
+    explicit Iterator(const Params& params)
+        : DatasetIterator<Dataset>(params) {}
+
+    bool SymbolicCheckpointCompatible() const override { return true; }
+
+    Status GetNextInternal(IteratorContext* ctx,
+                           std::vector<Tensor>* out_tensors,
+                           bool* end_of_sequence) override {
+      std::vector<Segment> segments;
+      int64_t num_rows = 0;
+      {
+        mutex_lock l(mu_);
+        while (num_rows < dataset()->batch_size_) {
+          if (!file_) {
+            // Iteration ends when there are no more files to process.
+            if (current_file_index_ == dataset()->filenames_.size()) break;
+            TF_RETURN_IF_ERROR(OpenFileLocked(ctx->env()));
+          }
+          if (row_group_ == file_->reader->num_row_groups()) {
+            file_.reset();
+            ++current_file_index_;
+            row_group_ = 0;
+            continue;
+          }
+          const int64_t group_rows = file_->reader->num_rows(row_group_);
+          const int64_t n = std::min(group_rows - row_offset_,
+                                     dataset()->batch_size_ - num_rows);
+          if (n > 0) {
+            segments.push_back({file_, row_group_, row_offset_, n});
+            num_rows += n;
+            row_offset_ += n;
+          }
+          if (row_offset_ == group_rows) {
+            ++row_group_;
+            row_offset_ = 0;
+          }
+        }
+      }
+      if (num_rows == 0 ||
+          (dataset()->drop_remainder_ && num_rows < dataset()->batch_size_)) {
+        *end_of_sequence = true;
+        return OkStatus();
+      }
+
+      static monitoring::CounterCell* bytes_counter =
+          metrics::GetTFDataBytesReadCounter(kDatasetType);
+      out_tensors->reserve(dataset()->columns_.size());
+      for (int i = 0; i < dataset()->columns_.size(); ++i) {
+        Tensor batch;
+        if (segments.size() == 1) {
+          // The rows come from a single column chunk, so they can be returned
+          // without copying if the alignment allows it.
+          const Segment& segment = segments[0];
+          TF_ASSIGN_OR_RETURN(
+              batch, segment.file->reader->Read(
+                         segment.row_group, segment.file->column_indices[i],
+                         segment.start, segment.num_rows));
+        } else {
+          const ColumnarFileReader& reader = *segments[0].file->reader;
+          TensorShape shape({num_rows});
+          shape.AppendShape(
+              reader.columns()[segments[0].file->column_indices[i]].shape);
+          batch = Tensor(ctx->allocator({}), dataset()->output_types_[i],
+                         shape);
+          int64_t offset = 0;
+          for (const Segment& segment : segments) {
+            TF_RETURN_IF_ERROR(segment.file->reader->CopyTo(
+                segment.row_group, segment.file->column_indices[i],
+                segment.start, segment.num_rows, &batch, offset));
+            offset += segment.num_rows;
+          }
+        }
+        bytes_counter->IncrementBy(batch.TotalBytes());
+        out_tensors->push_back(std::move(batch));
+      }
+      *end_of_sequence = false;
+      return OkStatus();
+    }
+
+   protected:
+    std::shared_ptr<model::Node> CreateNode(
+        IteratorContext* ctx, model::Node::Args args) const override {
+      return model::MakeSourceNode(std::move(args));
+    }
+
+    Status SaveInternal(SerializationContext* ctx,
+                        IteratorStateWriter* writer) override {
+      mutex_lock l(mu_);
+      TF_RETURN_IF_ERROR(writer->WriteScalar(prefix(), kCurrentFileIndex,
+                                             current_file_index_));
+      // The position within the file is written only if a file is open.
+      if (file_) {
+        TF_RETURN_IF_ERROR(
+            writer->WriteScalar(prefix(), kRowGroup, row_group_));
+        TF_RETURN_IF_ERROR(
+            writer->WriteScalar(prefix(), kRowOffset, row_offset_));
+      }
+      return OkStatus();
+    }
+
+    Status RestoreInternal(IteratorContext* ctx,
+                           IteratorStateReader* reader) override {
+      mutex_lock l(mu_);
+      file_.reset();
+      row_group_ = 0;
+      row_offset_ = 0;
+      int64_t current_file_index;
+      TF_RETURN_IF_ERROR(
+          reader->ReadScalar(prefix(), kCurrentFileIndex, &current_file_index));
+      if (current_file_index < 0 ||
+          current_file_index > dataset()->filenames_.size()) {
+        return errors::FailedPrecondition(
+            "Invalid checkpoint: file index ", current_file_index,
+            " is out of range.");
+      }
+      current_file_index_ = current_file_index;
+      if (reader->Contains(prefix(), kRowGroup)) {
+        TF_RETURN_IF_ERROR(OpenFileLocked(ctx->env()));
+        TF_RETURN_IF_ERROR(
+            reader->ReadScalar(prefix(), kRowGroup, &row_group_));
+        TF_RETURN_IF_ERROR(
+            reader->ReadScalar(prefix(), kRowOffset, &row_offset_));
+        if (row_group_ < 0 || row_group_ > file_->reader->num_row_groups() ||
+            row_offset_ < 0 ||
+            (row_group_ < file_->reader->num_row_groups() &&
+             row_offset_ > file_->reader->num_rows(row_group_))) {
+          return errors::FailedPrecondition(
+              "Invalid checkpoint: position in file ",
+              dataset()->filenames_[current_file_index_], " is out of range.");
+        }
+      }
+      return OkStatus();
+    }
+
+   private:
+    // Opens the file at `current_file_index_` and resolves the requested
+    // columns in it.
+    Status OpenFileLocked(Env* env) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      const string& filename = dataset()->filenames_[current_file_index_];
+      auto file = std::make_shared<OpenFile>();
+      TF_ASSIGN_OR_RETURN(file->reader, ColumnarFileReader::Open(
+                                            env, TranslateFileName(filename)));
+      for (int i = 0; i < dataset()->columns_.size(); ++i) {
+        TF_ASSIGN_OR_RETURN(int index,
+                            file->reader->ColumnIndex(dataset()->columns_[i]));
+        const ColumnarFileColumn& column = file->reader->columns()[index];
+        const PartialTensorShape batch_shape =
+            PartialTensorShape({-1}).Concatenate(column.shape);
+        if (column.dtype != dataset()->output_types_[i] ||
+            !batch_shape.IsCompatibleWith(dataset()->output_shapes_[i])) {
+          return errors::InvalidArgument(
+              "Column ", column.name, " of ", filename, " has dtype ",
+              DataTypeString(column.dtype), " and batch shape ",
+              batch_shape.DebugString(), ", which is incompatible with the ",
+              "expected dtype ", DataTypeString(dataset()->output_types_[i]),
+              " and shape ", dataset()->output_shapes_[i].DebugString());
+        }
+        file->column_indices.push_back(index);
+      }
+      file_ = std::move(file);
+      return OkStatus();
+    }
+
+    mutex mu_;
+    size_t current_file_index_ TF_GUARDED_BY(mu_) = 0;
+    // The currently open file, if any. Batches that are being produced may
+    // hold further references to it.
+    std::shared_ptr<const OpenFile> file_ TF_GUARDED_BY(mu_);
+    int64_t row_group_ TF_GUARDED_BY(mu_) = 0;
+    int64_t row_offset_ TF_GUARDED_BY(mu_) = 0;
+  };
+
+  const std::vector<string> filenames_;
+  const std::vector<string> columns_;
+  const int64_t batch_size_;
+  const bool drop_remainder_;
+  const DataTypeVector output_types_;
+  const std::vector<PartialTensorShape> output_shapes_;
+};
+
+ColumnarFileDatasetOp::ColumnarFileDatasetOp(OpKernelConstruction* ctx)
+    : DatasetOpKernel(ctx) {
+  OP_REQUIRES_OK(ctx, ctx->GetAttr(kOutputTypes, &output_types_));
+  OP_REQUIRES_OK(ctx, ctx->GetAttr(kOutputShapes, &output_shapes_));
+}
+
+void ColumnarFileDatasetOp::MakeDataset(OpKernelContext* ctx,
+                                        DatasetBase** output) {
+  const Tensor* filenames_tensor;
+  OP_REQUIRES_OK(ctx, ctx->input(kFileNames, &filenames_tensor));
+  OP_REQUIRES(
+      ctx, filenames_tensor->dims() <= 1,
+      errors::InvalidArgument("`filenames` must be a scalar or a vector."));
+  std::vector<string> filenames;
+  filenames.reserve(filenames_tensor->NumElements());
+  for (int i = 0; i < filenames_tensor->NumElements(); ++i) {
+    filenames.push_back(filenames_tensor->flat<tstring>()(i));
+    metrics::RecordTFDataFilename(kDatasetType, filenames[i]);
+  }
+
+  std::vector<tstring> column_names;
+  OP_REQUIRES_OK(ctx, ParseVectorArgument<tstring>(ctx, kColumns,
+                                                   &column_names));
+  OP_REQUIRES(ctx, column_names.size() == output_types_.size(),
+              errors::InvalidArgument(
+                  "`columns` must have one name per output, got ",
+                  column_names.size(), " names for ", output_types_.size(),
+                  " outputs."));
+  std::vector<string> columns(column_names.begin(), column_names.end());
+
+  int64_t batch_size = 0;
+  OP_REQUIRES_OK(ctx,
+                 ParseScalarArgument<int64_t>(ctx, kBatchSize, &batch_size));
+  OP_REQUIRES(ctx, batch_size > 0,
+              errors::InvalidArgument("`batch_size` must be greater than 0."));
+  bool drop_remainder = false;
+  OP_REQUIRES_OK(
+      ctx, ParseScalarArgument<bool>(ctx, kDropRemainder, &drop_remainder));
+
+  *output = new Dataset(ctx, std::move(filenames), std::move(columns),
+                        batch_size, drop_remainder, output_types_,
+                        output_shapes_);
+}
+
+namespace {
+
+REGISTER_KERNEL_BUILDER(Name("ColumnarFileDataset").Device(DEVICE_CPU),
+                        ColumnarFileDatasetOp);
+
+}  // namespace
+}  // namespace experimental
+}  // namespace data
+}  // namespace tensorflow
@@ -0,0 +1,234 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/kernels/data/experimental/columnar_file_dataset_op.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/data/columnar_file_utils.h"
+#include "tensorflow/core/data/dataset_test_base.h"
+#include "tensorflow/core/platform/path.h"
+
+namespace tensorflow {
+namespace data {
+namespace experimental {
+namespace {
+
+constexpr char kNodeName[] = "columnar_file_dataset";
+
+class ColumnarFileDatasetParams : public DatasetParams {
+ public:
+  ColumnarFileDatasetParams(std::vector<tstring> filenames,
+                            std::vector<tstring> columns, int64_t batch_size,
+                            bool drop_remainder, DataTypeVector output_dtypes,
+                            std::vector<PartialTensorShape> output_shapes,
+                            string node_name)
+      : DatasetParams(std::move(output_dtypes), std::move(output_shapes),
+                      std::move(node_name)),
+        filenames_(std::move(filenames)),
+        columns_(std::move(columns)),
+        batch_size_(batch_size),
+        drop_remainder_(drop_remainder) {}
+
+  std::vector<Tensor> GetInputTensors() const override {
+    const int64_t num_files = filenames_.size();
+    const int64_t num_columns = columns_.size();
+    return {CreateTensor<tstring>(TensorShape({num_files}), filenames_),
+            CreateTensor<tstring>(TensorShape({num_columns}), columns_),
+            CreateTensor<int64_t>(TensorShape({}), {batch_size_}),
+            CreateTensor<bool>(TensorShape({}), {drop_remainder_})};
+  }
+
+  Status GetInputNames(std::vector<string>* input_names) const override {
+    *input_names = {ColumnarFileDatasetOp::kFileNames,
+                    ColumnarFileDatasetOp::kColumns,
+                    ColumnarFileDatasetOp::kBatchSize,
+                    ColumnarFileDatasetOp::kDropRemainder};
+    return OkStatus();
+  }
+
+  Status GetAttributes(AttributeVector* attr_vector) const override {
+    *attr_vector = {{ColumnarFileDatasetOp::kOutputTypes, output_dtypes_},
+                    {ColumnarFileDatasetOp::kOutputShapes, output_shapes_}};
+    return OkStatus();
+  }
+
+  string dataset_type() const override {
+    return ColumnarFileDatasetOp::kDatasetType;
+  }
+
+ private:
+  std::vector<tstring> filenames_;
+  std::vector<tstring> columns_;
+  int64_t batch_size_;
+  bool drop_remainder_;
+};
+
+// The first file holds the rows 0 to 4 in row groups of 3 and 2 rows, and the
+// second file holds the rows 5 and 6 in a single row group. Row `i` has the
+// id `i` and the features `{2 * i, 2 * i + 1}`.
+std::vector<tstring> TestFilenames() {
+  return {io::JoinPath(testing::TmpDir(), "columnar_file_0"),
+          io::JoinPath(testing::TmpDir(), "columnar_file_1")};
+}
+
+Status WriteTestFile(const std::string& filename,
+                     const std::vector<std::pair<int64_t, int64_t>>& groups) {
+  ColumnarFileWriter writer(Env::Default(), filename,
+                            {{"ids", DT_INT64, TensorShape({})},
+                             {"features", DT_FLOAT, TensorShape({2})}});
+  TF_RETURN_IF_ERROR(writer.Initialize());
+  for (const auto& [begin, end] : groups) {
+    std::vector<int64_t> ids;
+    std::vector<float> features;
+    for (int64_t i = begin; i < end; ++i) {
+      ids.push_back(i);
+      features.push_back(2 * i);
+      features.push_back(2 * i + 1);
+    }
+    TF_RETURN_IF_ERROR(writer.WriteRowGroup(
+        {CreateTensor<int64_t>(TensorShape({end - begin}), ids),
+         CreateTensor<float>(TensorShape({end - begin, 2}), features)}));
+  }
+  return writer.Close();
+}
+
+ColumnarFileDatasetParams ColumnarFileParams(int64_t batch_size,
+                                             bool drop_remainder) {
+  return ColumnarFileDatasetParams(
+      TestFilenames(), {"features", "ids"}, batch_size, drop_remainder,
+      /*output_dtypes=*/{DT_FLOAT, DT_INT64},
+      /*output_shapes=*/
+      {PartialTensorShape({-1, 2}), PartialTensorShape({-1})},
+      /*node_name=*/kNodeName);
+}
+
+ColumnarFileDatasetParams ProjectionParams() {
+  return ColumnarFileDatasetParams(
+      TestFilenames(), {"ids"}, /*batch_size=*/2, /*drop_remainder=*/false,
+      /*output_dtypes=*/{DT_INT64},
+      /*output_shapes=*/{PartialTensorShape({-1})},
+      /*node_name=*/kNodeName);
+}
+
+ColumnarFileDatasetParams MissingColumnParams() {
+  return ColumnarFileDatasetParams(
+      TestFilenames(), {"labels"}, /*batch_size=*/2, /*drop_remainder=*/false,
+      /*output_dtypes=*/{DT_INT64},
+      /*output_shapes=*/{PartialTensorShape({-1})},
+      /*node_name=*/kNodeName);
+}
+
+// Returns the features and ids of the rows `[begin, end)`.
+std::vector<Tensor> Rows(int64_t begin, int64_t end) {
+  std::vector<int64_t> ids;
+  std::vector<float> features;
+  for (int64_t i = begin; i < end; ++i) {
+    ids.push_back(i);
+    features.push_back(2 * i);
+    features.push_back(2 * i + 1);
+  }
+  return {CreateTensor<float>(TensorShape({end - begin, 2}), features),
+          CreateTensor<int64_t>(TensorShape({end - begin}), ids)};
+}
+
+// Concatenates the components of the given batches.
+std::vector<Tensor> Batches(std::vector<std::vector<Tensor>> batches) {
+  std::vector<Tensor> outputs;
+  for (std::vector<Tensor>& batch : batches) {
+    for (Tensor& component : batch) outputs.push_back(std::move(component));
+  }
+  return outputs;
+}
+
+class ColumnarFileDatasetOpTest : public DatasetOpsTestBase {
+ protected:
+  void SetUp() override {
+    const std::vector<tstring> filenames = TestFilenames();
+    TF_ASSERT_OK(WriteTestFile(filenames[0], {{0, 3}, {3, 5}}));
+    TF_ASSERT_OK(WriteTestFile(filenames[1], {{5, 7}}));
+  }
+};
+
+std::vector<GetNextTestCase<ColumnarFileDatasetParams>> GetNextTestCases() {
+  return {
+      // Batches within a row group, across row groups, and across files.
+      {/*dataset_params=*/ColumnarFileParams(/*batch_size=*/3,
+                                             /*drop_remainder=*/false),
+       /*expected_outputs=*/Batches({Rows(0, 3), Rows(3, 6), Rows(6, 7)})},
+      {/*dataset_params=*/ColumnarFileParams(/*batch_size=*/3,
+                                             /*drop_remainder=*/true),
+       /*expected_outputs=*/Batches({Rows(0, 3), Rows(3, 6)})},
+      {/*dataset_params=*/ColumnarFileParams(/*batch_size=*/10,
+                                             /*drop_remainder=*/false),
+       /*expected_outputs=*/Rows(0, 7)},
+      {/*dataset_params=*/ColumnarFileParams(/*batch_size=*/10,
+                                             /*drop_remainder=*/true),
+       /*expected_outputs=*/{}},
+      {/*dataset_params=*/ProjectionParams(),
+       /*expected_outputs=*/
+       {CreateTensor<int64_t>(TensorShape({2}), {0, 1}),
+        CreateTensor<int64_t>(TensorShape({2}), {2, 3}),
+        CreateTensor<int64_t>(TensorShape({2}), {4, 5}),
+        CreateTensor<int64_t>(TensorShape({1}), {6})}}};
+}
+
+ITERATOR_GET_NEXT_TEST_P(ColumnarFileDatasetOpTest, ColumnarFileDatasetParams,
+                         GetNextTestCases())
+
+TEST_F(ColumnarFileDatasetOpTest, MissingColumn) {
+  TF_ASSERT_OK(Initialize(MissingColumnParams()));
+  std::vector<Tensor> next;
+  bool end_of_sequence = false;
+  Status status =
+      iterator_->GetNext(iterator_ctx_.get(), &next, &end_of_sequence);
+  EXPECT_EQ(status.code(), absl::StatusCode::kNotFound);
+}
+
+TEST_F(ColumnarFileDatasetOpTest, InvalidBatchSize) {
+  EXPECT_EQ(Initialize(ColumnarFileParams(/*batch_size=*/0,
+                                          /*drop_remainder=*/false))
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+std::vector<DatasetNodeNameTestCase<ColumnarFileDatasetParams>>
+DatasetNodeNameTestCases() {
+  return {{/*dataset_params=*/ColumnarFileParams(/*batch_size=*/3,
+                                                 /*drop_remainder=*/false),
+           /*expected_node_name=*/kNodeName}};
+}
+
+DATASET_NODE_NAME_TEST_P(ColumnarFileDatasetOpTest, ColumnarFileDatasetParams,
+                         DatasetNodeNameTestCases())
+
+std::vector<IteratorSaveAndRestoreTestCase<ColumnarFileDatasetParams>>
+IteratorSaveAndRestoreTestCases() {
+  return {{/*dataset_params=*/ColumnarFileParams(/*batch_size=*/2,
+                                                 /*drop_remainder=*/false),
+           /*breakpoints=*/{0, 1, 2, 3, 5},
+           /*expected_outputs=*/
+           Batches({Rows(0, 2), Rows(2, 4), Rows(4, 6), Rows(6, 7)})}};
+}
+
+ITERATOR_SAVE_AND_RESTORE_TEST_P(ColumnarFileDatasetOpTest,
+                                 ColumnarFileDatasetParams,
+                                 IteratorSaveAndRestoreTestCases())
+
+}  // namespace
+}  // namespace experimental
+}  // namespace data
+}  // namespace tensorflow
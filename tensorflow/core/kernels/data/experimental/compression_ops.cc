@@ -25,7 +25,13 @@ namespace data {
 namespace experimental {
 
 CompressElementOp::CompressElementOp(OpKernelConstruction* ctx)
-    : OpKernel(ctx) {}
+    : OpKernel(ctx) {
+  std::string codec;
+  OP_REQUIRES_OK(ctx, ctx->GetAttr(kCodec, &codec));
+  options_.codec =
+      codec == "zstd" ? CompressedElement::ZSTD : CompressedElement::SNAPPY;
+  OP_REQUIRES_OK(ctx, ctx->GetAttr(kLevel, &options_.level));
+}
 
 void CompressElementOp::Compute(OpKernelContext* ctx) {
   std::vector<Tensor> components;
@@ -33,7 +39,7 @@ void CompressElementOp::Compute(OpKernelContext* ctx) {
     components.push_back(ctx->input(i));
   }
   CompressedElement compressed;
-  OP_REQUIRES_OK(ctx, CompressElement(components, &compressed));
+  OP_REQUIRES_OK(ctx, CompressElement(components, options_, &compressed));
 
   Tensor* output;
   OP_REQUIRES_OK(ctx, ctx->allocate_output(0, TensorShape({}), &output));
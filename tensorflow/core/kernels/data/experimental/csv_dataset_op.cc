@@ -12,10 +12,13 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
+#include <cstring>
+
 #include "tensorflow/core/framework/common_shape_fns.h"
 #include "tensorflow/core/framework/dataset.h"
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/kernels/csv_util.h"
 #include "tensorflow/core/lib/io/inputstream_interface.h"
 #include "tensorflow/core/lib/io/random_inputstream.h"
 #include "tensorflow/core/lib/io/zlib_compression_options.h"
@@ -180,6 +183,7 @@ class CSVDatasetOp : public DatasetOpKernel {
           exclude_cols_(std::move(exclude_cols)),
           use_quote_delim_(use_quote_delim),
           delim_(delim),
+          scanner_(delim, use_quote_delim),
           na_value_(std::move(na_value)),
           op_version_(op_version),
           use_compression_(!compression_type.empty()),
@@ -508,7 +512,7 @@ class CSVDatasetOp : public DatasetOpKernel {
         pos_++;  // Starting quotation mark
 
         Status parse_result;
-        while (true) {  // Each iter reads 1 char, filling buffer if necessary
+        while (true) {  // Each iter reads a run of chars, refilling buffer
           if (pos_ >= buffer_.size()) {
             Status s = SaveAndFillBuffer(&earlier_pieces, &start, include);
             if (errors::IsOutOfRange(s)) {
@@ -562,7 +566,12 @@ class CSVDatasetOp : public DatasetOpKernel {
             }
 
           } else {
-            pos_++;
+            // Skips to the next quote.
+            const void* quote = std::memchr(&buffer_[pos_], '"',
+                                            buffer_.size() - pos_);
+            pos_ = quote == nullptr
+                       ? buffer_.size()
+                       : static_cast<const char*>(quote) - buffer_.data();
           }
         }
       }
@@ -641,7 +650,7 @@ class CSVDatasetOp : public DatasetOpKernel {
         size_t start = pos_;
         Status parse_result;
 
-        while (true) {  // Each iter reads 1 char, filling buffer if necessary
+        while (true) {  // Each iter reads a run of chars, refilling buffer
           if (pos_ >= buffer_.size()) {
             Status s = SaveAndFillBuffer(&earlier_pieces, &start, include);
             // Handle errors
@@ -657,6 +666,10 @@ class CSVDatasetOp : public DatasetOpKernel {
             }
           }
 
+          // Skips to the next delimiter, line break or quote.
+          pos_ = dataset()->scanner_.Find(
+              StringPiece(buffer_.data(), buffer_.size()), pos_);
+          if (pos_ >= buffer_.size()) continue;
           char ch = buffer_[pos_];
 
           if (ch == dataset()->delim_) {
@@ -730,7 +743,7 @@ class CSVDatasetOp : public DatasetOpKernel {
                   dataset()->record_defaults_[output_idx].flat<int32>()(0);
             } else {
               int32_t value;
-              if (!strings::safe_strto32(field, &value)) {
+              if (!CsvFieldToNumber(field, &value)) {
                 return errors::InvalidArgument(
                     "Field ", output_idx,
                     " in record is not a valid int32: ", field);
@@ -745,7 +758,7 @@ class CSVDatasetOp : public DatasetOpKernel {
                   dataset()->record_defaults_[output_idx].flat<int64_t>()(0);
             } else {
               int64_t value;
-              if (!strings::safe_strto64(field, &value)) {
+              if (!CsvFieldToNumber(field, &value)) {
                 return errors::InvalidArgument(
                     "Field ", output_idx,
                     " in record is not a valid int64: ", field);
@@ -760,7 +773,7 @@ class CSVDatasetOp : public DatasetOpKernel {
                   dataset()->record_defaults_[output_idx].flat<float>()(0);
             } else {
               float value;
-              if (!strings::safe_strtof(field, &value)) {
+              if (!CsvFieldToNumber(field, &value)) {
                 return errors::InvalidArgument(
                     "Field ", output_idx,
                     " in record is not a valid float: ", field);
@@ -775,7 +788,7 @@ class CSVDatasetOp : public DatasetOpKernel {
                   dataset()->record_defaults_[output_idx].flat<double>()(0);
             } else {
               double value;
-              if (!strings::safe_strtod(field, &value)) {
+              if (!CsvFieldToNumber(field, &value)) {
                 return errors::InvalidArgument(
                     "Field ", output_idx,
                     " in record is not a valid double: ", field);
@@ -915,6 +928,7 @@ class CSVDatasetOp : public DatasetOpKernel {
     const std::vector<int64_t> exclude_cols_;
     const bool use_quote_delim_;
     const char delim_;
+    const CsvScanner scanner_;
     const tstring na_value_;
     const int op_version_;
     const bool use_compression_;
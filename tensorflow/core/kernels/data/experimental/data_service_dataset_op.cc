@@ -697,7 +697,8 @@ void DataServiceDatasetOp::MakeDataset(OpKernelContext* ctx,
     OP_REQUIRES_OK(ctx, compression.status());
     should_uncompress =
         should_uncompress &&
-        (*compression == DataServiceMetadata::COMPRESSION_SNAPPY);
+        (*compression == DataServiceMetadata::COMPRESSION_SNAPPY ||
+         *compression == DataServiceMetadata::COMPRESSION_ZSTD);
   }
   if (should_uncompress) {
     StatusOr<bool> disable_compression_at_runtime = DisableCompressionAtRuntime(
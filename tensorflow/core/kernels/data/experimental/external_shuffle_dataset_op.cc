@@ -0,0 +1,561 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/kernels/data/experimental/external_shuffle_dataset_op.h"
+
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/data/dataset_utils.h"
+#include "tensorflow/core/data/name_utils.h"
+#include "tensorflow/core/data/snapshot_utils.h"
+#include "tensorflow/core/framework/dataset.h"
+#include "tensorflow/core/framework/partial_tensor_shape.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/kernels/data/random_seed_ops.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/random/random_distributions.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/path.h"
+
+namespace tensorflow {
+namespace data {
+namespace experimental {
+
+// Constants declared in external_shuffle_dataset_op.h and used both here and
+// in test cases.
+/* static */ constexpr const char* const ExternalShuffleDatasetOp::kDatasetType;
+/* static */ constexpr const char* const
+    ExternalShuffleDatasetOp::kInputDataset;
+/* static */ constexpr const char* const ExternalShuffleDatasetOp::kDirectory;
+/* static */ constexpr const char* const ExternalShuffleDatasetOp::kNumBuckets;
+/* static */ constexpr const char* const ExternalShuffleDatasetOp::kSeed;
+/* static */ constexpr const char* const ExternalShuffleDatasetOp::kSeed2;
+/* static */ constexpr const char* const ExternalShuffleDatasetOp::kCompression;
+/* static */ constexpr const char* const
+    ExternalShuffleDatasetOp::kReshuffleEachIteration;
+/* static */ constexpr const char* const ExternalShuffleDatasetOp::kOutputTypes;
+/* static */ constexpr const char* const
+    ExternalShuffleDatasetOp::kOutputShapes;
+/* static */ constexpr const int ExternalShuffleDatasetOp::kFileFormatVersion;
+/* static */ constexpr const int64_t ExternalShuffleDatasetOp::kMaxNumBuckets;
+
+namespace {
+
+constexpr char kIteratorSeed[] = "seed";
+constexpr char kIteratorSeed2[] = "seed2";
+constexpr char kEndOfSequence[] = "end_of_sequence";
+constexpr char kRunDirectory[] = "run_directory";
+constexpr char kNextBucket[] = "next_bucket";
+constexpr char kPosition[] = "position";
+
+// The random streams that the iterator draws from. The in-memory shuffle of
+// bucket `b` uses stream `kFirstBucketStream + b`.
+constexpr uint64 kBucketAssignmentStream = 0;
+constexpr uint64 kBucketOrderStream = 1;
+constexpr uint64 kFirstBucketStream = 2;
+
+// Returns a generator for the `stream`-th of the independent random streams
+// derived from `seed` and `seed2`.
+random::PhiloxRandom StreamGenerator(int64_t seed, int64_t seed2,
+                                     uint64 stream) {
+  random::PhiloxRandom generator(seed, seed2);
+  // Each stream has room for 2^40 samples of the generator.
+  generator.Skip(stream << 40);
+  return generator;
+}
+
+// Shuffles `elements` with the given random stream.
+template <typename T>
+void Shuffle(int64_t seed, int64_t seed2, uint64 stream,
+             std::vector<T>* elements) {
+  random::PhiloxRandom parent_generator =
+      StreamGenerator(seed, seed2, stream);
+  random::SimplePhilox generator(&parent_generator);
+  for (int64_t i = static_cast<int64_t>(elements->size()) - 1; i > 0; --i) {
+    std::swap((*elements)[i], (*elements)[generator.Uniform64(i + 1)]);
+  }
+}
+
+// The bucket files written by the first pass of an iterator. The files are
+// deleted when the last iterator that reads them is destroyed. Iterators that
+// are restored in the same process look the files up by directory instead of
+// repeating the first pass.
+class RunFiles {
+ public:
+  // Creates a new, empty run directory under `directory`, or under a local
+  // temporary directory if `directory` is empty.
+  static Status Create(Env* env, const std::string& directory,
+                       std::shared_ptr<RunFiles>* out) {
+    std::string run_directory;
+    if (directory.empty()) {
+      if (!env->LocalTempFilename(&run_directory)) {
+        return errors::Unavailable(
+            "Failed to create a local directory to write the shuffle buckets "
+            "to.");
+      }
+    } else {
+      run_directory = io::JoinPath(
+          directory, absl::StrCat("external_shuffle_",
+                                  absl::Hex(random::New64())));
+    }
+    TF_RETURN_IF_ERROR(env->RecursivelyCreateDir(run_directory));
+    VLOG(2) << "Writing the shuffle buckets to " << run_directory;
+    out->reset(new RunFiles(env, run_directory));
+    mutex_lock l(*registry_mu());
+    (*registry())[run_directory] = *out;
+    return OkStatus();
+  }
+
+  // Returns the files of the run in `run_directory` if they are still in use,
+  // or nullptr otherwise.
+  static std::shared_ptr<RunFiles> Lookup(const std::string& run_directory) {
+    mutex_lock l(*registry_mu());
+    auto it = registry()->find(run_directory);
+    if (it == registry()->end()) {
+      return nullptr;
+    }
+    return it->second.lock();
+  }
+
+  ~RunFiles() {
+    {
+      mutex_lock l(*registry_mu());
+      registry()->erase(directory_);
+    }
+    int64_t undeleted_files, undeleted_dirs;
+    Status s =
+        env_->DeleteRecursively(directory_, &undeleted_files, &undeleted_dirs);
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to delete the shuffle buckets in " << directory_
+                   << ": " << s;
+    }
+  }
+
+  const std::string& directory() const { return directory_; }
+
+  std::string BucketFilename(int64_t bucket) const {
+    return io::JoinPath(directory_, absl::StrCat("bucket_", bucket));
+  }
+
+ private:
+  RunFiles(Env* env, std::string directory)
+      : env_(env), directory_(std::move(directory)) {}
+
+  static mutex* registry_mu() {
+    static mutex* mu = new mutex();
+    return mu;
+  }
+
+  static absl::flat_hash_map<std::string, std::weak_ptr<RunFiles>>*
+  registry() {
+    static auto* registry =
+        new absl::flat_hash_map<std::string, std::weak_ptr<RunFiles>>();
+    return registry;
+  }
+
+  Env* const env_;
+  const std::string directory_;
+};
+
+}  // namespace
+
+class ExternalShuffleDatasetOp::Dataset : public DatasetBase {
+ public:
+  Dataset(OpKernelContext* ctx, const DatasetBase* input,
+          std::string directory, int64_t num_buckets, RandomSeeds&& seeds,
+          std::string compression, bool reshuffle_each_iteration)
+      : DatasetBase(DatasetContext(ctx)),
+        input_(input),
+        directory_(std::move(directory)),
+        num_buckets_(num_buckets),
+        input_seed_(seeds.input_seed()),
+        input_seed2_(seeds.input_seed2()),
+        compression_(std::move(compression)),
+        reshuffle_each_iteration_(reshuffle_each_iteration) {
+    if (reshuffle_each_iteration_) {
+      seed_generator_ = std::make_unique<RandomSeedGenerator>(std::move(seeds));
+    } else {
+      seed_generator_ = std::make_unique<FixedSeedGenerator>(std::move(seeds));
+    }
+    input_->Ref();
+  }
+
+  ~Dataset() override { input_->Unref(); }
+
+  std::unique_ptr<IteratorBase> MakeIteratorInternal(
+      const string& prefix) const override {
+    return std::make_unique<Iterator>(Iterator::Params{
+        this, name_utils::IteratorPrefix(kDatasetType, prefix)});
+  }
+
+  const DataTypeVector& output_dtypes() const override {
+    return input_->output_dtypes();
+  }
+
+  const std::vector<PartialTensorShape>& output_shapes() const override {
+    return input_->output_shapes();
+  }
+
+  string DebugString() const override {
+    return name_utils::DatasetDebugString(kDatasetType);
+  }
+
+  int64_t CardinalityInternal(CardinalityOptions options) const override {
+    return input_->Cardinality(options);
+  }
+
+  Status InputDatasets(std::vector<const DatasetBase*>* inputs) const override {
+    inputs->push_back(input_);
+    return OkStatus();
+  }
+
+  Status CheckExternalState() const override {
+    return input_->CheckExternalState();
+  }
+
+ protected:
+  Status AsGraphDefInternal(SerializationContext* ctx,
+                            DatasetGraphDefBuilder* b,
+                            Node** output) const override {
+    Node* input_graph_node = nullptr;
+    TF_RETURN_IF_ERROR(b->AddInputDataset(ctx, input_, &input_graph_node));
+    Node* directory = nullptr;
+    Node* num_buckets = nullptr;
+    Node* seed = nullptr;
+    Node* seed2 = nullptr;
+    TF_RETURN_IF_ERROR(b->AddScalar(tstring(directory_), &directory));
+    TF_RETURN_IF_ERROR(b->AddScalar(num_buckets_, &num_buckets));
+    TF_RETURN_IF_ERROR(b->AddScalar(input_seed_, &seed));
+    TF_RETURN_IF_ERROR(b->AddScalar(input_seed2_, &seed2));
+    AttrValue compression;
+    b->BuildAttrValue(compression_, &compression);
+    AttrValue reshuffle_each_iteration;
+    b->BuildAttrValue(reshuffle_each_iteration_, &reshuffle_each_iteration);
+    TF_RETURN_IF_ERROR(b->AddDataset(
+        this, {input_graph_node, directory, num_buckets, seed, seed2},
+        {{kCompression, compression},
+         {kReshuffleEachIteration, reshuffle_each_iteration}},
+        output));
+    return OkStatus();
+  }
+
+ private:
+  // Shuffles the input in two passes. The first pass writes every input
+  // element to one of `num_buckets` files, chosen uniformly at random. The
+  // second pass visits the buckets in a random order, and reads each bucket
+  // into memory, shuffles it, and produces its elements. The result is a
+  // uniformly random permutation of the input, and the memory used is bounded
+  // by the size of the largest bucket.
+  class Iterator : public DatasetIterator<Dataset> {
+   public:
+    explicit Iterator(const Params& params)
+        : DatasetIterator<Dataset>(params) {}
+
+    Status Initialize(IteratorContext* ctx) override {
+      mutex_lock l(mu_);
+      dataset()->seed_generator_->GenerateSeeds(&seed_, &seed2_);
+      return OkStatus();
+    }
+
+    Status GetNextInternal(IteratorContext* ctx,
+                           std::vector<Tensor>* out_tensors,
+                           bool* end_of_sequence) override {
+      TF_RETURN_IF_ERROR(EnsureBucketsWritten(ctx));
+      mutex_lock l(mu_);
+      while (!end_of_sequence_ && position_ >= buffer_.size()) {
+        if (next_bucket_ >= bucket_order_.size()) {
+          end_of_sequence_ = true;
+          run_files_.reset();
+          buffer_.clear();
+          break;
+        }
+        TF_RETURN_IF_ERROR(ReadBucket(ctx, bucket_order_[next_bucket_++]));
+        position_ = 0;
+      }
+      if (end_of_sequence_) {
+        *end_of_sequence = true;
+        return OkStatus();
+      }
+      *out_tensors = std::move(buffer_[position_++]);
+      *end_of_sequence = false;
+      return OkStatus();
+    }
+
+   protected:
+    std::shared_ptr<model::Node> CreateNode(
+        IteratorContext* ctx, model::Node::Args args) const override {
+      return model::MakeKnownRatioNode(std::move(args),
+                                       /*ratio=*/1);
+    }
+
+    Status SaveInternal(SerializationContext* ctx,
+                        IteratorStateWriter* writer) override {
+      mutex_lock l(mu_);
+      TF_RETURN_IF_ERROR(writer->WriteScalar(full_name(kIteratorSeed), seed_));
+      TF_RETURN_IF_ERROR(
+          writer->WriteScalar(full_name(kIteratorSeed2), seed2_));
+      if (end_of_sequence_) {
+        return writer->WriteScalar(full_name(kEndOfSequence), "");
+      }
+      if (run_files_ == nullptr) {
+        // The first pass has not finished yet. A restored iterator runs it
+        // again.
+        return OkStatus();
+      }
+      TF_RETURN_IF_ERROR(writer->WriteScalar(full_name(kRunDirectory),
+                                             run_files_->directory()));
+      TF_RETURN_IF_ERROR(
+          writer->WriteScalar(full_name(kNextBucket),
+                              static_cast<int64_t>(next_bucket_)));
+      TF_RETURN_IF_ERROR(writer->WriteScalar(
+          full_name(kPosition), static_cast<int64_t>(position_)));
+      return OkStatus();
+    }
+
+    Status RestoreInternal(IteratorContext* ctx,
+                           IteratorStateReader* reader) override {
+      mutex_lock l(mu_);
+      TF_RETURN_IF_ERROR(reader->ReadScalar(full_name(kIteratorSeed), &seed_));
+      TF_RETURN_IF_ERROR(
+          reader->ReadScalar(full_name(kIteratorSeed2), &seed2_));
+      run_files_.reset();
+      bucket_order_.clear();
+      buffer_.clear();
+      next_bucket_ = 0;
+      position_ = 0;
+      end_of_sequence_ = reader->Contains(full_name(kEndOfSequence));
+      if (end_of_sequence_ || !reader->Contains(full_name(kRunDirectory))) {
+        return OkStatus();
+      }
+      tstring run_directory;
+      TF_RETURN_IF_ERROR(
+          reader->ReadScalar(full_name(kRunDirectory), &run_directory));
+      int64_t next_bucket;
+      TF_RETURN_IF_ERROR(
+          reader->ReadScalar(full_name(kNextBucket), &next_bucket));
+      int64_t position;
+      TF_RETURN_IF_ERROR(reader->ReadScalar(full_name(kPosition), &position));
+
+      std::shared_ptr<RunFiles> run_files = RunFiles::Lookup(run_directory);
+      if (run_files != nullptr) {
+        StartSecondPass(std::move(run_files));
+      } else {
+        // The buckets were written by another process, or have already been
+        // deleted. Since the seeds are the same, writing them again
+        // reproduces the same buckets. Restoring is not concurrent with
+        // `GetNext()`, so the buckets are written under `mu_`.
+        LOG(WARNING) << "The shuffle buckets in " << run_directory
+                     << " are no longer available. Rewriting them, which "
+                        "reads the whole input again.";
+        TF_RETURN_IF_ERROR(WriteBuckets(ctx, seed_, seed2_, &run_files));
+        StartSecondPass(std::move(run_files));
+      }
+      if (next_bucket < 0 || next_bucket > bucket_order_.size() ||
+          position < 0) {
+        return errors::FailedPrecondition(
+            "Invalid shuffle position (", next_bucket, ", ", position,
+            ") in the checkpoint of ", prefix(), ".");
+      }
+      next_bucket_ = next_bucket;
+      if (next_bucket_ > 0) {
+        TF_RETURN_IF_ERROR(ReadBucket(ctx, bucket_order_[next_bucket_ - 1]));
+      }
+      position_ = position;
+      return OkStatus();
+    }
+
+   private:
+    // Returns the order in which the buckets are visited.
+    std::vector<int64_t> BucketOrder() const TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      std::vector<int64_t> bucket_order(dataset()->num_buckets_);
+      std::iota(bucket_order.begin(), bucket_order.end(), 0);
+      Shuffle(seed_, seed2_, kBucketOrderStream, &bucket_order);
+      return bucket_order;
+    }
+
+    // Runs the first pass, unless it has run already. The pass reads the whole
+    // input, so it runs without holding `mu_`, which would block `Save()` and
+    // other callers for its duration. `write_mu_` makes concurrent callers
+    // wait for a single pass.
+    Status EnsureBucketsWritten(IteratorContext* ctx)
+        TF_LOCKS_EXCLUDED(mu_, write_mu_) {
+      mutex_lock wl(write_mu_);
+      int64_t seed, seed2;
+      {
+        mutex_lock l(mu_);
+        if (end_of_sequence_ || run_files_ != nullptr) {
+          return OkStatus();
+        }
+        seed = seed_;
+        seed2 = seed2_;
+      }
+      std::shared_ptr<RunFiles> run_files;
+      TF_RETURN_IF_ERROR(WriteBuckets(ctx, seed, seed2, &run_files));
+      mutex_lock l(mu_);
+      StartSecondPass(std::move(run_files));
+      return OkStatus();
+    }
+
+    // Starts reading the buckets in `run_files`.
+    void StartSecondPass(std::shared_ptr<RunFiles> run_files)
+        TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      run_files_ = std::move(run_files);
+      bucket_order_ = BucketOrder();
+      next_bucket_ = 0;
+      buffer_.clear();
+      position_ = 0;
+    }
+
+    // Reads the whole input and writes each element to a bucket chosen with
+    // `seed` and `seed2`.
+    Status WriteBuckets(IteratorContext* ctx, int64_t seed, int64_t seed2,
+                        std::shared_ptr<RunFiles>* out) {
+      std::shared_ptr<RunFiles> run_files;
+      TF_RETURN_IF_ERROR(
+          RunFiles::Create(ctx->env(), dataset()->directory_, &run_files));
+      const int64_t num_buckets = dataset()->num_buckets_;
+      std::vector<std::unique_ptr<snapshot_util::Writer>> writers(num_buckets);
+      for (int64_t i = 0; i < num_buckets; ++i) {
+        TF_RETURN_IF_ERROR(snapshot_util::Writer::Create(
+            ctx->env(), run_files->BucketFilename(i), dataset()->compression_,
+            kFileFormatVersion, dataset()->output_dtypes(), &writers[i]));
+      }
+
+      std::unique_ptr<IteratorBase> input_impl;
+      TF_RETURN_IF_ERROR(
+          dataset()->input_->MakeIterator(ctx, this, prefix(), &input_impl));
+      random::PhiloxRandom parent_generator =
+          StreamGenerator(seed, seed2, kBucketAssignmentStream);
+      random::SimplePhilox generator(&parent_generator);
+      int64_t num_elements = 0;
+      while (true) {
+        std::vector<Tensor> element;
+        bool end_of_input = false;
+        TF_RETURN_IF_ERROR(input_impl->GetNext(ctx, &element, &end_of_input));
+        if (end_of_input) {
+          break;
+        }
+        TF_RETURN_IF_ERROR(
+            writers[generator.Uniform64(num_buckets)]->WriteTensors(element));
+        ++num_elements;
+      }
+      for (auto& writer : writers) {
+        TF_RETURN_IF_ERROR(writer->Close());
+      }
+      VLOG(2) << "Wrote " << num_elements << " elements to " << num_buckets
+              << " shuffle buckets in " << run_files->directory();
+      *out = std::move(run_files);
+      return OkStatus();
+    }
+
+    // Reads `bucket` into `buffer_` and shuffles it.
+    Status ReadBucket(IteratorContext* ctx, int64_t bucket)
+        TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      buffer_.clear();
+      std::unique_ptr<snapshot_util::Reader> reader;
+      TF_RETURN_IF_ERROR(snapshot_util::Reader::Create(
+          ctx->env(), run_files_->BucketFilename(bucket),
+          dataset()->compression_, kFileFormatVersion,
+          dataset()->output_dtypes(), &reader));
+      while (true) {
+        std::vector<Tensor> element;
+        Status s = reader->ReadTensors(&element);
+        if (errors::IsOutOfRange(s)) {
+          break;
+        }
+        TF_RETURN_IF_ERROR(s);
+        buffer_.push_back(std::move(element));
+      }
+      Shuffle(seed_, seed2_, kFirstBucketStream + bucket, &buffer_);
+      return OkStatus();
+    }
+
+    // Acquired before `mu_`.
+    mutex write_mu_;
+    mutex mu_;
+    int64_t seed_ TF_GUARDED_BY(mu_) = 0;
+    int64_t seed2_ TF_GUARDED_BY(mu_) = 0;
+    std::shared_ptr<RunFiles> run_files_ TF_GUARDED_BY(mu_);
+    std::vector<int64_t> bucket_order_ TF_GUARDED_BY(mu_);
+    // The index into `bucket_order_` of the next bucket to read.
+    size_t next_bucket_ TF_GUARDED_BY(mu_) = 0;
+    // The shuffled elements of the current bucket, and the index of the next
+    // one to produce.
+    std::vector<std::vector<Tensor>> buffer_ TF_GUARDED_BY(mu_);
+    size_t position_ TF_GUARDED_BY(mu_) = 0;
+    bool end_of_sequence_ TF_GUARDED_BY(mu_) = false;
+  };
+
+  const DatasetBase* const input_;
+  const std::string directory_;
+  const int64_t num_buckets_;
+  const int64_t input_seed_;
+  const int64_t input_seed2_;
+  const std::string compression_;
+  const bool reshuffle_each_iteration_;
+  std::unique_ptr<SeedGenerator> seed_generator_;
+};  // ExternalShuffleDatasetOp::Dataset
+
+ExternalShuffleDatasetOp::ExternalShuffleDatasetOp(OpKernelConstruction* ctx)
+    : UnaryDatasetOpKernel(ctx) {
+  OP_REQUIRES_OK(ctx, ctx->GetAttr(kCompression, &compression_));
+  OP_REQUIRES_OK(ctx, ctx->GetAttr(kReshuffleEachIteration,
+                                   &reshuffle_each_iteration_));
+}
+
+// Create a new ExternalShuffleDatasetOp::Dataset, and return it as the output.
+void ExternalShuffleDatasetOp::MakeDataset(OpKernelContext* ctx,
+                                           DatasetBase* input,
+                                           DatasetBase** output) {
+  tstring directory;
+  int64_t num_buckets;
+  int64_t seed;
+  int64_t seed2;
+  OP_REQUIRES_OK(ctx,
+                 ParseScalarArgument<tstring>(ctx, kDirectory, &directory));
+  OP_REQUIRES_OK(ctx,
+                 ParseScalarArgument<int64_t>(ctx, kNumBuckets, &num_buckets));
+  OP_REQUIRES_OK(ctx, ParseScalarArgument<int64_t>(ctx, kSeed, &seed));
+  OP_REQUIRES_OK(ctx, ParseScalarArgument<int64_t>(ctx, kSeed2, &seed2));
+  OP_REQUIRES(ctx, num_buckets > 0 && num_buckets <= kMaxNumBuckets,
+              errors::InvalidArgument("`num_buckets` must be in [1, ",
+                                      kMaxNumBuckets, "], but got ",
+                                      num_buckets, "."));
+  OP_REQUIRES(ctx, input->Cardinality() != kInfiniteCardinality,
+              errors::InvalidArgument(
+                  "An external shuffle requires a finite input dataset."));
+
+  *output = new Dataset(ctx, input, directory, num_buckets,
+                        RandomSeeds(seed, seed2), compression_,
+                        reshuffle_each_iteration_);
+}
+
+namespace {
+REGISTER_KERNEL_BUILDER(Name("ExternalShuffleDataset").Device(DEVICE_CPU),
+                        ExternalShuffleDatasetOp);
+}  // namespace
+}  // namespace experimental
+}  // namespace data
+}  // namespace tensorflow
@@ -0,0 +1,381 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/kernels/data/experimental/external_shuffle_dataset_op.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_join.h"
+#include "tensorflow/core/data/dataset_test_base.h"
+#include "tensorflow/core/data/serialization_utils.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/platform/threadpool.h"
+
+namespace tensorflow {
+namespace data {
+namespace experimental {
+namespace {
+
+constexpr char kNodeName[] = "external_shuffle_dataset";
+
+class ExternalShuffleDatasetParams : public DatasetParams {
+ public:
+  template <typename T>
+  ExternalShuffleDatasetParams(T input_dataset_params, std::string directory,
+                               int64_t num_buckets, int64_t seed,
+                               int64_t seed2, bool reshuffle_each_iteration,
+                               DataTypeVector output_dtypes,
+                               std::vector<PartialTensorShape> output_shapes,
+                               string node_name)
+      : DatasetParams(std::move(output_dtypes), std::move(output_shapes),
+                      std::move(node_name)),
+        directory_(std::move(directory)),
+        num_buckets_(num_buckets),
+        seed_(seed),
+        seed2_(seed2),
+        reshuffle_each_iteration_(reshuffle_each_iteration) {
+    input_dataset_params_.push_back(std::make_unique<T>(input_dataset_params));
+    iterator_prefix_ =
+        name_utils::IteratorPrefix(input_dataset_params.dataset_type(),
+                                   input_dataset_params.iterator_prefix());
+  }
+
+  std::vector<Tensor> GetInputTensors() const override {
+    return {CreateTensor<tstring>(TensorShape({}), {directory_}),
+            CreateTensor<int64_t>(TensorShape({}), {num_buckets_}),
+            CreateTensor<int64_t>(TensorShape({}), {seed_}),
+            CreateTensor<int64_t>(TensorShape({}), {seed2_})};
+  }
+
+  Status GetInputNames(std::vector<string>* input_names) const override {
+    *input_names = {ExternalShuffleDatasetOp::kInputDataset,
+                    ExternalShuffleDatasetOp::kDirectory,
+                    ExternalShuffleDatasetOp::kNumBuckets,
+                    ExternalShuffleDatasetOp::kSeed,
+                    ExternalShuffleDatasetOp::kSeed2};
+    return OkStatus();
+  }
+
+  Status GetAttributes(AttributeVector* attr_vector) const override {
+    *attr_vector = {
+        {ExternalShuffleDatasetOp::kCompression, ""},
+        {ExternalShuffleDatasetOp::kReshuffleEachIteration,
+         reshuffle_each_iteration_},
+        {ExternalShuffleDatasetOp::kOutputTypes, output_dtypes_},
+        {ExternalShuffleDatasetOp::kOutputShapes, output_shapes_}};
+    return OkStatus();
+  }
+
+  string dataset_type() const override {
+    return ExternalShuffleDatasetOp::kDatasetType;
+  }
+
+ private:
+  std::string directory_;
+  int64_t num_buckets_;
+  int64_t seed_;
+  int64_t seed2_;
+  bool reshuffle_each_iteration_;
+};
+
+ExternalShuffleDatasetParams ExternalShuffleParams(
+    int64_t num_elements, int64_t num_buckets,
+    std::string directory = testing::TmpDir(), int64_t seed = 42,
+    int64_t seed2 = 7) {
+  return ExternalShuffleDatasetParams(
+      RangeDatasetParams(0, num_elements, 1), std::move(directory),
+      num_buckets, seed, seed2, /*reshuffle_each_iteration=*/false,
+      /*output_dtypes=*/{DT_INT64},
+      /*output_shapes=*/{PartialTensorShape({})},
+      /*node_name=*/kNodeName);
+}
+
+std::vector<Tensor> Range(int64_t num_elements) {
+  std::vector<Tensor> elements;
+  for (int64_t i = 0; i < num_elements; ++i) {
+    elements.push_back(CreateTensor<int64_t>(TensorShape({}), {i}));
+  }
+  return elements;
+}
+
+std::vector<int64_t> Values(const std::vector<Tensor>& outputs) {
+  std::vector<int64_t> values;
+  for (const Tensor& output : outputs) {
+    values.push_back(output.scalar<int64_t>()());
+  }
+  return values;
+}
+
+// Tests that compare several datasets initialize the runtime once with
+// `InitializeRuntime()`, and create each dataset and iterator with the
+// helpers below rather than with `Initialize()`.
+class ExternalShuffleDatasetOpTest : public DatasetOpsTestBase {
+ protected:
+  Status MakeDatasetAndIterator(
+      const ExternalShuffleDatasetParams& dataset_params,
+      std::unique_ptr<TestDataset>* dataset,
+      std::unique_ptr<TestIterator>* iterator) {
+    TF_RETURN_IF_ERROR(MakeDataset(dataset_params, dataset));
+    return MakeIterator(dataset_params, **dataset, iterator);
+  }
+
+  // Returns the elements that a new iterator over `dataset_params` produces.
+  StatusOr<std::vector<Tensor>> GetAllOutputs(
+      const ExternalShuffleDatasetParams& dataset_params) {
+    std::unique_ptr<TestDataset> dataset;
+    std::unique_ptr<TestIterator> iterator;
+    TF_RETURN_IF_ERROR(
+        MakeDatasetAndIterator(dataset_params, &dataset, &iterator));
+    return GetRemainingOutputs(iterator->iterator(), iterator->ctx());
+  }
+
+  static StatusOr<std::vector<Tensor>> GetRemainingOutputs(
+      IteratorBase* iterator, IteratorContext* ctx) {
+    std::vector<Tensor> outputs;
+    bool end_of_sequence = false;
+    while (!end_of_sequence) {
+      std::vector<Tensor> next;
+      TF_RETURN_IF_ERROR(iterator->GetNext(ctx, &next, &end_of_sequence));
+      outputs.insert(outputs.end(), next.begin(), next.end());
+    }
+    return outputs;
+  }
+};
+
+TEST_F(ExternalShuffleDatasetOpTest, ProducesAPermutation) {
+  TF_ASSERT_OK(InitializeRuntime(ExternalShuffleParams(/*num_elements=*/1,
+                                                       /*num_buckets=*/1)));
+  for (int64_t num_buckets : {1, 4, 100}) {
+    TF_ASSERT_OK_AND_ASSIGN(
+        std::vector<Tensor> outputs,
+        GetAllOutputs(ExternalShuffleParams(/*num_elements=*/100,
+                                            num_buckets)));
+    TF_EXPECT_OK(ExpectEqual(outputs, Range(100), /*compare_order=*/false));
+    EXPECT_FALSE(ExpectEqual(outputs, Range(100), /*compare_order=*/true).ok());
+  }
+}
+
+TEST_F(ExternalShuffleDatasetOpTest, ProducesEveryOrder) {
+  TF_ASSERT_OK(InitializeRuntime(ExternalShuffleParams(/*num_elements=*/1,
+                                                       /*num_buckets=*/1)));
+  // Each of the 6 orders of 3 elements is produced for about 1 in 6 seeds,
+  // whether the order comes from the bucket assignment or from the shuffles
+  // of the buckets.
+  std::map<std::vector<int64_t>, int> counts;
+  const int kNumSeeds = 300;
+  for (int64_t seed = 1; seed <= kNumSeeds; ++seed) {
+    TF_ASSERT_OK_AND_ASSIGN(
+        std::vector<Tensor> outputs,
+        GetAllOutputs(ExternalShuffleParams(/*num_elements=*/3,
+                                            /*num_buckets=*/2,
+                                            testing::TmpDir(), seed,
+                                            /*seed2=*/0)));
+    ++counts[Values(outputs)];
+  }
+  EXPECT_EQ(counts.size(), 6);
+  for (const auto& count : counts) {
+    EXPECT_GE(count.second, kNumSeeds / 6 / 2)
+        << absl::StrJoin(count.first, ", ");
+  }
+}
+
+TEST_F(ExternalShuffleDatasetOpTest, LocalTemporaryDirectory) {
+  TF_ASSERT_OK(InitializeRuntime(ExternalShuffleParams(/*num_elements=*/1,
+                                                       /*num_buckets=*/1)));
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::vector<Tensor> outputs,
+      GetAllOutputs(ExternalShuffleParams(/*num_elements=*/50,
+                                          /*num_buckets=*/3,
+                                          /*directory=*/"")));
+  TF_EXPECT_OK(ExpectEqual(outputs, Range(50), /*compare_order=*/false));
+}
+
+TEST_F(ExternalShuffleDatasetOpTest, DeterministicWithFixedSeeds) {
+  TF_ASSERT_OK(InitializeRuntime(ExternalShuffleParams(/*num_elements=*/1,
+                                                       /*num_buckets=*/1)));
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::vector<Tensor> expected,
+      GetAllOutputs(ExternalShuffleParams(/*num_elements=*/100,
+                                          /*num_buckets=*/8)));
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::vector<Tensor> outputs,
+      GetAllOutputs(ExternalShuffleParams(/*num_elements=*/100,
+                                          /*num_buckets=*/8)));
+  TF_EXPECT_OK(ExpectEqual(outputs, expected, /*compare_order=*/true));
+
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::vector<Tensor> other_seeds,
+      GetAllOutputs(ExternalShuffleParams(/*num_elements=*/100,
+                                          /*num_buckets=*/8, testing::TmpDir(),
+                                          /*seed=*/1, /*seed2=*/2)));
+  EXPECT_FALSE(ExpectEqual(other_seeds, expected, /*compare_order=*/true).ok());
+}
+
+TEST_F(ExternalShuffleDatasetOpTest, DeletesBucketsAtEndOfSequence) {
+  const std::string directory =
+      io::JoinPath(testing::TmpDir(), "external_shuffle_cleanup");
+  TF_ASSERT_OK(Env::Default()->RecursivelyCreateDir(directory));
+  TF_ASSERT_OK(Initialize(ExternalShuffleParams(/*num_elements=*/10,
+                                                /*num_buckets=*/2, directory)));
+  std::vector<Tensor> next;
+  bool end_of_sequence = false;
+  TF_ASSERT_OK(
+      iterator_->GetNext(iterator_ctx_.get(), &next, &end_of_sequence));
+  std::vector<string> children;
+  TF_ASSERT_OK(Env::Default()->GetChildren(directory, &children));
+  EXPECT_EQ(children.size(), 1);
+  while (!end_of_sequence) {
+    TF_ASSERT_OK(
+        iterator_->GetNext(iterator_ctx_.get(), &next, &end_of_sequence));
+  }
+  TF_ASSERT_OK(Env::Default()->GetChildren(directory, &children));
+  EXPECT_TRUE(children.empty());
+}
+
+TEST_F(ExternalShuffleDatasetOpTest, ConcurrentGetNext) {
+  const std::string directory =
+      io::JoinPath(testing::TmpDir(), "external_shuffle_concurrent");
+  TF_ASSERT_OK(Env::Default()->RecursivelyCreateDir(directory));
+  const ExternalShuffleDatasetParams dataset_params =
+      ExternalShuffleParams(/*num_elements=*/200, /*num_buckets=*/4, directory);
+  TF_ASSERT_OK(InitializeRuntime(dataset_params));
+  std::unique_ptr<TestDataset> dataset;
+  std::unique_ptr<TestIterator> iterator;
+  TF_ASSERT_OK(MakeDatasetAndIterator(dataset_params, &dataset, &iterator));
+
+  // The callers that arrive during the first pass wait for it, and the input
+  // is written to the buckets once.
+  mutex mu;
+  std::vector<Tensor> outputs;
+  Status status;
+  {
+    thread::ThreadPool pool(Env::Default(), "concurrent_get_next",
+                            /*num_threads=*/4);
+    for (int i = 0; i < 4; ++i) {
+      pool.Schedule([&]() {
+        while (true) {
+          std::vector<Tensor> next;
+          bool end_of_sequence = false;
+          Status s = iterator->GetNext(&next, &end_of_sequence);
+          mutex_lock l(mu);
+          status.Update(s);
+          if (!s.ok() || end_of_sequence) return;
+          outputs.insert(outputs.end(), next.begin(), next.end());
+        }
+      });
+    }
+  }
+  TF_ASSERT_OK(status);
+  TF_EXPECT_OK(ExpectEqual(outputs, Range(200), /*compare_order=*/false));
+  std::vector<string> children;
+  TF_ASSERT_OK(Env::Default()->GetChildren(directory, &children));
+  EXPECT_TRUE(children.empty());
+}
+
+TEST_F(ExternalShuffleDatasetOpTest, SaveAndRestore) {
+  const ExternalShuffleDatasetParams dataset_params =
+      ExternalShuffleParams(/*num_elements=*/40, /*num_buckets=*/4);
+  TF_ASSERT_OK(InitializeRuntime(dataset_params));
+  TF_ASSERT_OK_AND_ASSIGN(std::vector<Tensor> expected,
+                          GetAllOutputs(dataset_params));
+  std::unique_ptr<TestDataset> dataset;
+  std::unique_ptr<TestIterator> iterator;
+  TF_ASSERT_OK(MakeDatasetAndIterator(dataset_params, &dataset, &iterator));
+  TF_EXPECT_OK(CheckIteratorSaveAndRestore(
+      dataset->dataset(), iterator->ctx(), dataset_params.iterator_prefix(),
+      expected, /*breakpoints=*/{0, 1, 7, 23, 40, 45}, /*compare_order=*/true));
+}
+
+TEST_F(ExternalShuffleDatasetOpTest, RestoreRewritesDeletedBuckets) {
+  const ExternalShuffleDatasetParams dataset_params =
+      ExternalShuffleParams(/*num_elements=*/30, /*num_buckets=*/3);
+  TF_ASSERT_OK(InitializeRuntime(dataset_params));
+  TF_ASSERT_OK_AND_ASSIGN(std::vector<Tensor> expected,
+                          GetAllOutputs(dataset_params));
+  std::unique_ptr<TestDataset> dataset;
+  std::unique_ptr<TestIterator> iterator;
+  TF_ASSERT_OK(MakeDatasetAndIterator(dataset_params, &dataset, &iterator));
+  std::vector<Tensor> outputs;
+  for (int i = 0; i < 13; ++i) {
+    std::vector<Tensor> next;
+    bool end_of_sequence = false;
+    TF_ASSERT_OK(iterator->GetNext(&next, &end_of_sequence));
+    ASSERT_FALSE(end_of_sequence);
+    outputs.insert(outputs.end(), next.begin(), next.end());
+  }
+  std::unique_ptr<SerializationContext> serialization_ctx;
+  TF_ASSERT_OK(CreateSerializationContext(&serialization_ctx));
+  VariantTensorDataWriter writer;
+  TF_ASSERT_OK(iterator->iterator()->Save(serialization_ctx.get(), &writer));
+  std::vector<const VariantTensorData*> data;
+  writer.GetData(&data);
+
+  // Destroying the only iterator that reads the buckets deletes them, so the
+  // restored iterator writes them again from the input.
+  iterator.reset();
+  std::unique_ptr<TestIterator> restore_iterator;
+  TF_ASSERT_OK(MakeIterator(dataset_params, *dataset, &restore_iterator));
+  VariantTensorDataReader reader(data);
+  std::unique_ptr<IteratorBase> restored;
+  TF_ASSERT_OK(RestoreIterator(restore_iterator->ctx(), &reader,
+                               dataset_params.iterator_prefix(),
+                               *dataset->dataset(), &restored));
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::vector<Tensor> remaining,
+      GetRemainingOutputs(restored.get(), restore_iterator->ctx()));
+  outputs.insert(outputs.end(), remaining.begin(), remaining.end());
+  TF_EXPECT_OK(ExpectEqual(outputs, expected, /*compare_order=*/true));
+}
+
+TEST_F(ExternalShuffleDatasetOpTest, InvalidArguments) {
+  for (int64_t num_buckets : {int64_t{0}, int64_t{-1},
+                              ExternalShuffleDatasetOp::kMaxNumBuckets + 1}) {
+    EXPECT_EQ(Initialize(ExternalShuffleParams(/*num_elements=*/10,
+                                               num_buckets))
+                  .code(),
+              absl::StatusCode::kInvalidArgument);
+  }
+}
+
+std::vector<DatasetNodeNameTestCase<ExternalShuffleDatasetParams>>
+DatasetNodeNameTestCases() {
+  return {{/*dataset_params=*/ExternalShuffleParams(/*num_elements=*/10,
+                                                    /*num_buckets=*/2),
+           /*expected_node_name=*/kNodeName}};
+}
+
+DATASET_NODE_NAME_TEST_P(ExternalShuffleDatasetOpTest,
+                         ExternalShuffleDatasetParams,
+                         DatasetNodeNameTestCases())
+
+std::vector<CardinalityTestCase<ExternalShuffleDatasetParams>>
+CardinalityTestCases() {
+  return {{/*dataset_params=*/ExternalShuffleParams(/*num_elements=*/10,
+                                                    /*num_buckets=*/2),
+           /*expected_cardinality=*/10}};
+}
+
+DATASET_CARDINALITY_TEST_P(ExternalShuffleDatasetOpTest,
+                           ExternalShuffleDatasetParams,
+                           CardinalityTestCases())
+
+}  // namespace
+}  // namespace experimental
+}  // namespace data
+}  // namespace tensorflow
@@ -13,6 +13,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 #include <deque>
+#include <memory>
 
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/data/dataset_utils.h"
@@ -198,9 +199,22 @@ class ParseExampleDatasetOp : public UnaryDatasetOpKernel {
       it->second = i++;
     }
 
+    // The config is compiled once per dataset, for parsing with and without
+    // collecting feature statistics.
+    std::unique_ptr<const example::CompiledFastParseExampleConfig>
+        compiled_config;
+    OP_REQUIRES_OK(ctx, example::CompiledFastParseExampleConfig::Compile(
+                            config, &compiled_config));
+    config.collect_feature_stats = true;
+    std::unique_ptr<const example::CompiledFastParseExampleConfig>
+        compiled_config_with_stats;
+    OP_REQUIRES_OK(ctx, example::CompiledFastParseExampleConfig::Compile(
+                            std::move(config), &compiled_config_with_stats));
+
     *output = new Dataset(
         ctx, input, dense_defaults, sparse_keys_, dense_keys_,
-        std::move(key_to_output_index), std::move(config), num_parallel_calls,
+        std::move(key_to_output_index), std::move(compiled_config),
+        std::move(compiled_config_with_stats), num_parallel_calls,
         sparse_types_, dense_types_, dense_shapes_, output_types_,
         output_shapes_, deterministic_, has_ragged_keys_, ragged_keys_,
         ragged_value_types_, ragged_split_types_, op_version_);
@@ -213,7 +227,11 @@ class ParseExampleDatasetOp : public UnaryDatasetOpKernel {
             std::vector<Tensor> dense_defaults, std::vector<string> sparse_keys,
             std::vector<string> dense_keys,
             std::map<string, int> key_to_output_index,
-            example::FastParseExampleConfig config, int32_t num_parallel_calls,
+            std::unique_ptr<const example::CompiledFastParseExampleConfig>
+                compiled_config,
+            std::unique_ptr<const example::CompiledFastParseExampleConfig>
+                compiled_config_with_stats,
+            int32_t num_parallel_calls,
             const DataTypeVector& sparse_types,
             const DataTypeVector& dense_types,
             const std::vector<PartialTensorShape>& dense_shapes,
@@ -230,7 +248,8 @@ class ParseExampleDatasetOp : public UnaryDatasetOpKernel {
           dense_keys_(std::move(dense_keys)),
           ragged_keys_(std::move(ragged_keys)),
           key_to_output_index_(std::move(key_to_output_index)),
-          config_(std::move(config)),
+          compiled_config_(std::move(compiled_config)),
+          compiled_config_with_stats_(std::move(compiled_config_with_stats)),
           num_parallel_calls_(num_parallel_calls),
           sparse_types_(sparse_types),
           dense_types_(dense_types),
@@ -658,15 +677,14 @@ class ParseExampleDatasetOp : public UnaryDatasetOpKernel {
           for (auto it = slice.begin(); it != slice.end(); it++)
             slice_vec.push_back(*it);
         }
-        example::FastParseExampleConfig config = dataset()->config_;
-        // local copy of config_ for modification.
         auto stats_aggregator = ctx->stats_aggregator();
-        if (stats_aggregator) {
-          config.collect_feature_stats = true;
-        }
+        const example::CompiledFastParseExampleConfig& compiled_config =
+            stats_aggregator ? *dataset()->compiled_config_with_stats_
+                             : *dataset()->compiled_config_;
         example::Result example_result;
-        TF_RETURN_IF_ERROR(FastParseExample(
-            config, slice_vec, {}, device_threadpool, &example_result));
+        TF_RETURN_IF_ERROR(FastParseExample(compiled_config, slice_vec, {},
+                                            device_threadpool,
+                                            &example_result));
         (*output).resize(dataset()->key_to_output_index_.size());
         for (int d = 0; d < dataset()->dense_keys_.size(); ++d) {
           int output_index =
@@ -922,7 +940,10 @@ class ParseExampleDatasetOp : public UnaryDatasetOpKernel {
     const std::vector<string> dense_keys_;
     const std::vector<string> ragged_keys_;
     const std::map<string, int> key_to_output_index_;
-    const example::FastParseExampleConfig config_;
+    const std::unique_ptr<const example::CompiledFastParseExampleConfig>
+        compiled_config_;
+    const std::unique_ptr<const example::CompiledFastParseExampleConfig>
+        compiled_config_with_stats_;
     const int64_t num_parallel_calls_;
     const DataTypeVector sparse_types_;
     const DataTypeVector dense_types_;
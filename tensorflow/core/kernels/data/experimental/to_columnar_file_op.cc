@@ -0,0 +1,183 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/data/columnar_file_utils.h"
+#include "tensorflow/core/data/dataset_utils.h"
+#include "tensorflow/core/data/root_dataset.h"
+#include "tensorflow/core/framework/dataset.h"
+#include "tensorflow/core/framework/function_handle_cache.h"
+#include "tensorflow/core/framework/metrics.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/platform/resource.h"
+#include "tensorflow/core/util/batch_util.h"
+
+namespace tensorflow {
+namespace data {
+namespace experimental {
+namespace {
+
+// Writes the elements of a dataset to a columnar file (see
+// tensorflow/core/data/columnar_file_utils.h). Each component of the elements
+// becomes a column, and every `row_group_size` elements form a row group.
+class ToColumnarFileOp : public AsyncOpKernel {
+ public:
+  explicit ToColumnarFileOp(OpKernelConstruction* ctx)
+      : AsyncOpKernel(ctx),
+        background_worker_(ctx->env(), "tf_data_to_columnar_file") {}
+
+  void ComputeAsync(OpKernelContext* ctx, DoneCallback done) override {
+    // The call to `iterator->GetNext()` may block and depend on an inter-op
+    // thread pool thread, so we issue the call using a background thread.
+    background_worker_.Schedule([this, ctx, done = std::move(done)]() {
+      OP_REQUIRES_OK_ASYNC(ctx, DoCompute(ctx), done);
+      done();
+    });
+  }
+
+ private:
+  Status DoCompute(OpKernelContext* ctx) {
+    tensorflow::ResourceTagger tag(kTFDataResourceTag,
+                                   ctx->op_kernel().type_string());
+    metrics::RecordTFDataFetchOp("ToColumnarFileOp");
+    tstring filename;
+    TF_RETURN_IF_ERROR(
+        ParseScalarArgument<tstring>(ctx, "filename", &filename));
+    std::vector<tstring> column_names;
+    TF_RETURN_IF_ERROR(
+        ParseVectorArgument<tstring>(ctx, "column_names", &column_names));
+    int64_t row_group_size;
+    TF_RETURN_IF_ERROR(
+        ParseScalarArgument<int64_t>(ctx, "row_group_size", &row_group_size));
+    if (row_group_size <= 0) {
+      return errors::InvalidArgument("`row_group_size` must be positive, got ",
+                                     row_group_size);
+    }
+
+    DatasetBase* dataset;
+    TF_RETURN_IF_ERROR(GetDatasetFromVariantTensor(ctx->input(0), &dataset));
+    if (column_names.size() != dataset->output_dtypes().size()) {
+      return errors::InvalidArgument(
+          "Expected one column name per dataset component, got ",
+          column_names.size(), " names for ", dataset->output_dtypes().size(),
+          " components.");
+    }
+
+    IteratorContext::Params params(ctx);
+    FunctionHandleCache function_handle_cache(params.flr);
+    params.function_handle_cache = &function_handle_cache;
+    ResourceMgr resource_mgr;
+    params.resource_mgr = &resource_mgr;
+    CancellationManager cancellation_manager(ctx->cancellation_manager());
+    params.cancellation_manager = &cancellation_manager;
+
+    IteratorContext iter_ctx(std::move(params));
+    DatasetBase* finalized_dataset;
+    TF_RETURN_IF_ERROR(FinalizeDataset(ctx, dataset, &finalized_dataset));
+    core::ScopedUnref unref(finalized_dataset);
+
+    std::unique_ptr<IteratorBase> iterator;
+    TF_RETURN_IF_ERROR(finalized_dataset->MakeIterator(
+        &iter_ctx, /*parent=*/nullptr, "ToColumnarFileOpIterator", &iterator));
+
+    // The per-row shapes of the columns are those of the first element.
+    std::vector<ColumnarFileColumn> columns;
+    std::unique_ptr<ColumnarFileWriter> writer;
+    std::vector<std::vector<Tensor>> rows;
+    bool end_of_sequence = false;
+    while (true) {
+      std::vector<Tensor> components;
+      TF_RETURN_IF_ERROR(
+          iterator->GetNext(&iter_ctx, &components, &end_of_sequence));
+      if (end_of_sequence) break;
+      if (!writer) {
+        for (int i = 0; i < components.size(); ++i) {
+          columns.push_back({column_names[i], components[i].dtype(),
+                             components[i].shape()});
+        }
+        writer = std::make_unique<ColumnarFileWriter>(ctx->env(), filename,
+                                                      columns);
+        TF_RETURN_IF_ERROR(writer->Initialize());
+      }
+      for (int i = 0; i < components.size(); ++i) {
+        if (components[i].shape() != columns[i].shape) {
+          return errors::InvalidArgument(
+              "All values of a column must have the same shape, but column ",
+              columns[i].name, " has values of shapes ",
+              columns[i].shape.DebugString(), " and ",
+              components[i].shape().DebugString());
+        }
+      }
+      rows.push_back(std::move(components));
+      if (rows.size() == row_group_size) {
+        TF_RETURN_IF_ERROR(WriteRowGroup(columns, &rows, writer.get()));
+        rows.clear();
+      }
+    }
+
+    if (!writer) {
+      // The dataset is empty, so the column shapes must be known statically.
+      for (int i = 0; i < column_names.size(); ++i) {
+        TensorShape shape;
+        if (!finalized_dataset->output_shapes()[i].AsTensorShape(&shape)) {
+          return errors::InvalidArgument(
+              "Cannot write an empty dataset whose element shapes are not "
+              "fully defined to a columnar file.");
+        }
+        columns.push_back(
+            {column_names[i], finalized_dataset->output_dtypes()[i], shape});
+      }
+      writer =
+          std::make_unique<ColumnarFileWriter>(ctx->env(), filename, columns);
+      TF_RETURN_IF_ERROR(writer->Initialize());
+    }
+    TF_RETURN_IF_ERROR(WriteRowGroup(columns, &rows, writer.get()));
+    return writer->Close();
+  }
+
+  // Batches `rows` and writes them as a row group, if there are any. The
+  // values of `rows` are moved from.
+  static Status WriteRowGroup(const std::vector<ColumnarFileColumn>& columns,
+                              std::vector<std::vector<Tensor>>* rows,
+                              ColumnarFileWriter* writer) {
+    if (rows->empty()) return OkStatus();
+    std::vector<Tensor> batched_columns;
+    for (int i = 0; i < columns.size(); ++i) {
+      TensorShape shape({static_cast<int64_t>(rows->size())});
+      shape.AppendShape(columns[i].shape);
+      Tensor batch(columns[i].dtype, shape);
+      for (int64_t j = 0; j < rows->size(); ++j) {
+        TF_RETURN_IF_ERROR(batch_util::CopyElementToSlice(
+            std::move((*rows)[j][i]), &batch, j));
+      }
+      batched_columns.push_back(std::move(batch));
+    }
+    return writer->WriteRowGroup(batched_columns);
+  }
+
+  BackgroundWorker background_worker_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("DatasetToColumnarFile").Device(DEVICE_CPU),
+                        ToColumnarFileOp);
+
+}  // namespace
+}  // namespace experimental
+}  // namespace data
+}  // namespace tensorflow
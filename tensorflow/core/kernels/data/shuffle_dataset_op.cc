@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/kernels/data/shuffle_dataset_op.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <deque>
 #include <memory>
@@ -32,13 +33,16 @@ limitations under the License.
 #include "tensorflow/core/framework/partial_tensor_shape.h"
 #include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_util.h"
 #include "tensorflow/core/kernels/data/random_seed_ops.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/random/philox_random.h"
 #include "tensorflow/core/lib/random/random.h"
 #include "tensorflow/core/lib/random/random_distributions.h"
 #include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/statusor.h"
 #include "tensorflow/core/platform/stringprintf.h"
+#include "tensorflow/core/util/batch_util.h"
 
 namespace tensorflow {
 namespace data {
@@ -54,6 +58,8 @@ namespace data {
 /* static */ constexpr const char* const ShuffleDatasetOpBase::kOutputShapes;
 /* static */ constexpr const char* const
     ShuffleDatasetOpBase::kReshuffleEachIteration;
+/* static */ constexpr const char* const ShuffleDatasetOpBase::kCompactBuffer;
+/* static */ constexpr const char* const ShuffleDatasetOpBase::kBlockSize;
 
 /* static */ constexpr const char* const ShuffleDatasetOp::kDatasetType;
 
@@ -80,6 +86,186 @@ constexpr char kShuffleDatasetV2[] = "ShuffleDatasetV2";
 constexpr char kShuffleDatasetV3[] = "ShuffleDatasetV3";
 constexpr char kShuffleAndRepeatDatasetV1[] = "ShuffleAndRepeatDataset";
 constexpr char kShuffleAndRepeatDatasetV2[] = "ShuffleAndRepeatDatasetV2";
+constexpr char kFrontRowsProduced[] = "front_rows_produced";
+constexpr char kCompactBufferBlockRows[] = "compact_buffer_block_rows";
+constexpr char kCompactBufferNumSlabs[] = "compact_buffer_num_slabs";
+constexpr char kCompactBufferSlab[] = "compact_buffer_slab";
+
+namespace {
+
+// Stores the elements of a shuffle buffer in one slab per component, with the
+// element in row `i` of every slab, instead of in a `std::vector<Tensor>` per
+// element. Rows are grouped into blocks of `block_size` consecutive input
+// elements, which are the units that the shuffle buffer samples from.
+class CompactShuffleBuffer {
+ public:
+  CompactShuffleBuffer(int64_t num_blocks, int64_t block_size)
+      : block_size_(block_size), block_rows_(num_blocks, 0) {}
+
+  int64_t num_blocks() const { return block_rows_.size(); }
+
+  // Returns the number of rows of `block` that hold an element.
+  int64_t block_rows(int64_t block) const { return block_rows_[block]; }
+
+  // Returns true if `block` has no free rows left.
+  bool IsFull(int64_t block) const { return block_rows_[block] == block_size_; }
+
+  // Copies `element` into the next free row of `block`. The slabs are
+  // allocated when the first element is added, and all later elements must
+  // have the same shapes.
+  Status AddRow(int64_t block, std::vector<Tensor>&& element) {
+    if (slabs_.empty()) {
+      TF_RETURN_IF_ERROR(AllocateSlabs(element));
+    }
+    if (element.size() != slabs_.size()) {
+      return errors::InvalidArgument(
+          "Expected an element with ", slabs_.size(), " components, but got ",
+          element.size(), ".");
+    }
+    const int64_t row = block * block_size_ + block_rows_[block];
+    for (size_t i = 0; i < element.size(); ++i) {
+      if (element[i].shape() != row_shapes_[i]) {
+        return errors::InvalidArgument(
+            "A compact shuffle buffer requires all elements to have the same "
+            "shape, but component ",
+            i, " has shape ", element[i].shape().DebugString(),
+            " instead of ", row_shapes_[i].DebugString(), ".");
+      }
+      TF_RETURN_IF_ERROR(batch_util::CopyElementToSlice(std::move(element[i]),
+                                                        &slabs_[i], row));
+    }
+    ++block_rows_[block];
+    return OkStatus();
+  }
+
+  // Moves the element in row `row` of `block` into `out`.
+  Status TakeRow(int64_t block, int64_t row, std::vector<Tensor>* out) {
+    out->clear();
+    out->reserve(slabs_.size());
+    for (size_t i = 0; i < slabs_.size(); ++i) {
+      out->emplace_back(slabs_[i].dtype(), row_shapes_[i]);
+      TF_RETURN_IF_ERROR(batch_util::MaybeMoveSliceToElement(
+          &slabs_[i], &out->back(), block * block_size_ + row));
+    }
+    return OkStatus();
+  }
+
+  void ClearBlock(int64_t block) { block_rows_[block] = 0; }
+
+  // Swaps the contents of blocks `a` and `b` in place.
+  void SwapBlocks(int64_t a, int64_t b) {
+    if (a == b) return;
+    std::swap(block_rows_[a], block_rows_[b]);
+    for (size_t i = 0; i < slabs_.size(); ++i) {
+      Tensor& slab = slabs_[i];
+      const int64_t block_elements =
+          block_size_ * row_shapes_[i].num_elements();
+      if (slab.dtype() == DT_STRING) {
+        tstring* data = slab.flat<tstring>().data();
+        std::swap_ranges(data + a * block_elements,
+                         data + (a + 1) * block_elements,
+                         data + b * block_elements);
+      } else {
+        const int64_t block_bytes =
+            block_elements * DataTypeSize(slab.dtype());
+        char* data = const_cast<char*>(slab.tensor_data().data());
+        std::swap_ranges(data + a * block_bytes, data + (a + 1) * block_bytes,
+                         data + b * block_bytes);
+      }
+    }
+  }
+
+  // Returns the number of elements in the buffer, and a copy of one of them
+  // in `sample` if there are any.
+  StatusOr<int64_t> Sample(std::vector<Tensor>* sample) const {
+    int64_t num_rows = 0;
+    for (int64_t block = 0; block < num_blocks(); ++block) {
+      if (block_rows_[block] > 0 && num_rows == 0) {
+        for (size_t i = 0; i < slabs_.size(); ++i) {
+          sample->emplace_back(slabs_[i].dtype(), row_shapes_[i]);
+          TF_RETURN_IF_ERROR(batch_util::CopySliceToElement(
+              slabs_[i], &sample->back(), block * block_size_));
+        }
+      }
+      num_rows += block_rows_[block];
+    }
+    return num_rows;
+  }
+
+  Status Save(const std::string& name, IteratorStateWriter* writer) const {
+    Tensor block_rows(DT_INT64, TensorShape({num_blocks()}));
+    std::copy(block_rows_.begin(), block_rows_.end(),
+              block_rows.flat<int64_t>().data());
+    TF_RETURN_IF_ERROR(
+        writer->WriteTensor(name, kCompactBufferBlockRows, block_rows));
+    TF_RETURN_IF_ERROR(
+        writer->WriteScalar(name, kCompactBufferNumSlabs, slabs_.size()));
+    for (size_t i = 0; i < slabs_.size(); ++i) {
+      // The slabs are updated in place, so the checkpoint needs its own copy.
+      TF_RETURN_IF_ERROR(writer->WriteTensor(
+          name, absl::StrCat(kCompactBufferSlab, "_", i),
+          tensor::DeepCopy(slabs_[i])));
+    }
+    return OkStatus();
+  }
+
+  Status Restore(const std::string& name, IteratorStateReader* reader) {
+    Tensor block_rows;
+    TF_RETURN_IF_ERROR(
+        reader->ReadTensor(name, kCompactBufferBlockRows, &block_rows));
+    if (block_rows.NumElements() != num_blocks()) {
+      return errors::FailedPrecondition(
+          "The checkpointed shuffle buffer has ", block_rows.NumElements(),
+          " blocks, but the shuffle buffer has ", num_blocks(), ".");
+    }
+    auto block_rows_flat = block_rows.flat<int64_t>();
+    std::copy(block_rows_flat.data(),
+              block_rows_flat.data() + block_rows_flat.size(),
+              block_rows_.begin());
+    int64_t num_slabs;
+    TF_RETURN_IF_ERROR(
+        reader->ReadScalar(name, kCompactBufferNumSlabs, &num_slabs));
+    slabs_.resize(num_slabs);
+    row_shapes_.clear();
+    for (int64_t i = 0; i < num_slabs; ++i) {
+      Tensor slab;
+      TF_RETURN_IF_ERROR(reader->ReadTensor(
+          name, absl::StrCat(kCompactBufferSlab, "_", i), &slab));
+      // The slabs are updated in place, so they must not share their buffers
+      // with the checkpoint.
+      slabs_[i] = tensor::DeepCopy(slab);
+      TensorShape row_shape = slabs_[i].shape();
+      row_shape.RemoveDim(0);
+      row_shapes_.push_back(std::move(row_shape));
+    }
+    return OkStatus();
+  }
+
+ private:
+  Status AllocateSlabs(const std::vector<Tensor>& element) {
+    for (const Tensor& component : element) {
+      if (!DataTypeCanUseMemcpy(component.dtype()) &&
+          component.dtype() != DT_STRING) {
+        return errors::InvalidArgument(
+            "A compact shuffle buffer does not support components of type ",
+            DataTypeString(component.dtype()), ".");
+      }
+      TensorShape slab_shape = component.shape();
+      TF_RETURN_IF_ERROR(
+          slab_shape.InsertDimWithStatus(0, num_blocks() * block_size_));
+      slabs_.emplace_back(component.dtype(), slab_shape);
+      row_shapes_.push_back(component.shape());
+    }
+    return OkStatus();
+  }
+
+  const int64_t block_size_;
+  std::vector<int64_t> block_rows_;
+  std::vector<Tensor> slabs_;
+  std::vector<TensorShape> row_shapes_;
+};
+
+}  // namespace
 
 ShuffleDatasetOpBase::ShuffleDatasetOpBase(OpKernelConstruction* ctx)
     : UnaryDatasetOpKernel(ctx) {}
@@ -90,12 +276,15 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
   ShuffleDatasetBase(OpKernelContext* ctx, const DatasetBase* input,
                      int64_t buffer_size,
                      std::shared_ptr<SeedGenerator> seed_generator,
-                     int64_t count)
+                     int64_t count, bool compact_buffer = false,
+                     int64_t block_size = 1)
       : DatasetBase(DatasetContext(ctx)),
         input_(input),
         buffer_size_(buffer_size),
         seed_generator_(std::move(seed_generator)),
         count_(count),
+        compact_buffer_(compact_buffer),
+        block_size_(block_size),
         traceme_metadata_(
             {{"buffer_size",
               strings::Printf("%lld", static_cast<long long>(buffer_size))}}) {
@@ -191,7 +380,13 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
           seed_generator_(seed_generator),
           parent_generator_(seed_generator->seed(), seed_generator->seed2()),
           generator_(&parent_generator_) {
-      if (params.dataset->buffer_size_ == kUnknownCardinality) {
+      if (params.dataset->compact_buffer_) {
+        const int64_t block_size = params.dataset->block_size_;
+        compact_buffer_ = std::make_unique<CompactShuffleBuffer>(
+            (params.dataset->buffer_size_ + block_size - 1) / block_size,
+            block_size);
+        buffer_ = std::make_unique<std::vector<std::vector<Tensor>>>();
+      } else if (params.dataset->buffer_size_ == kUnknownCardinality) {
         buffer_ = std::make_unique<std::vector<std::vector<Tensor>>>();
       } else {
         buffer_ = std::make_unique<std::vector<std::vector<Tensor>>>(
@@ -218,6 +413,12 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
                            std::vector<Tensor>* out_tensors,
                            bool* end_of_sequence) override {
       mutex_lock l(mu_);
+      if (front_rows_produced_ > 0) {
+        // Finish producing the block at the front of the buffer before
+        // sampling the next one.
+        *end_of_sequence = false;
+        return ProduceFromFrontBlock(ctx, out_tensors);
+      }
       TF_RETURN_IF_ERROR(FillBuffer(ctx));
       if (num_elements_ == 0) {
         DCHECK(input_impl_ == nullptr);
@@ -232,7 +433,12 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
       // slice, and then remove the element from the slice.
       int64_t offset =
           Random() % (slices_.front()->end - slices_.front()->start);
-      int64_t index = (slices_.front()->start + offset) % buffer_->size();
+      int64_t index = (slices_.front()->start + offset) % BufferCapacity();
+      if (compact_buffer_) {
+        compact_buffer_->SwapBlocks(
+            index, slices_.front()->start % BufferCapacity());
+        return ProduceFromFrontBlock(ctx, out_tensors);
+      }
       *out_tensors = std::move(buffer_->at(index));
       this->RecordBufferDequeue(ctx, *out_tensors);
       std::swap(buffer_->at(index),
@@ -284,7 +490,11 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
       TF_RETURN_IF_ERROR(
           writer->WriteScalar(prefix(), kNumElements, num_elements_));
       const std::string key_prefix = absl::StrCat(prefix(), kColon, "buffer");
-      if (ctx->symbolic_checkpoint()) {
+      if (compact_buffer_) {
+        TF_RETURN_IF_ERROR(compact_buffer_->Save(prefix(), writer));
+        TF_RETURN_IF_ERROR(writer->WriteScalar(prefix(), kFrontRowsProduced,
+                                               front_rows_produced_));
+      } else if (ctx->symbolic_checkpoint()) {
         // When symbolic checkpointing is turned on, `writer`
         // already contains checkpoint of the shuffle buffer created by the
         // previous invocation of this instance and the indices that need to be
@@ -357,21 +567,32 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
             reader->ReadScalar(this->prefix(), kSlicesSize, &temp));
         slices_size = static_cast<size_t>(temp);
       }
-      buffer_ = std::make_unique<std::vector<std::vector<Tensor>>>();
-      TF_RETURN_IF_ERROR(ReadElementsFromCheckpoint(
-          ctx, reader, absl::StrCat(prefix(), kColon, "buffer"),
-          buffer_.get()));
-      if (ctx->symbolic_checkpoint()) {
-        DCHECK(checkpoint_indices_.empty());
-        for (size_t i = 0; i < buffer_->size(); ++i) {
-          checkpoint_indices_.insert(i);
+      if (compact_buffer_) {
+        TF_RETURN_IF_ERROR(compact_buffer_->Restore(prefix(), reader));
+        TF_RETURN_IF_ERROR(reader->ReadScalar(prefix(), kFrontRowsProduced,
+                                              &front_rows_produced_));
+        std::vector<Tensor> sample;
+        TF_ASSIGN_OR_RETURN(int64_t num_rows, compact_buffer_->Sample(&sample));
+        for (int64_t i = front_rows_produced_; i < num_rows; ++i) {
+          RecordBufferEnqueue(ctx, sample);
+        }
+      } else {
+        buffer_ = std::make_unique<std::vector<std::vector<Tensor>>>();
+        TF_RETURN_IF_ERROR(ReadElementsFromCheckpoint(
+            ctx, reader, absl::StrCat(prefix(), kColon, "buffer"),
+            buffer_.get()));
+        if (ctx->symbolic_checkpoint()) {
+          DCHECK(checkpoint_indices_.empty());
+          for (size_t i = 0; i < buffer_->size(); ++i) {
+            checkpoint_indices_.insert(i);
+          }
+        }
+        for (const auto& element : *buffer_) {
+          RecordBufferEnqueue(ctx, element);
+        }
+        if (!IsShuffleAll()) {
+          buffer_->resize(dataset()->buffer_size_);
         }
-      }
-      for (const auto& element : *buffer_) {
-        RecordBufferEnqueue(ctx, element);
-      }
-      if (!IsShuffleAll()) {
-        buffer_->resize(dataset()->buffer_size_);
       }
       slices_.clear();
       for (size_t i = 0; i < slices_size; ++i) {
@@ -439,6 +660,30 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
       return dataset()->buffer_size_ == kUnknownCardinality;
     }
 
+    // Returns the number of units that the buffer holds when it is full. The
+    // units are elements, or blocks of elements for a compact buffer.
+    int64_t BufferCapacity() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      return compact_buffer_ ? compact_buffer_->num_blocks() : buffer_->size();
+    }
+
+    // Produces the next element of the block at the front of the compact
+    // buffer, and removes the block from the buffer once it is exhausted.
+    Status ProduceFromFrontBlock(IteratorContext* ctx,
+                                 std::vector<Tensor>* out_tensors)
+        TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      const int64_t front = slices_.front()->start % BufferCapacity();
+      TF_RETURN_IF_ERROR(
+          compact_buffer_->TakeRow(front, front_rows_produced_, out_tensors));
+      this->RecordBufferDequeue(ctx, *out_tensors);
+      if (++front_rows_produced_ == compact_buffer_->block_rows(front)) {
+        compact_buffer_->ClearBlock(front);
+        front_rows_produced_ = 0;
+        slices_.front()->start++;
+        num_elements_--;
+      }
+      return OkStatus();
+    }
+
     // Fills the shuffle buffer, preparing the buffer for sampling.
     Status FillBuffer(IteratorContext* ctx) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       int64_t start_micros = EnvTime::NowMicros();
@@ -460,10 +705,18 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
         TF_RETURN_IF_ERROR(
             input_impl_->GetNext(ctx, &input_element, &end_of_input_sequence));
         if (end_of_input_sequence) {
+          if (compact_buffer_ &&
+              compact_buffer_->block_rows(slices_.back()->end %
+                                          BufferCapacity()) > 0) {
+            // The last block of the epoch is shuffled without being full.
+            num_elements_++;
+            slices_.back()->end++;
+          }
           slices_.back()->reached_end_of_sequence = true;
         }
         if (!end_of_input_sequence) {
-          AddToShuffleBuffer(ctx, std::move(input_element));
+          TF_RETURN_IF_ERROR(
+              AddToShuffleBuffer(ctx, std::move(input_element)));
           continue;
         }
         input_impl_.reset();
@@ -500,7 +753,7 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
         // we need to add to the buffer.
         return true;
       }
-      return num_elements_ < buffer_->size();
+      return num_elements_ < BufferCapacity();
     }
 
     Status PrepareNextEpoch(IteratorContext* ctx)
@@ -520,7 +773,8 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
       return OkStatus();
     }
 
-    void AddToShuffleBuffer(IteratorContext* ctx, std::vector<Tensor>&& element)
+    Status AddToShuffleBuffer(IteratorContext* ctx,
+                              std::vector<Tensor>&& element)
         TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       data_produced_ = true;
       if (num_elements_ == 0) {
@@ -528,6 +782,17 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
                 << BufferSizeString();
       }
       this->RecordBufferEnqueue(ctx, element);
+      if (compact_buffer_) {
+        // Elements are added to the block after the last slice, which becomes
+        // part of the slice once it is full.
+        const int64_t block = slices_.back()->end % BufferCapacity();
+        TF_RETURN_IF_ERROR(compact_buffer_->AddRow(block, std::move(element)));
+        if (compact_buffer_->IsFull(block)) {
+          num_elements_++;
+          slices_.back()->end++;
+        }
+        return OkStatus();
+      }
       if (num_elements_ == buffer_->size()) {
         DCHECK(IsShuffleAll());
         checkpoint_indices_.insert(buffer_->size());
@@ -539,6 +804,7 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
       }
       num_elements_++;
       slices_.back()->end++;
+      return OkStatus();
     }
 
     void ClearEmptySlices() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
@@ -560,6 +826,13 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
     SeedGenerator* const seed_generator_ TF_GUARDED_BY(mu_);  // Not owned.
     std::unique_ptr<std::vector<std::vector<Tensor>>> buffer_
         TF_GUARDED_BY(mu_);
+    // Replaces `buffer_` if the dataset uses a compact buffer. Its units are
+    // blocks of elements rather than elements.
+    std::unique_ptr<CompactShuffleBuffer> compact_buffer_ TF_GUARDED_BY(mu_);
+    // The number of elements produced from the block at the front of
+    // `compact_buffer_`, which is produced in full before the next block is
+    // sampled.
+    int64_t front_rows_produced_ TF_GUARDED_BY(mu_) = 0;
     // Holds the indices of `buffer_` that have changed since the previous
     // `SaveInternal()` and need to be updated in the MemoryCheckpoint
     // (if symbolic checkpointing is used) in the next `SaveInternal()`.
@@ -588,6 +861,10 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
   // fuse shuffle and repeat together, and make the shuffle dataset op
   // responsible for repeating as well.
   const int64_t count_;
+  // Whether the iterators store their buffer in a `CompactShuffleBuffer`, and
+  // the number of consecutive input elements that they shuffle as a unit.
+  const bool compact_buffer_;
+  const int64_t block_size_;
   const TraceMeMetadata traceme_metadata_;
   mutable mutex mu_;
   mutable std::vector<std::int64_t> shuffled_indices_ TF_GUARDED_BY(mu_);
@@ -601,8 +878,10 @@ class ShuffleDatasetOp::Dataset : public ShuffleDatasetBase {
  public:
   Dataset(OpKernelContext* ctx, const DatasetBase* input, int64_t buffer_size,
           int64_t count, RandomSeeds&& seeds, SeedGeneratorManager* manager,
-          ResourceHandle&& resource_handle)
-      : ShuffleDatasetBase(ctx, input, buffer_size, manager->get(), count),
+          ResourceHandle&& resource_handle, bool compact_buffer,
+          int64_t block_size)
+      : ShuffleDatasetBase(ctx, input, buffer_size, manager->get(), count,
+                           compact_buffer, block_size),
         manager_(manager),
         resource_handle_(std::move(resource_handle)),
         resource_mgr_(ctx->resource_manager()),
@@ -635,11 +914,16 @@ class ShuffleDatasetOp::Dataset : public ShuffleDatasetBase {
     TF_RETURN_IF_ERROR(b->AddScalar(seeds_.input_seed2(), &seed2_node));
     b->BuildAttrValue(seed_generator_->reshuffle_each_iteration(),
                       &reshuffle_each_iteration);
+    AttrValue compact_buffer;
+    b->BuildAttrValue(compact_buffer_, &compact_buffer);
+    AttrValue block_size;
+    b->BuildAttrValue(block_size_, &block_size);
     TF_RETURN_IF_ERROR(b->AddDataset(
         this,
         {input_graph_node, buffer_size_node, seed_node, seed2_node},  // Inputs
-        {std::make_pair(kReshuffleEachIteration,
-                        reshuffle_each_iteration)},  // Attrs
+        {std::make_pair(kReshuffleEachIteration, reshuffle_each_iteration),
+         std::make_pair(kCompactBuffer, compact_buffer),
+         std::make_pair(kBlockSize, block_size)},  // Attrs
         output));
     return OkStatus();
   }
@@ -713,8 +997,10 @@ class ShuffleDatasetOp::DatasetV3 : public ShuffleDatasetBase {
  public:
   DatasetV3(OpKernelContext* ctx, const DatasetBase* input, int64_t buffer_size,
             int64_t count, RandomSeeds&& seeds, SeedGeneratorManager* manager,
-            ResourceHandle&& resource_handle, bool owns_resource)
-      : ShuffleDatasetBase(ctx, input, buffer_size, manager->get(), count),
+            ResourceHandle&& resource_handle, bool owns_resource,
+            bool compact_buffer, int64_t block_size)
+      : ShuffleDatasetBase(ctx, input, buffer_size, manager->get(), count,
+                           compact_buffer, block_size),
         manager_(manager),
         owns_resource_(owns_resource),
         resource_handle_(std::move(resource_handle)),
@@ -753,13 +1039,18 @@ class ShuffleDatasetOp::DatasetV3 : public ShuffleDatasetBase {
     AttrValue reshuffle_each_iteration;
     b->BuildAttrValue(seed_generator_->reshuffle_each_iteration(),
                       &reshuffle_each_iteration);
-    TF_RETURN_IF_ERROR(
-        b->AddDataset(this,
-                      {input_graph_node, buffer_size_node, seed_node,
-                       seed2_node, resource_handle_node},  // Inputs
-                      {std::make_pair(kReshuffleEachIteration,
-                                      reshuffle_each_iteration)},  // Attrs
-                      output));
+    AttrValue compact_buffer;
+    b->BuildAttrValue(compact_buffer_, &compact_buffer);
+    AttrValue block_size;
+    b->BuildAttrValue(block_size_, &block_size);
+    TF_RETURN_IF_ERROR(b->AddDataset(
+        this,
+        {input_graph_node, buffer_size_node, seed_node, seed2_node,
+         resource_handle_node},  // Inputs
+        {std::make_pair(kReshuffleEachIteration, reshuffle_each_iteration),
+         std::make_pair(kCompactBuffer, compact_buffer),
+         std::make_pair(kBlockSize, block_size)},  // Attrs
+        output));
     return OkStatus();
   }
 
@@ -785,6 +1076,28 @@ ShuffleDatasetOp::ShuffleDatasetOp(OpKernelConstruction* ctx)
     OP_REQUIRES_OK(
         ctx, ctx->GetAttr(kReshuffleEachIteration, &reshuffle_each_iteration_));
   }
+  if (ctx->HasAttr(kCompactBuffer)) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kCompactBuffer, &compact_buffer_));
+  }
+  if (ctx->HasAttr(kBlockSize)) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kBlockSize, &block_size_));
+  }
+  OP_REQUIRES(ctx, block_size_ > 0,
+              errors::InvalidArgument("block_size must be greater than zero"));
+  OP_REQUIRES(
+      ctx, block_size_ == 1 || compact_buffer_,
+      errors::InvalidArgument("block_size > 1 requires a compact buffer"));
+  if (compact_buffer_) {
+    DataTypeVector output_types;
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kOutputTypes, &output_types));
+    for (DataType dtype : output_types) {
+      OP_REQUIRES(ctx, DataTypeCanUseMemcpy(dtype) || dtype == DT_STRING,
+                  errors::InvalidArgument(
+                      "A compact shuffle buffer does not support components "
+                      "of type ",
+                      DataTypeString(dtype)));
+    }
+  }
 }
 
 void ShuffleDatasetOp::MakeDataset(OpKernelContext* ctx, DatasetBase* input,
@@ -796,6 +1109,9 @@ void ShuffleDatasetOp::MakeDataset(OpKernelContext* ctx, DatasetBase* input,
       ctx, buffer_size > 0 || buffer_size == kUnknownCardinality,
       errors::InvalidArgument(
           "buffer_size must be greater than zero or UNKNOWN_CARDINALITY"));
+  OP_REQUIRES(ctx, !compact_buffer_ || buffer_size != kUnknownCardinality,
+              errors::InvalidArgument(
+                  "A compact shuffle buffer requires a known buffer_size"));
 
   int64_t count = 1;
   static std::atomic<int64_t> resource_id_counter(0);
@@ -836,9 +1152,9 @@ void ShuffleDatasetOp::MakeDataset(OpKernelContext* ctx, DatasetBase* input,
     }
 
     // Ownership of manager is transferred onto `DatasetV3`.
-    *output = new ShuffleDatasetOp::DatasetV3(ctx, input, buffer_size, count,
-                                              std::move(seeds), manager,
-                                              std::move(handle), owns_resource);
+    *output = new ShuffleDatasetOp::DatasetV3(
+        ctx, input, buffer_size, count, std::move(seeds), manager,
+        std::move(handle), owns_resource, compact_buffer_, block_size_);
   } else if (op_version_ == 2) {
     auto handle = HandleFromInput(ctx, 2);
     SeedGeneratorManager* manager = nullptr;
@@ -898,9 +1214,9 @@ void ShuffleDatasetOp::MakeDataset(OpKernelContext* ctx, DatasetBase* input,
         MakeResourceHandle<SeedGeneratorManager>(ctx, container, name);
 
     // Ownership of manager is transferred onto `Dataset`.
-    *output = new ShuffleDatasetOp::Dataset(ctx, input, buffer_size, count,
-                                            std::move(seeds), manager,
-                                            std::move(handle));
+    *output = new ShuffleDatasetOp::Dataset(
+        ctx, input, buffer_size, count, std::move(seeds), manager,
+        std::move(handle), compact_buffer_, block_size_);
   }
 }
 
@@ -30,6 +30,8 @@ class ShuffleDatasetOpBase : public UnaryDatasetOpKernel {
   static constexpr const char* const kOutputShapes = "output_shapes";
   static constexpr const char* const kReshuffleEachIteration =
       "reshuffle_each_iteration";
+  static constexpr const char* const kCompactBuffer = "compact_buffer";
+  static constexpr const char* const kBlockSize = "block_size";
 
   explicit ShuffleDatasetOpBase(OpKernelConstruction* ctx);
 
@@ -53,6 +55,8 @@ class ShuffleDatasetOp : public ShuffleDatasetOpBase {
   class DatasetV3;
   int op_version_ = 0;
   bool reshuffle_each_iteration_ = true;
+  bool compact_buffer_ = false;
+  int64_t block_size_ = 1;
 };
 
 class ShuffleAndRepeatDatasetOp : public ShuffleDatasetOpBase {
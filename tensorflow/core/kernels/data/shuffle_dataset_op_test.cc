@@ -13,6 +13,7 @@ limitations under the License.
 
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "tensorflow/core/data/dataset_test_base.h"
 #include "tensorflow/core/data/dataset_utils.h"
@@ -33,14 +34,17 @@ class ShuffleDatasetParams : public DatasetParams {
                        bool reshuffle_each_iteration,
                        DataTypeVector output_dtypes,
                        std::vector<PartialTensorShape> output_shapes,
-                       string node_name)
+                       string node_name, bool compact_buffer = false,
+                       int64_t block_size = 1)
       : DatasetParams(std::move(output_dtypes), std::move(output_shapes),
                       std::move(node_name)),
         buffer_size_(buffer_size),
         seed_(seed),
         seed2_(seed2),
         count_(count),
-        reshuffle_each_iteration_(reshuffle_each_iteration) {
+        reshuffle_each_iteration_(reshuffle_each_iteration),
+        compact_buffer_(compact_buffer),
+        block_size_(block_size) {
     input_dataset_params_.push_back(std::make_unique<T>(input_dataset_params));
     iterator_prefix_ =
         name_utils::IteratorPrefix(input_dataset_params.dataset_type(),
@@ -78,6 +82,10 @@ class ShuffleDatasetParams : public DatasetParams {
     attr_vector->emplace_back("reshuffle_each_iteration",
                               reshuffle_each_iteration_);
     attr_vector->emplace_back("metadata", "");
+    if (count_ == 1) {
+      attr_vector->emplace_back("compact_buffer", compact_buffer_);
+      attr_vector->emplace_back("block_size", block_size_);
+    }
     return OkStatus();
   }
 
@@ -96,6 +104,8 @@ class ShuffleDatasetParams : public DatasetParams {
   int64_t seed2_;
   int64_t count_;
   bool reshuffle_each_iteration_;
+  bool compact_buffer_;
+  int64_t block_size_;
 };
 
 class ShuffleDatasetOpTest : public DatasetOpsTestBase {};
@@ -594,6 +604,179 @@ TEST_F(ShuffleDatasetOpTest, InvalidArguments) {
   }
 }
 
+ShuffleDatasetParams CompactShuffleDatasetParams(int64_t num_elements,
+                                                 int64_t buffer_size,
+                                                 bool compact_buffer,
+                                                 int64_t block_size) {
+  return ShuffleDatasetParams(RangeDatasetParams(0, num_elements, 1),
+                              buffer_size,
+                              /*seed=*/1,
+                              /*seed2=*/2,
+                              /*count=*/1,
+                              /*reshuffle_each_iteration=*/true,
+                              /*output_dtypes=*/{DT_INT64},
+                              /*output_shapes=*/{PartialTensorShape({})},
+                              /*node_name=*/kShuffleNodeName, compact_buffer,
+                              block_size);
+}
+
+class CompactShuffleBufferTest : public ShuffleDatasetOpTest {
+ protected:
+  // Returns the elements that a new iterator over `dataset_params` produces.
+  // The runtime is initialized by the first call and shared by the datasets of
+  // the later ones, so that a test can compare several configurations.
+  StatusOr<std::vector<Tensor>> GetAllOutputs(
+      const ShuffleDatasetParams& dataset_params) {
+    TF_RETURN_IF_ERROR(MaybeInitializeRuntime(dataset_params));
+    std::unique_ptr<TestDataset> dataset;
+    TF_RETURN_IF_ERROR(MakeDataset(dataset_params, &dataset));
+    std::unique_ptr<TestIterator> iterator;
+    TF_RETURN_IF_ERROR(MakeIterator(dataset_params, *dataset, &iterator));
+    std::vector<Tensor> outputs;
+    bool end_of_sequence = false;
+    while (!end_of_sequence) {
+      std::vector<Tensor> next;
+      TF_RETURN_IF_ERROR(iterator->GetNext(&next, &end_of_sequence));
+      outputs.insert(outputs.end(), next.begin(), next.end());
+    }
+    return outputs;
+  }
+
+  Status MaybeInitializeRuntime(const ShuffleDatasetParams& dataset_params) {
+    if (runtime_initialized_) return OkStatus();
+    TF_RETURN_IF_ERROR(InitializeRuntime(dataset_params));
+    runtime_initialized_ = true;
+    return OkStatus();
+  }
+
+ private:
+  bool runtime_initialized_ = false;
+};
+
+TEST_F(CompactShuffleBufferTest, MatchesBufferOfTensors) {
+  for (int64_t buffer_size : {1, 2, 3, 10, 20}) {
+    TF_ASSERT_OK_AND_ASSIGN(
+        std::vector<Tensor> expected,
+        GetAllOutputs(CompactShuffleDatasetParams(
+            /*num_elements=*/10, buffer_size, /*compact_buffer=*/false,
+            /*block_size=*/1)));
+    TF_ASSERT_OK_AND_ASSIGN(
+        std::vector<Tensor> outputs,
+        GetAllOutputs(CompactShuffleDatasetParams(
+            /*num_elements=*/10, buffer_size, /*compact_buffer=*/true,
+            /*block_size=*/1)));
+    TF_EXPECT_OK(ExpectEqual(outputs, expected, /*compare_order=*/true));
+  }
+}
+
+TEST_F(CompactShuffleBufferTest, MultipleComponents) {
+  auto make_dataset_params = [](bool compact_buffer) {
+    TensorSliceDatasetParams input(
+        {CreateTensor<int64_t>(TensorShape({6, 2}),
+                               {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11}),
+         CreateTensor<tstring>(TensorShape({6}),
+                               {"a", "b", "c", "d", "e", "f"})},
+        /*node_name=*/"tensor_slice");
+    return ShuffleDatasetParams(
+        std::move(input), /*buffer_size=*/4,
+        /*seed=*/1,
+        /*seed2=*/2,
+        /*count=*/1,
+        /*reshuffle_each_iteration=*/true,
+        /*output_dtypes=*/{DT_INT64, DT_STRING},
+        /*output_shapes=*/{PartialTensorShape({2}), PartialTensorShape({})},
+        /*node_name=*/kShuffleNodeName, compact_buffer);
+  };
+  TF_ASSERT_OK_AND_ASSIGN(std::vector<Tensor> expected,
+                          GetAllOutputs(make_dataset_params(false)));
+  TF_ASSERT_OK_AND_ASSIGN(std::vector<Tensor> outputs,
+                          GetAllOutputs(make_dataset_params(true)));
+  TF_EXPECT_OK(ExpectEqual(outputs, expected, /*compare_order=*/true));
+}
+
+TEST_F(CompactShuffleBufferTest, ShufflesBlocks) {
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::vector<Tensor> outputs,
+      GetAllOutputs(CompactShuffleDatasetParams(
+          /*num_elements=*/9, /*buffer_size=*/4, /*compact_buffer=*/true,
+          /*block_size=*/2)));
+  std::vector<int64_t> values;
+  for (const Tensor& output : outputs) {
+    values.push_back(output.scalar<int64_t>()());
+  }
+  EXPECT_THAT(values,
+              ::testing::UnorderedElementsAre(0, 1, 2, 3, 4, 5, 6, 7, 8));
+  // The blocks are {0, 1}, {2, 3}, {4, 5}, {6, 7} and {8}, and the elements
+  // of a block are produced together.
+  size_t i = 0;
+  while (i < values.size()) {
+    ASSERT_EQ(values[i] % 2, 0);
+    if (values[i] == 8) {
+      ++i;
+      continue;
+    }
+    ASSERT_LT(i + 1, values.size());
+    EXPECT_EQ(values[i + 1], values[i] + 1);
+    i += 2;
+  }
+}
+
+TEST_F(CompactShuffleBufferTest, SaveAndRestore) {
+  ShuffleDatasetParams dataset_params = CompactShuffleDatasetParams(
+      /*num_elements=*/20, /*buffer_size=*/6, /*compact_buffer=*/true,
+      /*block_size=*/3);
+  TF_ASSERT_OK_AND_ASSIGN(std::vector<Tensor> expected,
+                          GetAllOutputs(dataset_params));
+  std::unique_ptr<TestDataset> dataset;
+  TF_ASSERT_OK(MakeDataset(dataset_params, &dataset));
+  std::unique_ptr<TestIterator> test_iterator;
+  TF_ASSERT_OK(MakeIterator(dataset_params, *dataset, &test_iterator));
+  IteratorContext* ctx = test_iterator->ctx();
+  IteratorBase* iterator = test_iterator->iterator();
+  std::unique_ptr<IteratorBase> restored_iterator;
+
+  std::unique_ptr<SerializationContext> serialization_ctx;
+  TF_ASSERT_OK(CreateSerializationContext(&serialization_ctx));
+  bool end_of_sequence = false;
+  std::vector<Tensor> outputs;
+  int cur_iteration = 0;
+  for (int breakpoint : {0, 1, 4, 8, 13, 25}) {
+    VariantTensorDataWriter writer;
+    TF_EXPECT_OK(iterator->Save(serialization_ctx.get(), &writer));
+    std::vector<const VariantTensorData*> data;
+    writer.GetData(&data);
+    VariantTensorDataReader reader(data);
+    TF_EXPECT_OK(RestoreIterator(ctx, &reader, dataset_params.iterator_prefix(),
+                                 *dataset->dataset(), &restored_iterator));
+    iterator = restored_iterator.get();
+
+    while (cur_iteration <= breakpoint) {
+      std::vector<Tensor> next;
+      TF_EXPECT_OK(iterator->GetNext(ctx, &next, &end_of_sequence));
+      outputs.insert(outputs.end(), next.begin(), next.end());
+      cur_iteration++;
+    }
+  }
+  EXPECT_TRUE(end_of_sequence);
+  TF_EXPECT_OK(ExpectEqual(outputs, expected, /*compare_order=*/true));
+}
+
+TEST_F(CompactShuffleBufferTest, InvalidArguments) {
+  for (const ShuffleDatasetParams& dataset_params :
+       {CompactShuffleDatasetParams(/*num_elements=*/10,
+                                    /*buffer_size=*/kUnknownCardinality,
+                                    /*compact_buffer=*/true, /*block_size=*/1),
+        CompactShuffleDatasetParams(/*num_elements=*/10, /*buffer_size=*/4,
+                                    /*compact_buffer=*/false,
+                                    /*block_size=*/2),
+        CompactShuffleDatasetParams(/*num_elements=*/10, /*buffer_size=*/4,
+                                    /*compact_buffer=*/true,
+                                    /*block_size=*/0)}) {
+    EXPECT_EQ(Initialize(dataset_params).code(),
+              absl::StatusCode::kInvalidArgument);
+  }
+}
+
 }  // namespace
 }  // namespace data
 }  // namespace tensorflow
@@ -14,6 +14,11 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/kernels/data/tf_record_dataset_op.h"
 
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <utility>
+
 #include "tensorflow/core/data/name_utils.h"
 #include "tensorflow/core/data/utils.h"
 #include "tensorflow/core/framework/metrics.h"
@@ -37,14 +42,24 @@ namespace data {
 /* static */ constexpr const char* const TFRecordDatasetOp::kCompressionType;
 /* static */ constexpr const char* const TFRecordDatasetOp::kBufferSize;
 /* static */ constexpr const char* const TFRecordDatasetOp::kByteOffsets;
+/* static */ constexpr const char* const TFRecordDatasetOp::kNumParallelFiles;
+/* static */ constexpr const char* const TFRecordDatasetOp::kDeterministic;
 
 constexpr char kTFRecordDataset[] = "TFRecordDataset";
 constexpr char kCurrentFileIndex[] = "current_file_index";
 constexpr char kOffset[] = "offset";
+constexpr char kNextFileIndex[] = "next_file_index";
+constexpr char kNumOpenFiles[] = "num_open_files";
+constexpr char kOpenFileIndex[] = "open_file_index";
+constexpr char kOpenFileOffset[] = "open_file_offset";
 constexpr char kGcsFsPrefix[] = "gs://";
 constexpr char kS3FsPrefix[] = "s3://";
 constexpr int64_t kCloudTpuBlockSize = 127LL << 20;  // 127MB.
 constexpr int64_t kS3BlockSize = kCloudTpuBlockSize;
+// In the parallel mode, the minimum read size, and the number of bytes of
+// records that are read ahead of the consumer per file.
+constexpr int64_t kParallelReadBufferSize = 1 << 20;     // 1MB.
+constexpr int64_t kParallelReadAheadBytes = 16LL << 20;  // 16MB.
 
 bool is_cloud_tpu_gcs_fs() {
 #if (defined(PLATFORM_CLOUD_TPU) && defined(TPU_GCS_FS)) || \
@@ -58,17 +73,23 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
  public:
   explicit Dataset(OpKernelContext* ctx, std::vector<string> filenames,
                    const string& compression_type, int64_t buffer_size,
-                   std::vector<int64_t> byte_offsets, int op_version)
+                   std::vector<int64_t> byte_offsets, int op_version,
+                   int64_t num_parallel_files, DeterminismPolicy deterministic)
       : DatasetBase(DatasetContext(ctx)),
         filenames_(std::move(filenames)),
         compression_type_(compression_type),
         options_(io::RecordReaderOptions::CreateRecordReaderOptions(
             compression_type)),
         byte_offsets_(std::move(byte_offsets)),
-        op_version_(op_version) {
+        op_version_(op_version),
+        num_parallel_files_(num_parallel_files),
+        deterministic_(deterministic) {
     if (buffer_size > 0) {
       options_.buffer_size = buffer_size;
     }
+    parallel_options_ = options_;
+    parallel_options_.buffer_size =
+        std::max(options_.buffer_size, kParallelReadBufferSize);
   }
 
   std::unique_ptr<IteratorBase> MakeIteratorInternal(
@@ -112,8 +133,17 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
     TF_RETURN_IF_ERROR(b->AddScalar(compression_type_, &compression_type));
     Node* buffer_size = nullptr;
     TF_RETURN_IF_ERROR(b->AddScalar(options_.buffer_size, &buffer_size));
+    std::vector<std::pair<StringPiece, AttrValue>> attrs;
+    if (op_version_ > 1) {
+      AttrValue num_parallel_files;
+      b->BuildAttrValue(num_parallel_files_, &num_parallel_files);
+      attrs.emplace_back(kNumParallelFiles, num_parallel_files);
+      AttrValue deterministic;
+      b->BuildAttrValue(deterministic_.String(), &deterministic);
+      attrs.emplace_back(kDeterministic, deterministic);
+    }
     TF_RETURN_IF_ERROR(b->AddDataset(
-        this, {filenames, compression_type, buffer_size}, output));
+        this, {filenames, compression_type, buffer_size}, attrs, output));
     Node* byte_offsets = nullptr;
     TF_RETURN_IF_ERROR(b->AddVector(byte_offsets_, &byte_offsets));
     return OkStatus();
@@ -123,14 +153,37 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
   class Iterator : public DatasetIterator<Dataset> {
    public:
     explicit Iterator(const Params& params)
-        : DatasetIterator<Dataset>(params) {}
+        : DatasetIterator<Dataset>(params),
+          parallel_(params.dataset->num_parallel_files_ > 0) {}
+
+    ~Iterator() override {
+      CancelThreads();
+      if (deregister_fn_) deregister_fn_();
+    }
 
     bool SymbolicCheckpointCompatible() const override { return true; }
 
+    Status Initialize(IteratorContext* ctx) override {
+      if (!parallel_) return OkStatus();
+      return RegisterCancellationCallback(
+          ctx->cancellation_manager(), [this]() { CancelThreads(); },
+          &deregister_fn_);
+    }
+
     Status GetNextInternal(IteratorContext* ctx,
                            std::vector<Tensor>* out_tensors,
                            bool* end_of_sequence) override {
       out_tensors->reserve(1);
+      if (parallel_) {
+        tstring record;
+        TF_RETURN_IF_ERROR(GetNextParallel(ctx, &record, end_of_sequence));
+        if (!*end_of_sequence) {
+          out_tensors->emplace_back(ctx->allocator({}), DT_STRING,
+                                    TensorShape({}));
+          out_tensors->back().scalar<tstring>()() = std::move(record);
+        }
+        return OkStatus();
+      }
       mutex_lock l(mu_);
       do {
         // We are currently processing a file, so try to read the next record.
@@ -176,6 +229,16 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
     Status SkipInternal(IteratorContext* ctx, int num_to_skip,
                         bool* end_of_sequence, int* num_skipped) override {
       *num_skipped = 0;
+      if (parallel_) {
+        *end_of_sequence = false;
+        while (*num_skipped < num_to_skip) {
+          tstring record;
+          TF_RETURN_IF_ERROR(GetNextParallel(ctx, &record, end_of_sequence));
+          if (*end_of_sequence) break;
+          ++*num_skipped;
+        }
+        return OkStatus();
+      }
       mutex_lock l(mu_);
       do {
         // We are currently processing a file, so try to skip reading
@@ -223,6 +286,23 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
     Status SaveInternal(SerializationContext* ctx,
                         IteratorStateWriter* writer) override {
       mutex_lock l(mu_);
+      if (parallel_) {
+        // Every open file is restored from the end of the last record that
+        // was returned from it.
+        TF_RETURN_IF_ERROR(
+            writer->WriteScalar(prefix(), kNextFileIndex, next_file_index_));
+        TF_RETURN_IF_ERROR(
+            writer->WriteScalar(prefix(), kNumOpenFiles, open_files_.size()));
+        for (size_t i = 0; i < open_files_.size(); ++i) {
+          TF_RETURN_IF_ERROR(writer->WriteScalar(
+              prefix(), strings::StrCat(kOpenFileIndex, "_", i),
+              open_files_[i]->file_index));
+          TF_RETURN_IF_ERROR(writer->WriteScalar(
+              prefix(), strings::StrCat(kOpenFileOffset, "_", i),
+              open_files_[i]->consumed_offset));
+        }
+        return OkStatus();
+      }
       TF_RETURN_IF_ERROR(writer->WriteScalar(prefix(), kCurrentFileIndex,
                                              current_file_index_));
 
@@ -235,6 +315,7 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
 
     Status RestoreInternal(IteratorContext* ctx,
                            IteratorStateReader* reader) override {
+      if (parallel_) return RestoreParallel(reader);
       mutex_lock l(mu_);
       ResetStreamsLocked();
       int64_t current_file_index;
@@ -278,9 +359,203 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
       file_.reset();
     }
 
+    // A file that a background thread reads ahead of the consumer, in the
+    // parallel mode.
+    struct OpenFile {
+      OpenFile(size_t file_index, int64_t offset)
+          : file_index(file_index), consumed_offset(offset) {}
+
+      const size_t file_index;
+      // Offset right after the last record that was returned from the file.
+      int64_t consumed_offset;
+      // Records that were read, with the offset right after each of them.
+      std::deque<std::pair<tstring, int64_t>> records;
+      int64_t buffered_bytes = 0;
+      // Whether the thread has read the whole file, or failed with `status`.
+      bool done = false;
+      Status status;
+      // Joined on destruction, so it must be destroyed without holding `mu_`.
+      std::unique_ptr<Thread> thread;
+    };
+
+    // Opens files until `num_parallel_files` are open, and starts the threads
+    // of the open files that do not have one yet.
+    void EnsureFilesOpenLocked(IteratorContext* ctx)
+        TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      const size_t num_parallel_files = dataset()->num_parallel_files_;
+      while (open_files_.size() < num_parallel_files &&
+             next_file_index_ < dataset()->filenames_.size()) {
+        const int64_t offset = dataset()->byte_offsets_.empty()
+                                   ? 0
+                                   : dataset()->byte_offsets_[next_file_index_];
+        open_files_.push_back(
+            std::make_shared<OpenFile>(next_file_index_, offset));
+        ++next_file_index_;
+      }
+      for (const std::shared_ptr<OpenFile>& file : open_files_) {
+        if (file->thread == nullptr && !file->done) {
+          // The thread is joined before `file` is destroyed.
+          Env* env = ctx->env();
+          OpenFile* raw_file = file.get();
+          file->thread = ctx->StartThread(
+              "tf_data_tfrecord_reader",
+              [this, env, raw_file]() { ReadFileThread(env, raw_file); });
+        }
+      }
+    }
+
+    // Reads the records of `file` until the end of the file, an error, or
+    // cancellation. Checksums and decompression run on this thread.
+    void ReadFileThread(Env* env, OpenFile* file) TF_LOCKS_EXCLUDED(mu_) {
+      int64_t start_offset;
+      {
+        mutex_lock l(mu_);
+        start_offset = file->consumed_offset;
+      }
+      std::unique_ptr<RandomAccessFile> random_access_file;
+      std::unique_ptr<io::SequentialRecordReader> reader;
+      Status s = env->NewRandomAccessFile(
+          TranslateFileName(dataset()->filenames_[file->file_index]),
+          &random_access_file);
+      if (s.ok()) {
+        reader = std::make_unique<io::SequentialRecordReader>(
+            random_access_file.get(), dataset()->parallel_options_);
+        if (start_offset > 0) s = reader->SeekOffset(start_offset);
+      }
+      while (s.ok()) {
+        tstring record;
+        s = reader->ReadRecord(&record);
+        if (!s.ok()) break;
+        const int64_t size = record.size();
+        mutex_lock l(mu_);
+        while (!cancelled_ && file->buffered_bytes >= kParallelReadAheadBytes) {
+          cond_var_.wait(l);
+        }
+        if (cancelled_) return;
+        file->records.emplace_back(std::move(record), reader->TellOffset());
+        file->buffered_bytes += size;
+        cond_var_.notify_all();
+      }
+      mutex_lock l(mu_);
+      file->done = true;
+      // Reaching the end of the file is reported as out of range.
+      if (!errors::IsOutOfRange(s)) file->status = s;
+      cond_var_.notify_all();
+    }
+
+    // Returns the next record in the parallel mode. In deterministic order,
+    // the records of a file are returned before those of the next file.
+    // Otherwise, records are returned from whichever open file has one.
+    Status GetNextParallel(IteratorContext* ctx, tstring* record,
+                           bool* end_of_sequence) TF_LOCKS_EXCLUDED(mu_) {
+      // Destroyed after `l` is released, because destroying a file joins its
+      // thread, which acquires `mu_`.
+      std::shared_ptr<OpenFile> finished_file;
+      mutex_lock l(mu_);
+      EnsureFilesOpenLocked(ctx);
+      const bool deterministic =
+          !dataset()->deterministic_.IsNondeterministic();
+      while (true) {
+        if (cancelled_) {
+          return errors::Cancelled("Iterator was cancelled");
+        }
+        if (open_files_.empty()) {
+          *end_of_sequence = true;
+          return OkStatus();
+        }
+        auto it = open_files_.begin();
+        if (!deterministic) {
+          it = std::find_if(open_files_.begin(), open_files_.end(),
+                            [](const std::shared_ptr<OpenFile>& file) {
+                              return !file->records.empty() || file->done;
+                            });
+        }
+        if (it == open_files_.end() ||
+            ((*it)->records.empty() && !(*it)->done)) {
+          cond_var_.wait(l);
+          continue;
+        }
+        OpenFile* file = it->get();
+        if (!file->records.empty()) {
+          *record = std::move(file->records.front().first);
+          file->consumed_offset = file->records.front().second;
+          file->records.pop_front();
+          file->buffered_bytes -= record->size();
+          cond_var_.notify_all();
+          static monitoring::CounterCell* bytes_counter =
+              metrics::GetTFDataBytesReadCounter(kDatasetType);
+          bytes_counter->IncrementBy(record->size());
+          *end_of_sequence = false;
+          return OkStatus();
+        }
+        // The file is exhausted. In case of errors, e.g. DataLoss, it is still
+        // closed, so that the iterator works with ignore_errors.
+        Status s = file->status;
+        finished_file = std::move(*it);
+        open_files_.erase(it);
+        EnsureFilesOpenLocked(ctx);
+        if (!s.ok()) return s;
+      }
+    }
+
+    Status RestoreParallel(IteratorStateReader* reader)
+        TF_LOCKS_EXCLUDED(mu_) {
+      CancelThreads();
+      mutex_lock l(mu_);
+      open_files_.clear();
+      cancelled_ = false;
+      int64_t next_file_index;
+      TF_RETURN_IF_ERROR(
+          reader->ReadScalar(prefix(), kNextFileIndex, &next_file_index));
+      next_file_index_ = next_file_index;
+      int64_t num_open_files;
+      TF_RETURN_IF_ERROR(
+          reader->ReadScalar(prefix(), kNumOpenFiles, &num_open_files));
+      for (int64_t i = 0; i < num_open_files; ++i) {
+        int64_t file_index;
+        int64_t offset;
+        TF_RETURN_IF_ERROR(reader->ReadScalar(
+            prefix(), strings::StrCat(kOpenFileIndex, "_", i), &file_index));
+        TF_RETURN_IF_ERROR(reader->ReadScalar(
+            prefix(), strings::StrCat(kOpenFileOffset, "_", i), &offset));
+        if (file_index < 0 || file_index >= dataset()->filenames_.size()) {
+          return errors::InvalidArgument("Invalid file index ", file_index,
+                                         " in checkpoint for ", prefix());
+        }
+        open_files_.push_back(std::make_shared<OpenFile>(file_index, offset));
+      }
+      return OkStatus();
+    }
+
+    // Stops the threads of the open files and waits for them to finish.
+    void CancelThreads() TF_LOCKS_EXCLUDED(mu_) {
+      std::vector<std::unique_ptr<Thread>> threads;
+      {
+        mutex_lock l(mu_);
+        cancelled_ = true;
+        cond_var_.notify_all();
+        for (const std::shared_ptr<OpenFile>& file : open_files_) {
+          if (file->thread != nullptr) {
+            threads.push_back(std::move(file->thread));
+          }
+        }
+      }
+      // Joins the threads.
+      threads.clear();
+    }
+
+    const bool parallel_;
+    std::function<void()> deregister_fn_;
+
     mutex mu_;
+    condition_variable cond_var_;
     size_t current_file_index_ TF_GUARDED_BY(mu_) = 0;
 
+    // State of the parallel mode. `open_files_` is in file order.
+    size_t next_file_index_ TF_GUARDED_BY(mu_) = 0;
+    std::deque<std::shared_ptr<OpenFile>> open_files_ TF_GUARDED_BY(mu_);
+    bool cancelled_ TF_GUARDED_BY(mu_) = false;
+
     // `reader_` will borrow the object that `file_` points to, so
     // we must destroy `reader_` before `file_`.
     std::unique_ptr<RandomAccessFile> file_ TF_GUARDED_BY(mu_);
@@ -292,11 +567,27 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
   io::RecordReaderOptions options_;
   const std::vector<int64_t> byte_offsets_;
   const int op_version_;
+  // If positive, reads this many files ahead of the consumer in parallel.
+  const int64_t num_parallel_files_;
+  const DeterminismPolicy deterministic_;
+  // Options for the parallel mode, which reads larger blocks.
+  io::RecordReaderOptions parallel_options_;
 };
 
 TFRecordDatasetOp::TFRecordDatasetOp(OpKernelConstruction* ctx)
     : DatasetOpKernel(ctx),
-      op_version_(ctx->def().op() == kTFRecordDataset ? 1 : 2) {}
+      op_version_(ctx->def().op() == kTFRecordDataset ? 1 : 2) {
+  if (op_version_ > 1) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kNumParallelFiles, &num_parallel_files_));
+    OP_REQUIRES(ctx, num_parallel_files_ >= 0,
+                errors::InvalidArgument(
+                    "`num_parallel_files` must be >= 0 (0 == sequential)"));
+    std::string deterministic;
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kDeterministic, &deterministic));
+    OP_REQUIRES_OK(
+        ctx, DeterminismPolicy::FromString(deterministic, &deterministic_));
+  }
+}
 
 void TFRecordDatasetOp::MakeDataset(OpKernelContext* ctx,
                                     DatasetBase** output) {
@@ -361,7 +652,8 @@ void TFRecordDatasetOp::MakeDataset(OpKernelContext* ctx,
   }
 
   *output = new Dataset(ctx, std::move(filenames), compression_type,
-                        buffer_size, std::move(byte_offsets), op_version_);
+                        buffer_size, std::move(byte_offsets), op_version_,
+                        num_parallel_files_, deterministic_);
 }
 
 namespace {
@@ -15,6 +15,7 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_KERNELS_DATA_TF_RECORD_DATASET_OP_H_
 #define TENSORFLOW_CORE_KERNELS_DATA_TF_RECORD_DATASET_OP_H_
 
+#include "tensorflow/core/data/dataset_utils.h"
 #include "tensorflow/core/framework/dataset.h"
 
 namespace tensorflow {
@@ -27,6 +28,8 @@ class TFRecordDatasetOp : public DatasetOpKernel {
   static constexpr const char* const kCompressionType = "compression_type";
   static constexpr const char* const kBufferSize = "buffer_size";
   static constexpr const char* const kByteOffsets = "byte_offsets";
+  static constexpr const char* const kNumParallelFiles = "num_parallel_files";
+  static constexpr const char* const kDeterministic = "deterministic";
 
   explicit TFRecordDatasetOp(OpKernelConstruction* ctx);
 
@@ -36,6 +39,8 @@ class TFRecordDatasetOp : public DatasetOpKernel {
  private:
   class Dataset;
   int op_version_;
+  int64_t num_parallel_files_ = 0;
+  DeterminismPolicy deterministic_;
 };
 
 }  // namespace data
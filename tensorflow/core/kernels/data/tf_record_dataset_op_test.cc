@@ -46,13 +46,18 @@ class TFRecordDatasetParams : public DatasetParams {
  public:
   TFRecordDatasetParams(std::vector<tstring> filenames,
                         CompressionType compression_type, int64_t buffer_size,
-                        std::vector<int64_t> byte_offsets, string node_name)
+                        std::vector<int64_t> byte_offsets, string node_name,
+                        int64_t num_parallel_files = 0,
+                        const string& deterministic =
+                            DeterminismPolicy::kDefault)
       : DatasetParams({DT_STRING}, {PartialTensorShape({})},
                       std::move(node_name)),
         filenames_(std::move(filenames)),
         compression_type_(compression_type),
         buffer_size_(buffer_size),
-        byte_offsets_(std::move(byte_offsets)) {
+        byte_offsets_(std::move(byte_offsets)),
+        num_parallel_files_(num_parallel_files),
+        deterministic_(deterministic) {
     op_version_ = 2;
   }
 
@@ -80,6 +85,10 @@ class TFRecordDatasetParams : public DatasetParams {
   Status GetAttributes(AttributeVector* attr_vector) const override {
     attr_vector->clear();
     attr_vector->emplace_back("metadata", "");
+    attr_vector->emplace_back(TFRecordDatasetOp::kNumParallelFiles,
+                              num_parallel_files_);
+    attr_vector->emplace_back(TFRecordDatasetOp::kDeterministic,
+                              deterministic_);
     return OkStatus();
   }
 
@@ -92,6 +101,8 @@ class TFRecordDatasetParams : public DatasetParams {
   CompressionType compression_type_;
   int64_t buffer_size_;
   std::vector<int64_t> byte_offsets_;
+  int64_t num_parallel_files_;
+  string deterministic_;
 };
 
 class TFRecordDatasetOpTest : public DatasetOpsTestBase {};
@@ -208,6 +219,40 @@ TFRecordDatasetParams InvalidByteOffsets() {
                                /*node_name=*/kNodeName);
 }
 
+// Test case 6: three ZLIB files, read two at a time in parallel.
+TFRecordDatasetParams ParallelTFRecordDatasetParams(
+    const string& deterministic) {
+  std::vector<tstring> filenames = {
+      absl::StrCat(testing::TmpDir(), "/tf_record_parallel_1"),
+      absl::StrCat(testing::TmpDir(), "/tf_record_parallel_2"),
+      absl::StrCat(testing::TmpDir(), "/tf_record_parallel_3")};
+  std::vector<std::vector<string>> contents = {
+      {"1", "22", "333"}, {"a", "bb", "ccc"}, {"x", "yy", "zzz"}};
+  CompressionType compression_type = CompressionType::ZLIB;
+  absl::Status status = CreateTestFiles(filenames, contents, compression_type);
+  TF_CHECK_OK(status) << "Failed to create the test files: "
+                      << absl::StrJoin(filenames, ", ") << ": " << status;
+  return TFRecordDatasetParams(filenames,
+                               /*compression_type=*/compression_type,
+                               /*buffer_size=*/10,
+                               /*byte_offsets=*/{},
+                               /*node_name=*/kNodeName,
+                               /*num_parallel_files=*/2, deterministic);
+}
+
+std::vector<Tensor> ParallelTFRecordDatasetOutputs() {
+  return CreateTensors<tstring>(TensorShape({}),
+                                {{"1"},
+                                 {"22"},
+                                 {"333"},
+                                 {"a"},
+                                 {"bb"},
+                                 {"ccc"},
+                                 {"x"},
+                                 {"yy"},
+                                 {"zzz"}});
+}
+
 std::vector<GetNextTestCase<TFRecordDatasetParams>> GetNextTestCases() {
   return {
       {/*dataset_params=*/TFRecordDatasetParams1(),
@@ -223,7 +268,13 @@ std::vector<GetNextTestCase<TFRecordDatasetParams>> GetNextTestCases() {
       {/*dataset_params=*/TFRecordDatasetParams4(),
        CreateTensors<tstring>(
            TensorShape({}),
-           {{"1"}, {"22"}, {"333"}, {"bb"}, {"ccc"}, {"zzz"}})}};
+           {{"1"}, {"22"}, {"333"}, {"bb"}, {"ccc"}, {"zzz"}})},
+      {/*dataset_params=*/ParallelTFRecordDatasetParams(
+           DeterminismPolicy::kDeterministic),
+       ParallelTFRecordDatasetOutputs()},
+      {/*dataset_params=*/ParallelTFRecordDatasetParams(
+           DeterminismPolicy::kNondeterministic),
+       ParallelTFRecordDatasetOutputs(), /*compare_order=*/false}};
 }
 
 ITERATOR_GET_NEXT_TEST_P(TFRecordDatasetOpTest, TFRecordDatasetParams,
@@ -261,7 +312,16 @@ std::vector<SkipTestCase<TFRecordDatasetParams>> SkipTestCases() {
            /*expected_outputs=*/
            CreateTensors<tstring>(TensorShape({}), {{"bb"}})},
           {/*dataset_params=*/TFRecordDatasetParams3(),
-           /*num_to_skip*/ 7, /*expected_num_skipped*/ 6}};
+           /*num_to_skip*/ 7, /*expected_num_skipped*/ 6},
+
+          {/*dataset_params=*/ParallelTFRecordDatasetParams(
+               DeterminismPolicy::kDeterministic),
+           /*num_to_skip*/ 4, /*expected_num_skipped*/ 4, /*get_next*/ true,
+           /*expected_outputs=*/
+           CreateTensors<tstring>(TensorShape({}), {{"bb"}})},
+          {/*dataset_params=*/ParallelTFRecordDatasetParams(
+               DeterminismPolicy::kDeterministic),
+           /*num_to_skip*/ 10, /*expected_num_skipped*/ 9}};
 }
 
 ITERATOR_SKIP_TEST_P(TFRecordDatasetOpTest, TFRecordDatasetParams,
@@ -348,7 +408,14 @@ IteratorSaveAndRestoreTestCases() {
       {/*dataset_params=*/TFRecordDatasetParams3(),
        /*breakpoints=*/{0, 2, 7},
        CreateTensors<tstring>(
-           TensorShape({}), {{"1"}, {"22"}, {"333"}, {"a"}, {"bb"}, {"ccc"}})}};
+           TensorShape({}), {{"1"}, {"22"}, {"333"}, {"a"}, {"bb"}, {"ccc"}})},
+      {/*dataset_params=*/ParallelTFRecordDatasetParams(
+           DeterminismPolicy::kDeterministic),
+       /*breakpoints=*/{0, 2, 4, 10}, ParallelTFRecordDatasetOutputs()},
+      {/*dataset_params=*/ParallelTFRecordDatasetParams(
+           DeterminismPolicy::kNondeterministic),
+       /*breakpoints=*/{0, 2, 4, 10}, ParallelTFRecordDatasetOutputs(),
+       /*compare_order=*/false}};
 }
 
 ITERATOR_SAVE_AND_RESTORE_TEST_P(TFRecordDatasetOpTest, TFRecordDatasetParams,
@@ -14,16 +14,43 @@ limitations under the License.
 ==============================================================================*/
 
 // See docs in ../ops/parsing_ops.cc.
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <string>
 #include <vector>
+
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/csv_util.h"
 #include "tensorflow/core/lib/core/errors.h"
-#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
+namespace {
+
+// Rough estimates of the cycles spent decoding a record, for sharding.
+constexpr int64_t kCostPerRecordByte = 4;
+constexpr int64_t kCostPerField = 100;
+
+// Converts a non-empty field to a value of an output.
+template <typename T>
+bool ConvertField(StringPiece field, T* value) {
+  return CsvFieldToNumber(field, value);
+}
+template <>
+bool ConvertField(StringPiece field, tstring* value) {
+  value->assign(field.data(), field.size());
+  return true;
+}
+
+}  // namespace
+
 class DecodeCSVOp : public OpKernel {
  public:
   explicit DecodeCSVOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
@@ -51,6 +78,7 @@ class DecodeCSVOp : public OpKernel {
                 errors::InvalidArgument("field_delim should be only 1 char"));
     delim_ = delim[0];
     OP_REQUIRES_OK(ctx, ctx->GetAttr("na_value", &na_value_));
+    scanner_ = std::make_unique<CsvScanner>(delim_, use_quote_delim_);
   }
 
   void Compute(OpKernelContext* ctx) override {
@@ -76,126 +104,45 @@ class DecodeCSVOp : public OpKernel {
     OpOutputList output;
     OP_REQUIRES_OK(ctx, ctx->output_list("output", &output));
 
+    std::vector<Tensor*> outputs(out_type_.size());
     for (int i = 0; i < static_cast<int>(out_type_.size()); ++i) {
-      Tensor* out = nullptr;
-      OP_REQUIRES_OK(ctx, output.allocate(i, records->shape(), &out));
+      OP_REQUIRES_OK(ctx, output.allocate(i, records->shape(), &outputs[i]));
     }
+    if (records_size == 0) return;
 
-    for (int64_t i = 0; i < records_size; ++i) {
-      const StringPiece record(records_t(i));
-      std::vector<string> fields;
-      ExtractFields(ctx, record, &fields);
-      OP_REQUIRES(ctx, fields.size() == out_type_.size(),
-                  errors::InvalidArgument("Expect ", out_type_.size(),
-                                          " fields but have ", fields.size(),
-                                          " in record ", i));
-
-      // Check each field in the record
-      for (int f = 0; f < static_cast<int>(out_type_.size()); ++f) {
-        const DataType& dtype = out_type_[f];
-        switch (dtype) {
-          case DT_INT32: {
-            // If this field is empty or NA value, check if default is given:
-            // If yes, use default value; Otherwise report error.
-            if (fields[f].empty() || fields[f] == na_value_) {
-              OP_REQUIRES(ctx, record_defaults[f].NumElements() == 1,
-                          errors::InvalidArgument(
-                              "Field ", f,
-                              " is required but missing in record ", i, "!"));
-
-              output[f]->flat<int32>()(i) = record_defaults[f].flat<int32>()(0);
-            } else {
-              int32_t value;
-              OP_REQUIRES(ctx, strings::safe_strto32(fields[f], &value),
-                          errors::InvalidArgument(
-                              "Field ", f, " in record ", i,
-                              " is not a valid int32: ", fields[f]));
-              output[f]->flat<int32>()(i) = value;
-            }
-            break;
-          }
-          case DT_INT64: {
-            // If this field is empty or NA value, check if default is given:
-            // If yes, use default value; Otherwise report error.
-            if (fields[f].empty() || fields[f] == na_value_) {
-              OP_REQUIRES(ctx, record_defaults[f].NumElements() == 1,
-                          errors::InvalidArgument(
-                              "Field ", f,
-                              " is required but missing in record ", i, "!"));
-
-              output[f]->flat<int64_t>()(i) =
-                  record_defaults[f].flat<int64_t>()(0);
-            } else {
-              int64_t value;
-              OP_REQUIRES(ctx, strings::safe_strto64(fields[f], &value),
-                          errors::InvalidArgument(
-                              "Field ", f, " in record ", i,
-                              " is not a valid int64: ", fields[f]));
-              output[f]->flat<int64_t>()(i) = value;
-            }
-            break;
-          }
-          case DT_FLOAT: {
-            // If this field is empty or NA value, check if default is given:
-            // If yes, use default value; Otherwise report error.
-            if (fields[f].empty() || fields[f] == na_value_) {
-              OP_REQUIRES(ctx, record_defaults[f].NumElements() == 1,
-                          errors::InvalidArgument(
-                              "Field ", f,
-                              " is required but missing in record ", i, "!"));
-              output[f]->flat<float>()(i) = record_defaults[f].flat<float>()(0);
-            } else {
-              float value;
-              OP_REQUIRES(ctx, strings::safe_strtof(fields[f], &value),
-                          errors::InvalidArgument(
-                              "Field ", f, " in record ", i,
-                              " is not a valid float: ", fields[f]));
-              output[f]->flat<float>()(i) = value;
-            }
-            break;
-          }
-          case DT_DOUBLE: {
-            // If this field is empty or NA value, check if default is given:
-            // If yes, use default value; Otherwise report error.
-            if (fields[f].empty() || fields[f] == na_value_) {
-              OP_REQUIRES(ctx, record_defaults[f].NumElements() == 1,
-                          errors::InvalidArgument(
-                              "Field ", f,
-                              " is required but missing in record ", i, "!"));
-              output[f]->flat<double>()(i) =
-                  record_defaults[f].flat<double>()(0);
-            } else {
-              double value;
-              OP_REQUIRES(ctx, strings::safe_strtod(fields[f], &value),
-                          errors::InvalidArgument(
-                              "Field ", f, " in record ", i,
-                              " is not a valid double: ", fields[f]));
-              output[f]->flat<double>()(i) = value;
-            }
-            break;
-          }
-          case DT_STRING: {
-            // If this field is empty or NA value, check if default is given:
-            // If yes, use default value; Otherwise report error.
-            if (fields[f].empty() || fields[f] == na_value_) {
-              OP_REQUIRES(ctx, record_defaults[f].NumElements() == 1,
-                          errors::InvalidArgument(
-                              "Field ", f,
-                              " is required but missing in record ", i, "!"));
-              output[f]->flat<tstring>()(i) =
-                  record_defaults[f].flat<tstring>()(0);
-            } else {
-              output[f]->flat<tstring>()(i) = std::move(fields[f]);
-            }
-            break;
+    // Records are decoded in parallel. As when decoding them in order, the
+    // error of the first invalid record is reported.
+    mutex mu;
+    int64_t first_error_record = records_size;
+    Status first_error;
+    auto decode_records = [&](int64_t begin, int64_t end) {
+      std::vector<StringPiece> fields;
+      std::deque<string> unescaped_fields;
+      for (int64_t i = begin; i < end; ++i) {
+        Status s = DecodeRecord(i, records_t(i), record_defaults, outputs,
+                                &fields, &unescaped_fields);
+        if (!s.ok()) {
+          mutex_lock l(mu);
+          if (i < first_error_record) {
+            first_error_record = i;
+            first_error = std::move(s);
           }
-          default:
-            OP_REQUIRES(ctx, false,
-                        errors::InvalidArgument("csv: data type ", dtype,
-                                                " not supported in field ", f));
+          return;
         }
       }
+    };
+
+    int64_t records_bytes = 0;
+    for (int64_t i = 0; i < records_size; ++i) {
+      records_bytes += records_t(i).size();
     }
+    const int64_t cost_per_record =
+        kCostPerRecordByte * (records_bytes / records_size) +
+        kCostPerField * static_cast<int64_t>(out_type_.size());
+    auto* worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, records_size,
+          cost_per_record, decode_records);
+    OP_REQUIRES_OK(ctx, first_error);
   }
 
  private:
@@ -205,15 +152,93 @@ class DecodeCSVOp : public OpKernel {
   bool use_quote_delim_;
   bool select_all_cols_;
   string na_value_;
+  std::unique_ptr<CsvScanner> scanner_;
+
+  // Decodes record `i` into element `i` of `outputs`. `fields` and
+  // `unescaped_fields` are scratch space.
+  Status DecodeRecord(int64_t i, StringPiece record,
+                      const OpInputList& record_defaults,
+                      const std::vector<Tensor*>& outputs,
+                      std::vector<StringPiece>* fields,
+                      std::deque<string>* unescaped_fields) const {
+    fields->clear();
+    unescaped_fields->clear();
+    TF_RETURN_IF_ERROR(ExtractFields(record, fields, unescaped_fields));
+    if (fields->size() != out_type_.size()) {
+      return errors::InvalidArgument("Expect ", out_type_.size(),
+                                     " fields but have ", fields->size(),
+                                     " in record ", i);
+    }
+
+    // Check each field in the record
+    for (int f = 0; f < static_cast<int>(out_type_.size()); ++f) {
+      const DataType& dtype = out_type_[f];
+      const StringPiece field = (*fields)[f];
+      switch (dtype) {
+        case DT_INT32:
+          TF_RETURN_IF_ERROR(DecodeField<int32>(i, f, field, record_defaults[f],
+                                                "int32", outputs[f]));
+          break;
+        case DT_INT64:
+          TF_RETURN_IF_ERROR(DecodeField<int64_t>(
+              i, f, field, record_defaults[f], "int64", outputs[f]));
+          break;
+        case DT_FLOAT:
+          TF_RETURN_IF_ERROR(DecodeField<float>(i, f, field, record_defaults[f],
+                                                "float", outputs[f]));
+          break;
+        case DT_DOUBLE:
+          TF_RETURN_IF_ERROR(DecodeField<double>(
+              i, f, field, record_defaults[f], "double", outputs[f]));
+          break;
+        case DT_STRING:
+          TF_RETURN_IF_ERROR(DecodeField<tstring>(
+              i, f, field, record_defaults[f], "string", outputs[f]));
+          break;
+        default:
+          return errors::InvalidArgument("csv: data type ", dtype,
+                                         " not supported in field ", f);
+      }
+    }
+    return OkStatus();
+  }
+
+  // Decodes field `f` of record `i` into element `i` of `output`.
+  template <typename T>
+  Status DecodeField(int64_t i, int f, StringPiece field,
+                     const Tensor& record_default, StringPiece type_name,
+                     Tensor* output) const {
+    T& value = output->flat<T>()(i);
+    // If this field is empty or NA value, check if default is given:
+    // If yes, use default value; Otherwise report error.
+    if (field.empty() || field == na_value_) {
+      if (record_default.NumElements() != 1) {
+        return errors::InvalidArgument("Field ", f,
+                                       " is required but missing in record ",
+                                       i, "!");
+      }
+      value = record_default.flat<T>()(0);
+      return OkStatus();
+    }
+    if (!ConvertField(field, &value)) {
+      return errors::InvalidArgument("Field ", f, " in record ", i,
+                                     " is not a valid ", type_name, ": ",
+                                     field);
+    }
+    return OkStatus();
+  }
 
-  void ExtractFields(OpKernelContext* ctx, StringPiece input,
-                     std::vector<string>* result) {
-    int64_t current_idx = 0;
+  // Splits `input` into its selected fields. Unquoted fields, and quoted
+  // fields without escaped quotes, are views into `input`. Other quoted fields
+  // are unescaped into `unescaped_fields`.
+  Status ExtractFields(StringPiece input, std::vector<StringPiece>* result,
+                       std::deque<string>* unescaped_fields) const {
+    size_t current_idx = 0;
     int64_t num_fields_parsed = 0;
     int64_t selector_idx = 0;  // Keep track of index into select_cols
 
     if (!input.empty()) {
-      while (static_cast<size_t>(current_idx) < input.size()) {
+      while (current_idx < input.size()) {
         if (input[current_idx] == '\n' || input[current_idx] == '\r') {
           current_idx++;
           continue;
@@ -230,48 +255,56 @@ class DecodeCSVOp : public OpKernel {
         }
 
         // This is the body of the field;
-        string field;
+        StringPiece field;
         if (!quoted) {
-          while (static_cast<size_t>(current_idx) < input.size() &&
-                 input[current_idx] != delim_) {
-            OP_REQUIRES(ctx,
-                        (!use_quote_delim_ || input[current_idx] != '"') &&
-                            input[current_idx] != '\n' &&
-                            input[current_idx] != '\r',
-                        errors::InvalidArgument(
-                            "Unquoted fields cannot have quotes/CRLFs inside"));
-            if (include) field += input[current_idx];
-            current_idx++;
+          const size_t start = current_idx;
+          current_idx = scanner_->Find(input, current_idx);
+          if (current_idx < input.size() && input[current_idx] != delim_) {
+            return errors::InvalidArgument(
+                "Unquoted fields cannot have quotes/CRLFs inside");
           }
+          field = input.substr(start, current_idx - start);
 
           // Go to next field or the end
           current_idx++;
-        } else if (use_quote_delim_) {
+        } else {
           // Quoted field needs to be ended with '"' and delim or end
-          while (
-              (static_cast<size_t>(current_idx) < input.size() - 1) &&
-              (input[current_idx] != '"' || input[current_idx + 1] != delim_)) {
-            if (input[current_idx] != '"') {
-              if (include) field += input[current_idx];
-              current_idx++;
-            } else {
-              OP_REQUIRES(
-                  ctx, input[current_idx + 1] == '"',
-                  errors::InvalidArgument("Quote inside a string has to be "
-                                          "escaped by another quote"));
-              if (include) field += '"';
-              current_idx += 2;
+          const size_t start = current_idx;
+          bool has_escaped_quotes = false;
+          while (current_idx + 1 < input.size()) {
+            const void* quote = std::memchr(input.data() + current_idx, '"',
+                                            input.size() - 1 - current_idx);
+            if (quote == nullptr) {
+              current_idx = input.size() - 1;
+              break;
             }
+            current_idx = static_cast<const char*>(quote) - input.data();
+            if (input[current_idx + 1] == delim_) break;
+            if (input[current_idx + 1] != '"') {
+              return errors::InvalidArgument(
+                  "Quote inside a string has to be escaped by another quote");
+            }
+            has_escaped_quotes = true;
+            current_idx += 2;
           }
 
-          OP_REQUIRES(
-              ctx,
-              (static_cast<size_t>(current_idx) < input.size() &&
-               input[current_idx] == '"' &&
-               (static_cast<size_t>(current_idx) == input.size() - 1 ||
-                input[current_idx + 1] == delim_)),
-              errors::InvalidArgument("Quoted field has to end with quote "
-                                      "followed by delim or end"));
+          if (!(current_idx < input.size() && input[current_idx] == '"' &&
+                (current_idx == input.size() - 1 ||
+                 input[current_idx + 1] == delim_))) {
+            return errors::InvalidArgument(
+                "Quoted field has to end with quote followed by delim or end");
+          }
+          field = input.substr(start, current_idx - start);
+          if (include && has_escaped_quotes) {
+            string& unescaped = unescaped_fields->emplace_back();
+            unescaped.reserve(field.size());
+            for (size_t j = 0; j < field.size(); ++j) {
+              unescaped += field[j];
+              // Skips the second quote of each escaped quote.
+              if (field[j] == '"') ++j;
+            }
+            field = unescaped;
+          }
 
           current_idx += 2;
         }
@@ -280,7 +313,7 @@ class DecodeCSVOp : public OpKernel {
         if (include) {
           result->push_back(field);
           selector_idx++;
-          if (selector_idx == select_cols_.size()) return;
+          if (selector_idx == select_cols_.size()) return OkStatus();
         }
       }
 
@@ -289,8 +322,9 @@ class DecodeCSVOp : public OpKernel {
                                    static_cast<size_t>(num_fields_parsed));
       // Check if the last field is missing
       if (include && input[input.size() - 1] == delim_)
-        result->push_back(string());
+        result->push_back(StringPiece());
     }
+    return OkStatus();
   }
 };
 
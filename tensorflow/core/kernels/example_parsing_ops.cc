@@ -15,6 +15,7 @@ limitations under the License.
 
 // See docs in ../ops/parsing_ops.cc.
 
+#include <memory>
 #include <numeric>
 #include <unordered_set>
 #include <vector>
@@ -30,7 +31,9 @@ limitations under the License.
 #include "tensorflow/core/lib/gtl/array_slice.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/protobuf.h"
+#include "tensorflow/core/platform/thread_annotations.h"
 #include "tensorflow/core/util/example_proto_fast_parsing.h"
 #include "tensorflow/core/util/example_proto_helper.h"
 #include "tensorflow/core/util/sparse/sparse_tensor.h"
@@ -41,6 +44,18 @@ namespace tensorflow {
 namespace {
 constexpr char kParseExampleV2[] = "ParseExampleV2";
 constexpr char kParseSequenceExampleV2[] = "ParseSequenceExampleV2";
+
+// Returns whether `a` and `b` have the same dtype, shape and values.
+bool SameTensor(const Tensor& a, const Tensor& b) {
+  if (a.dtype() != b.dtype() || a.shape() != b.shape()) return false;
+  if (a.dtype() != DT_STRING) return a.tensor_data() == b.tensor_data();
+  auto a_flat = a.flat<tstring>();
+  auto b_flat = b.flat<tstring>();
+  for (int64_t i = 0; i < a_flat.size(); ++i) {
+    if (a_flat(i) != b_flat(i)) return false;
+  }
+  return true;
+}
 }  // namespace
 
 // Note: this kernel is used by both the ParseExample op and the ParseExampleV2
@@ -87,15 +102,18 @@ class ParseExampleOp : public OpKernel {
         ctx, CheckInputShapes(serialized, names, dense_defaults, dense_keys_t,
                               sparse_keys_t, ragged_keys_t));
 
-    example::FastParseExampleConfig config =
-        MakeConfig(dense_keys_t, sparse_keys_t, ragged_keys_t, dense_defaults);
+    std::shared_ptr<const example::CompiledFastParseExampleConfig> config;
+    OP_REQUIRES_OK(ctx, GetCompiledConfig(dense_keys_t, sparse_keys_t,
+                                          ragged_keys_t, dense_defaults,
+                                          &config));
 
     example::Result result;
     if (TensorShapeUtils::IsVector(serialized->shape())) {
       OP_REQUIRES_OK(
-          ctx, ParseExampleVector(config, serialized, names, ctx, &result));
+          ctx, ParseExampleVector(*config, serialized, names, ctx, &result));
     } else {
-      OP_REQUIRES_OK(ctx, ParseExampleScalar(config, serialized, ctx, &result));
+      OP_REQUIRES_OK(ctx,
+                     ParseExampleScalar(*config, serialized, ctx, &result));
     }
     OP_REQUIRES_OK(ctx, WriteOutput(result, ctx));
   }
@@ -234,19 +252,69 @@ class ParseExampleOp : public OpKernel {
     return config;
   }
 
+  // Returns whether `config` was made from the given keys and defaults.
+  bool ConfigMatches(const example::FastParseExampleConfig& config,
+                     const std::vector<StringPiece>& dense_keys_t,
+                     const std::vector<StringPiece>& sparse_keys_t,
+                     const std::vector<StringPiece>& ragged_keys_t,
+                     const OpInputList& dense_defaults) const {
+    for (int d = 0; d < attrs_.num_dense; ++d) {
+      if (config.dense[d].feature_name != dense_keys_t[d] ||
+          !SameTensor(config.dense[d].default_value, dense_defaults[d])) {
+        return false;
+      }
+    }
+    for (int d = 0; d < attrs_.num_sparse; ++d) {
+      if (config.sparse[d].feature_name != sparse_keys_t[d]) return false;
+    }
+    for (int d = 0; d < attrs_.num_ragged; ++d) {
+      if (config.ragged[d].feature_name != ragged_keys_t[d]) return false;
+    }
+    return true;
+  }
+
+  // Returns the compiled config for the keys and defaults. The keys and
+  // defaults are inputs, but they rarely change between calls, so the last
+  // compiled config is reused while they stay the same.
+  Status GetCompiledConfig(
+      const std::vector<StringPiece>& dense_keys_t,
+      const std::vector<StringPiece>& sparse_keys_t,
+      const std::vector<StringPiece>& ragged_keys_t,
+      const OpInputList& dense_defaults,
+      std::shared_ptr<const example::CompiledFastParseExampleConfig>* config) {
+    {
+      tf_shared_lock l(mu_);
+      *config = compiled_config_;
+    }
+    if (*config != nullptr &&
+        ConfigMatches((*config)->config(), dense_keys_t, sparse_keys_t,
+                      ragged_keys_t, dense_defaults)) {
+      return OkStatus();
+    }
+    std::unique_ptr<const example::CompiledFastParseExampleConfig> compiled;
+    TF_RETURN_IF_ERROR(example::CompiledFastParseExampleConfig::Compile(
+        MakeConfig(dense_keys_t, sparse_keys_t, ragged_keys_t, dense_defaults),
+        &compiled));
+    *config = std::move(compiled);
+    mutex_lock l(mu_);
+    compiled_config_ = *config;
+    return OkStatus();
+  }
+
   // Parses a single example.
-  Status ParseExampleScalar(const example::FastParseExampleConfig& config,
-                            const Tensor* serialized, OpKernelContext* ctx,
-                            example::Result* result) const {
+  Status ParseExampleScalar(
+      const example::CompiledFastParseExampleConfig& config,
+      const Tensor* serialized, OpKernelContext* ctx,
+      example::Result* result) const {
     const tstring& serialized_proto = serialized->scalar<tstring>()();
     return FastParseSingleExample(config, serialized_proto, result);
   }
 
   // Parses a vector of examples.
-  Status ParseExampleVector(const example::FastParseExampleConfig& config,
-                            const Tensor* serialized, const Tensor* names,
-                            OpKernelContext* ctx,
-                            example::Result* result) const {
+  Status ParseExampleVector(
+      const example::CompiledFastParseExampleConfig& config,
+      const Tensor* serialized, const Tensor* names, OpKernelContext* ctx,
+      example::Result* result) const {
     auto serialized_t = serialized->flat<tstring>();
     auto names_t = names->flat<tstring>();
     gtl::ArraySlice<tstring> slice(serialized_t.data(), serialized_t.size());
@@ -290,6 +358,9 @@ class ParseExampleOp : public OpKernel {
   ParseExampleAttrs attrs_;
   int op_version_;
   absl::once_flag flag_;
+  mutex mu_;
+  std::shared_ptr<const example::CompiledFastParseExampleConfig>
+      compiled_config_ TF_GUARDED_BY(mu_);
 };
 
 REGISTER_KERNEL_BUILDER(Name("ParseExample").Device(DEVICE_CPU),
@@ -66,6 +66,22 @@ class Int64Filler {
   DataType dtype = DT_INT64;
 };
 
+// Fills int64 lists with values whose varint encodings take from 1 to 10
+// bytes, like hashed ids and timestamps do.
+class WideInt64Filler {
+ public:
+  WideInt64Filler() {}
+  void operator()(Feature* f, int feature_size) const {
+    for (int i = 0; i < feature_size; ++i) {
+      f->mutable_int64_list()->add_value(int64_t{1729} << (7 * (i % 9)));
+    }
+  }
+  Tensor make_dense_default(int feature_size) {
+    return Tensor(dtype, TensorShape({feature_size}));
+  }
+  DataType dtype = DT_INT64;
+};
+
 class FloatFiller {
  public:
   FloatFiller() {}
@@ -98,6 +114,7 @@ struct ExampleStore {
       AddExample(&serialized_example, 10, 512, 1);
       AddExample(&serialized_example, 100, 512, 1);
       AddExample(&serialized_example, 1000, 512, 1);
+      AddExample(&serialized_example, 10, 128, 100);
       AddExample(&serialized_example, 1, 1, 10);
       AddExample(&serialized_example, 1, 1, 100);
       AddExample(&serialized_example, 1, 1, 1000);
@@ -139,6 +156,7 @@ absl::once_flag ExampleStore<T>::flags_init;
 
 template struct ExampleStore<BytesFiller>;
 template struct ExampleStore<Int64Filler>;
+template struct ExampleStore<WideInt64Filler>;
 template struct ExampleStore<FloatFiller>;
 
 enum BenchmarkType { kDense, kSparse, kVarLenDense, kRagged };
@@ -340,6 +358,9 @@ typedef BenchmarkOptions<ExampleStore<Int64Filler>, kDense> DenseInt64;
 typedef BenchmarkOptions<ExampleStore<Int64Filler>, kVarLenDense>
     VarLenDenseInt64;
 typedef BenchmarkOptions<ExampleStore<Int64Filler>, kRagged> RaggedInt64;
+typedef BenchmarkOptions<ExampleStore<WideInt64Filler>, kSparse>
+    SparseWideInt64;
+typedef BenchmarkOptions<ExampleStore<WideInt64Filler>, kDense> DenseWideInt64;
 typedef BenchmarkOptions<ExampleStore<FloatFiller>, kSparse> SparseFloat;
 typedef BenchmarkOptions<ExampleStore<FloatFiller>, kDense> DenseFloat;
 typedef BenchmarkOptions<ExampleStore<FloatFiller>, kVarLenDense>
@@ -432,11 +453,22 @@ BM_AllParseExampleV2(SparseInt64);
 BM_AllParseExampleV2(DenseInt64);
 BM_AllParseExampleV2(VarLenDenseInt64);
 BM_AllParseExampleV2(RaggedInt64);
+BM_AllParseExampleV2(SparseWideInt64);
+BM_AllParseExampleV2(DenseWideInt64);
 BM_AllParseExampleV2(SparseFloat);
 BM_AllParseExampleV2(DenseFloat);
 BM_AllParseExampleV2(VarLenDenseFloat);
 BM_AllParseExampleV2(RaggedFloat);
 
+// Batches of examples with long value lists, where parsing is dominated by
+// decoding packed floats and varints, and by copying bytes.
+BM_ParseExampleV2(DenseFloat, 128, 10, 100);
+BM_ParseExampleV2(SparseInt64, 128, 10, 100);
+BM_ParseExampleV2(SparseWideInt64, 128, 10, 100);
+BM_ParseExampleV2(DenseWideInt64, 128, 10, 100);
+BM_ParseExampleV2(SparseString, 128, 10, 100);
+BM_ParseExampleV2(DenseString, 128, 10, 100);
+
 // K == num_keys. F == feature_size.
 // K must be one of 10, 100, 1000
 #define BM_ParseSingleExample(TYPE, K, F)                                    \
@@ -15,16 +15,22 @@ limitations under the License.
 
 // Tests kernels of lookup ops.
 
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/framework/fake_input.h"
 #include "tensorflow/core/framework/lookup_interface.h"
 #include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/shape_inference_testutil.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
 #include "tensorflow/core/kernels/lookup_table_op.h"
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 namespace {
@@ -100,5 +106,131 @@ TEST_F(LookupOpsTest, AnonymousHashTable_RefCounting) {
   EXPECT_FALSE(alive);
 }
 
+constexpr int kNumContentionReaders = 8;
+constexpr int kBenchmarkVocabSize = 1 << 20;
+
+static Tensor RandomKeys(random::SimplePhilox* rnd, int num_keys) {
+  Tensor keys(DT_INT64, TensorShape({num_keys}));
+  auto keys_flat = keys.flat<int64_t>();
+  for (int i = 0; i < num_keys; ++i) {
+    keys_flat(i) = rnd->Uniform(kBenchmarkVocabSize);
+  }
+  return keys;
+}
+
+// Builds a graph in which `kNumContentionReaders` LookupTableFindV2 ops and
+// one LookupTableInsertV2 op access the same MutableHashTableV2 concurrently,
+// as happens when a serving graph receives online vocabulary updates.
+static Graph* MutableHashTableContention(int num_shards, int batch_size) {
+  Graph* g = new Graph(OpRegistry::Global());
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+
+  Node* table;
+  TF_CHECK_OK(NodeBuilder(g->NewName("table"), "MutableHashTableV2")
+                  .Attr("shared_name", "contention_table")
+                  .Attr("key_dtype", DT_INT64)
+                  .Attr("value_dtype", DT_INT64)
+                  .Attr("num_shards", num_shards)
+                  .Finalize(g, &table));
+
+  const int update_size = batch_size / 16;
+  Node* update_keys = test::graph::Constant(g, RandomKeys(&rnd, update_size));
+  Node* update_values =
+      test::graph::Constant(g, RandomKeys(&rnd, update_size));
+  TF_CHECK_OK(NodeBuilder(g->NewName("insert"), "LookupTableInsertV2")
+                  .Input(table)
+                  .Input(update_keys)
+                  .Input(update_values)
+                  .Finalize(g, nullptr));
+
+  Node* default_value = test::graph::Constant(g, test::AsScalar<int64_t>(-1));
+  for (int i = 0; i < kNumContentionReaders; ++i) {
+    Node* keys = test::graph::Constant(g, RandomKeys(&rnd, batch_size));
+    TF_CHECK_OK(NodeBuilder(g->NewName("find"), "LookupTableFindV2")
+                    .Input(table)
+                    .Input(keys)
+                    .Input(default_value)
+                    .Finalize(g, nullptr));
+  }
+  return g;
+}
+
+static void BM_MutableHashTableContention(::testing::benchmark::State& state) {
+  const int num_shards = state.range(0);
+  const int batch_size = state.range(1);
+  test::Benchmark("cpu", MutableHashTableContention(num_shards, batch_size),
+                  /*old_benchmark_api=*/false)
+      .Run(state);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          kNumContentionReaders * batch_size);
+}
+
+BENCHMARK(BM_MutableHashTableContention)
+    ->UseRealTime()
+    ->ArgPair(1, 1 << 12)
+    ->ArgPair(16, 1 << 12)
+    ->ArgPair(1, 200000)
+    ->ArgPair(16, 200000)
+    ->ArgPair(64, 200000);
+
+// Returns a MutableDenseHashTableV2 node with int64 keys and float values.
+// Graphs built with the same `shared_name` share one table.
+static Node* DenseHashTable(Graph* g, const string& shared_name) {
+  Node* table;
+  TF_CHECK_OK(
+      NodeBuilder(g->NewName("dense_table"), "MutableDenseHashTableV2")
+          .Input(test::graph::Constant(g, test::AsScalar<int64_t>(-1)))
+          .Input(test::graph::Constant(g, test::AsScalar<int64_t>(-2)))
+          .Attr("shared_name", shared_name)
+          .Attr("key_dtype", DT_INT64)
+          .Attr("value_dtype", DT_FLOAT)
+          .Attr("initial_num_buckets", 1 << 21)
+          .Finalize(g, &table));
+  return table;
+}
+
+// Looks up `batch_size` random ids in a dense table that holds
+// kBenchmarkVocabSize entries.
+static void BM_MutableDenseHashTableFind(::testing::benchmark::State& state) {
+  const int batch_size = state.range(0);
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+
+  Graph* init = new Graph(OpRegistry::Global());
+  {
+    Tensor keys(DT_INT64, TensorShape({kBenchmarkVocabSize}));
+    Tensor values(DT_FLOAT, TensorShape({kBenchmarkVocabSize}));
+    for (int i = 0; i < kBenchmarkVocabSize; ++i) {
+      keys.flat<int64_t>()(i) = i;
+      values.flat<float>()(i) = i;
+    }
+    TF_CHECK_OK(NodeBuilder(init->NewName("insert"), "LookupTableInsertV2")
+                    .Input(DenseHashTable(init, "dense_find_table"))
+                    .Input(test::graph::Constant(init, keys))
+                    .Input(test::graph::Constant(init, values))
+                    .Finalize(init, nullptr));
+  }
+
+  Graph* g = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(NodeBuilder(g->NewName("find"), "LookupTableFindV2")
+                  .Input(DenseHashTable(g, "dense_find_table"))
+                  .Input(test::graph::Constant(g, RandomKeys(&rnd, batch_size)))
+                  .Input(test::graph::Constant(g, test::AsScalar<float>(0)))
+                  .Finalize(g, nullptr));
+
+  test::Benchmark("cpu", g, /*options=*/nullptr, init, /*rendez=*/nullptr,
+                  /*executor_type=*/"", /*old_benchmark_api=*/false)
+      .Run(state);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          batch_size);
+}
+
+BENCHMARK(BM_MutableDenseHashTableFind)
+    ->UseRealTime()
+    ->Arg(1 << 10)
+    ->Arg(1 << 16)
+    ->Arg(200000);
+
 }  // namespace
 }  // namespace tensorflow
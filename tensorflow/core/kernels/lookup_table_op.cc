@@ -16,9 +16,17 @@ limitations under the License.
 #include "tensorflow/core/kernels/lookup_table_op.h"
 #define EIGEN_USE_THREADS
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <functional>
+#include <optional>
 #include <string>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/types.h"
@@ -26,7 +34,9 @@ limitations under the License.
 #include "tensorflow/core/kernels/initializable_lookup_table.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/platform/prefetch.h"
 #include "tensorflow/core/platform/random.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 namespace lookup {
@@ -36,12 +46,210 @@ std::string UniqueNodeName(const std::string& base) {
   return strings::StrCat(base, "/", counter.fetch_add(1), "/", random::New64());
 }
 
+namespace {
+
+// Estimated cost, in cycles, of looking up a single key in a sharded table.
+// Used to decide how finely Find() splits a batch across the intra-op pool.
+constexpr int64_t kShardedFindCostPerKey = 250;
+
+// Hashes a key to select its shard in a ShardedHashMap. Integral keys are
+// scrambled so that dense id ranges are spread evenly across shards, and so
+// that the shard index is independent of the bucket chosen inside the shard.
+template <typename T>
+inline uint64 ShardHash(const T& key) {
+  return static_cast<uint64>(key) * 0x9E3779B97F4A7C15ULL;
+}
+
+inline uint64 ShardHash(const tstring& key) { return Hash64(key); }
+
+// Returns the number of shards requested by the optional "num_shards" attr of
+// `kernel`. Ops that do not define the attr get a single shard.
+int64_t NumShardsAttr(OpKernel* kernel) {
+  int64_t num_shards = 1;
+  if (!TryGetNodeAttr(kernel->def(), "num_shards", &num_shards)) {
+    return 1;
+  }
+  return std::max<int64_t>(num_shards, 1);
+}
+
+// A hash map split into independently locked std::unordered_maps. Readers and
+// writers that touch different shards never contend with each other, and
+// batched operations acquire each shard lock at most once per call. With a
+// single shard this is equivalent to an unordered_map guarded by one mutex.
+template <class K, class V>
+class ShardedHashMap {
+ public:
+  typedef std::unordered_map<K, V> Map;
+  typedef std::vector<const Map*> MapList;
+
+  explicit ShardedHashMap(int64_t num_shards) : shards_(num_shards) {}
+
+  int64_t num_shards() const { return shards_.size(); }
+
+  size_t size() const {
+    size_t size = 0;
+    for (const Shard& shard : shards_) {
+      tf_shared_lock l(shard.mu);
+      size += shard.map.size();
+    }
+    return size;
+  }
+
+  // Calls `fn(map, i)` for every `i` in [begin, end) while holding a shared
+  // lock on the shard that owns `keys(i)`. Indices that belong to the same
+  // shard are visited in increasing order.
+  template <typename KeyFlat, typename Fn>
+  void VisitShared(const KeyFlat& keys, int64_t begin, int64_t end,
+                   Fn fn) const {
+    if (shards_.size() == 1) {
+      const Shard& shard = shards_[0];
+      tf_shared_lock l(shard.mu);
+      for (int64_t i = begin; i < end; ++i) {
+        fn(shard.map, i);
+      }
+      return;
+    }
+    std::vector<int64_t> order;
+    std::vector<int64_t> offsets;
+    GroupByShard(keys, begin, end, &order, &offsets);
+    for (size_t s = 0; s < shards_.size(); ++s) {
+      if (offsets[s] == offsets[s + 1]) continue;
+      const Shard& shard = shards_[s];
+      tf_shared_lock l(shard.mu);
+      for (int64_t j = offsets[s]; j < offsets[s + 1]; ++j) {
+        fn(shard.map, order[j]);
+      }
+    }
+  }
+
+  // Calls `fn(map, i)` for every `i` in [0, keys.size()) while holding an
+  // exclusive lock on the shard that owns `keys(i)`. Indices that belong to
+  // the same shard are visited in increasing order, so that the last update
+  // of a duplicated key wins. If `clear` is true, all shards are emptied
+  // first and every shard lock is held for the whole call, so that readers
+  // never observe a partially replaced table.
+  template <typename KeyFlat, typename Fn>
+  void VisitExclusive(const KeyFlat& keys, bool clear,
+                      Fn fn) TF_NO_THREAD_SAFETY_ANALYSIS {
+    const int64_t num_keys = keys.size();
+    std::vector<mutex_lock> all_locks;
+    if (clear) {
+      all_locks.reserve(shards_.size());
+      for (Shard& shard : shards_) {
+        all_locks.emplace_back(shard.mu);
+        shard.map.clear();
+      }
+    }
+    if (shards_.size() == 1) {
+      Shard& shard = shards_[0];
+      std::optional<mutex_lock> l;
+      if (!clear) l.emplace(shard.mu);
+      for (int64_t i = 0; i < num_keys; ++i) {
+        fn(shard.map, i);
+      }
+      return;
+    }
+    std::vector<int64_t> order;
+    std::vector<int64_t> offsets;
+    GroupByShard(keys, 0, num_keys, &order, &offsets);
+    for (size_t s = 0; s < shards_.size(); ++s) {
+      if (offsets[s] == offsets[s + 1]) continue;
+      Shard& shard = shards_[s];
+      std::optional<mutex_lock> l;
+      if (!clear) l.emplace(shard.mu);
+      for (int64_t j = offsets[s]; j < offsets[s + 1]; ++j) {
+        fn(shard.map, order[j]);
+      }
+    }
+  }
+
+  // Calls `fn(maps)` while holding a shared lock on every shard, where `maps`
+  // holds one map per shard. Used by operations that need a consistent view
+  // of the whole table, such as export.
+  template <typename Fn>
+  auto VisitAllShared(Fn fn) const TF_NO_THREAD_SAFETY_ANALYSIS {
+    std::vector<tf_shared_lock> all_locks;
+    all_locks.reserve(shards_.size());
+    MapList maps;
+    maps.reserve(shards_.size());
+    for (const Shard& shard : shards_) {
+      all_locks.emplace_back(shard.mu);
+      maps.push_back(&shard.map);
+    }
+    return fn(maps);
+  }
+
+  static int64_t TotalSize(const MapList& maps) {
+    int64_t size = 0;
+    for (const Map* map : maps) {
+      size += map->size();
+    }
+    return size;
+  }
+
+ private:
+  struct Shard {
+    mutable mutex mu;
+    Map map TF_GUARDED_BY(mu);
+  };
+
+  // Stably groups the indices in [begin, end) by the shard that owns
+  // `keys(i)`. On return, the indices owned by shard `s` are
+  // `order[offsets[s]], ..., order[offsets[s + 1] - 1]`.
+  template <typename KeyFlat>
+  void GroupByShard(const KeyFlat& keys, int64_t begin, int64_t end,
+                    std::vector<int64_t>* order,
+                    std::vector<int64_t>* offsets) const {
+    const uint64 num_shards = shards_.size();
+    std::vector<int32> shard_ids(end - begin);
+    offsets->assign(num_shards + 1, 0);
+    for (int64_t i = begin; i < end; ++i) {
+      const int32 s =
+          (ShardHash(SubtleMustCopyIfIntegral(keys(i))) >> 32) % num_shards;
+      shard_ids[i - begin] = s;
+      ++(*offsets)[s + 1];
+    }
+    for (uint64 s = 0; s < num_shards; ++s) {
+      (*offsets)[s + 1] += (*offsets)[s];
+    }
+    std::vector<int64_t> next(offsets->begin(), offsets->end() - 1);
+    order->resize(end - begin);
+    for (int64_t i = begin; i < end; ++i) {
+      (*order)[next[shard_ids[i - begin]]++] = i;
+    }
+  }
+
+  std::vector<Shard> shards_;
+};
+
+// Runs `fn` over the key range [0, num_keys). Tables with more than one shard
+// split large batches across the intra-op thread pool of the device; each
+// range then only takes the locks of the shards its keys map to.
+void FindInParallel(OpKernelContext* ctx, int64_t num_shards, int64_t num_keys,
+                    int64_t cost_per_key,
+                    const std::function<void(int64_t, int64_t)>& fn) {
+  if (num_shards == 1 || ctx == nullptr) {
+    fn(0, num_keys);
+    return;
+  }
+  const auto* worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+  Shard(worker_threads->num_threads, worker_threads->workers, num_keys,
+        cost_per_key, fn);
+}
+
+}  // namespace
+
 // Lookup table that wraps an unordered_map, where the key and value data type
 // is specified. Each individual value must be a scalar. If vector values are
 // required, use MutableHashTableOfTensors.
 //
 // This table is mutable and thread safe - Insert can be called at any time.
 //
+// If the "num_shards" attr is greater than 1, keys are partitioned across that
+// many independently locked maps, and Find splits large batches across the
+// intra-op thread pool. This reduces contention between concurrent lookups and
+// inserts on tables that receive online updates.
+//
 // Sample use case:
 //
 // MutableHashTableOfScalars<int64, int64> table;  // int64 -> int64.
@@ -53,12 +261,10 @@ std::string UniqueNodeName(const std::string& base) {
 template <class K, class V>
 class MutableHashTableOfScalars final : public LookupInterface {
  public:
-  MutableHashTableOfScalars(OpKernelContext* ctx, OpKernel* kernel) {}
+  MutableHashTableOfScalars(OpKernelContext* ctx, OpKernel* kernel)
+      : table_(NumShardsAttr(kernel)) {}
 
-  size_t size() const override {
-    tf_shared_lock l(mu_);
-    return table_.size();
-  }
+  size_t size() const override { return table_.size(); }
 
   Status Find(OpKernelContext* ctx, const Tensor& key, Tensor* value,
               const Tensor& default_value) override {
@@ -70,18 +276,22 @@ class MutableHashTableOfScalars final : public LookupInterface {
     int64_t default_total = default_flat.size();
     bool is_full_size_default = (total == default_total);
 
-    tf_shared_lock l(mu_);
-    for (int64_t i = 0; i < key_values.size(); ++i) {
-      // is_full_size_default is true:
-      //   Each key has an independent default value, key_values(i)
-      //   corresponding uses default_flat(i) as its default value.
-      //
-      // is_full_size_default is false:
-      //   All keys will share the default_flat(0) as default value.
-      value_values(i) = gtl::FindWithDefault(
-          table_, SubtleMustCopyIfIntegral(key_values(i)),
-          is_full_size_default ? default_flat(i) : default_flat(0));
-    }
+    auto find_range = [&](int64_t begin, int64_t end) {
+      table_.VisitShared(
+          key_values, begin, end, [&](const Map& map, int64_t i) {
+            // is_full_size_default is true:
+            //   Each key has an independent default value, key_values(i)
+            //   corresponding uses default_flat(i) as its default value.
+            //
+            // is_full_size_default is false:
+            //   All keys will share the default_flat(0) as default value.
+            value_values(i) = gtl::FindWithDefault(
+                map, SubtleMustCopyIfIntegral(key_values(i)),
+                is_full_size_default ? default_flat(i) : default_flat(0));
+          });
+    };
+    FindInParallel(ctx, table_.num_shards(), key_values.size(),
+                   kShardedFindCostPerKey, find_range);
 
     return OkStatus();
   }
@@ -90,14 +300,10 @@ class MutableHashTableOfScalars final : public LookupInterface {
     const auto key_values = keys.flat<K>();
     const auto value_values = values.flat<V>();
 
-    mutex_lock l(mu_);
-    if (clear) {
-      table_.clear();
-    }
-    for (int64_t i = 0; i < key_values.size(); ++i) {
-      gtl::InsertOrUpdate(&table_, SubtleMustCopyIfIntegral(key_values(i)),
+    table_.VisitExclusive(key_values, clear, [&](Map& map, int64_t i) {
+      gtl::InsertOrUpdate(&map, SubtleMustCopyIfIntegral(key_values(i)),
                           SubtleMustCopyIfIntegral(value_values(i)));
-    }
+    });
     return OkStatus();
   }
 
@@ -109,10 +315,10 @@ class MutableHashTableOfScalars final : public LookupInterface {
   Status Remove(OpKernelContext* ctx, const Tensor& keys) override {
     const auto key_values = keys.flat<K>();
 
-    mutex_lock l(mu_);
-    for (int64_t i = 0; i < key_values.size(); ++i) {
-      table_.erase(SubtleMustCopyIfIntegral(key_values(i)));
-    }
+    table_.VisitExclusive(key_values, /*clear=*/false,
+                          [&](Map& map, int64_t i) {
+                            map.erase(SubtleMustCopyIfIntegral(key_values(i)));
+                          });
     return OkStatus();
   }
 
@@ -122,17 +328,18 @@ class MutableHashTableOfScalars final : public LookupInterface {
   }
 
   Status ExportValues(OpKernelContext* ctx) override {
-    tf_shared_lock l(mu_);
-    int64_t size = table_.size();
-
-    Tensor* keys;
-    Tensor* values;
-    TF_RETURN_IF_ERROR(
-        ctx->allocate_output("keys", TensorShape({size}), &keys));
-    TF_RETURN_IF_ERROR(
-        ctx->allocate_output("values", TensorShape({size}), &values));
-    ExportKeysAndValues(keys, values);
-    return OkStatus();
+    return table_.VisitAllShared([&](const MapList& maps) -> Status {
+      int64_t size = ShardedMap::TotalSize(maps);
+
+      Tensor* keys;
+      Tensor* values;
+      TF_RETURN_IF_ERROR(
+          ctx->allocate_output("keys", TensorShape({size}), &keys));
+      TF_RETURN_IF_ERROR(
+          ctx->allocate_output("values", TensorShape({size}), &values));
+      ExportKeysAndValues(maps, keys, values);
+      return OkStatus();
+    });
   }
 
   DataType key_dtype() const override { return DataTypeToEnum<K>::v(); }
@@ -144,25 +351,32 @@ class MutableHashTableOfScalars final : public LookupInterface {
   TensorShape value_shape() const override { return TensorShape(); }
 
   int64_t MemoryUsed() const override {
-    int64_t ret = 0;
-    tf_shared_lock l(mu_);
-    for (unsigned i = 0; i < table_.bucket_count(); ++i) {
-      size_t bucket_size = table_.bucket_size(i);
-      if (bucket_size == 0) {
-        ret++;
-      } else {
-        ret += bucket_size;
+    int64_t ret = table_.VisitAllShared([](const MapList& maps) {
+      int64_t num_slots = 0;
+      for (const Map* map : maps) {
+        for (unsigned i = 0; i < map->bucket_count(); ++i) {
+          size_t bucket_size = map->bucket_size(i);
+          if (bucket_size == 0) {
+            num_slots++;
+          } else {
+            num_slots += bucket_size;
+          }
+        }
       }
-    }
+      return num_slots;
+    });
     return sizeof(MutableHashTableOfScalars) + ret;
   }
 
   Status AsGraphDef(GraphDefBuilder* builder, Node** out) const override {
-    tf_shared_lock l(mu_);
-    int64_t size = table_.size();
-    Tensor keys(key_dtype(), TensorShape({size}));
-    Tensor values(value_dtype(), TensorShape({size}));
-    ExportKeysAndValues(&keys, &values);
+    Tensor keys;
+    Tensor values;
+    table_.VisitAllShared([&](const MapList& maps) {
+      int64_t size = ShardedMap::TotalSize(maps);
+      keys = Tensor(key_dtype(), TensorShape({size}));
+      values = Tensor(value_dtype(), TensorShape({size}));
+      ExportKeysAndValues(maps, &keys, &values);
+    });
 
     // We set use_node_name_sharing with a unique node name so that the resource
     // can outlive the MutableHashTableV2 kernel. This means that the lifetime
@@ -176,7 +390,8 @@ class MutableHashTableOfScalars final : public LookupInterface {
             .WithName(UniqueNodeName("MutableHashTableFromGraphDef"))
             .WithAttr("use_node_name_sharing", true)
             .WithAttr("key_dtype", key_dtype())
-            .WithAttr("value_dtype", value_dtype()));
+            .WithAttr("value_dtype", value_dtype())
+            .WithAttr("num_shards", table_.num_shards()));
     Node* keys_node = ops::SourceOp(
         "Const",
         builder->opts().WithAttr("dtype", key_dtype()).WithAttr("value", keys));
@@ -195,21 +410,26 @@ class MutableHashTableOfScalars final : public LookupInterface {
   }
 
  private:
-  // Writes all keys and values into `keys` and `values`. `keys` and `values`
-  // must point to tensors of size `table_.size()`.
-  void ExportKeysAndValues(Tensor* keys, Tensor* values) const
-      TF_SHARED_LOCKS_REQUIRED(mu_) {
+  typedef ShardedHashMap<K, V> ShardedMap;
+  typedef typename ShardedMap::Map Map;
+  typedef typename ShardedMap::MapList MapList;
+
+  // Writes all keys and values in `maps` into `keys` and `values`. `keys` and
+  // `values` must point to tensors of size `ShardedMap::TotalSize(maps)`.
+  void ExportKeysAndValues(const MapList& maps, Tensor* keys,
+                           Tensor* values) const {
     auto keys_data = keys->flat<K>();
     auto values_data = values->flat<V>();
     int64_t i = 0;
-    for (auto it = table_.begin(); it != table_.end(); ++it, ++i) {
-      keys_data(i) = it->first;
-      values_data(i) = it->second;
+    for (const Map* map : maps) {
+      for (auto it = map->begin(); it != map->end(); ++it, ++i) {
+        keys_data(i) = it->first;
+        values_data(i) = it->second;
+      }
     }
   }
 
-  mutable mutex mu_;
-  std::unordered_map<K, V> table_ TF_GUARDED_BY(mu_);
+  ShardedMap table_;
 };
 
 // Lookup table that wraps an unordered_map. Behaves identical to
@@ -217,7 +437,8 @@ class MutableHashTableOfScalars final : public LookupInterface {
 template <class K, class V>
 class MutableHashTableOfTensors final : public LookupInterface {
  public:
-  MutableHashTableOfTensors(OpKernelContext* ctx, OpKernel* kernel) {
+  MutableHashTableOfTensors(OpKernelContext* ctx, OpKernel* kernel)
+      : table_(NumShardsAttr(kernel)) {
     OP_REQUIRES_OK(ctx,
                    GetNodeAttr(kernel->def(), "value_shape", &value_shape_));
     OP_REQUIRES(
@@ -226,10 +447,7 @@ class MutableHashTableOfTensors final : public LookupInterface {
                                 value_shape_.DebugString()));
   }
 
-  size_t size() const override {
-    tf_shared_lock l(mu_);
-    return table_.size();
-  }
+  size_t size() const override { return table_.size(); }
 
   Status Find(OpKernelContext* ctx, const Tensor& key, Tensor* value,
               const Tensor& default_value) override {
@@ -242,27 +460,31 @@ class MutableHashTableOfTensors final : public LookupInterface {
     int64_t default_total = default_flat.size();
     bool is_full_size_default = (total == default_total);
 
-    tf_shared_lock l(mu_);
-    for (int64_t i = 0; i < key_values.size(); ++i) {
-      ValueArray* value_vec =
-          gtl::FindOrNull(table_, SubtleMustCopyIfIntegral(key_values(i)));
-      if (value_vec != nullptr) {
-        for (int64_t j = 0; j < value_dim; j++) {
-          value_values(i, j) = value_vec->at(j);
-        }
-      } else {
-        // is_full_size_default is true:
-        //   Each key has an independent default value, key_values(i)
-        //   corresponding uses default_flat(i) as its default value.
-        //
-        // is_full_size_default is false:
-        //   All keys will share the default_flat(0) as default value.
-        for (int64_t j = 0; j < value_dim; j++) {
-          value_values(i, j) =
-              is_full_size_default ? default_flat(i, j) : default_flat(0, j);
+    auto find_range = [&](int64_t begin, int64_t end) {
+      table_.VisitShared(key_values, begin, end, [&](const Map& map,
+                                                     int64_t i) {
+        const ValueArray* value_vec =
+            gtl::FindOrNull(map, SubtleMustCopyIfIntegral(key_values(i)));
+        if (value_vec != nullptr) {
+          for (int64_t j = 0; j < value_dim; j++) {
+            value_values(i, j) = value_vec->at(j);
+          }
+        } else {
+          // is_full_size_default is true:
+          //   Each key has an independent default value, key_values(i)
+          //   corresponding uses default_flat(i) as its default value.
+          //
+          // is_full_size_default is false:
+          //   All keys will share the default_flat(0) as default value.
+          for (int64_t j = 0; j < value_dim; j++) {
+            value_values(i, j) =
+                is_full_size_default ? default_flat(i, j) : default_flat(0, j);
+          }
         }
-      }
-    }
+      });
+    };
+    FindInParallel(ctx, table_.num_shards(), key_values.size(),
+                   kShardedFindCostPerKey + value_dim, find_range);
 
     return OkStatus();
   }
@@ -272,19 +494,15 @@ class MutableHashTableOfTensors final : public LookupInterface {
     const auto value_values = values.flat_inner_dims<V, 2>();
     int64_t value_dim = value_shape_.dim_size(0);
 
-    mutex_lock l(mu_);
-    if (clear) {
-      table_.clear();
-    }
-    for (int64_t i = 0; i < key_values.size(); ++i) {
+    table_.VisitExclusive(key_values, clear, [&](Map& map, int64_t i) {
       ValueArray value_vec;
       for (int64_t j = 0; j < value_dim; j++) {
         V value = value_values(i, j);
         value_vec.push_back(value);
       }
-      gtl::InsertOrUpdate(&table_, SubtleMustCopyIfIntegral(key_values(i)),
+      gtl::InsertOrUpdate(&map, SubtleMustCopyIfIntegral(key_values(i)),
                           value_vec);
-    }
+    });
     return OkStatus();
   }
 
@@ -296,10 +514,10 @@ class MutableHashTableOfTensors final : public LookupInterface {
   Status Remove(OpKernelContext* ctx, const Tensor& keys) override {
     const auto key_values = keys.flat<K>();
 
-    mutex_lock l(mu_);
-    for (int64_t i = 0; i < key_values.size(); ++i) {
-      table_.erase(SubtleMustCopyIfIntegral(key_values(i)));
-    }
+    table_.VisitExclusive(key_values, /*clear=*/false,
+                          [&](Map& map, int64_t i) {
+                            map.erase(SubtleMustCopyIfIntegral(key_values(i)));
+                          });
     return OkStatus();
   }
 
@@ -309,18 +527,19 @@ class MutableHashTableOfTensors final : public LookupInterface {
   }
 
   Status ExportValues(OpKernelContext* ctx) override {
-    tf_shared_lock l(mu_);
-    int64_t size = table_.size();
-    int64_t value_dim = value_shape_.dim_size(0);
-
-    Tensor* keys;
-    Tensor* values;
-    TF_RETURN_IF_ERROR(
-        ctx->allocate_output("keys", TensorShape({size}), &keys));
-    TF_RETURN_IF_ERROR(ctx->allocate_output(
-        "values", TensorShape({size, value_dim}), &values));
-    ExportKeysAndValues(keys, values);
-    return OkStatus();
+    return table_.VisitAllShared([&](const MapList& maps) -> Status {
+      int64_t size = ShardedMap::TotalSize(maps);
+      int64_t value_dim = value_shape_.dim_size(0);
+
+      Tensor* keys;
+      Tensor* values;
+      TF_RETURN_IF_ERROR(
+          ctx->allocate_output("keys", TensorShape({size}), &keys));
+      TF_RETURN_IF_ERROR(ctx->allocate_output(
+          "values", TensorShape({size, value_dim}), &values));
+      ExportKeysAndValues(maps, keys, values);
+      return OkStatus();
+    });
   }
 
   DataType key_dtype() const override { return DataTypeToEnum<K>::v(); }
@@ -332,25 +551,33 @@ class MutableHashTableOfTensors final : public LookupInterface {
   TensorShape value_shape() const override { return value_shape_; }
 
   int64_t MemoryUsed() const override {
-    int64_t ret = 0;
-    tf_shared_lock l(mu_);
-    for (unsigned i = 0; i < table_.bucket_count(); ++i) {
-      size_t bucket_size = table_.bucket_size(i);
-      if (bucket_size == 0) {
-        ret++;
-      } else {
-        ret += bucket_size;
+    int64_t ret = table_.VisitAllShared([](const MapList& maps) {
+      int64_t num_slots = 0;
+      for (const Map* map : maps) {
+        for (unsigned i = 0; i < map->bucket_count(); ++i) {
+          size_t bucket_size = map->bucket_size(i);
+          if (bucket_size == 0) {
+            num_slots++;
+          } else {
+            num_slots += bucket_size;
+          }
+        }
       }
-    }
+      return num_slots;
+    });
     return sizeof(MutableHashTableOfTensors) + ret;
   }
 
   Status AsGraphDef(GraphDefBuilder* builder, Node** out) const override {
-    tf_shared_lock l(mu_);
-    int64_t size = table_.size();
-    Tensor keys(key_dtype(), TensorShape({size}));
-    Tensor values(value_dtype(), TensorShape({size, value_shape_.dim_size(0)}));
-    ExportKeysAndValues(&keys, &values);
+    Tensor keys;
+    Tensor values;
+    table_.VisitAllShared([&](const MapList& maps) {
+      int64_t size = ShardedMap::TotalSize(maps);
+      keys = Tensor(key_dtype(), TensorShape({size}));
+      values = Tensor(value_dtype(),
+                      TensorShape({size, value_shape_.dim_size(0)}));
+      ExportKeysAndValues(maps, &keys, &values);
+    });
 
     // We set use_node_name_sharing with a unique node name so that the resource
     // can outlive the MutableHashTableOfTensorsV2 kernel. This means that the
@@ -365,7 +592,8 @@ class MutableHashTableOfTensors final : public LookupInterface {
                           .WithAttr("use_node_name_sharing", true)
                           .WithAttr("key_dtype", key_dtype())
                           .WithAttr("value_dtype", value_dtype())
-                          .WithAttr("value_shape", value_shape_));
+                          .WithAttr("value_shape", value_shape_)
+                          .WithAttr("num_shards", table_.num_shards()));
     Node* keys_node = ops::SourceOp(
         "Const",
         builder->opts().WithAttr("dtype", key_dtype()).WithAttr("value", keys));
@@ -384,28 +612,33 @@ class MutableHashTableOfTensors final : public LookupInterface {
   }
 
  private:
-  // Writes all keys and values into `keys` and `values`. `keys` and `values`
-  // must point to tensors of size `table_.size()`.
-  void ExportKeysAndValues(Tensor* keys, Tensor* values) const
-      TF_SHARED_LOCKS_REQUIRED(mu_) {
+  typedef gtl::InlinedVector<V, 4> ValueArray;
+  typedef ShardedHashMap<K, ValueArray> ShardedMap;
+  typedef typename ShardedMap::Map Map;
+  typedef typename ShardedMap::MapList MapList;
+
+  // Writes all keys and values in `maps` into `keys` and `values`. `keys` and
+  // `values` must point to tensors of size `ShardedMap::TotalSize(maps)`.
+  void ExportKeysAndValues(const MapList& maps, Tensor* keys,
+                           Tensor* values) const {
     int64_t value_dim = value_shape_.dim_size(0);
     auto keys_data = keys->flat<K>();
     auto values_data = values->matrix<V>();
     int64_t i = 0;
-    for (auto it = table_.begin(); it != table_.end(); ++it, ++i) {
-      K key = it->first;
-      ValueArray value = it->second;
-      keys_data(i) = key;
-      for (int64_t j = 0; j < value_dim; j++) {
-        values_data(i, j) = value[j];
+    for (const Map* map : maps) {
+      for (auto it = map->begin(); it != map->end(); ++it, ++i) {
+        K key = it->first;
+        ValueArray value = it->second;
+        keys_data(i) = key;
+        for (int64_t j = 0; j < value_dim; j++) {
+          values_data(i, j) = value[j];
+        }
       }
     }
   }
 
   TensorShape value_shape_;
-  mutable mutex mu_;
-  typedef gtl::InlinedVector<V, 4> ValueArray;
-  std::unordered_map<K, ValueArray> table_ TF_GUARDED_BY(mu_);
+  ShardedMap table_;
 };
 
 namespace {
@@ -425,6 +658,91 @@ TensorShape MaybeVectorizeShape(const TensorShape& shape) {
   return shape;
 }
 
+// Number of keys that the batched lookup of MutableDenseHashTable hashes and
+// prefetches before probing any of them. This lets the cache misses of
+// independent lookups overlap, while keeping the prefetched lines in L1.
+constexpr int64_t kDenseProbeBlockSize = 16;
+
+// The batched lookup first checks the initial kProbeGroupSize buckets of the
+// quadratic probe sequence together. kProbeGroupOffsets holds their offsets
+// from the home bucket of the key.
+constexpr int kProbeGroupSize = 4;
+constexpr int64_t kProbeGroupOffsets[kProbeGroupSize] = {0, 1, 3, 6};
+
+// Results of ProbeGroup() that are not bucket indices.
+constexpr int64_t kProbeGroupEmpty = -1;
+constexpr int64_t kProbeGroupContinue = -2;
+
+// Given bitmasks of the group slots that hold the key and the empty key,
+// returns the bucket holding the key, kProbeGroupEmpty if an empty bucket comes
+// first in the probe sequence, or kProbeGroupContinue if neither was found.
+inline int64_t ResolveProbeGroup(int key_mask, int empty_mask, int64_t home,
+                                 int64_t bit_mask) {
+  for (int g = 0; g < kProbeGroupSize; ++g) {
+    if (key_mask & (1 << g)) {
+      return (home + kProbeGroupOffsets[g]) & bit_mask;
+    }
+    if (empty_mask & (1 << g)) {
+      return kProbeGroupEmpty;
+    }
+  }
+  return kProbeGroupContinue;
+}
+
+// Checks the first kProbeGroupSize buckets of the probe sequence of `key`,
+// whose home bucket is `home`. See ResolveProbeGroup() for the result.
+template <typename K>
+inline int64_t ProbeGroup(const K* bucket_keys, int64_t home, int64_t bit_mask,
+                          K key, K empty_key) {
+  for (int g = 0; g < kProbeGroupSize; ++g) {
+    const int64_t bucket_index = (home + kProbeGroupOffsets[g]) & bit_mask;
+    if (bucket_keys[bucket_index] == key) {
+      return bucket_index;
+    }
+    if (bucket_keys[bucket_index] == empty_key) {
+      return kProbeGroupEmpty;
+    }
+  }
+  return kProbeGroupContinue;
+}
+
+#ifdef __AVX2__
+inline __m256i ProbeGroupIndices(int64_t home, int64_t bit_mask) {
+  return _mm256_and_si256(
+      _mm256_add_epi64(_mm256_set1_epi64x(home),
+                       _mm256_setr_epi64x(
+                           kProbeGroupOffsets[0], kProbeGroupOffsets[1],
+                           kProbeGroupOffsets[2], kProbeGroupOffsets[3])),
+      _mm256_set1_epi64x(bit_mask));
+}
+
+template <>
+inline int64_t ProbeGroup<int64_t>(const int64_t* bucket_keys, int64_t home,
+                                   int64_t bit_mask, int64_t key,
+                                   int64_t empty_key) {
+  const __m256i slots = _mm256_i64gather_epi64(
+      reinterpret_cast<const long long*>(bucket_keys),  // NOLINT
+      ProbeGroupIndices(home, bit_mask), sizeof(int64_t));
+  const int key_mask = _mm256_movemask_pd(_mm256_castsi256_pd(
+      _mm256_cmpeq_epi64(slots, _mm256_set1_epi64x(key))));
+  const int empty_mask = _mm256_movemask_pd(_mm256_castsi256_pd(
+      _mm256_cmpeq_epi64(slots, _mm256_set1_epi64x(empty_key))));
+  return ResolveProbeGroup(key_mask, empty_mask, home, bit_mask);
+}
+
+template <>
+inline int64_t ProbeGroup<int32>(const int32* bucket_keys, int64_t home,
+                                 int64_t bit_mask, int32 key, int32 empty_key) {
+  const __m128i slots = _mm256_i64gather_epi32(
+      bucket_keys, ProbeGroupIndices(home, bit_mask), sizeof(int32));
+  const int key_mask = _mm_movemask_ps(
+      _mm_castsi128_ps(_mm_cmpeq_epi32(slots, _mm_set1_epi32(key))));
+  const int empty_mask = _mm_movemask_ps(
+      _mm_castsi128_ps(_mm_cmpeq_epi32(slots, _mm_set1_epi32(empty_key))));
+  return ResolveProbeGroup(key_mask, empty_mask, home, bit_mask);
+}
+#endif  // __AVX2__
+
 }  // namespace
 
 // Modeled after densehashtable in https://github.com/sparsehash/sparsehash
@@ -513,6 +831,11 @@ class MutableDenseHashTable final : public LookupInterface {
     const auto default_flat = default_value.flat<V>();
 
     tf_shared_lock l(mu_);
+    if constexpr (std::is_integral<K>::value) {
+      if (key_size == 1) {
+        return FindScalarKeys(key, value, default_value);
+      }
+    }
     const auto key_buckets_matrix = key_buckets_.template matrix<K>();
     const auto value_buckets_matrix = value_buckets_.template matrix<V>();
     const auto empty_key_matrix =
@@ -673,6 +996,103 @@ class MutableDenseHashTable final : public LookupInterface {
   }
 
  private:
+  // Lookup path for tables with scalar integral keys, the common case for id
+  // to embedding tables. Keys are processed in blocks of kDenseProbeBlockSize:
+  // the home buckets of a whole block are computed and prefetched before any
+  // of them is probed, and the first buckets of each probe sequence are
+  // compared together (with AVX2 gathers when available). Follows the same
+  // probe sequence as Find(), so results are identical.
+  Status FindScalarKeys(const Tensor& key, Tensor* value,
+                        const Tensor& default_value)
+      TF_SHARED_LOCKS_REQUIRED(mu_) {
+    const int64_t num_elements = key.NumElements();
+    const int64_t value_size = value_shape_.num_elements();
+    const K* keys = key.flat<K>().data();
+    auto value_matrix = value->shaped<V, 2>({num_elements, value_size});
+    const auto default_flat = default_value.flat<V>();
+
+    const K* bucket_keys = key_buckets_.template flat<K>().data();
+    const V* bucket_values = value_buckets_.template flat<V>().data();
+    const auto value_buckets_matrix = value_buckets_.template matrix<V>();
+    const K empty_key = empty_key_.template flat<K>()(0);
+    const K deleted_key = deleted_key_.template flat<K>()(0);
+    const int64_t bit_mask = num_buckets_ - 1;
+
+    K block_keys[kDenseProbeBlockSize];
+    int64_t block_homes[kDenseProbeBlockSize];
+    for (int64_t block_start = 0; block_start < num_elements;
+         block_start += kDenseProbeBlockSize) {
+      const int64_t block_size =
+          std::min(kDenseProbeBlockSize, num_elements - block_start);
+      for (int64_t b = 0; b < block_size; ++b) {
+        const K k = SubtleMustCopyIfIntegral(keys[block_start + b]);
+        if (k == empty_key) {
+          return errors::InvalidArgument(
+              "Using the empty_key as a table key is not allowed");
+        }
+        if (k == deleted_key) {
+          return errors::InvalidArgument(
+              "Using the deleted_key as a table key is not allowed");
+        }
+        const int64_t home = HashScalar(k) & bit_mask;
+        block_keys[b] = k;
+        block_homes[b] = home;
+        port::prefetch<port::PREFETCH_HINT_T0>(
+            reinterpret_cast<const char*>(bucket_keys + home));
+        port::prefetch<port::PREFETCH_HINT_T0>(
+            reinterpret_cast<const char*>(bucket_values + home * value_size));
+      }
+      for (int64_t b = 0; b < block_size; ++b) {
+        const int64_t i = block_start + b;
+        int64_t bucket_index = ProbeGroup(bucket_keys, block_homes[b], bit_mask,
+                                          block_keys[b], empty_key);
+        if (bucket_index == kProbeGroupContinue) {
+          TF_RETURN_IF_ERROR(ProbeScalarKey(bucket_keys, block_homes[b],
+                                            block_keys[b], empty_key,
+                                            &bucket_index));
+        }
+        if (bucket_index >= 0) {
+          for (int64_t j = 0; j < value_size; ++j) {
+            value_matrix(i, j) =
+                SubtleMustCopyIfIntegral(value_buckets_matrix(bucket_index, j));
+          }
+        } else {
+          for (int64_t j = 0; j < value_size; ++j) {
+            value_matrix(i, j) = SubtleMustCopyIfIntegral(default_flat(j));
+          }
+        }
+      }
+    }
+    return OkStatus();
+  }
+
+  // Continues the probe sequence of a scalar `key` with home bucket `home`
+  // after the first kProbeGroupSize buckets. Sets `*bucket_index` to the bucket
+  // holding `key`, or to kProbeGroupEmpty if an empty bucket is reached first.
+  Status ProbeScalarKey(const K* bucket_keys, int64_t home, K key, K empty_key,
+                        int64_t* bucket_index) const
+      TF_SHARED_LOCKS_REQUIRED(mu_) {
+    const int64_t bit_mask = num_buckets_ - 1;
+    int64_t num_probes = kProbeGroupSize - 1;
+    int64_t index = (home + kProbeGroupOffsets[num_probes]) & bit_mask;
+    while (true) {
+      ++num_probes;
+      index = (index + num_probes) & bit_mask;  // quadratic probing
+      if (num_probes >= num_buckets_) {
+        return errors::Internal(
+            "Internal error in MutableDenseHashTable lookup");
+      }
+      if (bucket_keys[index] == key) {
+        *bucket_index = index;
+        return OkStatus();
+      }
+      if (bucket_keys[index] == empty_key) {
+        *bucket_index = kProbeGroupEmpty;
+        return OkStatus();
+      }
+    }
+  }
+
   Status DoInsert(OpKernelContext* ctx, const Tensor& key, const Tensor& value,
                   bool ignore_empty_and_deleted_key)
       TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
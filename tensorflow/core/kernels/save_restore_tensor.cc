@@ -250,6 +250,9 @@ namespace {
 // Tensors larger than this threshold will be restored from a thread-pool.
 const int64_t kLargeShapeThreshold = 16 << 20;  // 16M
 
+// Number of threads that restore tensors concurrently.
+const int kRestoreThreads = 8;
+
 // A restore operation for a single tensor.  Small tensors may be restored
 // directly from the op thread to improve read locality.  Large tensors can be
 // restored from a thread pool: this requires creating a separate BundleReader
@@ -402,10 +405,23 @@ Status RestoreTensorsV2(OpKernelContext* context, const Tensor& prefix,
     return errors::InvalidArgument(error_msg);
   }
 
+  // Full tensors are read in bulk, in parallel and in file order. Slices are
+  // restored one at a time.
+  std::vector<string> bulk_keys;
+  std::vector<Tensor*> bulk_tensors;
   std::vector<RestoreOp*> pool_restore_ops;
   std::vector<RestoreOp*> direct_restore_ops;
   for (RestoreOp& restore_op : restore_ops) {
-    if (restore_op.should_run_in_pool(&default_reader)) {
+    if (restore_op.shape_and_slice.empty()) {
+      TensorShape restored_full_shape;
+      TF_RETURN_IF_ERROR(default_reader.LookupTensorShape(
+          restore_op.tensor_name, &restored_full_shape));
+      Tensor* restored_tensor;
+      TF_RETURN_IF_ERROR(context->allocate_output(
+          restore_op.idx, restored_full_shape, &restored_tensor));
+      bulk_keys.push_back(restore_op.tensor_name);
+      bulk_tensors.push_back(restored_tensor);
+    } else if (restore_op.should_run_in_pool(&default_reader)) {
       pool_restore_ops.push_back(&restore_op);
     } else {
       direct_restore_ops.push_back(&restore_op);
@@ -418,12 +434,18 @@ Status RestoreTensorsV2(OpKernelContext* context, const Tensor& prefix,
     std::unique_ptr<thread::ThreadPool> reader_pool;
     if (!pool_restore_ops.empty()) {
       reader_pool.reset(
-          new thread::ThreadPool(Env::Default(), "restore_tensors", 8));
+          new thread::ThreadPool(Env::Default(), "restore_tensors",
+                                 kRestoreThreads));
       for (auto* op : pool_restore_ops) {
         reader_pool->Schedule([op]() { op->run_with_new_reader(); });
       }
     }
 
+    BundleReader::LookupManyOptions lookup_options;
+    lookup_options.num_threads = kRestoreThreads;
+    TF_RETURN_IF_ERROR(
+        default_reader.LookupMany(bulk_keys, bulk_tensors, lookup_options));
+
     // Read small tensors from the op thread
     for (auto* op : direct_restore_ops) {
       TF_RETURN_IF_ERROR(op->run(&default_reader));
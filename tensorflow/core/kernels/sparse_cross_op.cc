@@ -16,6 +16,7 @@ limitations under the License.
 // Contains OP to generate sparse crosses.
 #include <assert.h>
 
+#include <cstring>
 #include <limits>
 #include <string>
 #include <vector>
@@ -30,7 +31,7 @@ limitations under the License.
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/lib/core/stringpiece.h"
-#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/fingerprint.h"
 #include "tensorflow/core/platform/strong_hash.h"
@@ -282,6 +283,11 @@ class OutputUpdater {
 
   void Update(const int64_t batch_index, const int64_t cross_count,
               const OutType& cross) const {
+    *Output(batch_index, cross_count) = cross;
+  }
+
+  // Sets the indices of the cross and returns the value to write it to.
+  OutType* Output(const int64_t batch_index, const int64_t cross_count) const {
     const int64_t output_index =
         output_start_indices_[batch_index] + cross_count;
 
@@ -289,8 +295,7 @@ class OutputUpdater {
     indices_matrix(output_index, 0) = batch_index;
     indices_matrix(output_index, 1) = cross_count;
 
-    auto value_vec = values_out_->vec<OutType>();
-    value_vec(output_index) = cross;
+    return &values_out_->vec<OutType>()(output_index);
   }
 
  private:
@@ -299,6 +304,78 @@ class OutputUpdater {
   Tensor* values_out_;
 };
 
+// The features of all columns in one batch. Each feature is fetched (and so
+// hashed or converted to a string) once, rather than once per cross it is
+// part of.
+template <typename InternalType>
+class BatchFeatures {
+ public:
+  BatchFeatures(
+      const std::vector<std::unique_ptr<ColumnInterface<InternalType>>>&
+          columns,
+      int64_t batch_index, bool strong_hash) {
+    offsets_.reserve(columns.size() + 1);
+    offsets_.push_back(0);
+    for (const auto& column : columns) {
+      const int64_t feature_count = column->FeatureCount(batch_index);
+      for (int64_t n = 0; n < feature_count; ++n) {
+        features_.push_back(column->Feature(batch_index, n, strong_hash));
+      }
+      offsets_.push_back(features_.size());
+    }
+  }
+
+  int num_columns() const { return offsets_.size() - 1; }
+  int64_t FeatureCount(int column) const {
+    return offsets_[column + 1] - offsets_[column];
+  }
+  const InternalType& Feature(int column, int64_t n) const {
+    return features_[offsets_[column] + n];
+  }
+
+ private:
+  gtl::InlinedVector<InternalType, 16> features_;
+  gtl::InlinedVector<int64_t, 8> offsets_;
+};
+
+typedef gtl::InlinedVector<int64_t, 8> Permutation;
+
+// Calls `fn(permutation, first_changed)` for each permutation of one feature
+// per column, in lexicographic order (the last column varies fastest).
+// `first_changed` is the first column whose feature differs from the previous
+// permutation, so that `fn` can reuse the work done on the columns before it.
+template <typename InternalType, typename Fn>
+void ForEachPermutation(const BatchFeatures<InternalType>& features, Fn fn) {
+  const int num_columns = features.num_columns();
+  for (int i = 0; i < num_columns; ++i) {
+    // If one column is missing any feature, there won't be any cross.
+    if (features.FeatureCount(i) == 0) return;
+  }
+  Permutation permutation(num_columns, 0);
+  int first_changed = 0;
+  while (true) {
+    fn(permutation, first_changed);
+    int i = num_columns - 1;
+    for (; i >= 0; --i) {
+      if (++permutation[i] < features.FeatureCount(i)) break;
+      permutation[i] = 0;
+    }
+    if (i < 0) return;
+    first_changed = i;
+  }
+}
+
+// Returns the bucket of a hashed cross.
+inline int64_t HashedCrossBucket(uint64 hashed_output, int64_t num_buckets) {
+  // The return value is int64 based on the number of buckets.
+  if (num_buckets > 0) {
+    return hashed_output % num_buckets;
+  } else {
+    // To prevent negative output we take modulo to max int64.
+    return hashed_output % std::numeric_limits<int64_t>::max();
+  }
+}
+
 // Generates the sparse crosses as concatenation of strings.
 template <typename InternalType>
 class StringCrosser {
@@ -309,16 +386,33 @@ class StringCrosser {
                 const tstring k_feature_separator)
       : columns_(columns), k_feature_separator_(k_feature_separator) {}
 
-  string Generate(const int64_t batch_index,
-                  const std::vector<int>& permutation,
-                  bool unused_strong_hash) const {
-    gtl::InlinedVector<InternalType, 6> cross_vec(columns_.size());
-    for (int i = 0; i < permutation.size(); i++) {
-      cross_vec[i] = columns_[i]->Feature(batch_index, permutation[i], false);
-    }
-    // TODO(zakaria): this will copy the string twice, might effect
-    // performance.
-    return absl::StrJoin(cross_vec, k_feature_separator_);
+  // Writes the crosses of `batch_index` with `updater`. Each cross is written
+  // directly into its output string.
+  void GenerateBatch(const int64_t batch_index, bool unused_strong_hash,
+                     const OutputUpdater<tstring>& updater) const {
+    const BatchFeatures<InternalType> features(columns_, batch_index, false);
+    int64_t cross_count = 0;
+    ForEachPermutation(features, [&](const Permutation& permutation,
+                                     int unused_first_changed) {
+      size_t size = 0;
+      for (int i = 0; i < permutation.size(); ++i) {
+        if (i > 0) size += k_feature_separator_.size();
+        size += features.Feature(i, permutation[i]).size();
+      }
+      tstring* cross = updater.Output(batch_index, cross_count++);
+      cross->resize_uninitialized(size);
+      char* out = cross->mdata();
+      for (int i = 0; i < permutation.size(); ++i) {
+        if (i > 0) {
+          std::memcpy(out, k_feature_separator_.data(),
+                      k_feature_separator_.size());
+          out += k_feature_separator_.size();
+        }
+        const InternalType& feature = features.Feature(i, permutation[i]);
+        std::memcpy(out, feature.data(), feature.size());
+        out += feature.size();
+      }
+    });
   }
 
  private:
@@ -335,22 +429,24 @@ class HashCrosser {
       const tstring k_feature_separator_unused)
       : columns_(columns), num_buckets_(num_buckets), hash_key_(hash_key) {}
 
-  int64_t Generate(const int64_t batch_index,
-                   const std::vector<int>& permutation,
-                   bool unused_strong_hash) const {
-    // Do the fingerprint concatenation on uint64.
-    uint64 hashed_output = hash_key_;
-    for (size_t i = 0; i < permutation.size(); ++i) {
-      uint64 hash_i = columns_[i]->Feature(batch_index, permutation[i], false);
-      hashed_output = FingerprintCat64(hashed_output, hash_i);
-    }
-    // The return value is int64 based on the number of buckets.
-    if (num_buckets_ > 0) {
-      return hashed_output % num_buckets_;
-    } else {
-      // To prevent negative output we take modulo to max int64.
-      return hashed_output % std::numeric_limits<int64_t>::max();
-    }
+  // Writes the crosses of `batch_index` with `updater`.
+  void GenerateBatch(const int64_t batch_index, bool unused_strong_hash,
+                     const OutputUpdater<int64_t>& updater) const {
+    const BatchFeatures<int64_t> features(columns_, batch_index, false);
+    // Do the fingerprint concatenation on uint64. `prefix_hashes[i]` is the
+    // hash of the features of the first `i` columns of the permutation.
+    gtl::InlinedVector<uint64, 8> prefix_hashes(columns_.size() + 1);
+    prefix_hashes[0] = hash_key_;
+    int64_t cross_count = 0;
+    ForEachPermutation(features, [&](const Permutation& permutation,
+                                     int first_changed) {
+      for (int i = first_changed; i < permutation.size(); ++i) {
+        prefix_hashes[i + 1] = FingerprintCat64(
+            prefix_hashes[i], features.Feature(i, permutation[i]));
+      }
+      updater.Update(batch_index, cross_count++,
+                     HashedCrossBucket(prefix_hashes.back(), num_buckets_));
+    });
   }
 
  private:
@@ -368,24 +464,24 @@ class HashCrosserV2 {
       const tstring k_feature_separator_unused)
       : columns_(columns), num_buckets_(num_buckets) {}
 
-  int64_t Generate(const int64_t batch_index,
-                   const std::vector<int>& permutation,
-                   bool strong_hash) const {
-    // Do the fingerprint concatenation on uint64.
-    uint64 hashed_output =
-        columns_[0]->Feature(batch_index, permutation[0], strong_hash);
-    for (size_t i = 1; i < permutation.size(); ++i) {
-      uint64 hash_i =
-          columns_[i]->Feature(batch_index, permutation[i], strong_hash);
-      hashed_output = FingerprintCat64(hashed_output, hash_i);
-    }
-    // The return value is int64 based on the number of buckets.
-    if (num_buckets_ > 0) {
-      return hashed_output % num_buckets_;
-    } else {
-      // To prevent negative output we take modulo to max int64.
-      return hashed_output % std::numeric_limits<int64_t>::max();
-    }
+  // Writes the crosses of `batch_index` with `updater`.
+  void GenerateBatch(const int64_t batch_index, bool strong_hash,
+                     const OutputUpdater<int64_t>& updater) const {
+    const BatchFeatures<int64_t> features(columns_, batch_index, strong_hash);
+    // Do the fingerprint concatenation on uint64. `prefix_hashes[i]` is the
+    // hash of the features of the first `i + 1` columns of the permutation.
+    gtl::InlinedVector<uint64, 8> prefix_hashes(columns_.size());
+    int64_t cross_count = 0;
+    ForEachPermutation(features, [&](const Permutation& permutation,
+                                     int first_changed) {
+      for (int i = first_changed; i < permutation.size(); ++i) {
+        const uint64 hash_i = features.Feature(i, permutation[i]);
+        prefix_hashes[i] =
+            i == 0 ? hash_i : FingerprintCat64(prefix_hashes[i - 1], hash_i);
+      }
+      updater.Update(batch_index, cross_count++,
+                     HashedCrossBucket(prefix_hashes.back(), num_buckets_));
+    });
   }
 
  private:
@@ -393,55 +489,6 @@ class HashCrosserV2 {
   const int64_t num_buckets_;
 };
 
-// ProductIterator generates cartesian products based on indices.
-template <typename InternalType>
-class ProductIterator {
- public:
-  explicit ProductIterator(
-      const std::vector<std::unique_ptr<ColumnInterface<InternalType>>>&
-          columns,
-      int64_t batch_index)
-      : columns_(columns), batch_index_(batch_index) {
-    next_permutation_.resize(columns_.size(), 0);
-    // Sets has_next_ to false if any feature column has 0 features.
-    has_next_ = true;
-    for (int i = 0; i < columns_.size(); i++) {
-      if (columns_[i]->FeatureCount(batch_index_) == 0) {
-        has_next_ = false;
-        break;
-      }
-    }
-  }
-
-  std::vector<int> Next() {
-    std::vector<int> permutation(next_permutation_);
-
-    // Generates next permutation, if available.
-    bool carry = true;
-    for (int i = next_permutation_.size() - 1; i >= 0; i--) {
-      if (carry) {
-        next_permutation_[i] = next_permutation_[i] + 1;
-      }
-      if (next_permutation_[i] == columns_[i]->FeatureCount(batch_index_)) {
-        next_permutation_[i] = 0;
-      } else {
-        carry = false;
-        break;
-      }
-    }
-    has_next_ = !carry;
-    return permutation;
-  }
-
-  bool HasNext() { return has_next_; }
-
- private:
-  bool has_next_;
-  const std::vector<std::unique_ptr<ColumnInterface<InternalType>>>& columns_;
-  const int64_t batch_index_;
-  std::vector<int> next_permutation_;
-};
-
 template <bool HASHED_OUTPUT, typename InternalType>
 struct CrossTraits;
 
@@ -785,16 +832,9 @@ class SparseCrossOp : public OpKernel {
 
     typename CrossTraits<HASHED_OUTPUT, InternalType>::Updater updater(
         output_start_indices, indices_out, values_out);
-    auto do_work = [&columns, crosser, updater](int64_t begin, int64_t end) {
+    auto do_work = [&crosser, &updater](int64_t begin, int64_t end) {
       for (int b = begin; b < end; b++) {
-        ProductIterator<InternalType> product_iterator(columns, b);
-        int64_t cross_count = 0;
-        while (product_iterator.HasNext()) {
-          const auto permutation = product_iterator.Next();
-          updater.Update(b, cross_count,
-                         crosser.Generate(b, permutation, false));
-          cross_count++;
-        }
+        crosser.GenerateBatch(b, false, updater);
       }
     };
 
@@ -856,16 +896,9 @@ class SparseCrossV2Op : public OpKernel {
     StringCrosser<tstring> crosser(columns, 0, 0, separator);
     OutputUpdater<tstring> updater(output_start_indices, indices_out,
                                    values_out);
-    auto do_work = [&columns, crosser, updater](int64_t begin, int64_t end) {
+    auto do_work = [&crosser, &updater](int64_t begin, int64_t end) {
       for (int b = begin; b < end; b++) {
-        ProductIterator<tstring> product_iterator(columns, b);
-        int64_t cross_count = 0;
-        while (product_iterator.HasNext()) {
-          const auto permutation = product_iterator.Next();
-          updater.Update(b, cross_count,
-                         crosser.Generate(b, permutation, false));
-          cross_count++;
-        }
+        crosser.GenerateBatch(b, false, updater);
       }
     };
 
@@ -935,17 +968,10 @@ class SparseCrossHashedOp : public OpKernel {
     HashCrosserV2 crosser(columns, num_buckets, 0, unused_sep);
     OutputUpdater<int64_t> updater(output_start_indices, indices_out,
                                    values_out);
-    auto do_work = [&columns, crosser, updater, strong_hash](int64_t begin,
-                                                             int64_t end) {
+    auto do_work = [&crosser, &updater, strong_hash](int64_t begin,
+                                                     int64_t end) {
       for (int b = begin; b < end; b++) {
-        ProductIterator<int64_t> product_iterator(columns, b);
-        int64_t cross_count = 0;
-        while (product_iterator.HasNext()) {
-          const auto permutation = product_iterator.Next();
-          updater.Update(b, cross_count,
-                         crosser.Generate(b, permutation, strong_hash));
-          cross_count++;
-        }
+        crosser.GenerateBatch(b, strong_hash, updater);
       }
     };
 
@@ -0,0 +1,282 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_join.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/strong_hash.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+// The features of each row of each column, the columns with several features
+// per row exercising the crosses that share a prefix. Row 2 of `kStrings` is
+// empty, so that row has no crosses.
+const std::vector<std::vector<tstring>> kStrings = {
+    {"a", "b", "c"}, {"d"}, {}};
+const std::vector<std::vector<int64_t>> kInts = {{7, 8}, {9, 10}, {11}};
+const std::vector<std::vector<tstring>> kDenseStrings = {
+    {"x", "y"}, {"z", "w"}, {"u", "v"}};
+
+// Features of one row, by column.
+typedef std::vector<std::vector<uint64>> RowFeatures;
+
+template <typename T>
+struct SparseColumn {
+  std::vector<int64_t> indices;
+  std::vector<T> values;
+  std::vector<int64_t> shape;
+};
+
+template <typename T>
+SparseColumn<T> MakeSparseColumn(const std::vector<std::vector<T>>& rows) {
+  SparseColumn<T> column;
+  int64_t width = 0;
+  for (int64_t b = 0; b < rows.size(); ++b) {
+    for (int64_t n = 0; n < rows[b].size(); ++n) {
+      column.indices.push_back(b);
+      column.indices.push_back(n);
+      column.values.push_back(rows[b][n]);
+    }
+    width = std::max<int64_t>(width, rows[b].size());
+  }
+  column.shape = {static_cast<int64_t>(rows.size()), width};
+  return column;
+}
+
+std::vector<tstring> Flatten(const std::vector<std::vector<tstring>>& rows) {
+  std::vector<tstring> flat;
+  for (const auto& row : rows) flat.insert(flat.end(), row.begin(), row.end());
+  return flat;
+}
+
+// Hashes each cross of `features` from scratch, one FingerprintCat64 per
+// column, in the order the ops output them (the last column varies fastest).
+// The first column's feature seeds the hash if `hash_key` is null.
+std::vector<uint64> NaiveHashedCrosses(const RowFeatures& features,
+                                       const uint64* hash_key) {
+  std::vector<uint64> crosses;
+  if (hash_key != nullptr) {
+    crosses.push_back(*hash_key);
+  } else {
+    crosses = features[0];
+  }
+  for (int i = hash_key != nullptr ? 0 : 1; i < features.size(); ++i) {
+    std::vector<uint64> next;
+    for (uint64 prefix : crosses) {
+      for (uint64 feature : features[i]) {
+        next.push_back(FingerprintCat64(prefix, feature));
+      }
+    }
+    crosses = std::move(next);
+  }
+  return crosses;
+}
+
+class SparseCrossOpTest : public OpsTestBase {
+ protected:
+  // Adds `kStrings` and `sparse_ints` as sparse columns and `kDenseStrings`
+  // as a dense column.
+  template <typename T>
+  void AddColumns(const std::vector<std::vector<T>>& sparse_ints) {
+    const SparseColumn<tstring> strings = MakeSparseColumn(kStrings);
+    const SparseColumn<T> ints = MakeSparseColumn(sparse_ints);
+    AddInputFromArray<int64_t>(
+        TensorShape({static_cast<int64_t>(strings.values.size()), 2}),
+        strings.indices);
+    AddInputFromArray<int64_t>(
+        TensorShape({static_cast<int64_t>(ints.values.size()), 2}),
+        ints.indices);
+    AddInputFromArray<tstring>(
+        TensorShape({static_cast<int64_t>(strings.values.size())}),
+        strings.values);
+    AddInputFromArray<T>(
+        TensorShape({static_cast<int64_t>(ints.values.size())}), ints.values);
+    AddInputFromArray<int64_t>(TensorShape({2}), strings.shape);
+    AddInputFromArray<int64_t>(TensorShape({2}), ints.shape);
+    AddInputFromArray<tstring>(
+        TensorShape({static_cast<int64_t>(kDenseStrings.size()), 2}),
+        Flatten(kDenseStrings));
+  }
+
+  // Expects the outputs to hold `crosses`, by row.
+  template <typename T>
+  void ExpectCrosses(const std::vector<std::vector<T>>& crosses) {
+    std::vector<int64_t> indices;
+    std::vector<T> values;
+    int64_t width = 0;
+    for (int64_t b = 0; b < crosses.size(); ++b) {
+      for (int64_t n = 0; n < crosses[b].size(); ++n) {
+        indices.push_back(b);
+        indices.push_back(n);
+        values.push_back(crosses[b][n]);
+      }
+      width = std::max<int64_t>(width, crosses[b].size());
+    }
+    const int64_t num_crosses = values.size();
+    test::ExpectTensorEqual<int64_t>(
+        *GetOutput(0), test::AsTensor<int64_t>(indices, {num_crosses, 2}));
+    test::ExpectTensorEqual<T>(*GetOutput(1),
+                               test::AsTensor<T>(values, {num_crosses}));
+    test::ExpectTensorEqual<int64_t>(
+        *GetOutput(2),
+        test::AsTensor<int64_t>({static_cast<int64_t>(crosses.size()), width},
+                                {2}));
+  }
+};
+
+std::vector<uint64> Fingerprints(const std::vector<tstring>& strings) {
+  std::vector<uint64> fingerprints;
+  for (const tstring& s : strings) fingerprints.push_back(Fingerprint64(s));
+  return fingerprints;
+}
+
+std::vector<int64_t> Buckets(const std::vector<uint64>& hashes,
+                             int64_t num_buckets) {
+  std::vector<int64_t> buckets;
+  for (uint64 hash : hashes) {
+    buckets.push_back(num_buckets > 0
+                          ? hash % num_buckets
+                          : hash % std::numeric_limits<int64_t>::max());
+  }
+  return buckets;
+}
+
+TEST_F(SparseCrossOpTest, HashedMatchesNaiveCrosses) {
+  for (const int64_t num_buckets : {0, 1000}) {
+    const uint64 hash_key = 0xDECAFCAFFE;
+    TF_ASSERT_OK(NodeDefBuilder("sparse_cross", "SparseCross")
+                     .Input(FakeInput(2, DT_INT64))
+                     .Input(FakeInput(DataTypeVector{DT_STRING, DT_INT64}))
+                     .Input(FakeInput(2, DT_INT64))
+                     .Input(FakeInput(DataTypeVector{DT_STRING}))
+                     .Attr("hashed_output", true)
+                     .Attr("num_buckets", num_buckets)
+                     .Attr("hash_key", static_cast<int64_t>(hash_key))
+                     .Attr("out_type", DT_INT64)
+                     .Attr("internal_type", DT_INT64)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+    inputs_.clear();
+    AddColumns(kInts);
+    TF_ASSERT_OK(RunOpKernel());
+
+    std::vector<std::vector<int64_t>> expected;
+    for (int b = 0; b < kStrings.size(); ++b) {
+      // SparseCross hashes strings and takes int64s as they are.
+      const RowFeatures features = {
+          Fingerprints(kStrings[b]),
+          std::vector<uint64>(kInts[b].begin(), kInts[b].end()),
+          Fingerprints(kDenseStrings[b])};
+      expected.push_back(
+          Buckets(NaiveHashedCrosses(features, &hash_key), num_buckets));
+    }
+    ExpectCrosses(expected);
+  }
+}
+
+TEST_F(SparseCrossOpTest, HashedV2MatchesNaiveCrosses) {
+  const int64_t num_buckets = 1000;
+  const uint64 salt[2] = {13, 17};
+  std::vector<std::vector<tstring>> int_strings;
+  for (const auto& row : kInts) {
+    int_strings.emplace_back();
+    for (int64_t value : row) {
+      int_strings.back().push_back(std::to_string(value));
+    }
+  }
+  for (const bool strong_hash : {false, true}) {
+    TF_ASSERT_OK(NodeDefBuilder("sparse_cross_hashed", "SparseCrossHashed")
+                     .Input(FakeInput(2, DT_INT64))
+                     .Input(FakeInput(DataTypeVector{DT_STRING, DT_STRING}))
+                     .Input(FakeInput(2, DT_INT64))
+                     .Input(FakeInput(DataTypeVector{DT_STRING}))
+                     .Input(FakeInput(DT_INT64))
+                     .Input(FakeInput(DT_BOOL))
+                     .Input(FakeInput(DT_INT64))
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+    inputs_.clear();
+    AddColumns(int_strings);
+    AddInputFromArray<int64_t>(TensorShape({}), {num_buckets});
+    AddInputFromArray<bool>(TensorShape({}), {strong_hash});
+    AddInputFromArray<int64_t>(
+        TensorShape({2}),
+        {static_cast<int64_t>(salt[0]), static_cast<int64_t>(salt[1])});
+    TF_ASSERT_OK(RunOpKernel());
+
+    auto hash = [&](const std::vector<tstring>& strings) {
+      if (!strong_hash) return Fingerprints(strings);
+      std::vector<uint64> hashes;
+      for (const tstring& s : strings) {
+        hashes.push_back(StrongKeyedHash(salt, std::string(s)));
+      }
+      return hashes;
+    };
+    std::vector<std::vector<int64_t>> expected;
+    for (int b = 0; b < kStrings.size(); ++b) {
+      const RowFeatures features = {hash(kStrings[b]), hash(int_strings[b]),
+                                    hash(kDenseStrings[b])};
+      expected.push_back(Buckets(NaiveHashedCrosses(features, nullptr),
+                                 num_buckets));
+    }
+    ExpectCrosses(expected);
+  }
+}
+
+TEST_F(SparseCrossOpTest, StringCrosses) {
+  TF_ASSERT_OK(NodeDefBuilder("sparse_cross_v2", "SparseCrossV2")
+                   .Input(FakeInput(2, DT_INT64))
+                   .Input(FakeInput(DataTypeVector{DT_STRING, DT_INT64}))
+                   .Input(FakeInput(2, DT_INT64))
+                   .Input(FakeInput(DataTypeVector{DT_STRING}))
+                   .Input(FakeInput(DT_STRING))
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddColumns(kInts);
+  AddInputFromArray<tstring>(TensorShape({}), {"_X_"});
+  TF_ASSERT_OK(RunOpKernel());
+
+  std::vector<std::vector<tstring>> expected(kStrings.size());
+  for (int b = 0; b < kStrings.size(); ++b) {
+    for (const tstring& s : kStrings[b]) {
+      for (int64_t value : kInts[b]) {
+        for (const tstring& dense : kDenseStrings[b]) {
+          expected[b].push_back(absl::StrJoin(
+              {std::string(s), std::to_string(value), std::string(dense)},
+              "_X_"));
+        }
+      }
+    }
+  }
+  ExpectCrosses(expected);
+}
+
+}  // namespace
+}  // namespace tensorflow
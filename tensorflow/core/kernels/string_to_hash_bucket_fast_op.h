@@ -23,6 +23,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -43,19 +44,44 @@ class StringToHashBucketOp : public OpKernel {
                    context->allocate_output("output", input_tensor->shape(),
                                             &output_tensor));
     auto output_flat = output_tensor->flat<int64_t>();
+    const int64_t num_buckets = num_buckets_;
 
-    typedef decltype(input_flat.size()) Index;
-    for (Index i = 0; i < input_flat.size(); ++i) {
-      const uint64 input_hash = hash(input_flat(i));
-      const uint64 bucket_id = input_hash % num_buckets_;
-      // The number of buckets is always in the positive range of int64 so is
-      // the resulting bucket_id. Casting the bucket_id from uint64 to int64 is
-      // safe.
-      output_flat(i) = static_cast<int64_t>(bucket_id);
+    auto hash_range = [&input_flat, &output_flat, num_buckets](int64_t begin,
+                                                               int64_t end) {
+      for (int64_t i = begin; i < end; ++i) {
+        const uint64 input_hash = hash(input_flat(i));
+        const uint64 bucket_id = input_hash % num_buckets;
+        // The number of buckets is always in the positive range of int64 so
+        // is the resulting bucket_id. Casting the bucket_id from uint64 to
+        // int64 is safe.
+        output_flat(i) = static_cast<int64_t>(bucket_id);
+      }
+    };
+    // Large batches are hashed in parallel. The cost of hashing a string is
+    // estimated from the mean length of the strings.
+    const int64_t num_strings = input_flat.size();
+    if (num_strings < kMinParallelStrings) {
+      hash_range(0, num_strings);
+      return;
     }
+    int64_t total_length = 0;
+    for (int64_t i = 0; i < num_strings; ++i) {
+      total_length += input_flat(i).size();
+    }
+    const int64_t cost_per_string =
+        kCostPerString + kCostPerByte * (total_length / num_strings);
+    auto* worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, num_strings,
+          cost_per_string, hash_range);
   }
 
  private:
+  // Inputs with fewer strings are hashed on the calling thread.
+  static constexpr int64_t kMinParallelStrings = 4096;
+  // Estimated cycles to hash a string, per string and per byte.
+  static constexpr int64_t kCostPerString = 20;
+  static constexpr int64_t kCostPerByte = 1;
+
   int64_t num_buckets_;
 
   StringToHashBucketOp(const StringToHashBucketOp&) = delete;
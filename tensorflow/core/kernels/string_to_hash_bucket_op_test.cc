@@ -0,0 +1,81 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+class StringToHashBucketFastOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(int64_t num_buckets) {
+    TF_ASSERT_OK(NodeDefBuilder("string_to_hash_bucket_fast",
+                                "StringToHashBucketFast")
+                     .Input(FakeInput(DT_STRING))
+                     .Attr("num_buckets", num_buckets)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  // Runs the op on `strings` and expects it to hash them as a serial loop
+  // over Fingerprint64 does.
+  void ExpectSerialBuckets(const std::vector<tstring>& strings,
+                           int64_t num_buckets) {
+    AddInputFromArray<tstring>(
+        TensorShape({static_cast<int64_t>(strings.size())}), strings);
+    TF_ASSERT_OK(RunOpKernel());
+
+    std::vector<int64_t> expected;
+    expected.reserve(strings.size());
+    for (const tstring& s : strings) {
+      expected.push_back(Fingerprint64(s) % num_buckets);
+    }
+    test::ExpectTensorEqual<int64_t>(
+        *GetOutput(0),
+        test::AsTensor<int64_t>(expected,
+                                {static_cast<int64_t>(strings.size())}));
+  }
+};
+
+TEST_F(StringToHashBucketFastOpTest, Small) {
+  MakeOp(10);
+  ExpectSerialBuckets({"", "a", "hello", "world"}, 10);
+}
+
+TEST_F(StringToHashBucketFastOpTest, ShardedMatchesSerial) {
+  // Enough strings, of varied lengths, to be hashed in parallel.
+  std::vector<tstring> strings;
+  for (int i = 0; i < 10000; ++i) {
+    strings.push_back(std::string(i % 100, 'a' + i % 26) + std::to_string(i));
+  }
+  MakeOp(1 << 20);
+  ExpectSerialBuckets(strings, 1 << 20);
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -603,6 +603,8 @@ REGISTER_OP("ShuffleDataset")
     .Attr("output_types: list(type) >= 1")
     .Attr("output_shapes: list(shape) >= 1")
     .Attr("metadata: string = ''")
+    .Attr("compact_buffer: bool = false")
+    .Attr("block_size: int = 1")
     .SetTypeConstructor(full_type::VariadicTensorContainer(TFT_DATASET,
                                                            "output_types"))
     .SetShapeFn([](shape_inference::InferenceContext* c) {
@@ -643,6 +645,8 @@ REGISTER_OP("ShuffleDatasetV3")
     .Attr("output_types: list(type) >= 1")
     .Attr("output_shapes: list(shape) >= 1")
     .Attr("metadata: string = ''")
+    .Attr("compact_buffer: bool = false")
+    .Attr("block_size: int = 1")
     .SetTypeConstructor(full_type::VariadicTensorContainer(TFT_DATASET,
                                                            "output_types"))
     .SetShapeFn([](shape_inference::InferenceContext* c) {
@@ -855,6 +859,8 @@ REGISTER_OP("TFRecordDatasetV2")
     .Input("buffer_size: int64")
     .Input("byte_offsets: int64")
     .Attr("metadata: string = ''")
+    .Attr("num_parallel_files: int = 0")
+    .Attr("deterministic: string = 'default'")
     .Output("handle: variant")
     .SetDoNotOptimize()  // TODO(b/123753214): See comment in dataset_ops.cc.
     .SetTypeConstructor(full_type::UnaryTensorContainer(TFT_DATASET,
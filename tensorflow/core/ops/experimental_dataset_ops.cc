@@ -171,10 +171,35 @@ REGISTER_OP("ExperimentalChooseFastestDataset")
                                                            "output_types"))
     .SetShapeFn(shape_inference::ScalarShape);
 
+REGISTER_OP("ColumnarFileDataset")
+    .Input("filenames: string")
+    .Input("columns: string")
+    .Input("batch_size: int64")
+    .Input("drop_remainder: bool")
+    .Output("handle: variant")
+    .Attr("output_types: list(type) >= 1")
+    .Attr("output_shapes: list(shape) >= 1")
+    .SetDoNotOptimize()  // TODO(b/123753214): See comment in dataset_ops.cc.
+    .SetTypeConstructor(full_type::VariadicTensorContainer(TFT_DATASET,
+                                                           "output_types"))
+    .SetShapeFn([](shape_inference::InferenceContext* c) {
+      shape_inference::ShapeHandle unused;
+      // `filenames` must be a scalar or a vector.
+      TF_RETURN_IF_ERROR(c->WithRankAtMost(c->input(0), 1, &unused));
+      // `columns` must be a vector.
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &unused));
+      // `batch_size` and `drop_remainder` must be scalars.
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(3), 0, &unused));
+      return shape_inference::ScalarShape(c);
+    });
+
 REGISTER_OP("CompressElement")
     .Input("components: input_types")
     .Output("compressed: variant")
     .Attr("input_types: list(type) >= 1")
+    .Attr("codec: {'snappy', 'zstd'} = 'snappy'")
+    .Attr("level: int = 0")
     .SetShapeFn(shape_inference::ScalarShape);
 
 REGISTER_OP("UncompressElement")
@@ -334,6 +359,14 @@ REGISTER_OP("DatasetFromGraph")
     .SetForwardTypeFn(full_type::Decode(TFT_STRING, 0))
     .SetShapeFn(shape_inference::ScalarShape);
 
+REGISTER_OP("DatasetToColumnarFile")
+    .Input("input_dataset: variant")
+    .Input("filename: string")
+    .Input("column_names: string")
+    .Input("row_group_size: int64")
+    .SetIsStateful()
+    .SetShapeFn(shape_inference::NoOutputs);
+
 // TODO(b/124308596): Instead of conservatively marking this op as stateful,
 // implement a mechanism to determine whether `dataset` has a side-effect
 // and use it to decide whether to use a stateless or stateful version of this
@@ -411,6 +444,29 @@ REGISTER_OP("ExperimentalDirectedInterleaveDataset")
                                                            "output_types"))
     .SetShapeFn(shape_inference::ScalarShape);
 
+REGISTER_OP("ExternalShuffleDataset")
+    .Input("input_dataset: variant")
+    .Input("directory: string")
+    .Input("num_buckets: int64")
+    .Input("seed: int64")
+    .Input("seed2: int64")
+    .Output("handle: variant")
+    .Attr("compression: string = ''")
+    .Attr("reshuffle_each_iteration: bool = true")
+    .Attr("output_types: list(type) >= 1")
+    .Attr("output_shapes: list(shape) >= 1")
+    .SetTypeConstructor(full_type::VariadicTensorContainer(TFT_DATASET,
+                                                           "output_types"))
+    .SetShapeFn([](shape_inference::InferenceContext* c) {
+      shape_inference::ShapeHandle unused;
+      // directory, num_buckets, seed, and seed2 should be scalars.
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(3), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(4), 0, &unused));
+      return shape_inference::ScalarShape(c);
+    });
+
 REGISTER_OP("GroupByReducerDataset")
     .Input("input_dataset: variant")
     .Input("key_func_other_arguments: Tkey_func_other_arguments")
@@ -16,12 +16,15 @@ limitations under the License.
 
 #include <algorithm>
 #include <functional>
+#include <memory>
+#include <numeric>
 #include <optional>
 #include <utility>
 #include <vector>
 
 #include "absl/base/casts.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "tensorflow/core/example/example.pb.h"
 #include "tensorflow/core/example/feature.pb.h"
 #include "tensorflow/core/framework/allocator.h"
@@ -35,9 +38,10 @@ limitations under the License.
 #include "tensorflow/core/lib/monitoring/counter.h"
 #include "tensorflow/core/platform/blocking_counter.h"
 #include "tensorflow/core/platform/byte_order.h"
+#include "tensorflow/core/platform/hash.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/protobuf.h"
-#include "tensorflow/core/util/presized_cuckoo_map.h"
+#include "tensorflow/core/util/packed_wire_format.h"
 #include "tensorflow/core/util/sparse/sparse_tensor.h"
 
 namespace tensorflow {
@@ -113,6 +117,25 @@ uint8 PeekTag(protobuf::io::CodedInputStream* stream) {
   return *static_cast<const uint8*>(ptr);
 }
 
+// Reads the next `length` bytes of `stream` into `packed`, without copying
+// them.
+bool ReadPacked(protobuf::io::CodedInputStream* stream, uint32 length,
+                StringPiece* packed) {
+  DCHECK(stream != nullptr);
+  if (length == 0) {
+    *packed = StringPiece();
+    return true;
+  }
+  const void* ptr;
+  int size;
+  if (!stream->GetDirectBufferPointer(&ptr, &size) || size < 0 ||
+      static_cast<uint32>(size) < length) {
+    return false;
+  }
+  *packed = StringPiece(static_cast<const char*>(ptr), length);
+  return stream->Skip(length);
+}
+
 constexpr uint8 kVarintTag(uint32 tag) { return (tag << 3) | 0; }
 constexpr uint8 kDelimitedTag(uint32 tag) { return (tag << 3) | 2; }
 constexpr uint8 kFixed32Tag(uint32 tag) { return (tag << 3) | 5; }
@@ -303,15 +326,19 @@ class Feature {
         if (!stream.ExpectTag(kDelimitedTag(1))) return false;  // packed tag
         uint32 packed_length;
         if (!stream.ReadVarint32(&packed_length)) return false;
-        auto packed_limit = stream.PushLimit(packed_length);
-
-        while (!stream.ExpectAtEnd()) {
-          protobuf_uint64 n;  // There is no API for int64
-          if (!stream.ReadVarint64(&n)) return false;
-          int64_list->push_back(static_cast<int64_t>(n));
+        StringPiece packed;
+        if (!ReadPacked(&stream, packed_length, &packed)) return false;
+        const int64_t num_values = CountPackedVarints(packed);
+        if (num_values < 0) return false;
+
+        // As in ParseFloatList, a LimitedArraySlice may have less room than
+        // requested, in which case only the values that fit are decoded.
+        const size_t initial_size = int64_list->size();
+        int64_list->resize(initial_size + num_values);
+        if (!DecodePackedVarints(packed, int64_list->size() - initial_size,
+                                 int64_list->data() + initial_size)) {
+          return false;
         }
-
-        stream.PopLimit(packed_limit);
       } else {  // non-packed
         while (!stream.ExpectAtEnd()) {
           if (!stream.ExpectTag(kVarintTag(1))) return false;
@@ -518,6 +545,7 @@ bool TestFastParse(const string& serialized, Example* example) {
 namespace {
 
 using Config = FastParseExampleConfig;
+using Kind = CompiledFastParseExampleConfig::Kind;
 
 void ParallelFor(const std::function<void(size_t)>& f, size_t n,
                  thread::ThreadPool* thread_pool) {
@@ -558,11 +586,17 @@ struct SparseBuffer {
   std::vector<size_t> example_end_indices;
 };
 
-struct SeededHasher {
-  uint64 operator()(StringPiece s) const {
-    return Hash64(s.data(), s.size(), seed);
-  }
-  uint64 seed{0xDECAFCAFFE};
+// Index of the last example in which the feature of each sub-config was found.
+// It is reused across the examples of a minibatch.
+struct LastExampleIndices {
+  explicit LastExampleIndices(const Config& config)
+      : dense(config.dense.size(), -1),
+        sparse(config.sparse.size(), -1),
+        ragged(config.ragged.size(), -1) {}
+
+  std::vector<int64_t> dense;
+  std::vector<int64_t> sparse;
+  std::vector<int64_t> ragged;
 };
 
 void LogDenseFeatureDataLoss(StringPiece feature_name) {
@@ -589,24 +623,30 @@ void LogSparseFeatureDataLoss(StringPiece feature_name) {
 
 Status FastParseSerializedExample(
     const tstring& serialized_example, const tstring& example_name,
-    const size_t example_index, const Config& config,
-    const PresizedCuckooMap<std::pair<size_t, Type>>& config_index,
-    SeededHasher hasher, std::vector<Tensor>* output_dense,
+    const size_t example_index,
+    const CompiledFastParseExampleConfig& compiled_config,
+    LastExampleIndices* last_example_indices,
+    std::vector<Tensor>* output_dense,
     std::vector<SparseBuffer>* output_varlen_dense,
     std::vector<SparseBuffer>* output_sparse,
     std::vector<SparseBuffer>* output_ragged,
     PerExampleFeatureStats* output_stats) {
+  DCHECK(last_example_indices != nullptr);
   DCHECK(output_dense != nullptr);
   DCHECK(output_sparse != nullptr);
   DCHECK(output_ragged != nullptr);
+  const Config& config = compiled_config.config();
   parsed::Example parsed_example;
   if (!ParseExample(serialized_example, &parsed_example)) {
     return errors::InvalidArgument("Could not parse example input, value: '",
                                    serialized_example, "'");
   }
-  std::vector<int64_t> sparse_feature_last_example(config.sparse.size(), -1);
-  std::vector<int64_t> dense_feature_last_example(config.dense.size(), -1);
-  std::vector<int64_t> ragged_feature_last_example(config.ragged.size(), -1);
+  std::vector<int64_t>& sparse_feature_last_example =
+      last_example_indices->sparse;
+  std::vector<int64_t>& dense_feature_last_example =
+      last_example_indices->dense;
+  std::vector<int64_t>& ragged_feature_last_example =
+      last_example_indices->ragged;
 
   // Handle features present in the example.
   const size_t parsed_example_size = parsed_example.size();
@@ -627,23 +667,13 @@ Status FastParseSerializedExample(
     const StringPiece feature_name = name_and_feature.first;
     parsed::Feature& feature = name_and_feature.second;
 
-    std::pair<size_t, Type> d_and_type;
-    uint64 h = hasher(feature_name);
-    if (!config_index.Find(h, &d_and_type)) continue;
-
-    size_t d = d_and_type.first;
-    bool is_dense = d_and_type.second == Type::Dense;
-    bool is_ragged = d_and_type.second == Type::Ragged;
+    const CompiledFastParseExampleConfig::Feature* config_feature =
+        compiled_config.Find(feature_name);
+    if (config_feature == nullptr) continue;
 
-    {
-      // Testing for PresizedCuckooMap collision.
-      // TODO(lew): Use dense_hash_map and avoid this and hasher creation.
-      const tstring& config_feature_name =
-          is_dense ? config.dense[d].feature_name
-                   : (is_ragged ? config.ragged[d].feature_name
-                                : config.sparse[d].feature_name);
-      if (feature_name != config_feature_name) continue;
-    }
+    size_t d = config_feature->index;
+    bool is_dense = config_feature->kind == Kind::kDense;
+    bool is_ragged = config_feature->kind == Kind::kRagged;
 
     auto example_error = [&](StringPiece suffix) {
       return errors::InvalidArgument("Name: ", example_name,
@@ -1129,51 +1159,150 @@ void CopySparseBufferToTensor(DataType dtype, size_t offset, SparseBuffer* src,
   }
 }
 
+// Returns the bucket of the perfect hash table that `hash` falls into.
+inline uint32 BucketOf(uint64 hash, uint32 bucket_mask) {
+  return static_cast<uint32>(hash >> 32) & bucket_mask;
+}
+
+// Returns the slot of the perfect hash table that `hash` probes when its
+// bucket has the given displacement.
+inline uint32 SlotOf(uint64 hash, uint32 displacement, uint32 slot_mask) {
+  const uint32 start = static_cast<uint32>(hash);
+  const uint32 step = static_cast<uint32>(hash >> 32) | 1;
+  return (start + displacement * step) & slot_mask;
+}
+
 }  // namespace
 
+Status CompiledFastParseExampleConfig::Compile(
+    FastParseExampleConfig config,
+    std::unique_ptr<const CompiledFastParseExampleConfig>* compiled) {
+  // Check config so we can safely CHECK(false) in switches on config.*.dtype
+  TF_RETURN_IF_ERROR(CheckConfigDataTypes(config));
+  std::unique_ptr<CompiledFastParseExampleConfig> result(
+      new CompiledFastParseExampleConfig(std::move(config)));
+  TF_RETURN_IF_ERROR(result->BuildIndex());
+  *compiled = std::move(result);
+  return OkStatus();
+}
+
+// The table is built with the "hash and displace" scheme: feature names are
+// grouped into buckets, and the buckets, largest first, are given the smallest
+// displacement that moves all their names to free slots.
+Status CompiledFastParseExampleConfig::BuildIndex() {
+  for (size_t d = 0; d < config_.dense.size(); ++d) {
+    features_.push_back({config_.dense[d].feature_name, Kind::kDense, d});
+  }
+  for (size_t d = 0; d < config_.sparse.size(); ++d) {
+    features_.push_back({config_.sparse[d].feature_name, Kind::kSparse, d});
+  }
+  for (size_t d = 0; d < config_.ragged.size(); ++d) {
+    features_.push_back({config_.ragged[d].feature_name, Kind::kRagged, d});
+  }
+  absl::flat_hash_set<StringPiece> feature_names;
+  for (const Feature& feature : features_) {
+    if (!feature_names.insert(feature.name).second) {
+      return errors::InvalidArgument("Feature '", feature.name,
+                                     "' appears more than once in the config.");
+    }
+  }
+
+  // Keep the table at most half full, with two names per bucket on average.
+  uint32 num_slots = 4;
+  while (num_slots < 2 * features_.size()) num_slots *= 2;
+  const uint32 slot_mask = num_slots - 1;
+  const uint32 bucket_mask = num_slots / 4 - 1;
+  const uint32 num_buckets = bucket_mask + 1;
+
+  constexpr uint64 kInitialSeed = 0xDECAFCAFFE;
+  constexpr int kMaxSeeds = 100;
+  constexpr uint32 kMaxDisplacement = 1 << 16;
+  std::vector<uint64> hashes(features_.size());
+  std::vector<std::vector<int32>> buckets(num_buckets);
+  std::vector<uint32> bucket_order(num_buckets);
+  for (int i = 0; i < kMaxSeeds; ++i) {
+    seed_ = kInitialSeed + i;
+    for (auto& bucket : buckets) bucket.clear();
+    for (size_t f = 0; f < features_.size(); ++f) {
+      hashes[f] = Hash64(features_[f].name.data(), features_[f].name.size(),
+                         seed_);
+      buckets[BucketOf(hashes[f], bucket_mask)].push_back(f);
+    }
+    std::iota(bucket_order.begin(), bucket_order.end(), 0);
+    std::stable_sort(bucket_order.begin(), bucket_order.end(),
+                     [&buckets](uint32 a, uint32 b) {
+                       return buckets[a].size() > buckets[b].size();
+                     });
+
+    displacements_.assign(num_buckets, 0);
+    slots_.assign(num_slots, -1);
+    // Tries to move the names of `bucket` to free slots with `displacement`.
+    auto place = [&](const std::vector<int32>& bucket, uint32 displacement) {
+      for (size_t k = 0; k < bucket.size(); ++k) {
+        const uint32 slot = SlotOf(hashes[bucket[k]], displacement, slot_mask);
+        if (slots_[slot] >= 0) {
+          for (size_t j = 0; j < k; ++j) {
+            slots_[SlotOf(hashes[bucket[j]], displacement, slot_mask)] = -1;
+          }
+          return false;
+        }
+        slots_[slot] = bucket[k];
+      }
+      return true;
+    };
+    bool ok = true;
+    for (uint32 b : bucket_order) {
+      if (buckets[b].empty()) break;
+      uint32 displacement = 0;
+      while (displacement < kMaxDisplacement &&
+             !place(buckets[b], displacement)) {
+        ++displacement;
+      }
+      if (displacement == kMaxDisplacement) {
+        ok = false;
+        break;
+      }
+      displacements_[b] = displacement;
+    }
+    if (ok) return OkStatus();
+  }
+  return errors::Internal(
+      "Could not build a perfect hash table of the feature names. This should "
+      "not happen.");
+}
+
+const CompiledFastParseExampleConfig::Feature*
+CompiledFastParseExampleConfig::Find(StringPiece name) const {
+  const uint64 hash = Hash64(name.data(), name.size(), seed_);
+  const uint32 displacement =
+      displacements_[BucketOf(hash, displacements_.size() - 1)];
+  const int32 f = slots_[SlotOf(hash, displacement, slots_.size() - 1)];
+  if (f < 0 || features_[f].name != name) return nullptr;
+  return &features_[f];
+}
+
 Status FastParseExample(const Config& config,
                         gtl::ArraySlice<tstring> serialized,
                         gtl::ArraySlice<tstring> example_names,
                         thread::ThreadPool* thread_pool, Result* result) {
+  std::unique_ptr<const CompiledFastParseExampleConfig> compiled_config;
+  TF_RETURN_IF_ERROR(
+      CompiledFastParseExampleConfig::Compile(config, &compiled_config));
+  return FastParseExample(*compiled_config, serialized, example_names,
+                          thread_pool, result);
+}
+
+Status FastParseExample(const CompiledFastParseExampleConfig& compiled_config,
+                        gtl::ArraySlice<tstring> serialized,
+                        gtl::ArraySlice<tstring> example_names,
+                        thread::ThreadPool* thread_pool, Result* result) {
   DCHECK(result != nullptr);
-  // Check config so we can safely CHECK(false) in switches on config.*.dtype
-  TF_RETURN_IF_ERROR(CheckConfigDataTypes(config));
+  const Config& config = compiled_config.config();
 
   if (config.collect_feature_stats) {
     result->feature_stats.resize(serialized.size());
   }
 
-  size_t config_size =
-      config.dense.size() + config.sparse.size() + config.ragged.size();
-  SeededHasher hasher;
-  // Build config index.
-  PresizedCuckooMap<std::pair<size_t, Type>> config_index(config_size);
-  bool ok = true;
-  for (size_t i = 0; i < 1000; ++i) {
-    for (size_t d = 0; d < config.dense.size(); ++d) {
-      ok &= config_index.InsertUnique(hasher(config.dense[d].feature_name),
-                                      {d, Type::Dense});
-    }
-    for (size_t d = 0; d < config.sparse.size(); ++d) {
-      ok &= config_index.InsertUnique(hasher(config.sparse[d].feature_name),
-                                      {d, Type::Sparse});
-    }
-    for (size_t d = 0; d < config.ragged.size(); ++d) {
-      ok &= config_index.InsertUnique(hasher(config.ragged[d].feature_name),
-                                      {d, Type::Ragged});
-    }
-    if (ok) break;
-    LOG(WARNING) << "Collision found. This should happen only if you have "
-                    "around 2^32 entries in your config.";
-    hasher.seed++;
-    config_index.Clear(config_size);
-    ok = true;
-  }
-  if (!ok) {
-    return errors::Internal(
-        "Could not avoid collision. This should not happen.");
-  }
-
   // Allocate dense output for fixed length dense values
   // (variable-length dense and sparse and ragged have to be buffered).
   std::vector<Tensor> fixed_dense_values(config.dense.size());
@@ -1235,6 +1364,7 @@ Status FastParseExample(const Config& config,
     ragged_buffers[minibatch].resize(config.ragged.size());
     size_t start = first_example_of_minibatch(minibatch);
     size_t end = first_example_of_minibatch(minibatch + 1);
+    LastExampleIndices last_example_indices(config);
     for (size_t e = start; e < end; ++e) {
       PerExampleFeatureStats* stats = nullptr;
       if (config.collect_feature_stats) {
@@ -1242,8 +1372,8 @@ Status FastParseExample(const Config& config,
       }
       status_of_minibatch[minibatch] = FastParseSerializedExample(
           serialized[e],
-          (!example_names.empty() ? example_names[e] : "<unknown>"), e, config,
-          config_index, hasher, &fixed_dense_values,
+          (!example_names.empty() ? example_names[e] : "<unknown>"), e,
+          compiled_config, &last_example_indices, &fixed_dense_values,
           &varlen_dense_buffers[minibatch], &sparse_buffers[minibatch],
           &ragged_buffers[minibatch], stats);
       if (!status_of_minibatch[minibatch].ok()) break;
@@ -1447,9 +1577,17 @@ Status FastParseExample(const Config& config,
 
 Status FastParseSingleExample(const Config& config, StringPiece serialized,
                               Result* result) {
+  std::unique_ptr<const CompiledFastParseExampleConfig> compiled_config;
+  TF_RETURN_IF_ERROR(
+      CompiledFastParseExampleConfig::Compile(config, &compiled_config));
+  return FastParseSingleExample(*compiled_config, serialized, result);
+}
+
+Status FastParseSingleExample(
+    const CompiledFastParseExampleConfig& compiled_config,
+    StringPiece serialized, Result* result) {
   DCHECK(result != nullptr);
-  // Check config so we can safely CHECK(false) in switches on config.*.dtype
-  TF_RETURN_IF_ERROR(CheckConfigDataTypes(config));
+  const Config& config = compiled_config.config();
 
   PerExampleFeatureStats* stats = nullptr;
   if (config.collect_feature_stats) {
@@ -1457,38 +1595,6 @@ Status FastParseSingleExample(const Config& config, StringPiece serialized,
     stats = &result->feature_stats.back();
   }
 
-  // TODO(mrry): Cache the construction of this map at Op construction time.
-  size_t config_size =
-      config.dense.size() + config.sparse.size() + config.ragged.size();
-  SeededHasher hasher;
-  // Build config index.
-  PresizedCuckooMap<std::pair<size_t, Type>> config_index(config_size);
-  bool ok = true;
-  for (size_t i = 0; i < 1000; ++i) {
-    for (size_t d = 0; d < config.dense.size(); ++d) {
-      ok &= config_index.InsertUnique(hasher(config.dense[d].feature_name),
-                                      {d, Type::Dense});
-    }
-    for (size_t d = 0; d < config.sparse.size(); ++d) {
-      ok &= config_index.InsertUnique(hasher(config.sparse[d].feature_name),
-                                      {d, Type::Sparse});
-    }
-    for (size_t d = 0; d < config.ragged.size(); ++d) {
-      ok &= config_index.InsertUnique(hasher(config.ragged[d].feature_name),
-                                      {d, Type::Ragged});
-    }
-    if (ok) break;
-    LOG(WARNING) << "Collision found. This should happen only if you have "
-                    "around 2^32 entries in your config.";
-    hasher.seed++;
-    config_index.Clear(config_size);
-    ok = true;
-  }
-  if (!ok) {
-    return errors::Internal(
-        "Could not avoid collision. This should not happen.");
-  }
-
   result->sparse_indices.reserve(config.sparse.size());
   result->sparse_values.reserve(config.sparse.size());
   result->sparse_shapes.reserve(config.sparse.size());
@@ -1556,23 +1662,13 @@ Status FastParseSingleExample(const Config& config, StringPiece serialized,
     const StringPiece feature_name = name_and_feature.first;
     parsed::Feature& feature = name_and_feature.second;
 
-    std::pair<size_t, Type> d_and_type;
-    uint64 h = hasher(feature_name);
-    if (!config_index.Find(h, &d_and_type)) continue;
+    const CompiledFastParseExampleConfig::Feature* config_feature =
+        compiled_config.Find(feature_name);
+    if (config_feature == nullptr) continue;
 
-    size_t d = d_and_type.first;
-    bool is_dense = d_and_type.second == Type::Dense;
-    bool is_sparse = d_and_type.second == Type::Sparse;
-
-    {
-      // Testing for PresizedCuckooMap collision.
-      // TODO(lew): Use dense_hash_map and avoid this and hasher creation.
-      const tstring& config_feature_name =
-          is_dense ? config.dense[d].feature_name
-                   : (is_sparse ? config.sparse[d].feature_name
-                                : config.ragged[d].feature_name);
-      if (feature_name != config_feature_name) continue;
-    }
+    size_t d = config_feature->index;
+    bool is_dense = config_feature->kind == Kind::kDense;
+    bool is_sparse = config_feature->kind == Kind::kSparse;
 
     auto example_error = [feature_name](StringPiece suffix) {
       return errors::InvalidArgument("Key: ", feature_name, ".  ", suffix);
@@ -1920,22 +2016,17 @@ inline int ParseFloatFeature(protobuf::io::CodedInputStream* stream,
     uint8 peek_tag = PeekTag(stream);
     if (peek_tag == kDelimitedTag(1)) {  // packed
       uint32 packed_length;
+      StringPiece packed;
       if (!stream->ExpectTag(kDelimitedTag(1)) ||
-          !stream->ReadVarint32(&packed_length)) {
+          !stream->ReadVarint32(&packed_length) ||
+          packed_length % sizeof(float) != 0 ||
+          !ReadPacked(stream, packed_length, &packed)) {
         return -1;
       }
-      auto packed_limit = stream->PushLimit(packed_length);
-      while (!stream->ExpectAtEnd()) {
-        uint32 buffer32;
-        if (!stream->ReadLittleEndian32(&buffer32)) {
-          return -1;
-        }
-        if (out != nullptr) {
-          *out++ = absl::bit_cast<float>(buffer32);
-        }
-        num_elements++;
+      num_elements = packed_length / sizeof(float);
+      if (out != nullptr) {
+        DecodePackedFloats(packed.data(), num_elements, out);
       }
-      stream->PopLimit(packed_limit);
     } else if (peek_tag == kFixed32Tag(1)) {
       while (!stream->ExpectAtEnd()) {
         uint32 buffer32;
@@ -1971,22 +2062,19 @@ inline int ParseInt64Feature(protobuf::io::CodedInputStream* stream,
     uint8 peek_tag = PeekTag(stream);
     if (peek_tag == kDelimitedTag(1)) {  // packed
       uint32 packed_length;
+      StringPiece packed;
       if (!stream->ExpectTag(kDelimitedTag(1)) ||
-          !stream->ReadVarint32(&packed_length)) {
+          !stream->ReadVarint32(&packed_length) ||
+          !ReadPacked(stream, packed_length, &packed)) {
         return -1;
       }
-      auto packed_limit = stream->PushLimit(packed_length);
-      while (!stream->ExpectAtEnd()) {
-        protobuf_uint64 n;  // There is no API for int64
-        if (!stream->ReadVarint64(&n)) {
-          return -1;
-        }
-        if (out != nullptr) {
-          *out++ = n;
-        }
-        num_elements++;
+      num_elements = CountPackedVarints(packed);
+      if (num_elements < 0) {
+        return -1;
+      }
+      if (out != nullptr && !DecodePackedVarints(packed, num_elements, out)) {
+        return -1;
       }
-      stream->PopLimit(packed_limit);
     } else if (peek_tag == kVarintTag(1)) {
       while (!stream->ExpectAtEnd()) {
         protobuf_uint64 n;  // There is no API for int64
@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_UTIL_EXAMPLE_PROTO_FAST_PARSING_H_
 #define TENSORFLOW_CORE_UTIL_EXAMPLE_PROTO_FAST_PARSING_H_
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -130,6 +131,61 @@ struct Result {
   std::vector<PerExampleFeatureStats> feature_stats;
 };
 
+// A FastParseExampleConfig compiled for parsing: a perfect hash table maps the
+// name of each feature in an Example to its sub-config with a single probe,
+// and the kind and index of the sub-config are stored in the table.
+//
+// `FastParseExample(const FastParseExampleConfig&, ...)` compiles its config
+// on every call, which is costly for configs with hundreds of features. Ops
+// whose config does not change between calls should compile it once and use
+// the overloads below that take a compiled config.
+//
+// CompiledFastParseExampleConfig is immutable and thread-safe.
+class CompiledFastParseExampleConfig {
+ public:
+  enum class Kind : uint8 { kDense, kSparse, kRagged };
+
+  // A sub-config of `config()`.
+  struct Feature {
+    StringPiece name;
+    Kind kind = Kind::kDense;
+    // Index into `config().dense`, `config().sparse` or `config().ragged`,
+    // depending on `kind`.
+    size_t index = 0;
+  };
+
+  // Compiles `config`. Returns an error if `config` has an unsupported data
+  // type, or if two of its sub-configs have the same feature name.
+  static Status Compile(
+      FastParseExampleConfig config,
+      std::unique_ptr<const CompiledFastParseExampleConfig>* compiled);
+
+  const FastParseExampleConfig& config() const { return config_; }
+
+  // Returns the sub-config of the feature named `name`, or nullptr if there is
+  // none.
+  const Feature* Find(StringPiece name) const;
+
+ private:
+  explicit CompiledFastParseExampleConfig(FastParseExampleConfig config)
+      : config_(std::move(config)) {}
+  CompiledFastParseExampleConfig(const CompiledFastParseExampleConfig&) =
+      delete;
+  void operator=(const CompiledFastParseExampleConfig&) = delete;
+
+  // Builds the perfect hash table of the feature names of `config_`.
+  Status BuildIndex();
+
+  const FastParseExampleConfig config_;
+  // A feature name is hashed with `seed_` into a bucket and a probe sequence.
+  // The displacement of the bucket picks the slot in the probe sequence.
+  uint64 seed_ = 0;
+  std::vector<uint32> displacements_;
+  // Indices into `features_`, or -1 for empty slots.
+  std::vector<int32> slots_;
+  std::vector<Feature> features_;
+};
+
 // Parses a batch of serialized Example protos and converts them into result
 // according to given config.
 // Given example names have to either be empty or the same size as serialized.
@@ -138,12 +194,17 @@ Status FastParseExample(const FastParseExampleConfig& config,
                         gtl::ArraySlice<tstring> serialized,
                         gtl::ArraySlice<tstring> example_names,
                         thread::ThreadPool* thread_pool, Result* result);
+Status FastParseExample(const CompiledFastParseExampleConfig& config,
+                        gtl::ArraySlice<tstring> serialized,
+                        gtl::ArraySlice<tstring> example_names,
+                        thread::ThreadPool* thread_pool, Result* result);
 
-// TODO(mrry): Move the hash table construction into the config object.
 typedef FastParseExampleConfig FastParseSingleExampleConfig;
 
 Status FastParseSingleExample(const FastParseSingleExampleConfig& config,
                               StringPiece serialized, Result* result);
+Status FastParseSingleExample(const CompiledFastParseExampleConfig& config,
+                              StringPiece serialized, Result* result);
 
 // Parses a batch of serialized SequenceExample protos and converts them into
 // result according to given config.
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/util/example_proto_fast_parsing.h"
 
+#include <memory>
 #include <unordered_set>
 #include <utility>
 #include <vector>
@@ -22,6 +23,7 @@ limitations under the License.
 #include "tensorflow/core/example/example.pb.h"
 #include "tensorflow/core/example/feature.pb.h"
 #include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/platform/test.h"
@@ -255,6 +257,40 @@ static string ExampleWithSomeFeatures() {
 
 TEST(FastParse, SomeFeatures) { TestCorrectness(ExampleWithSomeFeatures()); }
 
+// Returns runs of one-byte varints interleaved with varints of every length
+// from 1 to 10 bytes.
+static std::vector<int64_t> Int64sOfAllVarintLengths() {
+  std::vector<int64_t> values;
+  for (int shift = 0; shift < 64; shift += 7) {
+    for (int i = 0; i < 40; ++i) values.push_back(i);
+    values.push_back(int64_t{1} << shift);
+    values.push_back(-(int64_t{1} << shift));
+  }
+  return values;
+}
+
+static string ExampleWithInt64s(const std::vector<int64_t>& values) {
+  Example example;
+  Int64List* int64_list =
+      (*example.mutable_features()->mutable_feature())["int64_list"]
+          .mutable_int64_list();
+  for (int64_t value : values) int64_list->add_value(value);
+  return Serialize(example);
+}
+
+TEST(FastParse, PackedInt64sOfAllVarintLengths) {
+  TestCorrectness(ExampleWithInt64s(Int64sOfAllVarintLengths()));
+}
+
+TEST(FastParse, MalformedPackedInt64s) {
+  // The packed value `\x80\x80` ends in the middle of a varint.
+  Example example;
+  EXPECT_FALSE(TestFastParse(
+      "\x0a\x12\x0a\x10\x0a\x03\x61\x67\x65\x12\x09\x1a\x07\x0a\x05\x01"
+      "\x02\x03\x80\x80",
+      &example));
+}
+
 static void AddDenseFeature(const char* feature_name, DataType dtype,
                             PartialTensorShape shape, bool variable_length,
                             size_t elements_per_stride,
@@ -419,6 +455,107 @@ TEST(FastParse, FuzzTest) {
   }
 }
 
+TEST(TestFastParseExample, DensePackedInt64s) {
+  const std::vector<int64_t> values = Int64sOfAllVarintLengths();
+  const int64_t num_values = values.size();
+  std::vector<tstring> serialized(2, ExampleWithInt64s(values));
+
+  FastParseExampleConfig config;
+  AddDenseFeature("int64_list", DT_INT64, {num_values}, false, num_values,
+                  &config);
+  Result result;
+  TF_ASSERT_OK(FastParseExample(config, serialized, {}, nullptr, &result));
+  ASSERT_EQ(result.dense_values.size(), 1);
+  auto dense_values = result.dense_values[0].flat<int64_t>();
+  ASSERT_EQ(dense_values.size(), 2 * num_values);
+  for (int64_t i = 0; i < 2 * num_values; ++i) {
+    EXPECT_EQ(dense_values(i), values[i % num_values]) << i;
+  }
+
+  FastParseExampleConfig too_small_config;
+  AddDenseFeature("int64_list", DT_INT64, {num_values - 1}, false,
+                  num_values - 1, &too_small_config);
+  EXPECT_FALSE(
+      FastParseExample(too_small_config, serialized, {}, nullptr, &result)
+          .ok());
+}
+
+TEST(CompiledFastParseExampleConfig, FindsEveryFeature) {
+  for (int num_features : {0, 1, 2, 10, 300, 3000}) {
+    FastParseExampleConfig config;
+    for (int i = 0; i < num_features; ++i) {
+      const string name = strings::StrCat("feature_", i);
+      switch (i % 3) {
+        case 0:
+          AddDenseFeature(name.c_str(), DT_FLOAT, {1}, false, 1, &config);
+          break;
+        case 1:
+          AddSparseFeature(name.c_str(), DT_INT64, &config);
+          break;
+        case 2:
+          config.ragged.emplace_back(name, DT_STRING, DT_INT64);
+          break;
+      }
+    }
+    std::unique_ptr<const CompiledFastParseExampleConfig> compiled;
+    TF_ASSERT_OK(CompiledFastParseExampleConfig::Compile(config, &compiled));
+    for (int i = 0; i < num_features; ++i) {
+      const CompiledFastParseExampleConfig::Feature* feature =
+          compiled->Find(strings::StrCat("feature_", i));
+      ASSERT_NE(feature, nullptr) << i;
+      EXPECT_EQ(feature->index, static_cast<size_t>(i / 3));
+      EXPECT_EQ(static_cast<int>(feature->kind), i % 3);
+    }
+    EXPECT_EQ(compiled->Find(""), nullptr);
+    EXPECT_EQ(compiled->Find("feature"), nullptr);
+    EXPECT_EQ(compiled->Find(strings::StrCat("feature_", num_features)),
+              nullptr);
+  }
+}
+
+TEST(CompiledFastParseExampleConfig, DuplicateFeatureName) {
+  FastParseExampleConfig config;
+  AddDenseFeature("feature", DT_FLOAT, {1}, false, 1, &config);
+  AddSparseFeature("feature", DT_INT64, &config);
+  std::unique_ptr<const CompiledFastParseExampleConfig> compiled;
+  EXPECT_EQ(CompiledFastParseExampleConfig::Compile(config, &compiled).code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+TEST(CompiledFastParseExampleConfig, ParsesLikeConfig) {
+  const size_t kNumExamples = 13;
+  std::vector<tstring> serialized(kNumExamples, ExampleWithSomeFeatures());
+  FastParseExampleConfig config;
+  AddDenseFeature("bytes_list", DT_STRING, {2}, false, 2, &config);
+  AddDenseFeature("float_list", DT_FLOAT, {-1}, true, 1, &config);
+  AddSparseFeature("int64_list", DT_INT64, &config);
+  AddSparseFeature("missing", DT_INT64, &config);
+  std::unique_ptr<const CompiledFastParseExampleConfig> compiled;
+  TF_ASSERT_OK(CompiledFastParseExampleConfig::Compile(config, &compiled));
+
+  Result expected;
+  TF_ASSERT_OK(FastParseExample(config, serialized, {}, nullptr, &expected));
+  Result result;
+  TF_ASSERT_OK(FastParseExample(*compiled, serialized, {}, nullptr, &result));
+  ASSERT_EQ(result.dense_values.size(), expected.dense_values.size());
+  for (size_t d = 0; d < result.dense_values.size(); ++d) {
+    EXPECT_EQ(result.dense_values[d].DebugString(/*num_values=*/100),
+              expected.dense_values[d].DebugString(/*num_values=*/100));
+  }
+  ASSERT_EQ(result.sparse_values.size(), expected.sparse_values.size());
+  for (size_t d = 0; d < result.sparse_values.size(); ++d) {
+    EXPECT_EQ(result.sparse_indices[d].DebugString(/*num_values=*/100),
+              expected.sparse_indices[d].DebugString(/*num_values=*/100));
+    EXPECT_EQ(result.sparse_values[d].DebugString(/*num_values=*/100),
+              expected.sparse_values[d].DebugString(/*num_values=*/100));
+  }
+
+  Result single_result;
+  TF_ASSERT_OK(
+      FastParseSingleExample(*compiled, serialized[0], &single_result));
+  EXPECT_EQ(single_result.sparse_values[0].NumElements(), 3);
+}
+
 TEST(TestFastParseExample, Empty) {
   Result result;
   FastParseExampleConfig config;
@@ -0,0 +1,174 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/util/packed_wire_format.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "absl/base/casts.h"
+#include "absl/numeric/bits.h"
+#include "tensorflow/core/platform/byte_order.h"
+#include "tensorflow/core/platform/coding.h"
+#include "tensorflow/core/platform/raw_coding.h"
+#include "tensorflow/core/platform/stringpiece.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace example {
+
+namespace {
+
+// Number of bytes whose continuation bits are inspected at once.
+#if defined(__AVX2__)
+constexpr int kBlockSize = 32;
+#elif defined(__SSE2__)
+constexpr int kBlockSize = 16;
+#else
+constexpr int kBlockSize = 8;
+#endif
+
+constexpr uint32 kBlockMask =
+    kBlockSize == 32 ? ~uint32{0} : (uint32{1} << kBlockSize) - 1;
+
+// Returns a mask whose bit `i` is set iff byte `i` of the block at `p` has its
+// continuation bit set.
+inline uint32 ContinuationMask(const char* p) {
+#if defined(__AVX2__)
+  return static_cast<uint32>(_mm256_movemask_epi8(
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))));
+#elif defined(__SSE2__)
+  return static_cast<uint32>(
+      _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))));
+#else
+  // Moves the continuation bit of each byte to the bottom of the byte, then
+  // gathers the eight bits into the top byte of the product.
+  const uint64 continuation_bits =
+      core::DecodeFixed64(p) & uint64{0x8080808080808080};
+  return static_cast<uint32>(
+      ((continuation_bits >> 7) * uint64{0x0102040810204080}) >> 56);
+#endif
+}
+
+// Decodes the block at `p`, which holds `kBlockSize` one-byte varints.
+inline void DecodeOneByteVarints(const char* p, int64_t* out) {
+#if defined(__AVX2__)
+  for (int i = 0; i < kBlockSize; i += 4) {
+    int32_t bytes;
+    std::memcpy(&bytes, p + i, sizeof(bytes));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                        _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(bytes)));
+  }
+#elif defined(__SSE4_1__)
+  for (int i = 0; i < kBlockSize; i += 2) {
+    uint16 bytes;
+    std::memcpy(&bytes, p + i, sizeof(bytes));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                     _mm_cvtepu8_epi64(_mm_cvtsi32_si128(bytes)));
+  }
+#else
+  for (int i = 0; i < kBlockSize; ++i) {
+    out[i] = static_cast<uint8>(p[i]);
+  }
+#endif
+}
+
+// Decodes the varint of `length` bytes at `p`.
+inline uint64 DecodeVarint(const char* p, int length) {
+  uint64 value = 0;
+  for (int i = 0; i < length; ++i) {
+    value |= static_cast<uint64>(static_cast<uint8>(p[i]) & 0x7f) << (7 * i);
+  }
+  return value;
+}
+
+}  // namespace
+
+int64_t CountPackedVarints(StringPiece packed) {
+  if (packed.empty()) return 0;
+  if (static_cast<uint8>(packed.back()) & 0x80) return -1;
+  const char* p = packed.data();
+  const char* const end = p + packed.size();
+  int64_t num_values = 0;
+  for (; end - p >= kBlockSize; p += kBlockSize) {
+    num_values += absl::popcount(~ContinuationMask(p) & kBlockMask);
+  }
+  for (; p < end; ++p) {
+    num_values += (static_cast<uint8>(*p) & 0x80) == 0;
+  }
+  return num_values;
+}
+
+bool DecodePackedVarints(StringPiece packed, size_t num_values, int64_t* out) {
+  const char* p = packed.data();
+  const char* const end = p + packed.size();
+  size_t i = 0;
+  while (i < num_values && end - p >= kBlockSize) {
+    const uint32 continuations = ContinuationMask(p);
+    if (continuations == 0 && num_values - i >= kBlockSize) {
+      DecodeOneByteVarints(p, out + i);
+      i += kBlockSize;
+      p += kBlockSize;
+      continue;
+    }
+    // Bit `j` of `ends` is set iff byte `j` of the block ends a varint.
+    uint32 ends = ~continuations & kBlockMask;
+    if (ends == 0) {
+      // The block is the prefix of a varint that is longer than the block.
+      uint64 value;
+      p = core::GetVarint64Ptr(p, end, &value);
+      if (p == nullptr) return false;
+      out[i++] = static_cast<int64_t>(value);
+      continue;
+    }
+    const char* const block = p;
+    do {
+      const char* const next = block + absl::countr_zero(ends) + 1;
+      if (next - p > core::kMaxVarint64Bytes) return false;
+      out[i++] = static_cast<int64_t>(DecodeVarint(p, next - p));
+      p = next;
+      ends &= ends - 1;
+    } while (ends != 0 && i < num_values);
+  }
+  for (; i < num_values; ++i) {
+    uint64 value;
+    p = core::GetVarint64Ptr(p, end, &value);
+    if (p == nullptr) return false;
+    out[i] = static_cast<int64_t>(value);
+  }
+  return true;
+}
+
+void DecodePackedFloats(const char* packed, size_t num_values, float* out) {
+  if (port::kLittleEndian) {
+    std::memcpy(out, packed, num_values * sizeof(float));
+    return;
+  }
+  for (size_t i = 0; i < num_values; ++i) {
+    out[i] = absl::bit_cast<float>(core::DecodeFixed32(packed + 4 * i));
+  }
+}
+
+}  // namespace example
+}  // namespace tensorflow
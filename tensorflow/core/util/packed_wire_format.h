@@ -0,0 +1,50 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_UTIL_PACKED_WIRE_FORMAT_H_
+#define TENSORFLOW_CORE_UTIL_PACKED_WIRE_FORMAT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "tensorflow/core/platform/stringpiece.h"
+
+namespace tensorflow {
+namespace example {
+
+// Batch decoders for the payload of packed repeated proto fields, i.e. the
+// bytes that follow the tag and length of an `Int64List` or `FloatList`.
+//
+// Varints are decoded a block of bytes at a time: the continuation bits of a
+// block are gathered into a bitmask (with AVX2 or SSE2 when available, and
+// with 64-bit arithmetic otherwise), which gives the boundaries of all the
+// varints that end in the block without testing each byte.
+
+// Returns the number of varints in `packed`, or -1 if `packed` ends in the
+// middle of a varint.
+int64_t CountPackedVarints(StringPiece packed);
+
+// Decodes the first `num_values` varints of `packed` into `out`. Returns false
+// if `packed` holds fewer varints or if one of them is longer than 10 bytes.
+bool DecodePackedVarints(StringPiece packed, size_t num_values, int64_t* out);
+
+// Decodes `num_values` little-endian floats from `packed` into `out`.
+// REQUIRES: `packed` holds at least `4 * num_values` bytes.
+void DecodePackedFloats(const char* packed, size_t num_values, float* out);
+
+}  // namespace example
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_UTIL_PACKED_WIRE_FORMAT_H_
@@ -0,0 +1,111 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/util/packed_wire_format.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/base/casts.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/coding.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace example {
+namespace {
+
+std::string EncodeVarints(const std::vector<int64_t>& values) {
+  std::string packed;
+  for (int64_t value : values) {
+    core::PutVarint64(&packed, static_cast<uint64>(value));
+  }
+  return packed;
+}
+
+// Returns `num_values` values whose varint encodings take from 1 to 10 bytes,
+// with long runs of one-byte varints.
+std::vector<int64_t> RandomValues(random::SimplePhilox* rng, int num_values) {
+  std::vector<int64_t> values;
+  for (int i = 0; i < num_values; ++i) {
+    if (rng->OneIn(2)) {
+      values.push_back(rng->Uniform(128));
+    } else {
+      values.push_back(static_cast<int64_t>(rng->Rand64() >> rng->Uniform(64)));
+    }
+  }
+  return values;
+}
+
+TEST(PackedWireFormatTest, CountPackedVarints) {
+  EXPECT_EQ(CountPackedVarints(""), 0);
+  EXPECT_EQ(CountPackedVarints(EncodeVarints({1, 300, -1})), 3);
+  EXPECT_EQ(CountPackedVarints(EncodeVarints(std::vector<int64_t>(100, 1))),
+            100);
+  EXPECT_EQ(CountPackedVarints("\x01\x80"), -1);
+}
+
+TEST(PackedWireFormatTest, DecodePackedVarints) {
+  random::PhiloxRandom philox(1337);
+  random::SimplePhilox rng(&philox);
+  for (int num_values = 0; num_values < 200; ++num_values) {
+    const std::vector<int64_t> values = RandomValues(&rng, num_values);
+    const std::string packed = EncodeVarints(values);
+    ASSERT_EQ(CountPackedVarints(packed), num_values);
+
+    std::vector<int64_t> decoded(num_values);
+    ASSERT_TRUE(DecodePackedVarints(packed, num_values, decoded.data()));
+    EXPECT_EQ(decoded, values);
+
+    // Decodes a prefix without writing past it.
+    if (num_values > 0) {
+      const int num_decoded = rng.Uniform(num_values);
+      std::vector<int64_t> prefix(num_decoded + 1, -1);
+      ASSERT_TRUE(DecodePackedVarints(packed, num_decoded, prefix.data()));
+      EXPECT_EQ(prefix.back(), -1);
+      prefix.pop_back();
+      EXPECT_EQ(prefix, std::vector<int64_t>(values.begin(),
+                                             values.begin() + num_decoded));
+    }
+
+    std::vector<int64_t> too_many(num_values + 1);
+    EXPECT_FALSE(DecodePackedVarints(packed, num_values + 1, too_many.data()));
+  }
+}
+
+TEST(PackedWireFormatTest, DecodePackedVarintsLongerThanTenBytes) {
+  std::string packed(40, '\x80');
+  packed += '\x01';
+  ASSERT_EQ(CountPackedVarints(packed), 1);
+  int64_t value;
+  EXPECT_FALSE(DecodePackedVarints(packed, 1, &value));
+}
+
+TEST(PackedWireFormatTest, DecodePackedFloats) {
+  const std::vector<float> values = {0.0f, -1.5f, 3.25f, 1e30f};
+  std::string packed;
+  for (float value : values) {
+    core::PutFixed32(&packed, absl::bit_cast<uint32>(value));
+  }
+  std::vector<float> decoded(values.size());
+  DecodePackedFloats(packed.data(), values.size(), decoded.data());
+  EXPECT_EQ(decoded, values);
+}
+
+}  // namespace
+}  // namespace example
+}  // namespace tensorflow
@@ -15,14 +15,18 @@ limitations under the License.
 
 #include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
+#include <functional>
 #include <memory>
 #include <utility>
 
+#include "tensorflow/core/framework/allocation_description.pb.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
+#include "tensorflow/core/framework/tensor_util.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/framework/variant.h"
@@ -38,6 +42,7 @@ limitations under the License.
 #include "tensorflow/core/lib/io/table_builder.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/bfloat16.h"
+#include "tensorflow/core/platform/blocking_counter.h"
 #include "tensorflow/core/platform/cord.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/mem.h"
@@ -425,14 +430,17 @@ Status PadAlignment(tsl::BufferedWritableFile* out, int alignment,
 }  // namespace
 
 BundleWriter::BundleWriter(Env* env, StringPiece prefix, const Options& options)
-    : env_(env), options_(options), prefix_(prefix), out_(nullptr), size_(0) {
+    : env_(env), options_(options), prefix_(prefix) {
   status_ = env_->HasAtomicMove(prefix_, &use_temp_file_);
   if (!status_.ok()) return;
+  if (options_.num_data_files < 1) {
+    status_ = errors::InvalidArgument("num_data_files must be positive, got ",
+                                      options_.num_data_files);
+    return;
+  }
 
-  data_path_ = DataFilename(prefix_, 0, 1);
   metadata_path_ = MetaFilename(prefix_);
   if (use_temp_file_) {
-    data_path_ = strings::StrCat(data_path_, ".tempstate", random::New64());
     metadata_path_ =
         strings::StrCat(metadata_path_, ".tempstate", random::New64());
   }
@@ -442,50 +450,120 @@ BundleWriter::BundleWriter(Env* env, StringPiece prefix, const Options& options)
     return;
   }
 
-  std::unique_ptr<WritableFile> wrapper;
-  status_ = env_->NewWritableFile(data_path_, &wrapper);
-  if (!status_.ok()) return;
-  out_ = std::make_unique<tsl::BufferedWritableFile>(
-      std::move(wrapper), 8 << 20 /* 8MB write buffer */);
+  const int num_data_files = options_.num_data_files;
+  const bool write_in_background =
+      num_data_files > 1 || options_.snapshot_tensors;
+  for (int i = 0; i < num_data_files; ++i) {
+    auto file = std::make_unique<DataFile>();
+    file->shard_id = i;
+    file->path = DataFilename(prefix_, i, num_data_files);
+    if (use_temp_file_) {
+      file->path = strings::StrCat(file->path, ".tempstate", random::New64());
+    }
+    std::unique_ptr<WritableFile> wrapper;
+    status_ = env_->NewWritableFile(file->path, &wrapper);
+    if (!status_.ok()) return;
+    file->out = std::make_unique<tsl::BufferedWritableFile>(
+        std::move(wrapper), 8 << 20 /* 8MB write buffer */);
+    if (write_in_background) {
+      file->writer = std::make_unique<thread::ThreadPool>(
+          env_, "bundle_writer", /*num_threads=*/1);
+    }
+    VLOG(1) << "Writing to file " << file->path;
+    data_files_.push_back(std::move(file));
+  }
+}
 
-  VLOG(1) << "Writing to file " << data_path_;
+BundleWriter::~BundleWriter() {
+  // Background writes must not outlive the files and entries they update.
+  WaitForWriters().IgnoreError();
 }
 
 Status BundleWriter::Add(StringPiece key, const Tensor& val) {
   if (!status_.ok()) return status_;
   CHECK_NE(key, kHeaderEntryKey);
   const string key_string(key);
-  if (entries_.find(key_string) != entries_.end()) {
-    status_ = errors::InvalidArgument("Adding duplicate key: ", key);
+
+  // Appends to the data file with the fewest bytes assigned so far.
+  DataFile* file = data_files_[0].get();
+  for (const auto& f : data_files_) {
+    if (f->assigned_bytes < file->assigned_bytes) file = f.get();
+  }
+  file->assigned_bytes += val.TotalBytes();
+
+  BundleEntryProto* entry;
+  {
+    mutex_lock l(mu_);
+    if (!writer_status_.ok()) {
+      status_ = writer_status_;
+      return status_;
+    }
+    if (entries_.find(key_string) != entries_.end()) {
+      status_ = errors::InvalidArgument("Adding duplicate key: ", key);
+      return status_;
+    }
+    // Entries are never erased, so "entry" stays valid.
+    entry = &entries_[key_string];
+    entry->set_dtype(val.dtype());
+    val.shape().AsProto(entry->mutable_shape());
+    entry->set_shard_id(file->shard_id);
+  }
+
+  if (file->writer == nullptr) {
+    // Writes on the caller thread, which is the only thread.
+    status_ = WriteToFile(val, file, entry);
     return status_;
   }
 
-  BundleEntryProto* entry = &entries_[key_string];
-  entry->set_dtype(val.dtype());
-  val.shape().AsProto(entry->mutable_shape());
-  entry->set_shard_id(0);
-  entry->set_offset(size_);
+  // Copying shares the buffer of "val" unless a snapshot is requested.
+  Tensor queued = options_.snapshot_tensors ? tensor::DeepCopy(val) : val;
+  file->writer->Schedule([this, file, entry, queued = std::move(queued)]() {
+    BundleEntryProto written;
+    Status s = WriteToFile(queued, file, &written);
+    mutex_lock l(mu_);
+    if (s.ok()) {
+      entry->set_offset(written.offset());
+      entry->set_size(written.size());
+      entry->set_crc32c(written.crc32c());
+    } else {
+      writer_status_.Update(s);
+    }
+  });
+  return OkStatus();
+}
+
+Status BundleWriter::WriteToFile(const Tensor& val, DataFile* file,
+                                 BundleEntryProto* entry) const {
+  entry->set_offset(file->size);
 
   // Updates the data file.
   size_t data_bytes_written = 0;
   uint32 crc32c = 0;
-  out_->reset_crc32();
+  Status s;
+  file->out->reset_crc32();
   if (val.dtype() == DT_STRING) {
-    status_ = WriteStringTensor(val, out_.get(), &data_bytes_written, &crc32c);
+    s = WriteStringTensor(val, file->out.get(), &data_bytes_written, &crc32c);
   } else if (val.dtype() == DT_VARIANT) {
-    status_ = WriteVariantTensor(val, out_.get(), &data_bytes_written, &crc32c);
+    s = WriteVariantTensor(val, file->out.get(), &data_bytes_written, &crc32c);
   } else {
-    status_ = WriteTensor(val, out_.get(), &data_bytes_written);
-    crc32c = out_->crc32();
+    s = WriteTensor(val, file->out.get(), &data_bytes_written);
+    crc32c = file->out->crc32();
   }
 
-  if (status_.ok()) {
+  if (s.ok()) {
     entry->set_size(data_bytes_written);
     entry->set_crc32c(crc32c::Mask(crc32c));
-    size_ += data_bytes_written;
-    status_ = PadAlignment(out_.get(), options_.data_alignment, &size_);
+    file->size += data_bytes_written;
+    s = PadAlignment(file->out.get(), options_.data_alignment, &file->size);
   }
-  return status_;
+  return s;
+}
+
+Status BundleWriter::WaitForWriters() {
+  // Destroying a ThreadPool runs the tasks that are still queued.
+  for (const auto& file : data_files_) file->writer = nullptr;
+  mutex_lock l(mu_);
+  return writer_status_;
 }
 
 Status BundleWriter::AddSlice(StringPiece full_tensor_key,
@@ -506,20 +584,23 @@ Status BundleWriter::AddSlice(StringPiece full_tensor_key,
   // the "slices" field of multiple metadata entries corresponding to the same
   // full tensor.
   const string full_tensor_key_string(full_tensor_key);
-  BundleEntryProto* full_entry = &entries_[full_tensor_key_string];
-  if (full_entry->dtype() != DT_INVALID) {
-    CHECK_EQ(full_entry->dtype(), slice_tensor.dtype());
-  }
-  if (full_entry->has_shape()) {
-    CHECK(TensorShape(full_entry->shape()) == full_tensor_shape);
-  }
+  {
+    mutex_lock l(mu_);
+    BundleEntryProto* full_entry = &entries_[full_tensor_key_string];
+    if (full_entry->dtype() != DT_INVALID) {
+      CHECK_EQ(full_entry->dtype(), slice_tensor.dtype());
+    }
+    if (full_entry->has_shape()) {
+      CHECK(TensorShape(full_entry->shape()) == full_tensor_shape);
+    }
 
-  // Populates dtype, shape, and slices.  Intentionally leaving out shard_id and
-  // offset, which do not make sense for this full tensor entry.
-  full_entry->set_dtype(slice_tensor.dtype());
-  full_tensor_shape.AsProto(full_entry->mutable_shape());
-  TensorSliceProto* slice_proto = full_entry->add_slices();
-  slice_spec.AsProto(slice_proto);
+    // Populates dtype, shape, and slices.  Intentionally leaving out shard_id
+    // and offset, which do not make sense for this full tensor entry.
+    full_entry->set_dtype(slice_tensor.dtype());
+    full_tensor_shape.AsProto(full_entry->mutable_shape());
+    TensorSliceProto* slice_proto = full_entry->add_slices();
+    slice_spec.AsProto(slice_proto);
+  }
 
   // The slice itself is handled by a regular Add(), which includes adding its
   // own metadata entry, and writing out the slice's values.
@@ -532,18 +613,24 @@ Status BundleWriter::AddSlice(StringPiece full_tensor_key,
 // TODO(zongheng): on metadata write failure or !status_.ok(), consider removing
 // the orphaned data file.
 Status BundleWriter::Finish() {
-  if (out_) {
-    status_.Update(out_->Close());
-    out_ = nullptr;
+  if (!data_files_.empty()) status_.Update(WaitForWriters());
+  const int num_data_files = data_files_.size();
+  for (const auto& file : data_files_) {
+    status_.Update(file->out->Close());
+    file->out = nullptr;
+  }
+  for (const auto& file : data_files_) {
     if (status_.ok()) {
       if (use_temp_file_) {
-        status_ =
-            Env::Default()->RenameFile(data_path_, DataFilename(prefix_, 0, 1));
+        status_ = Env::Default()->RenameFile(
+            file->path,
+            DataFilename(prefix_, file->shard_id, num_data_files));
       }
     } else {
-      Env::Default()->DeleteFile(data_path_).IgnoreError();
+      Env::Default()->DeleteFile(file->path).IgnoreError();
     }
   }
+  data_files_.clear();
   if (!status_.ok()) return status_;
   // Build key -> BundleEntryProto table.
   std::unique_ptr<WritableFile> file;
@@ -557,7 +644,7 @@ Status BundleWriter::Finish() {
     table::TableBuilder builder(options, file.get());
     // Header entry.
     BundleHeaderProto header;
-    header.set_num_shards(1);
+    header.set_num_shards(num_data_files);
     header.set_endianness(BundleHeaderProto::LITTLE);
     if (!port::kLittleEndian) header.set_endianness(BundleHeaderProto::BIG);
     VersionDef* version = header.mutable_version();
@@ -567,6 +654,7 @@ Status BundleWriter::Finish() {
     builder.Add(kHeaderEntryKey, header.SerializeAsString());
 
     // All others.
+    mutex_lock l(mu_);
     for (const auto& p : entries_) {
       builder.Add(p.first, p.second.SerializeAsString());
     }
@@ -765,6 +853,37 @@ Status MergeBundles(Env* env, gtl::ArraySlice<tstring> prefixes,
   return status;
 }
 
+namespace {
+
+// Maximum size of the sections that `BundleReader::LookupMany()` splits the
+// reads of large entries into.
+const int64_t kBulkReadSectionSize = static_cast<int64_t>(64) << 20;
+
+// A tensor buffer that points into a memory mapped data file, which it keeps
+// mapped while the buffer is alive.
+class MappedTensorBuffer : public TensorBuffer {
+ public:
+  MappedTensorBuffer(std::shared_ptr<ReadOnlyMemoryRegion> region,
+                     const void* data, size_t size)
+      : TensorBuffer(const_cast<void*>(data)),
+        region_(std::move(region)),
+        size_(size) {}
+
+  size_t size() const override { return size_; }
+  TensorBuffer* root_buffer() override { return this; }
+  void FillAllocationDescription(AllocationDescription* proto) const override {
+    proto->set_requested_bytes(size_);
+    proto->set_allocator_name("tensor_bundle_mmap");
+  }
+  bool OwnsMemory() const override { return false; }
+
+ private:
+  const std::shared_ptr<ReadOnlyMemoryRegion> region_;
+  const size_t size_;
+};
+
+}  // namespace
+
 // Interface for reading a tensor bundle.
 
 BundleReader::BundleReader(
@@ -898,17 +1017,8 @@ Status BundleReader::GetValue(const BundleEntryProto& entry, Tensor* val) {
     }
   }
 
-  // Open the data file if it has not been opened.
-  io::InputBuffer* buffered_file = data_[entry.shard_id()];
-  if (buffered_file == nullptr) {
-    std::unique_ptr<RandomAccessFile> file = nullptr;
-    TF_RETURN_IF_ERROR(env_->NewRandomAccessFile(
-        DataFilename(prefix_, entry.shard_id(), num_shards_), &file));
-    buffered_file = new io::InputBuffer(file.release(), kBufferSize);
-    // The InputBuffer and RandomAccessFile objects are both released in dtor.
-    data_[entry.shard_id()] = buffered_file;
-  }
-  CHECK(buffered_file != nullptr);
+  io::InputBuffer* buffered_file;
+  TF_RETURN_IF_ERROR(GetBufferedFile(entry.shard_id(), &buffered_file));
 
   TF_RETURN_IF_ERROR(buffered_file->Seek(entry.offset()));
   uint32 actual_crc32c = 0;
@@ -1010,6 +1120,213 @@ Status BundleReader::GetValue(const BundleEntryProto& entry, Tensor* val) {
   return OkStatus();
 }
 
+Status BundleReader::GetBufferedFile(int32_t shard_id,
+                                     io::InputBuffer** buffered_file) {
+  // Open the data file if it has not been opened.
+  io::InputBuffer*& file_buffer = data_[shard_id];
+  if (file_buffer == nullptr) {
+    std::unique_ptr<RandomAccessFile> file = nullptr;
+    TF_RETURN_IF_ERROR(env_->NewRandomAccessFile(
+        DataFilename(prefix_, shard_id, num_shards_), &file));
+    // The InputBuffer and RandomAccessFile objects are both released in dtor.
+    file_buffer = new io::InputBuffer(file.release(), kBufferSize);
+  }
+  *buffered_file = file_buffer;
+  return OkStatus();
+}
+
+std::shared_ptr<ReadOnlyMemoryRegion> BundleReader::GetMappedFile(
+    int32_t shard_id) {
+  auto it = mapped_data_.find(shard_id);
+  if (it != mapped_data_.end()) return it->second;
+  const string filename = DataFilename(prefix_, shard_id, num_shards_);
+  std::unique_ptr<ReadOnlyMemoryRegion> region;
+  Status s = env_->NewReadOnlyMemoryRegionFromFile(filename, &region);
+  if (!s.ok()) {
+    VLOG(1) << "Reading instead of memory mapping " << filename << ": " << s;
+    region.reset();
+  }
+  return mapped_data_[shard_id] = std::move(region);
+}
+
+Status BundleReader::LookupMany(absl::Span<const std::string> keys,
+                                absl::Span<Tensor* const> vals,
+                                const LookupManyOptions& options) {
+  if (keys.size() != vals.size()) {
+    return errors::InvalidArgument("LookupMany() got ", keys.size(),
+                                   " keys but ", vals.size(), " tensors");
+  }
+
+  // An unpartitioned numeric tensor to read in bulk.
+  struct BulkEntry {
+    BundleEntryProto entry;
+    Tensor* val;
+    // The file the entry is read from, or the mapped bytes of the entry.
+    RandomAccessFile* file = nullptr;
+    std::shared_ptr<ReadOnlyMemoryRegion> region;
+    const char* mapped_data = nullptr;
+  };
+  std::vector<BulkEntry> bulk_entries;
+  bulk_entries.reserve(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    CHECK(vals[i] != nullptr);
+    BundleEntryProto entry;
+    TF_RETURN_IF_ERROR(GetBundleEntryProto(keys[i], &entry));
+    if (!entry.slices().empty()) {
+      TF_RETURN_IF_ERROR(GetSliceValue(
+          keys[i], entry,
+          /* a full slice */ TensorSlice(TensorShape(entry.shape()).dims()),
+          vals[i]));
+      continue;
+    }
+    if (!DataTypeCanUseMemcpy(entry.dtype())) {
+      // String and variant tensors are parsed from buffered reads.
+      TF_RETURN_IF_ERROR(GetValue(entry, vals[i]));
+      continue;
+    }
+    BulkEntry bulk_entry;
+    bulk_entry.entry.Swap(&entry);
+    bulk_entry.val = vals[i];
+    bulk_entries.push_back(std::move(bulk_entry));
+  }
+  if (bulk_entries.empty()) return OkStatus();
+
+  std::sort(bulk_entries.begin(), bulk_entries.end(),
+            [](const BulkEntry& a, const BulkEntry& b) {
+              return std::make_pair(a.entry.shard_id(), a.entry.offset()) <
+                     std::make_pair(b.entry.shard_id(), b.entry.offset());
+            });
+
+  // Decide how each entry is restored, and split the reads into sections.
+  struct Section {
+    BulkEntry* bulk_entry;
+    int64_t offset;
+    int64_t size;
+  };
+  std::vector<Section> sections;
+  int64_t total_bytes = 0;
+  for (BulkEntry& bulk_entry : bulk_entries) {
+    const BundleEntryProto& entry = bulk_entry.entry;
+    const TensorShape stored_shape(entry.shape());
+    Tensor* val = bulk_entry.val;
+    // As in `Lookup()`, a preallocated tensor of another dtype or shape keeps
+    // them and is filled in place, provided that its size matches the entry.
+    const bool val_matches_entry =
+        val->NumElements() == 0 ||
+        (val->dtype() == entry.dtype() && val->shape() == stored_shape);
+    if (options.use_mmap && !need_to_swap_bytes_ && val_matches_entry) {
+      bulk_entry.region = GetMappedFile(entry.shard_id());
+      ReadOnlyMemoryRegion* region = bulk_entry.region.get();
+      if (region != nullptr &&
+          entry.offset() + entry.size() <= region->length()) {
+        const char* data =
+            static_cast<const char*>(region->data()) + entry.offset();
+        if (reinterpret_cast<uintptr_t>(data) % EIGEN_MAX_ALIGN_BYTES == 0) {
+          bulk_entry.mapped_data = data;
+        }
+      }
+    }
+    if (bulk_entry.mapped_data == nullptr && val->NumElements() == 0) {
+      *val = Tensor(entry.dtype(), stored_shape);
+    }
+    const size_t expected_size =
+        bulk_entry.mapped_data != nullptr
+            ? stored_shape.num_elements() * DataTypeSize(entry.dtype())
+            : val->TotalBytes();
+    if (entry.size() != expected_size) {
+      return errors::DataLoss("Invalid size in bundle entry: shard ",
+                              entry.shard_id(), " offset ", entry.offset(),
+                              "; stored size ", entry.size(),
+                              "; expected size ", expected_size);
+    }
+    if (bulk_entry.mapped_data != nullptr) continue;
+
+    io::InputBuffer* buffered_file;
+    TF_RETURN_IF_ERROR(GetBufferedFile(entry.shard_id(), &buffered_file));
+    bulk_entry.file = buffered_file->file();
+    for (int64_t offset = 0; offset < entry.size();
+         offset += kBulkReadSectionSize) {
+      sections.push_back(
+          {&bulk_entry, offset,
+           std::min<int64_t>(kBulkReadSectionSize, entry.size() - offset)});
+    }
+    total_bytes += entry.size();
+  }
+
+  // Runs `fn(i)` for i in [0, n), on the thread pool if there is one.
+  std::unique_ptr<thread::ThreadPool> pool;
+  const int num_threads = std::min<int64_t>(
+      options.num_threads, std::max(sections.size(), bulk_entries.size()));
+  if (num_threads > 1 && (total_bytes > kBufferSize || options.use_mmap)) {
+    pool = std::make_unique<thread::ThreadPool>(env_, "bundle_lookup_many",
+                                                num_threads);
+  }
+  auto run_all = [&pool](size_t n, const std::function<Status(size_t)>& fn) {
+    std::vector<Status> statuses(n);
+    if (pool == nullptr) {
+      for (size_t i = 0; i < n; ++i) statuses[i] = fn(i);
+    } else {
+      BlockingCounter counter(n);
+      for (size_t i = 0; i < n; ++i) {
+        pool->Schedule([&, i]() {
+          statuses[i] = fn(i);
+          counter.DecrementCount();
+        });
+      }
+      counter.Wait();
+    }
+    for (const Status& status : statuses) {
+      TF_RETURN_IF_ERROR(status);
+    }
+    return OkStatus();
+  };
+
+  // Sections are scheduled in file order, so that each data file is read
+  // mostly sequentially while the files are read in parallel.
+  TF_RETURN_IF_ERROR(run_all(sections.size(), [&sections](size_t i) {
+    const Section& section = sections[i];
+    const BundleEntryProto& entry = section.bulk_entry->entry;
+    char* backing_buffer =
+        const_cast<char*>(section.bulk_entry->val->tensor_data().data()) +
+        section.offset;
+    StringPiece sp;
+    TF_RETURN_IF_ERROR(section.bulk_entry->file->Read(
+        entry.offset() + section.offset, section.size, &sp, backing_buffer));
+    if (sp.data() != backing_buffer) {
+      memmove(backing_buffer, sp.data(), section.size);
+    }
+    return OkStatus();
+  }));
+
+  return run_all(bulk_entries.size(), [this, &bulk_entries](size_t i) {
+    BulkEntry& bulk_entry = bulk_entries[i];
+    const BundleEntryProto& entry = bulk_entry.entry;
+    const char* data = bulk_entry.mapped_data != nullptr
+                           ? bulk_entry.mapped_data
+                           : bulk_entry.val->tensor_data().data();
+    // Note that we compute the checksum *before* byte-swapping. The checksum
+    // should be on the bytes in the order they appear in the file.
+    const uint32 actual_crc32c = crc32c::Value(data, entry.size());
+    if (crc32c::Unmask(entry.crc32c()) != actual_crc32c) {
+      return errors::DataLoss(
+          "TensorBundle at ", prefix_, " shard ", entry.shard_id(), " (",
+          entry.size(), " bytes): Checksum does not match: stored ",
+          strings::Printf("%08u", crc32c::Unmask(entry.crc32c())),
+          " vs. calculated on the restored bytes ", actual_crc32c);
+    }
+    if (bulk_entry.mapped_data != nullptr) {
+      auto* buf = new MappedTensorBuffer(std::move(bulk_entry.region), data,
+                                         entry.size());
+      *bulk_entry.val =
+          Tensor(entry.dtype(), TensorShape(entry.shape()), buf);
+      buf->Unref();
+    } else if (need_to_swap_bytes_) {
+      TF_RETURN_IF_ERROR(ByteSwapTensor(bulk_entry.val));
+    }
+    return OkStatus();
+  });
+}
+
 Status BundleReader::Lookup(StringPiece key, Tensor* val) {
   CHECK(val != nullptr);
   BundleEntryProto entry;
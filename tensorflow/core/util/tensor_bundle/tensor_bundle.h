@@ -72,9 +72,11 @@ limitations under the License.
 #include "absl/container/flat_hash_map.h"
 #include "absl/functional/function_ref.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_slice.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/gtl/array_slice.h"
 #include "tensorflow/core/lib/io/cache.h"
 #include "tensorflow/core/lib/io/inputbuffer.h"
@@ -83,7 +85,9 @@ limitations under the License.
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/file_system.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/thread_annotations.h"
 #include "tensorflow/core/platform/tstring.h"
 #include "tensorflow/core/protobuf/tensor_bundle.pb.h"
 #include "tensorflow/core/util/tensor_slice_set.h"
@@ -119,9 +123,20 @@ class BundleWriter {
     // Alignment, in bytes, for tensor data.
     // Must be >= 1. The default size of 1 densely packs tensors.
     int data_alignment{1};
+    // Number of data files to spread the tensors over. Each tensor is stored
+    // whole, in the data file with the fewest bytes assigned so far. With
+    // more than one data file, or with "snapshot_tensors", every data file is
+    // written by its own background thread, which serializes and checksums
+    // the tensors, and Add() returns once the tensor is queued.
+    int num_data_files{1};
+    // If true, Add() copies the tensor before queueing it, so the caller may
+    // modify the tensor as soon as Add() returns. Otherwise, tensors that are
+    // written in the background must not be modified until Finish() returns.
+    bool snapshot_tensors{false};
   };
   BundleWriter(Env* env, absl::string_view prefix,
                const Options& options = Options());
+  ~BundleWriter();
 
   // Adds the tensor "val" under key "key".
   // Across calls "key" must be unique but can be added in any order.
@@ -147,21 +162,44 @@ class BundleWriter {
                   const TensorShape& full_tensor_shape,
                   const TensorSlice& slice_spec, const Tensor& slice_tensor);
 
-  // Finishes the writer and flushes.
+  // Finishes the writer and flushes. Waits for the tensors that are written
+  // in the background.
   Status Finish() TF_MUST_USE_RESULT;
 
   Status status() const { return status_; }
 
  private:
+  // A data file that tensors are appended to.
+  struct DataFile {
+    int32_t shard_id = 0;
+    std::string path;
+    std::unique_ptr<tsl::BufferedWritableFile> out;
+    int64_t size = 0;  // Number of bytes written into out.
+    // Number of bytes of the tensors assigned to this file, including the
+    // ones that are still queued.
+    int64_t assigned_bytes = 0;
+    // Writes the queued tensors in order, if writing in the background.
+    std::unique_ptr<thread::ThreadPool> writer;
+  };
+
+  // Appends "val" to "file", and records its offset, size and checksum in
+  // "entry".
+  Status WriteToFile(const Tensor& val, DataFile* file,
+                     BundleEntryProto* entry) const;
+
+  // Waits for the background writes, and returns the first error.
+  Status WaitForWriters();
+
   Env* const env_;  // Not owned.
   const Options options_;
   const std::string prefix_;
   std::string metadata_path_;
-  std::string data_path_;
   bool use_temp_file_;
-  std::unique_ptr<tsl::BufferedWritableFile> out_;
-  int64_t size_;  // Number of bytes written into out_.
-  std::map<std::string, BundleEntryProto> entries_;
+  std::vector<std::unique_ptr<DataFile>> data_files_;
+  mutex mu_;
+  std::map<std::string, BundleEntryProto> entries_ TF_GUARDED_BY(mu_);
+  // The first error of the background writes.
+  Status writer_status_ TF_GUARDED_BY(mu_);
   Status status_;
 
   BundleWriter(const BundleWriter&) = delete;
@@ -251,6 +289,36 @@ class BundleReader {
   // REQUIRES: status().ok()
   Status Lookup(absl::string_view key, Tensor* val) TF_MUST_USE_RESULT;
 
+  // Options for `LookupMany()`.
+  struct LookupManyOptions {
+    // Maximum number of threads that read from the data files concurrently.
+    // Reads are issued from the calling thread if this is at most 1.
+    int num_threads = 8;
+
+    // If true, numeric tensors whose stored bytes need no conversion and are
+    // suitably aligned in their data file are backed by read-only, memory
+    // mapped pages of the file instead of being copied. The contents of such
+    // tensors must not be modified. A preallocated tensor of the stored dtype
+    // and shape is replaced by the mapped tensor rather than filled in place,
+    // and one of another dtype or shape is read into as by `Lookup()`. Tensors
+    // are read as usual when the file system does not support memory mapping.
+    bool use_mmap = false;
+  };
+
+  // Looks up the tensors keyed by "keys" into the corresponding "vals", with
+  // the same semantics as calling `Lookup()` for each key.
+  //
+  // The entries of unpartitioned numeric tensors are sorted by data file and
+  // offset, and read in parallel, splitting large entries into sections, so
+  // that restoring many tensors is bound by disk bandwidth rather than by
+  // sequential reads. Other tensors are read one at a time.
+  //
+  // On error, "vals" may contain nonsense data.
+  // REQUIRES: status().ok() && keys.size() == vals.size()
+  Status LookupMany(absl::Span<const std::string> keys,
+                    absl::Span<Tensor* const> vals,
+                    const LookupManyOptions& options) TF_MUST_USE_RESULT;
+
   // Looks up the tensor pointed to by the internal iterator.
   //
   // On error, "val" may contain nonsense data.
@@ -309,6 +377,14 @@ class BundleReader {
   Status GetValue(const BundleEntryProto& entry,
                   Tensor* val) TF_MUST_USE_RESULT;
 
+  // Returns the buffered reader of data file "shard_id", opening it if needed.
+  Status GetBufferedFile(int32_t shard_id,
+                         io::InputBuffer** buffered_file) TF_MUST_USE_RESULT;
+
+  // Returns the memory mapped contents of data file "shard_id", or nullptr if
+  // the file cannot be mapped.
+  std::shared_ptr<ReadOnlyMemoryRegion> GetMappedFile(int32_t shard_id);
+
   // Reads the slice described by "slice_spec".  The corresponding full tensor
   // has key "ful_tensor_key" and metadata proto "full_tensor_entry".
   // REQUIRES: full_tensor_entry.slices_size() > 0
@@ -327,6 +403,10 @@ class BundleReader {
   table::Iterator* iter_;
   // Owned the InputBuffer objects and their underlying RandomAccessFile's.
   std::unordered_map<int32_t, io::InputBuffer*> data_;
+  // The memory mapped data files, populated on demand by `LookupMany()`.
+  // Holds nullptr for files that cannot be mapped.
+  std::unordered_map<int32_t, std::shared_ptr<ReadOnlyMemoryRegion>>
+      mapped_data_;
 
   // Maps each partitioned tensor's key to its stored slices (represented in a
   // TensorSliceSet).  Populated on-demand.
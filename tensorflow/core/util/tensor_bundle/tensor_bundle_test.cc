@@ -951,6 +951,169 @@ TEST(TensorBundleTest, SortForSequentialAccess) {
                           "tensor-1-2", "tensor-1-1", "tensor-1-0"));
 }
 
+TEST(TensorBundleTest, LookupMany) {
+  Env* env = Env::Default();
+  const std::vector<string> kBundlePrefixes = {Prefix("many0"),
+                                               Prefix("many1")};
+  for (int b = 0; b < 2; ++b) {
+    BundleWriter writer(env, kBundlePrefixes[b]);
+    for (int i = 0; i < 3; ++i) {
+      TF_EXPECT_OK(writer.Add(strings::StrCat("float-", b, "-", i),
+                              Constant_100x100<float>(b * 10 + i)));
+    }
+    TF_EXPECT_OK(writer.Add(strings::StrCat("string-", b),
+                            Constant_2x3<tstring>(strings::StrCat("s", b))));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  const string kMerged = Prefix("many_merged");
+  TF_ASSERT_OK(
+      MergeBundles(env, {kBundlePrefixes[0], kBundlePrefixes[1]}, kMerged));
+
+  BundleReader reader(env, kMerged);
+  TF_ASSERT_OK(reader.status());
+  const std::vector<string> keys = {"float-1-2", "string-0", "float-0-1",
+                                    "float-1-0", "string-1", "float-0-0"};
+  // Preallocated and empty tensors are both filled in.
+  std::vector<Tensor> vals(keys.size());
+  vals[0] = Tensor(DT_FLOAT, TensorShape({100, 100}));
+  std::vector<Tensor*> val_ptrs;
+  for (Tensor& val : vals) val_ptrs.push_back(&val);
+
+  BundleReader::LookupManyOptions options;
+  options.num_threads = 4;
+  TF_ASSERT_OK(reader.LookupMany(keys, val_ptrs, options));
+  test::ExpectTensorEqual<float>(vals[0], Constant_100x100<float>(12));
+  test::ExpectTensorEqual<tstring>(vals[1], Constant_2x3<tstring>("s0"));
+  test::ExpectTensorEqual<float>(vals[2], Constant_100x100<float>(1));
+  test::ExpectTensorEqual<float>(vals[3], Constant_100x100<float>(10));
+  test::ExpectTensorEqual<tstring>(vals[4], Constant_2x3<tstring>("s1"));
+  test::ExpectTensorEqual<float>(vals[5], Constant_100x100<float>(0));
+
+  std::vector<Tensor> missing(1);
+  Tensor* missing_ptr = &missing[0];
+  EXPECT_TRUE(errors::IsNotFound(
+      reader.LookupMany({"nonexistent"}, {&missing_ptr, 1}, options)));
+}
+
+TEST(TensorBundleTest, LookupManyMemoryMapped) {
+  Env* env = Env::Default();
+  for (const int alignment : {1, 64}) {
+    const string prefix = Prefix(strings::StrCat("mmap", alignment));
+    {
+      BundleWriter::Options opts;
+      opts.data_alignment = alignment;
+      BundleWriter writer(env, prefix, opts);
+      TF_EXPECT_OK(writer.Add("a", Constant_2x3<int32>(5)));
+      TF_EXPECT_OK(writer.Add("b", Constant_100x100<double>(2.5)));
+      TF_EXPECT_OK(writer.Add("c", Constant_2x3<float>(-1)));
+      TF_ASSERT_OK(writer.Finish());
+    }
+    const std::vector<string> keys = {"c", "a", "b"};
+    std::vector<Tensor> vals(keys.size());
+    {
+      BundleReader reader(env, prefix);
+      TF_ASSERT_OK(reader.status());
+      std::vector<Tensor*> val_ptrs;
+      for (Tensor& val : vals) val_ptrs.push_back(&val);
+      BundleReader::LookupManyOptions options;
+      options.use_mmap = true;
+      TF_ASSERT_OK(reader.LookupMany(keys, val_ptrs, options));
+    }
+    // Mapped tensors stay valid after the reader is destroyed.
+    test::ExpectTensorEqual<float>(vals[0], Constant_2x3<float>(-1));
+    test::ExpectTensorEqual<int32>(vals[1], Constant_2x3<int32>(5));
+    test::ExpectTensorEqual<double>(vals[2], Constant_100x100<double>(2.5));
+
+    // Preallocated tensors are validated and filled as by `Lookup()`.
+    BundleReader reader(env, prefix);
+    TF_ASSERT_OK(reader.status());
+    BundleReader::LookupManyOptions options;
+    options.use_mmap = true;
+    Tensor preallocated(DT_INT32, TensorShape({3, 2}));
+    Tensor* preallocated_ptr = &preallocated;
+    TF_ASSERT_OK(reader.LookupMany({"a"}, {&preallocated_ptr, 1}, options));
+    EXPECT_EQ(preallocated.shape(), TensorShape({3, 2}));
+    test::ExpectTensorEqual<int32>(
+        preallocated, test::AsTensor<int32>({5, 5, 5, 5, 5, 5}, {3, 2}));
+
+    Tensor wrong_size(DT_FLOAT, TensorShape({3, 3}));
+    Tensor* wrong_size_ptr = &wrong_size;
+    EXPECT_TRUE(errors::IsDataLoss(
+        reader.LookupMany({"c"}, {&wrong_size_ptr, 1}, options)));
+    EXPECT_EQ(wrong_size.shape(), TensorShape({3, 3}));
+  }
+}
+
+TEST(TensorBundleTest, MultipleDataFiles) {
+  Env* env = Env::Default();
+  const std::vector<string> kBundlePrefixes = {Prefix("multi0"),
+                                               Prefix("multi1")};
+  for (int b = 0; b < 2; ++b) {
+    BundleWriter::Options opts;
+    opts.num_data_files = 3;
+    opts.snapshot_tensors = true;
+    BundleWriter writer(env, kBundlePrefixes[b], opts);
+    for (int i = 0; i < 5; ++i) {
+      Tensor val = Constant_100x100<float>(b * 10 + i);
+      TF_EXPECT_OK(writer.Add(strings::StrCat("float-", b, "-", i), val));
+      // The snapshot is written, not the modified tensor.
+      val.flat<float>().setZero();
+    }
+    TF_EXPECT_OK(writer.Add(strings::StrCat("string-", b),
+                            Constant_2x3<tstring>(strings::StrCat("s", b))));
+    TF_ASSERT_OK(writer.Finish());
+    for (int i = 0; i < 3; ++i) {
+      TF_EXPECT_OK(env->FileExists(DataFilename(kBundlePrefixes[b], i, 3)));
+    }
+
+    BundleReader reader(env, kBundlePrefixes[b]);
+    TF_ASSERT_OK(reader.status());
+    for (int i = 0; i < 5; ++i) {
+      Expect<float>(&reader, strings::StrCat("float-", b, "-", i),
+                    Constant_100x100<float>(b * 10 + i));
+    }
+    Expect<tstring>(&reader, strings::StrCat("string-", b),
+                    Constant_2x3<tstring>(strings::StrCat("s", b)));
+  }
+
+  const string kMerged = Prefix("multi_merged");
+  TF_ASSERT_OK(
+      MergeBundles(env, {kBundlePrefixes[0], kBundlePrefixes[1]}, kMerged));
+  BundleReader reader(env, kMerged);
+  TF_ASSERT_OK(reader.status());
+  for (int b = 0; b < 2; ++b) {
+    for (int i = 0; i < 5; ++i) {
+      Expect<float>(&reader, strings::StrCat("float-", b, "-", i),
+                    Constant_100x100<float>(b * 10 + i));
+    }
+  }
+}
+
+TEST(TensorBundleTest, MultipleDataFilesError) {
+  Env* env = Env::Default();
+  BundleWriter::Options opts;
+  opts.num_data_files = 3;
+  {  // Dup keys.
+    const string prefix = Prefix("multi_dup");
+    BundleWriter writer(env, prefix, opts);
+    TF_EXPECT_OK(writer.Add("foo", Constant_2x3(1.f)));
+    TF_EXPECT_OK(writer.Add("bar", Constant_2x3(2.f)));
+    EXPECT_FALSE(writer.Add("foo", Constant_2x3(3.f)).ok());
+    EXPECT_FALSE(writer.Finish().ok());
+    // Neither the metadata nor any data file is left behind.
+    EXPECT_FALSE(env->FileExists(MetaFilename(prefix)).ok());
+    for (int i = 0; i < 3; ++i) {
+      EXPECT_FALSE(env->FileExists(DataFilename(prefix, i, 3)).ok());
+    }
+  }
+  {  // Double finish
+    BundleWriter writer(env, Prefix("multi_bad"), opts);
+    TF_EXPECT_OK(writer.Add("foo", Constant_2x3(1.f)));
+    TF_EXPECT_OK(writer.Finish());
+    EXPECT_FALSE(writer.Finish().ok());
+  }
+}
+
 TEST(TensorBundleTest, Error) {
   {  // Dup keys.
     BundleWriter writer(Env::Default(), Prefix("dup"));
@@ -0,0 +1,172 @@
+# Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Benchmarks for `ColumnarFileDataset` against parsing `tf.train.Example`s."""
+
+import os
+import tempfile
+
+import numpy as np
+
+from tensorflow.core.example import example_pb2
+from tensorflow.core.example import feature_pb2
+from tensorflow.python.data.benchmarks import benchmark_base
+from tensorflow.python.data.experimental.ops import parsing_ops as exp_parsing_ops
+from tensorflow.python.data.ops import dataset_ops
+from tensorflow.python.data.ops import readers as core_readers
+from tensorflow.python.framework import dtypes
+from tensorflow.python.framework import tensor_spec
+from tensorflow.python.lib.io import tf_record
+from tensorflow.python.ops import gen_experimental_dataset_ops
+from tensorflow.python.ops import parsing_ops
+from tensorflow.python.platform import gfile
+from tensorflow.python.platform import googletest
+
+
+class _ColumnarFileDataset(dataset_ops.DatasetSource):
+  """A dataset of batches of the columns of columnar files."""
+
+  def __init__(self, filenames, columns, specs, batch_size):
+    self._element_spec = tuple(
+        tensor_spec.TensorSpec([None] + spec.shape.as_list(), spec.dtype)
+        for spec in specs)
+    variant_tensor = gen_experimental_dataset_ops.columnar_file_dataset(
+        filenames=filenames,
+        columns=columns,
+        batch_size=batch_size,
+        drop_remainder=False,
+        **self._flat_structure)
+    super(_ColumnarFileDataset, self).__init__(variant_tensor)
+
+  @property
+  def element_spec(self):
+    return self._element_spec
+
+
+class ColumnarFileDatasetBenchmark(benchmark_base.DatasetBenchmarkBase):
+  """Benchmarks for `ColumnarFileDataset`."""
+
+  NUM_ROWS = 10000
+  BATCH_SIZE = 256
+  ROW_GROUP_SIZE = 1024
+
+  def _set_up(self, num_cols, feature_size):
+    # Since this isn't test.TestCase, have to manually create a test dir
+    gfile.MakeDirs(googletest.GetTempDir())
+    self._temp_dir = tempfile.mkdtemp(dir=googletest.GetTempDir())
+    self._column_names = ['f%d' % i for i in range(num_cols)]
+    self._specs = [
+        tensor_spec.TensorSpec([feature_size], dtypes.float32)
+        for _ in range(num_cols)
+    ]
+    values = np.random.rand(self.NUM_ROWS, num_cols,
+                            feature_size).astype(np.float32)
+
+    self._columnar_file = os.path.join(self._temp_dir, 'data.columnar')
+    dataset = dataset_ops.Dataset.from_tensor_slices(
+        tuple(values[:, i, :] for i in range(num_cols)))
+    gen_experimental_dataset_ops.dataset_to_columnar_file(
+        dataset._variant_tensor,  # pylint: disable=protected-access
+        filename=self._columnar_file,
+        column_names=self._column_names,
+        row_group_size=self.ROW_GROUP_SIZE)
+
+    self._tfrecord_file = os.path.join(self._temp_dir, 'data.tfrecord')
+    with tf_record.TFRecordWriter(self._tfrecord_file) as writer:
+      for row in values:
+        example = example_pb2.Example(
+            features=feature_pb2.Features(
+                feature={
+                    name: feature_pb2.Feature(
+                        float_list=feature_pb2.FloatList(value=row[i]))
+                    for i, name in enumerate(self._column_names)
+                }))
+        writer.write(example.SerializeToString())
+
+  def _tear_down(self):
+    gfile.DeleteRecursively(self._temp_dir)
+
+  def _run_benchmark(self, dataset, name, num_cols, benchmark_id):
+    self.run_and_report_benchmark(
+        dataset=dataset,
+        num_elements=self.NUM_ROWS // self.BATCH_SIZE,
+        name='%s_with_cols_%d' % (name, num_cols),
+        iters=10,
+        extras={
+            'model_name': 'columnar_file.benchmark.%d' % benchmark_id,
+            'parameters': '%d' % num_cols,
+        },
+        warmup=True)
+
+  def _parse_example_dataset(self, column_names):
+    features = {
+        name: parsing_ops.FixedLenFeature(self._specs[i].shape, dtypes.float32)
+        for i, name in enumerate(self._column_names) if name in column_names
+    }
+    dataset = core_readers.TFRecordDataset(self._tfrecord_file).repeat()
+    dataset = dataset.batch(self.BATCH_SIZE)
+    return dataset.apply(exp_parsing_ops.parse_example_dataset(features))
+
+  def _columnar_file_dataset(self, column_names):
+    specs = [
+        self._specs[i]
+        for i, name in enumerate(self._column_names)
+        if name in column_names
+    ]
+    return _ColumnarFileDataset([self._columnar_file], column_names, specs,
+                                self.BATCH_SIZE).repeat()
+
+  def benchmark_parse_example_dataset(self):
+    for num_cols in [4, 64]:
+      self._set_up(num_cols, feature_size=16)
+      self._run_benchmark(
+          dataset=self._parse_example_dataset(self._column_names),
+          name='parse_example_dataset',
+          num_cols=num_cols,
+          benchmark_id=1)
+      self._tear_down()
+
+  def benchmark_columnar_file_dataset(self):
+    for num_cols in [4, 64]:
+      self._set_up(num_cols, feature_size=16)
+      self._run_benchmark(
+          dataset=self._columnar_file_dataset(self._column_names),
+          name='columnar_file_dataset',
+          num_cols=num_cols,
+          benchmark_id=2)
+      self._tear_down()
+
+  def benchmark_parse_example_dataset_projection(self):
+    for num_cols in [4, 64]:
+      self._set_up(num_cols, feature_size=16)
+      self._run_benchmark(
+          dataset=self._parse_example_dataset(self._column_names[:2]),
+          name='parse_example_dataset_projection',
+          num_cols=num_cols,
+          benchmark_id=3)
+      self._tear_down()
+
+  def benchmark_columnar_file_dataset_projection(self):
+    for num_cols in [4, 64]:
+      self._set_up(num_cols, feature_size=16)
+      self._run_benchmark(
+          dataset=self._columnar_file_dataset(self._column_names[:2]),
+          name='columnar_file_dataset_projection',
+          num_cols=num_cols,
+          benchmark_id=4)
+      self._tear_down()
+
+
+if __name__ == '__main__':
+  benchmark_base.test.main()
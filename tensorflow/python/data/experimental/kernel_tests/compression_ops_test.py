@@ -80,15 +80,18 @@ def _test_v2_eager_only_objects():
 class CompressionOpsTest(test_base.DatasetTestBase, parameterized.TestCase):
 
   @combinations.generate(
-      combinations.times(test_base.default_test_combinations(),
-                         combinations.combine(element=_test_objects())) +
+      combinations.times(
+          test_base.default_test_combinations(),
+          combinations.combine(
+              element=_test_objects(), codec=["snappy", "zstd"])) +
       combinations.times(
           test_base.v2_eager_only_combinations(),
-          combinations.combine(element=_test_v2_eager_only_objects())))
-  def testCompression(self, element):
+          combinations.combine(
+              element=_test_v2_eager_only_objects(), codec=["snappy", "zstd"])))
+  def testCompression(self, element, codec):
     element = element._obj
 
-    compressed = compression_ops.compress(element)
+    compressed = compression_ops.compress(element, codec=codec)
     uncompressed = compression_ops.uncompress(
         compressed, structure.type_spec_from_value(element))
     self.assertValuesEqual(element, self.evaluate(uncompressed))
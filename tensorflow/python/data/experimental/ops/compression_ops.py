@@ -17,11 +17,14 @@ from tensorflow.python.data.util import structure
 from tensorflow.python.ops import gen_experimental_dataset_ops as ged_ops
 
 
-def compress(element):
+def compress(element, codec="snappy", level=0):
   """Compress a dataset element.
 
   Args:
     element: A nested structure of types supported by Tensorflow.
+    codec: The codec to compress with, either "snappy" or "zstd".
+    level: The zstd compression level. 0 selects zstd's default level. Ignored
+      by snappy.
 
   Returns:
     A variant tensor representing the compressed element. This variant can be
@@ -29,7 +32,7 @@ def compress(element):
   """
   element_spec = structure.type_spec_from_value(element)
   tensor_list = structure.to_tensor_list(element_spec, element)
-  return ged_ops.compress_element(tensor_list)
+  return ged_ops.compress_element(tensor_list, codec=codec, level=level)
 
 
 def uncompress(element, output_spec):
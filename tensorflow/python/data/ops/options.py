@@ -45,12 +45,17 @@ class AutotuneAlgorithm(enum.Enum):
 
   STAGE_BASED: In each optimization step, this algorithm chooses the worst
   bottleneck parameter and increases its value by 1.
+
+  EMPIRICAL: Similar to STAGE_BASED, but predicts the effect of parallelism
+  from throughput curves measured while the pipeline runs, which account for
+  CPU contention with the training step, and tunes buffer sizes along with it.
   """
   DEFAULT = 0
   HILL_CLIMB = 1
   GRADIENT_DESCENT = 2
   MAX_PARALLELISM = 3
   STAGE_BASED = 4
+  EMPIRICAL = 5
 
   @classmethod
   def _to_proto(cls, obj):
@@ -64,9 +69,11 @@ class AutotuneAlgorithm(enum.Enum):
       return model_pb2.AutotuneAlgorithm.MAX_PARALLELISM
     if obj == cls.STAGE_BASED:
       return model_pb2.AutotuneAlgorithm.STAGE_BASED
+    if obj == cls.EMPIRICAL:
+      return model_pb2.AutotuneAlgorithm.EMPIRICAL
     raise ValueError(
         f"Invalid `obj.` Supported values include `DEFAULT`, `HILL_CLIMB` "
-        f"`GRADIENT_DESCENT`, and `STAGE_BASED`. Got {obj.name}.")
+        f"`GRADIENT_DESCENT`, `STAGE_BASED`, and `EMPIRICAL`. Got {obj.name}.")
 
   @classmethod
   def _from_proto(cls, pb):
@@ -80,9 +87,11 @@ class AutotuneAlgorithm(enum.Enum):
       return cls.MAX_PARALLELISM
     if pb == model_pb2.AutotuneAlgorithm.STAGE_BASED:
       return cls.STAGE_BASED
+    if pb == model_pb2.AutotuneAlgorithm.EMPIRICAL:
+      return cls.EMPIRICAL
     raise ValueError(
         f"Invalid `pb.` Supported values include `DEFAULT`, `HILL_CLIMB`, "
-        f"`GRADIENT_DESCENT` and `STAGE_BASED`. Got {pb}.")
+        f"`GRADIENT_DESCENT`, `STAGE_BASED` and `EMPIRICAL`. Got {pb}.")
 
 
 @tf_export("data.experimental.AutoShardPolicy")
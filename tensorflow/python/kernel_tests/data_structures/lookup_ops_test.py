@@ -3369,6 +3369,47 @@ class MutableHashTableOpTest(test.TestCase):
     self.assertAllEqual([b"brain", b"salad", b"surgery"], sorted_keys)
     self.assertAllEqual([0, 1, 2], sorted_values)
 
+  def testMutableHashTableWithShards(self, is_anonymous):
+    if is_anonymous:
+      self.skipTest("num_shards is only supported by MutableHashTableV2")
+    shared_name = ""
+    if context.executing_eagerly():
+      shared_name = "table_%d" % (ops.uid(),)
+    table = gen_lookup_ops.mutable_hash_table_v2(
+        shared_name=shared_name,
+        key_dtype=dtypes.int64,
+        value_dtype=dtypes.int64,
+        num_shards=8)
+    keys = constant_op.constant(np.arange(1000), dtypes.int64)
+    values = constant_op.constant(np.arange(1000) * 2, dtypes.int64)
+    self.evaluate(gen_lookup_ops.lookup_table_insert_v2(table, keys, values))
+    size = gen_lookup_ops.lookup_table_size_v2(table)
+    self.assertAllEqual(1000, self.evaluate(size))
+
+    remove_keys = constant_op.constant([0, 1, 5000], dtypes.int64)
+    self.evaluate(gen_lookup_ops.lookup_table_remove_v2(table, remove_keys))
+    size = gen_lookup_ops.lookup_table_size_v2(table)
+    self.assertAllEqual(998, self.evaluate(size))
+
+    output = gen_lookup_ops.lookup_table_find_v2(
+        table, constant_op.constant([1, 2, 999, 5000], dtypes.int64),
+        constant_op.constant(-1, dtypes.int64))
+    self.assertAllEqual([-1, 4, 1998, -1], self.evaluate(output))
+
+    exported_keys, exported_values = gen_lookup_ops.lookup_table_export_v2(
+        table, Tkeys=dtypes.int64, Tvalues=dtypes.int64)
+    self.assertAllEqual(np.arange(2, 1000),
+                        np.sort(self.evaluate(exported_keys)))
+    self.assertAllEqual(
+        np.arange(2, 1000) * 2, np.sort(self.evaluate(exported_values)))
+
+    self.evaluate(
+        gen_lookup_ops.lookup_table_import_v2(
+            table, constant_op.constant([7, 8], dtypes.int64),
+            constant_op.constant([70, 80], dtypes.int64)))
+    size = gen_lookup_ops.lookup_table_size_v2(table)
+    self.assertAllEqual(2, self.evaluate(size))
+
   # TODO(https://github.com/tensorflow/tensorflow/issues/24439): remove exepectedFailure when fixed
   @unittest.expectedFailure
   @test_util.run_v2_only